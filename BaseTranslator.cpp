@@ -36,10 +36,13 @@
 #include <stdio.h>
 
 #include <algorithm>
+#include <new>
 
 #include <Catalog.h>
 #include <Locale.h>
 
+#include "bitmapconversion.h"
+
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "BaseTranslator"
@@ -68,8 +71,8 @@ BaseTranslator::BaseTranslator(const char *name, const char *info,
 	BTranslator()
 {
 	fSettings = new TranslatorSettings(settingsFile, defaults, defCount);
-	fSettings->LoadSettings();
-		// load settings from the Base Translator settings file
+		// the settings file is loaded on first use, see
+		// TranslatorSettings::EnsureLoaded()
 
 	fVersion = version;
 	fName = new char[strlen(name) + 1];
@@ -500,6 +503,12 @@ BaseTranslator::Identify(BPositionIO *inSource,
 //				read,		pointer to the data already read from
 //							inSource
 //
+//				ioExtension,	may ask for another color space
+//								through B_TRANSLATOR_EXT_BITMAP_COLOR_SPACE,
+//								and for only the header or the data
+//								through B_TRANSLATOR_EXT_HEADER_ONLY and
+//								B_TRANSLATOR_EXT_DATA_ONLY
+//
 //				outType,	the type of data to convert to
 //
 //				outDestination,	where the output is written to
@@ -507,7 +516,10 @@ BaseTranslator::Identify(BPositionIO *inSource,
 // Postconditions:
 //
 // Returns: B_NO_TRANSLATOR,	if the data is not in a supported
-//								format
+//								format or color space
+//
+// B_BAD_DATA, if the data is shorter than the header says or the
+//			header's dataSize isn't rowBytes times its height
 //
 // B_ERROR, if there was an error allocating memory or some other
 //			error
@@ -516,10 +528,15 @@ BaseTranslator::Identify(BPositionIO *inSource,
 // ---------------------------------------------------------------
 status_t
 BaseTranslator::translate_from_bits_to_bits(BPositionIO *inSource,
-	uint32 outType,	BPositionIO *outDestination)
+	BMessage *ioExtension, uint32 outType, BPositionIO *outDestination)
 {
 	TranslatorBitmap bitsHeader;
 	bool bheaderonly = false, bdataonly = false;
+	if (ioExtension != NULL) {
+		bheaderonly = ioExtension->GetBool(B_TRANSLATOR_EXT_HEADER_ONLY,
+			false);
+		bdataonly = ioExtension->GetBool(B_TRANSLATOR_EXT_DATA_ONLY, false);
+	}
 
 	status_t result;
 	result = identify_bits_header(inSource, NULL, &bitsHeader);
@@ -528,36 +545,36 @@ BaseTranslator::translate_from_bits_to_bits(BPositionIO *inSource,
 
 	// Translate B_TRANSLATOR_BITMAP to B_TRANSLATOR_BITMAP, easy enough :)
 	if (outType == B_TRANSLATOR_BITMAP) {
+		int32 colors;
+		if (ioExtension != NULL && ioExtension->FindInt32(
+				B_TRANSLATOR_EXT_BITMAP_COLOR_SPACE, &colors) == B_OK
+			&& (color_space)colors != bitsHeader.colors) {
+			return convert_bitmap(inSource, bitsHeader, (color_space)colors,
+				bheaderonly || !bdataonly, bdataonly || !bheaderonly,
+				outDestination);
+		}
+
+		// the data has to be as big as the rows the header gives
+		uint32 dataSize = bitsHeader.dataSize;
+		if ((uint64)bitsHeader.rowBytes
+				* (bitsHeader.bounds.IntegerHeight() + 1) != dataSize)
+			return B_BAD_DATA;
+
 		// write out bitsHeader (only if configured to)
 		if (bheaderonly || (!bheaderonly && !bdataonly)) {
 			if (swap_data(B_UINT32_TYPE, &bitsHeader,
 				sizeof(TranslatorBitmap), B_SWAP_HOST_TO_BENDIAN) != B_OK)
 				return B_ERROR;
-			if (outDestination->Write(&bitsHeader,
-				sizeof(TranslatorBitmap)) != sizeof(TranslatorBitmap))
-				return B_ERROR;
+			result = outDestination->WriteExactly(&bitsHeader,
+				sizeof(TranslatorBitmap));
+			if (result != B_OK)
+				return result;
 		}
 
 		// write out the data (only if configured to)
-		if (bdataonly || (!bheaderonly && !bdataonly)) {
-			uint8 buf[1024];
-			uint32 remaining = B_BENDIAN_TO_HOST_INT32(bitsHeader.dataSize);
-			ssize_t rd, writ;
-			rd = inSource->Read(buf, 1024);
-			while (rd > 0) {
-				writ = outDestination->Write(buf, rd);
-				if (writ < 0)
-					break;
-				remaining -= static_cast<uint32>(writ);
-				rd = inSource->Read(buf, std::min((uint32)1024,
-					remaining));
-			}
-
-			if (remaining > 0)
-				return B_ERROR;
-			else
-				return B_OK;
-		} else
+		if (bdataonly || (!bheaderonly && !bdataonly))
+			return copy_stream_data(inSource, outDestination, dataSize);
+		else
 			return B_OK;
 
 	} else
@@ -572,7 +589,7 @@ BaseTranslator::BitsTranslate(BPositionIO *inSource,
 {
 	status_t result = BitsCheck(inSource, ioExtension, outType);
 	if (result == B_OK && outType == B_TRANSLATOR_BITMAP) {
-		result = translate_from_bits_to_bits(inSource, outType,
+		result = translate_from_bits_to_bits(inSource, ioExtension, outType,
 			outDestination);
 	} else if (result >= B_OK) {
 		// If NOT B_TRANSLATOR_BITMAP type it could be the derived format
@@ -728,14 +745,106 @@ BaseTranslator::NewConfigView(TranslatorSettings *settings)
 }
 
 
-void
-translate_direct_copy(BPositionIO *inSource, BPositionIO *outDestination)
+// ---------------------------------------------------------------
+// copy_stream_data
+//
+// Copies data from the current position of inSource to
+// outDestination, a large block at a time. A BMallocIO source is
+// written from its buffer directly, and a BMallocIO destination is
+// grown to its final size before the first block.
+//
+// Preconditions:
+//
+// Parameters:	inSource,	the data to copy
+//
+//				outDestination,	where the data is written to
+//
+//				size,		the amount of data to copy, or a
+//							negative value to copy all of it
+//
+// Postconditions:
+//
+// Returns: B_BAD_DATA, if inSource holds less than size bytes, which is
+// checked before anything is written where it can tell its size
+//
+// B_NO_MEMORY, if the copy buffer couldn't be allocated
+//
+// the error from inSource or outDestination, if reading or
+// writing failed
+//
+// B_OK, if all of the data was copied
+// ---------------------------------------------------------------
+status_t
+copy_stream_data(BPositionIO *inSource, BPositionIO *outDestination,
+	off_t size)
 {
-	const size_t kbufsize = 2048;
-	uint8 buffer[kbufsize];
-	ssize_t ret = inSource->Read(buffer, kbufsize);
-	while (ret > 0) {
-		outDestination->Write(buffer, ret);
-		ret = inSource->Read(buffer, kbufsize);
+	off_t sourceSize;
+	if (size >= 0 && inSource->GetSize(&sourceSize) == B_OK
+		&& sourceSize - inSource->Position() < size)
+		return B_BAD_DATA;
+
+	BMallocIO *mallocSource = dynamic_cast<BMallocIO *>(inSource);
+	if (mallocSource != NULL) {
+		off_t position = mallocSource->Position();
+		off_t length = std::max((off_t)0,
+			(off_t)mallocSource->BufferLength() - position);
+		if (size >= 0)
+			length = std::min(length, size);
+		status_t result = outDestination->WriteExactly(
+			(const uint8 *)mallocSource->Buffer() + position, length);
+		if (result != B_OK)
+			return result;
+		mallocSource->Seek(length, SEEK_CUR);
+		return length < size ? B_BAD_DATA : B_OK;
 	}
+
+	const size_t kBufferSize = 256 * 1024;
+	uint8 *buffer = new(std::nothrow) uint8[kBufferSize];
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	BMallocIO *mallocDestination = dynamic_cast<BMallocIO *>(outDestination);
+	off_t destinationSize = -1;
+	if (mallocDestination != NULL && size > 0) {
+		// grow the destination once rather than with every block
+		destinationSize = mallocDestination->BufferLength();
+		status_t result = mallocDestination->SetSize(
+			std::max(destinationSize, mallocDestination->Position() + size));
+		if (result != B_OK) {
+			delete[] buffer;
+			return result;
+		}
+	}
+
+	status_t result = B_OK;
+	while (size != 0) {
+		size_t chunk = kBufferSize;
+		if (size > 0)
+			chunk = std::min((off_t)kBufferSize, size);
+		ssize_t bytesRead = inSource->Read(buffer, chunk);
+		if (bytesRead <= 0) {
+			if (bytesRead < 0)
+				result = bytesRead;
+			else if (size > 0)
+				result = B_BAD_DATA;
+			break;
+		}
+		result = outDestination->WriteExactly(buffer, bytesRead);
+		if (result != B_OK)
+			break;
+		if (size > 0)
+			size -= bytesRead;
+	}
+
+	delete[] buffer;
+	if (result != B_OK && destinationSize >= 0)
+		mallocDestination->SetSize(destinationSize);
+	return result;
+}
+
+
+status_t
+translate_direct_copy(BPositionIO *inSource, BPositionIO *outDestination)
+{
+	return copy_stream_data(inSource, outDestination, -1);
 }
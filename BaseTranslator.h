@@ -124,7 +124,7 @@ protected:
 		BPositionIO *outDestination);
 
 	status_t translate_from_bits_to_bits(BPositionIO *inSource,
-		uint32 outType, BPositionIO *outDestination);
+		BMessage *ioExtension, uint32 outType, BPositionIO *outDestination);
 
 	virtual ~BaseTranslator();
 		// this is protected because the object is deleted by the
@@ -145,7 +145,10 @@ private:
 	uint32 fTranType;
 };
 
-void translate_direct_copy(BPositionIO *inSource, BPositionIO *outDestination);
+status_t copy_stream_data(BPositionIO *inSource, BPositionIO *outDestination,
+	off_t size);
+status_t translate_direct_copy(BPositionIO *inSource,
+	BPositionIO *outDestination);
 
 #endif // #ifndef BASE_TRANSLATOR_H
 
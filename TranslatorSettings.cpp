@@ -59,6 +59,7 @@ TranslatorSettings::TranslatorSettings(const char *settingsFile,
 	fSettingsPath.Append(settingsFile);
 
 	fRefCount = 1;
+	fLoaded = false;
 
 	if (defCount > 0) {
 		fDefaults = defaults;
@@ -190,6 +191,7 @@ TranslatorSettings::LoadSettings()
 	status_t result;
 
 	fLock.Lock();
+	fLoaded = true;
 
 	// Don't try to open the settings file if there are
 	// no settings that need to be loaded
@@ -234,6 +236,7 @@ TranslatorSettings::LoadSettings(BMessage *pmsg)
 		return B_BAD_VALUE;
 
 	fLock.Lock();
+	EnsureLoaded();
 	const TranSetting *defaults = fDefaults;
 	for (int32 i = 0; i < fDefCount; i++) {
 		switch (defaults[i].dataType) {
@@ -296,6 +299,7 @@ TranslatorSettings::SaveSettings()
 	status_t result;
 
 	fLock.Lock();
+	EnsureLoaded();
 
 	// Only write out settings file if there are
 	// actual settings stored by this object
@@ -344,6 +348,7 @@ TranslatorSettings::GetConfigurationMessage(BMessage *pmsg)
 		}
 		if (i == fDefCount) {
 			fLock.Lock();
+			EnsureLoaded();
 			result = B_OK;
 
 			const TranSetting *defs = fDefaults;
@@ -398,6 +403,28 @@ TranslatorSettings::FindTranSetting(const char *name)
 	return NULL;
 }
 
+// ---------------------------------------------------------------
+// EnsureLoaded
+//
+// Loads the settings file if it has not been loaded yet. Loading
+// is deferred so that constructing the translator, which happens
+// for every application using the Translation Kit, does no I/O.
+//
+// Preconditions: fLock is held
+//
+// Parameters:
+//
+// Postconditions: the settings file has been read
+//
+// Returns:
+// ---------------------------------------------------------------
+void
+TranslatorSettings::EnsureLoaded()
+{
+	if (!fLoaded)
+		LoadSettings();
+}
+
 // ---------------------------------------------------------------
 // SetGetBool
 //
@@ -422,6 +449,7 @@ TranslatorSettings::SetGetBool(const char *name, bool *pbool)
 	bool bprevValue;
 
 	fLock.Lock();
+	EnsureLoaded();
 
 	const TranSetting *def = FindTranSetting(name);
 	if (def) {
@@ -460,6 +488,7 @@ TranslatorSettings::SetGetInt32(const char *name, int32 *pint32)
 	int32 prevValue;
 
 	fLock.Lock();
+	EnsureLoaded();
 
 	const TranSetting *def = FindTranSetting(name);
 	if (def) {
@@ -70,6 +70,9 @@ public:
 
 private:
 	const TranSetting *FindTranSetting(const char *name);
+	void EnsureLoaded();
+		// reads the settings file the first time a setting
+		// is actually needed
 	~TranslatorSettings();
 		// private so that Release() must be used
 		// to delete the object
@@ -83,6 +86,9 @@ private:
 	BMessage fSettingsMsg;
 		// the actual settings
 
+	bool fLoaded;
+		// whether the settings file has been read yet
+
 	const TranSetting *fDefaults;
 	int32 fDefCount;
 };
@@ -0,0 +1,321 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "benchresults.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <algorithm>
+
+// Which way is better for the metrics runs are compared by
+static const struct {
+	const char*	metric;
+	bool		higherIsBetter;
+} sMetricDirections[] = {
+	{ "megapixelsPerSecond", true },
+	{ "megabytesPerSecond", true },
+	{ "latencyP50", false },
+	{ "latencyP90", false },
+	{ "latencyP99", false },
+	{ "bitsPerPixel", false },
+	{ "peakMemory", false },
+	{ "firstPaintFraction", false },
+	{ "hitRate", true },
+	{ "psnr", true }
+};
+
+
+static bool
+find_direction(const std::string& metric, bool* higherIsBetter)
+{
+	for (const auto& direction : sMetricDirections) {
+		if (metric == direction.metric) {
+			*higherIsBetter = direction.higherIsBetter;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+static status_t
+errno_status()
+{
+	return errno > 0 ? -errno : B_IO_ERROR;
+}
+
+
+// #pragma mark -
+
+
+void
+BenchResults::Add(const std::string& name, const char* metric, double value)
+{
+	printf("%-40s %-22s %14.3f\n", name.c_str(), metric, value);
+	BenchResult* result = _Find(name);
+	if (result == NULL) {
+		fResults.push_back(BenchResult());
+		result = &fResults.back();
+		result->name = name;
+	}
+	for (auto& entry : result->metrics) {
+		if (entry.first == metric) {
+			entry.second = value;
+			return;
+		}
+	}
+	result->metrics.push_back(std::make_pair(std::string(metric), value));
+}
+
+
+status_t
+BenchResults::WriteJSON(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return errno_status();
+
+	fputs("{\n\t\"results\": [\n", file);
+	for (size_t i = 0; i < fResults.size(); i++) {
+		const BenchResult& result = fResults[i];
+		fprintf(file, "\t\t{\"name\": \"%s\"", result.name.c_str());
+		for (const auto& metric : result.metrics) {
+			fprintf(file, ", \"%s\": %.6g", metric.first.c_str(),
+				metric.second);
+		}
+		fputs(i + 1 < fResults.size() ? "},\n" : "}\n", file);
+	}
+	fputs("\t]\n}\n", file);
+	return fclose(file) == 0 ? B_OK : errno_status();
+}
+
+
+status_t
+BenchResults::ReadJSON(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+		return errno_status();
+
+	char* line = NULL;
+	size_t size = 0;
+	// {"name": "<name>", "<metric>": <value>, ...}
+	while (getline(&line, &size, file) > 0) {
+		const char* start = strstr(line, "{\"name\": \"");
+		if (start == NULL)
+			continue;
+		start += 10;
+		const char* end = strchr(start, '"');
+		if (end == NULL)
+			continue;
+		BenchResult result;
+		result.name.assign(start, end);
+
+		const char* key;
+		while ((key = strstr(end + 1, ", \"")) != NULL) {
+			key += 3;
+			const char* keyEnd = strchr(key, '"');
+			if (keyEnd == NULL || strncmp(keyEnd, "\": ", 3) != 0)
+				break;
+			char* valueEnd;
+			const double value = strtod(keyEnd + 3, &valueEnd);
+			if (valueEnd == keyEnd + 3)
+				break;
+			result.metrics.push_back(std::make_pair(std::string(key, keyEnd),
+				value));
+			end = valueEnd - 1;
+		}
+		fResults.push_back(result);
+	}
+	free(line);
+	fclose(file);
+	return fResults.empty() ? B_BAD_DATA : B_OK;
+}
+
+
+int32
+BenchResults::Compare(const BenchResults& baseline, double threshold) const
+{
+	int32 regressions = 0;
+	int32 compared = 0;
+	for (const BenchResult& result : fResults) {
+		const BenchResult* before = baseline._Find(result.name);
+		if (before == NULL)
+			continue;
+		for (const auto& metric : result.metrics) {
+			bool higherIsBetter;
+			if (!find_direction(metric.first, &higherIsBetter))
+				continue;
+			for (const auto& old : before->metrics) {
+				if (old.first != metric.first || old.second <= 0)
+					continue;
+				compared++;
+				const double change = (metric.second - old.second)
+					/ old.second * 100;
+				if ((higherIsBetter ? -change : change) > threshold) {
+					printf("regression: %s %s %.3f -> %.3f (%+.1f%%)\n",
+						result.name.c_str(), metric.first.c_str(),
+						old.second, metric.second, change);
+					regressions++;
+				}
+			}
+		}
+	}
+	printf("%d of %d metrics regressed by more than %.1f%%\n",
+		(int)regressions, (int)compared, threshold);
+	return regressions;
+}
+
+
+BenchResult*
+BenchResults::_Find(const std::string& name)
+{
+	for (BenchResult& result : fResults) {
+		if (result.name == name)
+			return &result;
+	}
+	return NULL;
+}
+
+
+const BenchResult*
+BenchResults::_Find(const std::string& name) const
+{
+	for (const BenchResult& result : fResults) {
+		if (result.name == name)
+			return &result;
+	}
+	return NULL;
+}
+
+
+// #pragma mark -
+
+
+#if defined(__HAIKU__)
+
+static uint64
+team_memory()
+{
+	uint64 total = 0;
+	ssize_t cookie = 0;
+	area_info info;
+	while (get_next_area_info(B_CURRENT_TEAM, &cookie, &info) == B_OK)
+		total += info.ram_size;
+	return total;
+}
+
+#elif defined(__linux__)
+
+// A size from /proc/self/status in bytes, 0 if it isn't there
+static uint64
+read_status_size(const char* field)
+{
+	FILE* file = fopen("/proc/self/status", "r");
+	if (file == NULL)
+		return 0;
+	const size_t length = strlen(field);
+	char line[256];
+	uint64 size = 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (strncmp(line, field, length) == 0 && line[length] == ':') {
+			size = strtoull(line + length + 1, NULL, 10) * 1024;
+			break;
+		}
+	}
+	fclose(file);
+	return size;
+}
+
+#endif
+
+
+PeakMemoryMeter::PeakMemoryMeter()
+	:
+	fStart(0)
+#ifdef __HAIKU__
+	,
+	fRunning(false),
+	fPeak(0)
+#endif
+{
+}
+
+
+PeakMemoryMeter::~PeakMemoryMeter()
+{
+#ifdef __HAIKU__
+	if (fRunning)
+		Stop();
+#endif
+}
+
+
+void
+PeakMemoryMeter::Start()
+{
+#ifdef __GLIBC__
+	// or memory freed earlier would be used again without being counted
+	malloc_trim(0);
+#endif
+#if defined(__HAIKU__)
+	fStart = team_memory();
+	fPeak = fStart;
+	fRunning = true;
+	fSampler = std::thread(&PeakMemoryMeter::_Sample, this);
+#elif defined(__linux__)
+	// "5" resets the high water mark to the memory now in use
+	fStart = 0;
+	FILE* file = fopen("/proc/self/clear_refs", "w");
+	if (file == NULL)
+		return;
+	const bool reset = fputs("5", file) >= 0;
+	if (fclose(file) == 0 && reset)
+		fStart = read_status_size("VmRSS");
+#endif
+}
+
+
+uint64
+PeakMemoryMeter::Stop()
+{
+#if defined(__HAIKU__)
+	fRunning = false;
+	fSampler.join();
+	const uint64 peak = std::max(fPeak.load(), team_memory());
+	return peak > fStart ? peak - fStart : 0;
+#elif defined(__linux__)
+	if (fStart == 0)
+		return 0;
+	const uint64 peak = read_status_size("VmHWM");
+	return peak > fStart ? peak - fStart : 0;
+#else
+	return 0;
+#endif
+}
+
+
+#ifdef __HAIKU__
+
+// Areas are only looked at every millisecond, so short peaks may be missed
+void
+PeakMemoryMeter::_Sample()
+{
+	while (fRunning) {
+		const uint64 memory = team_memory();
+		uint64 peak = fPeak;
+		while (memory > peak && !fPeak.compare_exchange_weak(peak, memory))
+			;
+		snooze(1000);
+	}
+}
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef BENCHRESULTS_H
+#define BENCHRESULTS_H
+
+#include "codecdefs.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// What jxlbench measured, kept to write out as JSON and to compare with an
+// earlier run.
+
+struct BenchResult {
+			std::string		name;
+			std::vector<std::pair<std::string, double> > metrics;
+};
+
+
+class BenchResults {
+public:
+			void			Add(const std::string& name, const char* metric,
+								double value);
+				// also prints it
+
+			status_t		WriteJSON(const char* path) const;
+				// one result per line, so runs can be diffed
+			status_t		ReadJSON(const char* path);
+				// reads what WriteJSON() wrote
+
+			int32			Compare(const BenchResults& baseline,
+								double threshold) const;
+				// Prints the metrics that got worse than in baseline by
+				// more than threshold percent, returns how many did.
+				// Metrics not known to be better higher or lower are left
+				// out.
+
+private:
+			BenchResult*	_Find(const std::string& name);
+			const BenchResult* _Find(const std::string& name) const;
+
+			std::vector<BenchResult> fResults;
+};
+
+
+// The most memory in use while it ran, above what was in use when it was
+// started. It goes by the resident memory of the whole process, so
+// only one thing should be measured at a time.
+class PeakMemoryMeter {
+public:
+							PeakMemoryMeter();
+							~PeakMemoryMeter();
+
+			void			Start();
+			uint64			Stop();
+				// 0 where it can't be measured
+
+private:
+			uint64			fStart;
+#ifdef __HAIKU__
+			void			_Sample();
+
+			std::atomic<bool> fRunning;
+			std::atomic<uint64> fPeak;
+			std::thread		fSampler;
+#endif
+};
+
+
+#endif // BENCHRESULTS_H
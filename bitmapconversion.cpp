@@ -0,0 +1,95 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "bitmapconversion.h"
+
+#include <string.h>
+
+#include <ByteOrder.h>
+#include <DataIO.h>
+#include <InterfaceDefs.h>
+
+#include <algorithm>
+#include <new>
+
+#include "pixelconversion.h"
+
+const size_t kConversionBufferSize = 1024 * 1024;
+
+
+status_t
+convert_bitmap(BPositionIO* in, const TranslatorBitmap& header,
+	color_space to, bool writeHeader, bool writeData, BPositionIO* out)
+{
+	const uint32 sourceBits = RowConverter::BitsPerPixel(header.colors);
+	const uint32 targetBits = RowConverter::BitsPerPixel(to);
+	if (sourceBits == 0 || targetBits == 0)
+		return B_NO_TRANSLATOR;
+
+	const int32 width = header.bounds.IntegerWidth() + 1;
+	const int32 height = header.bounds.IntegerHeight() + 1;
+	const size_t sourceRowBytes = header.rowBytes;
+	if (width < 1 || height < 1
+		|| (uint64)width * sourceBits > (uint64)sourceRowBytes * 8)
+		return B_BAD_DATA;
+	// padded to 4 bytes, like a BBitmap
+	const size_t rowBytes = ((size_t)width * targetBits + 31) / 32 * 4;
+	const size_t usedBytes = ((size_t)width * targetBits + 7) / 8;
+	const uint64 dataSize = (uint64)rowBytes * height;
+	if (dataSize > UINT32_MAX)
+		return B_NOT_SUPPORTED;
+
+	const color_map* map = NULL;
+	if (header.colors == B_CMAP8 || to == B_CMAP8) {
+		map = system_colors();
+		if (map == NULL)
+			return B_NO_TRANSLATOR;
+	}
+	RowConverter converter(header.colors, to, width, map);
+	status_t status = converter.InitCheck();
+	if (status != B_OK)
+		return status;
+
+	if (writeHeader) {
+		TranslatorBitmap outHeader;
+		outHeader.magic = B_TRANSLATOR_BITMAP;
+		outHeader.bounds = header.bounds;
+		outHeader.rowBytes = rowBytes;
+		outHeader.colors = to;
+		outHeader.dataSize = dataSize;
+		if (swap_data(B_UINT32_TYPE, &outHeader, sizeof(TranslatorBitmap),
+				B_SWAP_HOST_TO_BENDIAN) != B_OK)
+			return B_ERROR;
+		status = out->WriteExactly(&outHeader, sizeof(TranslatorBitmap));
+		if (status != B_OK)
+			return status;
+	}
+	if (!writeData)
+		return B_OK;
+
+	const int32 blockRows = std::max((size_t)1, std::min((size_t)height,
+		kConversionBufferSize / std::max(sourceRowBytes, rowBytes)));
+	uint8* sourceRows = new(std::nothrow) uint8[sourceRowBytes * blockRows];
+	uint8* destRows = new(std::nothrow) uint8[rowBytes * blockRows];
+	if (sourceRows == NULL || destRows == NULL)
+		status = B_NO_MEMORY;
+
+	for (int32 y = 0; y < height && status == B_OK; y += blockRows) {
+		const int32 count = std::min(blockRows, height - y);
+		status = in->ReadExactly(sourceRows, sourceRowBytes * count);
+		if (status != B_OK)
+			break;
+
+		for (int32 i = 0; i < count; i++) {
+			uint8* destRow = destRows + i * rowBytes;
+			converter.Convert(sourceRows + i * sourceRowBytes, destRow);
+			memset(destRow + usedBytes, 0, rowBytes - usedBytes);
+		}
+		status = out->WriteExactly(destRows, rowBytes * count);
+	}
+
+	delete[] sourceRows;
+	delete[] destRows;
+	return status;
+}
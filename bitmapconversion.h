@@ -0,0 +1,25 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef BITMAPCONVERSION_H
+#define BITMAPCONVERSION_H
+
+#include <GraphicsDefs.h>
+#include <TranslatorFormats.h>
+
+class BPositionIO;
+
+
+status_t convert_bitmap(BPositionIO* in, const TranslatorBitmap& header,
+	color_space to, bool writeHeader, bool writeData, BPositionIO* out);
+	// Reads the pixels that follow a bitmap header, given in host byte
+	// order, and writes them out as a bitmap in another color space. Rows
+	// go through B_RGBA32 unless one of the sides already is, a megabyte
+	// at a time. writeHeader and writeData choose which parts of the
+	// bitmap are written, for B_TRANSLATOR_EXT_HEADER_ONLY and
+	// B_TRANSLATOR_EXT_DATA_ONLY. Returns B_NO_TRANSLATOR if either color
+	// space isn't one identify_bits_header() accepts.
+
+
+#endif // BITMAPCONVERSION_H
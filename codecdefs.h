@@ -0,0 +1,116 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CODECDEFS_H
+#define CODECDEFS_H
+
+// The codec core also builds on other systems, to test and profile it
+// against a plain libjxl. Elsewhere, these stand in for the few Haiku
+// definitions it uses.
+
+#ifdef __HAIKU__
+
+#include <GraphicsDefs.h>
+#include <OS.h>
+#include <SupportDefs.h>
+
+#else // !__HAIKU__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+typedef int32 status_t;
+typedef int64 bigtime_t;
+typedef int32 thread_id;
+
+// Only the meaning matches Haiku, not the values
+enum {
+	B_OK				= 0,
+	B_ERROR				= -1,
+	B_NO_MEMORY			= -2,
+	B_IO_ERROR			= -3,
+	B_BAD_VALUE			= -4,
+	B_BAD_DATA			= -5,
+	B_CANCELED			= -6,
+	B_NOT_SUPPORTED		= -7,
+	B_NO_TRANSLATOR		= -8,
+	B_MISSING_LIBRARY	= -9
+};
+
+// These do match, bitmaps are written in Haiku's layout
+enum color_space {
+	B_NO_COLOR_SPACE	= 0x0000,
+	B_RGB32				= 0x0008,
+	B_RGBA32			= 0x2008,
+	B_RGB24				= 0x0003,
+	B_RGB16				= 0x0005,
+	B_RGB15				= 0x0010,
+	B_RGBA15			= 0x2010,
+	B_GRAY8				= 0x0002,
+	B_GRAY1				= 0x0001,
+	B_CMAP8				= 0x0004,
+	B_RGB32_BIG			= 0x1008,
+	B_RGBA32_BIG		= 0x3008,
+	B_RGB24_BIG			= 0x1003,
+	B_RGB16_BIG			= 0x1005,
+	B_RGB15_BIG			= 0x1010,
+	B_RGBA15_BIG		= 0x3010,
+	B_CMY24				= 0xC001,
+	B_CMY32				= 0xC002,
+	B_CMYA32			= 0xE002,
+	B_CMYK32			= 0xC003
+};
+
+struct rgb_color {
+	uint8	red;
+	uint8	green;
+	uint8	blue;
+	uint8	alpha;
+};
+
+// The palette of B_CMAP8, which Haiku gets from the app_server
+struct color_map {
+	int32		id;
+	rgb_color	color_list[256];
+	uint8		inversion_map[256];
+	uint8		index_map[32768];
+		// indexed by 5 bits each of red, green and blue
+};
+
+const uint8 B_TRANSPARENT_MAGIC_CMAP8 = 0xff;
+
+
+static inline bigtime_t
+system_time()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (bigtime_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+static inline thread_id
+find_thread(const char*)
+{
+	// only ever asked for the calling thread
+	return (thread_id)syscall(SYS_gettid);
+}
+
+#endif // !__HAIKU__
+
+
+#endif // CODECDEFS_H
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "codecio.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+
+// errno as a negative status; only on Haiku are they the same
+static status_t
+file_error()
+{
+	return errno < 0 ? errno : B_IO_ERROR;
+}
+
+
+CodecInput::~CodecInput()
+{
+}
+
+
+status_t
+CodecInput::ReadAtExactly(off_t position, void* buffer, size_t size)
+{
+	uint8* out = (uint8*)buffer;
+	while (size > 0) {
+		ssize_t bytesRead = ReadAt(position, out, size);
+		if (bytesRead < 0)
+			return (status_t)bytesRead;
+		if (bytesRead == 0)
+			return B_IO_ERROR;
+		position += bytesRead;
+		out += bytesRead;
+		size -= bytesRead;
+	}
+	return B_OK;
+}
+
+
+// #pragma mark -
+
+
+CodecOutput::~CodecOutput()
+{
+}
+
+
+status_t
+CodecOutput::WriteExactly(const void* buffer, size_t size)
+{
+	const uint8* data = (const uint8*)buffer;
+	while (size > 0) {
+		ssize_t written = Write(data, size);
+		if (written < 0)
+			return (status_t)written;
+		if (written == 0)
+			return B_IO_ERROR;
+		data += written;
+		size -= written;
+	}
+	return B_OK;
+}
+
+
+status_t
+CodecOutput::WriteAtExactly(off_t position, const void* buffer, size_t size)
+{
+	const uint8* data = (const uint8*)buffer;
+	while (size > 0) {
+		ssize_t written = WriteAt(position, data, size);
+		if (written < 0)
+			return (status_t)written;
+		if (written == 0)
+			return B_IO_ERROR;
+		position += written;
+		data += written;
+		size -= written;
+	}
+	return B_OK;
+}
+
+
+// #pragma mark -
+
+
+MemoryOutput::MemoryOutput()
+	:
+	fPosition(0)
+{
+}
+
+
+ssize_t
+MemoryOutput::Write(const void* buffer, size_t size)
+{
+	ssize_t written = WriteAt(fPosition, buffer, size);
+	if (written > 0)
+		fPosition += written;
+	return written;
+}
+
+
+ssize_t
+MemoryOutput::WriteAt(off_t position, const void* buffer, size_t size)
+{
+	if (position < 0)
+		return B_BAD_VALUE;
+	if ((size_t)position + size > fData.size()) {
+		try {
+			fData.resize(position + size);
+		} catch (const std::bad_alloc&) {
+			return B_NO_MEMORY;
+		}
+	}
+	memcpy(fData.data() + position, buffer, size);
+	return size;
+}
+
+
+off_t
+MemoryOutput::Position() const
+{
+	return fPosition;
+}
+
+
+status_t
+MemoryOutput::SetPosition(off_t position)
+{
+	if (position < 0)
+		return B_BAD_VALUE;
+	fPosition = position;
+	return B_OK;
+}
+
+
+const uint8*
+MemoryOutput::Buffer() const
+{
+	return fData.data();
+}
+
+
+size_t
+MemoryOutput::BufferLength() const
+{
+	return fData.size();
+}
+
+
+// #pragma mark -
+
+
+MemoryInput::MemoryInput(const void* data, size_t size)
+	:
+	fData((const uint8*)data),
+	fSize(size)
+{
+}
+
+
+ssize_t
+MemoryInput::ReadAt(off_t position, void* buffer, size_t size)
+{
+	if (position < 0)
+		return B_BAD_VALUE;
+	if ((size_t)position >= fSize)
+		return 0;
+	size = std::min(size, fSize - (size_t)position);
+	memcpy(buffer, fData + position, size);
+	return size;
+}
+
+
+// #pragma mark -
+
+
+FileInput::FileInput(int fd)
+	:
+	fFile(fd)
+{
+}
+
+
+ssize_t
+FileInput::ReadAt(off_t position, void* buffer, size_t size)
+{
+	ssize_t bytesRead = pread(fFile, buffer, size, position);
+	if (bytesRead < 0)
+		return file_error();
+	return bytesRead;
+}
+
+
+// #pragma mark -
+
+
+FileOutput::FileOutput(int fd)
+	:
+	fFile(fd),
+	fPosition(0)
+{
+}
+
+
+ssize_t
+FileOutput::Write(const void* buffer, size_t size)
+{
+	ssize_t written = WriteAt(fPosition, buffer, size);
+	if (written > 0)
+		fPosition += written;
+	return written;
+}
+
+
+ssize_t
+FileOutput::WriteAt(off_t position, const void* buffer, size_t size)
+{
+	ssize_t written = pwrite(fFile, buffer, size, position);
+	if (written < 0)
+		return file_error();
+	return written;
+}
+
+
+off_t
+FileOutput::Position() const
+{
+	return fPosition;
+}
+
+
+status_t
+FileOutput::SetPosition(off_t position)
+{
+	if (position < 0)
+		return B_BAD_VALUE;
+	fPosition = position;
+	return B_OK;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CODECIO_H
+#define CODECIO_H
+
+#include "codecdefs.h"
+
+#include <vector>
+
+
+// Where the codec reads files and bitmaps from. Only positioned reads are
+// used, so chunks may be read from several threads under a lock.
+class CodecInput {
+public:
+	virtual						~CodecInput();
+
+	virtual	ssize_t				ReadAt(off_t position, void* buffer,
+									size_t size) = 0;
+			status_t			ReadAtExactly(off_t position, void* buffer,
+									size_t size);
+};
+
+
+// Where the codec writes to. Streamed encodes go back to fill in sizes, so
+// it has to be seekable.
+class CodecOutput {
+public:
+	virtual						~CodecOutput();
+
+	virtual	ssize_t				Write(const void* buffer, size_t size) = 0;
+	virtual	ssize_t				WriteAt(off_t position, const void* buffer,
+									size_t size) = 0;
+	virtual	off_t				Position() const = 0;
+	virtual	status_t			SetPosition(off_t position) = 0;
+
+			status_t			WriteExactly(const void* buffer, size_t size);
+			status_t			WriteAtExactly(off_t position,
+									const void* buffer, size_t size);
+};
+
+
+// An output that grows in memory, for trial encodes and caches
+class MemoryOutput : public CodecOutput {
+public:
+								MemoryOutput();
+
+	virtual	ssize_t				Write(const void* buffer, size_t size);
+	virtual	ssize_t				WriteAt(off_t position, const void* buffer,
+									size_t size);
+	virtual	off_t				Position() const;
+	virtual	status_t			SetPosition(off_t position);
+
+			const uint8*		Buffer() const;
+			size_t				BufferLength() const;
+
+private:
+			std::vector<uint8>	fData;
+			off_t				fPosition;
+};
+
+
+// Reads from a buffer in memory
+class MemoryInput : public CodecInput {
+public:
+								MemoryInput(const void* data, size_t size);
+
+	virtual	ssize_t				ReadAt(off_t position, void* buffer,
+									size_t size);
+
+private:
+			const uint8*		fData;
+			size_t				fSize;
+};
+
+
+// Reads from an open file, which it leaves open
+class FileInput : public CodecInput {
+public:
+								FileInput(int fd);
+
+	virtual	ssize_t				ReadAt(off_t position, void* buffer,
+									size_t size);
+
+private:
+			int					fFile;
+};
+
+
+// Writes to an open file, which it leaves open
+class FileOutput : public CodecOutput {
+public:
+								FileOutput(int fd);
+
+	virtual	ssize_t				Write(const void* buffer, size_t size);
+	virtual	ssize_t				WriteAt(off_t position, const void* buffer,
+									size_t size);
+	virtual	off_t				Position() const;
+	virtual	status_t			SetPosition(off_t position);
+
+private:
+			int					fFile;
+			off_t				fPosition;
+};
+
+
+#endif // CODECIO_H
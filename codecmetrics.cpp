@@ -0,0 +1,226 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "codecmetrics.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+static const char* sPhaseKeys[kNumTranslationPhases] = {
+	"readTime",
+	"convertTime",
+	"writeTime",
+	"codecTime"
+};
+
+
+static uint32
+histogram_bucket(uint64 value)
+{
+	uint32 bucket = 0;
+	while (value > 1 && bucket < kNumHistogramBuckets - 1) {
+		value >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+
+// Splits each power of two into kLatencySubBuckets, which keeps the
+// percentiles within 12.5% at a fixed size
+static uint32
+latency_bucket(uint64 value)
+{
+	if (value < kLatencySubBuckets)
+		return value;
+	uint32 shift = histogram_bucket(value) - 3;
+	uint32 bucket = kLatencySubBuckets * (shift + 1)
+		+ (value >> shift) - kLatencySubBuckets;
+	return std::min(bucket, kNumLatencyBuckets - 1);
+}
+
+
+// The first value past a bucket of latency_bucket()
+static bigtime_t
+latency_bucket_end(uint32 bucket)
+{
+	if (bucket < kLatencySubBuckets)
+		return bucket + 1;
+	uint32 shift = bucket / kLatencySubBuckets - 1;
+	return (bigtime_t)(kLatencySubBuckets + bucket % kLatencySubBuckets + 1)
+		<< shift;
+}
+
+
+static void
+write_json_array(FILE* file, const char* key, const int64* values,
+	uint32 count)
+{
+	fprintf(file, ",\n\t\t\"%s\": [", key);
+	for (uint32 i = 0; i < count; i++)
+		fprintf(file, "%s%lld", i > 0 ? ", " : "", (long long)values[i]);
+	fputs("]", file);
+}
+
+
+TranslationMetrics::TranslationMetrics()
+	:
+	totalTime(0),
+	bytesIn(0),
+	bytesOut(0),
+	pixels(0),
+	compressedBytes(0),
+	peakMemory(0)
+{
+	for (uint32 i = 0; i < kNumTranslationPhases; i++)
+		phaseTime[i] = 0;
+}
+
+
+void
+TranslationMetrics::Finish(bigtime_t total)
+{
+	totalTime = total;
+	bigtime_t other = 0;
+	for (uint32 i = 0; i < kNumTranslationPhases; i++) {
+		if (i != PHASE_CODEC)
+			other += phaseTime[i];
+	}
+	phaseTime[PHASE_CODEC] = std::max((bigtime_t)0, total - other);
+}
+
+
+float
+TranslationMetrics::BitsPerPixel() const
+{
+	return pixels > 0 ? compressedBytes * 8.0f / pixels : 0;
+}
+
+
+// #pragma mark -
+
+
+float
+MetricsSummary::BitsPerPixel() const
+{
+	return pixels > 0 ? compressedBytes * 8.0f / pixels : 0;
+}
+
+
+float
+MetricsSummary::MegapixelsPerSecond() const
+{
+	// pixels per microsecond are megapixels per second
+	return totalTime > 0 ? (float)pixels / totalTime : 0;
+}
+
+
+void
+MetricsSummary::WriteJSON(FILE* file) const
+{
+	fprintf(file, "{\n\t\t\"count\": %lld,\n\t\t\"bytesIn\": %lld,\n"
+		"\t\t\"bytesOut\": %lld,\n\t\t\"compressedBytes\": %lld,\n"
+		"\t\t\"pixels\": %lld,\n\t\t\"totalTime\": %lld",
+		(long long)count, (long long)bytesIn, (long long)bytesOut,
+		(long long)compressedBytes, (long long)pixels, (long long)totalTime);
+	for (uint32 i = 0; i < kNumTranslationPhases; i++) {
+		fprintf(file, ",\n\t\t\"%s\": %lld", sPhaseKeys[i],
+			(long long)phaseTime[i]);
+	}
+	fprintf(file, ",\n\t\t\"megapixelsPerSecond\": %.3f,\n"
+		"\t\t\"bitsPerPixel\": %.4f,\n\t\t\"peakMemory\": %llu,\n"
+		"\t\t\"latencyP50\": %lld,\n\t\t\"latencyP90\": %lld,\n"
+		"\t\t\"latencyP99\": %lld", MegapixelsPerSecond(), BitsPerPixel(),
+		(unsigned long long)peakMemory, (long long)latencyP50,
+		(long long)latencyP90, (long long)latencyP99);
+	write_json_array(file, "latencyHistogram", latency, kNumHistogramBuckets);
+	write_json_array(file, "speedHistogram", speed, kNumHistogramBuckets);
+	fputs("\n\t}", file);
+}
+
+
+// #pragma mark -
+
+
+MetricsAggregate::MetricsAggregate()
+{
+	memset(&fTotals, 0, sizeof(fTotals));
+	memset(fLatency, 0, sizeof(fLatency));
+}
+
+
+void
+MetricsAggregate::Add(const TranslationMetrics& metrics)
+{
+	std::lock_guard<std::mutex> lock(fLock);
+	fTotals.count++;
+	fTotals.bytesIn += metrics.bytesIn;
+	fTotals.bytesOut += metrics.bytesOut;
+	fTotals.compressedBytes += metrics.compressedBytes;
+	fTotals.pixels += metrics.pixels;
+	for (uint32 i = 0; i < kNumTranslationPhases; i++)
+		fTotals.phaseTime[i] += metrics.phaseTime[i];
+	fTotals.totalTime += metrics.totalTime;
+	fTotals.peakMemory = std::max(fTotals.peakMemory, metrics.peakMemory);
+
+	fTotals.latency[histogram_bucket(metrics.totalTime)]++;
+	fLatency[latency_bucket(metrics.totalTime)]++;
+	if (metrics.pixels > 0) {
+		// pixels per microsecond times 1000 is kilopixels per second
+		fTotals.speed[histogram_bucket(metrics.pixels * 1000
+			/ std::max((bigtime_t)1, metrics.totalTime))]++;
+	}
+}
+
+
+void
+MetricsAggregate::GetSummary(MetricsSummary* summary) const
+{
+	std::lock_guard<std::mutex> lock(fLock);
+	*summary = fTotals;
+	summary->latencyP50 = _Percentile(50);
+	summary->latencyP90 = _Percentile(90);
+	summary->latencyP99 = _Percentile(99);
+}
+
+
+// The end of the latency bucket holding the percentile, at most 1/8
+// above it. fLock must be held.
+bigtime_t
+MetricsAggregate::_Percentile(uint32 percent) const
+{
+	if (fTotals.count == 0)
+		return 0;
+
+	const int64 rank = (fTotals.count * percent + 99) / 100;
+	int64 seen = 0;
+	for (uint32 i = 0; i < kNumLatencyBuckets; i++) {
+		seen += fLatency[i];
+		if (seen >= rank)
+			return latency_bucket_end(i);
+	}
+	return latency_bucket_end(kNumLatencyBuckets - 1);
+}
+
+
+// #pragma mark -
+
+
+status_t
+write_metrics_json(const char* path, const MetricsSummary& decodes,
+	const MetricsSummary& encodes)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+		return errno;
+
+	fputs("{\n\t\"decodes\": ", file);
+	decodes.WriteJSON(file);
+	fputs(",\n\t\"encodes\": ", file);
+	encodes.WriteJSON(file);
+	fputs("\n}\n", file);
+	return fclose(file) == 0 ? B_OK : errno;
+}
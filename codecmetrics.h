@@ -0,0 +1,132 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CODECMETRICS_H
+#define CODECMETRICS_H
+
+#include "codecdefs.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+
+
+enum translation_phase {
+	PHASE_READ = 0,
+	PHASE_CONVERT,
+		// swizzling, expanding and packing pixels
+	PHASE_WRITE,
+	PHASE_CODEC,
+		// what the others leave of the total, mostly libjxl
+	kNumTranslationPhases
+};
+
+const uint32 kNumHistogramBuckets = 40;
+const uint32 kLatencySubBuckets = 8;
+	// per power of two, for the percentiles
+const uint32 kNumLatencyBuckets
+	= kLatencySubBuckets * (kNumHistogramBuckets - 2);
+
+
+// Timings and counts of one translation. Phases may be timed from
+// several threads at once.
+struct TranslationMetrics {
+							TranslationMetrics();
+
+			void			Finish(bigtime_t totalTime);
+				// sets the total and derives the codec time from it
+			float			BitsPerPixel() const;
+
+			std::atomic<bigtime_t> phaseTime[kNumTranslationPhases];
+			bigtime_t		totalTime;
+			uint64			bytesIn;
+			uint64			bytesOut;
+			uint64			pixels;
+				// 0 when not known, as for cached decodes
+			uint64			compressedBytes;
+				// the size of the JPEG XL side
+			uint64			peakMemory;
+				// estimated from the way the image was translated, 0 for
+				// cached decodes
+};
+
+
+// Adds the time until it goes out of scope to a phase. Without metrics it
+// doesn't even read the clock.
+class PhaseTimer {
+public:
+	PhaseTimer(TranslationMetrics* metrics, translation_phase phase)
+		:
+		fMetrics(metrics),
+		fPhase(phase),
+		fStart(metrics != NULL ? system_time() : 0)
+	{
+	}
+
+	~PhaseTimer()
+	{
+		if (fMetrics != NULL)
+			fMetrics->phaseTime[fPhase] += system_time() - fStart;
+	}
+
+private:
+			TranslationMetrics* fMetrics;
+			translation_phase fPhase;
+			bigtime_t		fStart;
+};
+
+
+// The totals of a MetricsAggregate at one point in time
+struct MetricsSummary {
+			int64			count;
+			int64			bytesIn;
+			int64			bytesOut;
+			int64			compressedBytes;
+			int64			pixels;
+			bigtime_t		phaseTime[kNumTranslationPhases];
+			bigtime_t		totalTime;
+			uint64			peakMemory;
+				// of the most demanding translation
+			bigtime_t		latencyP50;
+			bigtime_t		latencyP90;
+			bigtime_t		latencyP99;
+				// upper bounds, at most 1/8 above the exact value
+			int64			latency[kNumHistogramBuckets];
+				// item n counts translations under 2^(n+1) microseconds
+			int64			speed[kNumHistogramBuckets];
+				// item n counts speeds under 2^(n+1) kilopixels/s
+
+			float			BitsPerPixel() const;
+			float			MegapixelsPerSecond() const;
+			void			WriteJSON(FILE* file) const;
+};
+
+
+// Sums up translations, with log2 histograms of latency and speed
+class MetricsAggregate {
+public:
+							MetricsAggregate();
+
+			void			Add(const TranslationMetrics& metrics);
+			void			GetSummary(MetricsSummary* summary) const;
+
+private:
+			bigtime_t		_Percentile(uint32 percent) const;
+
+	mutable	std::mutex		fLock;
+			MetricsSummary	fTotals;
+				// the percentiles are filled in by GetSummary()
+			int64			fLatency[kNumLatencyBuckets];
+				// kLatencySubBuckets per power of two, exact below that
+};
+
+
+status_t write_metrics_json(const char* path, const MetricsSummary& decodes,
+	const MetricsSummary& encodes);
+	// Writes both summaries to a file as {"decodes": {...}, "encodes":
+	// {...}}, for scripts comparing runs
+
+
+#endif // CODECMETRICS_H
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "codecmonitor.h"
+
+#include <algorithm>
+
+#include "codecpool.h"
+#include "eventtrace.h"
+
+const bigtime_t kReportInterval = 50000;
+
+
+CodecMonitor::CodecMonitor()
+	:
+	fCancel(NULL),
+	fMetrics(NULL),
+	fThreadPool(NULL),
+	fTotal(0),
+	fDone(0),
+	fLastReport(0)
+{
+}
+
+
+CodecMonitor::~CodecMonitor()
+{
+}
+
+
+void
+CodecMonitor::SetCancelFlag(int32* cancel)
+{
+	fCancel = cancel;
+}
+
+
+bool
+CodecMonitor::IsCancelled() const
+{
+	// the caller sets the flag from another thread
+	return fCancel != NULL && __atomic_load_n(fCancel, __ATOMIC_RELAXED) != 0;
+}
+
+
+bool
+CodecMonitor::ReportsProgress() const
+{
+	return false;
+}
+
+
+void
+CodecMonitor::SetTotal(uint64 total)
+{
+	fTotal = total;
+	fDone = 0;
+}
+
+
+void
+CodecMonitor::AddDone(uint64 amount)
+{
+	if (!ReportsProgress())
+		return;
+
+	const uint64 done = fDone.fetch_add(amount) + amount;
+	const bigtime_t now = system_time();
+	bigtime_t last = fLastReport;
+	// only the thread that moves the report time reports
+	if (now - last < kReportInterval
+		|| !fLastReport.compare_exchange_strong(last, now))
+		return;
+
+	const uint64 total = fTotal;
+	if (total > 0)
+		ReportProgress(std::min(1.0f, (float)done / total));
+}
+
+
+void
+CodecMonitor::Finish()
+{
+	if (ReportsProgress())
+		ReportProgress(1.0f);
+}
+
+
+void
+CodecMonitor::SetMetrics(TranslationMetrics* metrics)
+{
+	fMetrics = metrics;
+}
+
+
+TranslationMetrics*
+CodecMonitor::Metrics() const
+{
+	return fMetrics;
+}
+
+
+void
+CodecMonitor::SetThreadPool(CodecThreadPool* pool)
+{
+	fThreadPool = pool;
+}
+
+
+CodecThreadPool*
+CodecMonitor::ThreadPool() const
+{
+	return fThreadPool;
+}
+
+
+void
+CodecMonitor::Follow(const CodecMonitor* other)
+{
+	fCancel = other->fCancel;
+	fThreadPool = other->fThreadPool;
+}
+
+
+JxlParallelRetCode
+CodecMonitor::Run(void* runnerOpaque, void* jxlOpaque,
+	JxlParallelRunInit init, JxlParallelRunFunction function, uint32_t start,
+	uint32_t end)
+{
+	TraceSpan span("Run");
+	CodecMonitor* monitor = (CodecMonitor*)runnerOpaque;
+	if (monitor->fThreadPool != NULL) {
+		return monitor->fThreadPool->Run(monitor, jxlOpaque, init, function,
+			start, end);
+	}
+
+	JxlParallelRetCode result = init(jxlOpaque, 1);
+	if (result != JXL_PARALLEL_RET_SUCCESS)
+		return result;
+
+	for (uint32 i = start; i < end; i++) {
+		// a group takes milliseconds, so this is checked often enough
+		if (monitor->IsCancelled())
+			return JXL_PARALLEL_RET_RUNNER_ERROR;
+		function(jxlOpaque, i, 0);
+	}
+	return JXL_PARALLEL_RET_SUCCESS;
+}
+
+
+void
+CodecMonitor::ReportProgress(float fraction)
+{
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CODECMONITOR_H
+#define CODECMONITOR_H
+
+#include "codecdefs.h"
+
+#include <jxl/parallel_runner.h>
+
+#include <atomic>
+
+class CodecThreadPool;
+struct TranslationMetrics;
+
+
+// Follows one encode or decode: whether the caller asked to stop, how far
+// along it is and where its phases are timed. Progress may be added from
+// any thread; how it reaches the caller is up to subclasses.
+class CodecMonitor {
+public:
+							CodecMonitor();
+	virtual					~CodecMonitor();
+
+			void			SetCancelFlag(int32* cancel);
+				// the codec stops soon after *cancel becomes non-zero
+			bool			IsCancelled() const;
+	virtual	bool			ReportsProgress() const;
+
+			void			SetTotal(uint64 total);
+			void			AddDone(uint64 amount);
+			void			Finish();
+
+			void			SetMetrics(TranslationMetrics* metrics);
+			TranslationMetrics* Metrics() const;
+				// where the phases are timed, NULL when that's off
+
+			void			SetThreadPool(CodecThreadPool* pool);
+				// where Run() spreads the groups, NULL to run them on
+				// the calling thread
+			CodecThreadPool* ThreadPool() const;
+
+			void			Follow(const CodecMonitor* other);
+				// stops when other is cancelled and runs on its threads,
+				// without adding to its progress or metrics. For encodes
+				// a codec makes on the side, like trials.
+
+	static	JxlParallelRetCode Run(void* runnerOpaque, void* jxlOpaque,
+								JxlParallelRunInit init,
+								JxlParallelRunFunction function,
+								uint32_t start, uint32_t end);
+				// a JxlParallelRunner taking a CodecMonitor. It runs the
+				// work on the monitor's thread pool, or serially without
+				// one, and stops between groups once cancelled.
+
+protected:
+	virtual	void			ReportProgress(float fraction);
+				// called at most every 50 ms, by whichever thread added
+				// to the progress
+
+private:
+			int32*			fCancel;
+			TranslationMetrics* fMetrics;
+			CodecThreadPool* fThreadPool;
+			std::atomic<uint64> fTotal;
+			std::atomic<uint64> fDone;
+			std::atomic<bigtime_t> fLastReport;
+};
+
+
+#endif // CODECMONITOR_H
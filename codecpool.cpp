@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "codecpool.h"
+
+#include "codecmonitor.h"
+#include "eventtrace.h"
+
+
+CodecThreadPool::CodecThreadPool(uint32 threads)
+	:
+	fQuit(false)
+{
+	// the codec calling Run() is thread 0 of its groups
+	for (uint32 i = 1; i <= threads; i++)
+		fThreads.push_back(std::thread(_Work, this, i));
+}
+
+
+CodecThreadPool::~CodecThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(fLock);
+		fQuit = true;
+	}
+	fWake.notify_all();
+	for (size_t i = 0; i < fThreads.size(); i++)
+		fThreads[i].join();
+}
+
+
+uint32
+CodecThreadPool::CountThreads() const
+{
+	return fThreads.size();
+}
+
+
+void
+CodecThreadPool::AddTask(codec_task task, void* data)
+{
+	if (fThreads.empty()) {
+		task(data);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(fLock);
+		Task queued = { task, data };
+		fTasks.push_back(queued);
+	}
+	fWake.notify_one();
+}
+
+
+JxlParallelRetCode
+CodecThreadPool::Run(const CodecMonitor* monitor, void* jxlOpaque,
+	JxlParallelRunInit init, JxlParallelRunFunction function, uint32 start,
+	uint32 end)
+{
+	if (end - start < 2 || fThreads.empty()) {
+		JxlParallelRetCode result = init(jxlOpaque, 1);
+		if (result != JXL_PARALLEL_RET_SUCCESS)
+			return result;
+		for (uint32 i = start; i < end; i++) {
+			if (monitor->IsCancelled())
+				return JXL_PARALLEL_RET_RUNNER_ERROR;
+			function(jxlOpaque, i, 0);
+		}
+		return JXL_PARALLEL_RET_SUCCESS;
+	}
+
+	JxlParallelRetCode result = init(jxlOpaque, fThreads.size() + 1);
+	if (result != JXL_PARALLEL_RET_SUCCESS)
+		return result;
+
+	Groups groups;
+	groups.monitor = monitor;
+	groups.opaque = jxlOpaque;
+	groups.function = function;
+	groups.next = start;
+	groups.end = end;
+	groups.helpers = 0;
+	groups.cancelled = false;
+	{
+		std::lock_guard<std::mutex> lock(fLock);
+		fGroups.push_back(&groups);
+	}
+	fWake.notify_all();
+
+	_RunGroups(&groups, 0);
+	std::unique_lock<std::mutex> lock(fLock);
+	fGroups.remove(&groups);
+	while (groups.helpers > 0)
+		fHelped.wait(lock);
+	return groups.cancelled ? JXL_PARALLEL_RET_RUNNER_ERROR
+		: JXL_PARALLEL_RET_SUCCESS;
+}
+
+
+void
+CodecThreadPool::_Work(CodecThreadPool* pool, uint32 thread)
+{
+	std::unique_lock<std::mutex> lock(pool->fLock);
+	for (;;) {
+		// groups first, the images they belong to are already using memory
+		Groups* groups = pool->_GroupsToHelp();
+		if (groups != NULL) {
+			groups->helpers++;
+			lock.unlock();
+			pool->_RunGroups(groups, thread);
+			lock.lock();
+			if (--groups->helpers == 0)
+				pool->fHelped.notify_all();
+			continue;
+		}
+
+		if (!pool->fTasks.empty()) {
+			Task task = pool->fTasks.front();
+			pool->fTasks.pop_front();
+			lock.unlock();
+			task.function(task.data);
+			lock.lock();
+			continue;
+		}
+
+		if (pool->fQuit)
+			return;
+		pool->fWake.wait(lock);
+	}
+}
+
+
+// The groups with the most left to run, NULL if there are none. Called
+// with fLock held.
+CodecThreadPool::Groups*
+CodecThreadPool::_GroupsToHelp() const
+{
+	Groups* best = NULL;
+	uint32 bestLeft = 0;
+	for (std::list<Groups*>::const_iterator it = fGroups.begin();
+			it != fGroups.end(); it++) {
+		uint32 next = (*it)->next;
+		uint32 left = next < (*it)->end ? (*it)->end - next : 0;
+		if (left > bestLeft) {
+			best = *it;
+			bestLeft = left;
+		}
+	}
+	return best;
+}
+
+
+void
+CodecThreadPool::_RunGroups(Groups* groups, uint32 thread)
+{
+	TraceSpan span("RunGroups");
+	for (uint32 i = groups->next++; i < groups->end; i = groups->next++) {
+		// a group takes milliseconds, so this is checked often enough
+		if (groups->monitor->IsCancelled()) {
+			groups->cancelled = true;
+			groups->next = groups->end;
+			break;
+		}
+		groups->function(groups->opaque, i, thread);
+	}
+}
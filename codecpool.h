@@ -0,0 +1,84 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CODECPOOL_H
+#define CODECPOOL_H
+
+#include "codecdefs.h"
+
+#include <jxl/parallel_runner.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CodecMonitor;
+
+typedef void (*codec_task)(void* data);
+
+
+// Threads shared by the images being translated. Each codec runs the
+// groups of its image on its own thread and the pool's idle threads take
+// groups from whichever image has the most left. Whole translations can
+// be queued on the pool too; its threads only start one of those when no
+// image in flight has groups left, so those finish first.
+class CodecThreadPool {
+public:
+							CodecThreadPool(uint32 threads);
+								// the threads it starts, next to those
+								// of the codecs using it
+							~CodecThreadPool();
+								// runs the queued tasks first
+
+			uint32			CountThreads() const;
+
+			void			AddTask(codec_task task, void* data);
+				// runs task on one of the threads
+
+			JxlParallelRetCode Run(const CodecMonitor* monitor,
+								void* jxlOpaque, JxlParallelRunInit init,
+								JxlParallelRunFunction function,
+								uint32 start, uint32 end);
+				// runs function for start to end on the calling thread
+				// and any idle threads, stopping between groups once the
+				// monitor is cancelled. Any number of codecs may run
+				// groups at once.
+
+private:
+	struct Task {
+		codec_task			function;
+		void*				data;
+	};
+
+	// The groups of one Run() call
+	struct Groups {
+		const CodecMonitor*	monitor;
+		void*				opaque;
+		JxlParallelRunFunction function;
+		std::atomic<uint32>	next;
+		uint32				end;
+		uint32				helpers;
+			// pool threads running its groups
+		std::atomic<bool>	cancelled;
+	};
+
+	static	void			_Work(CodecThreadPool* pool, uint32 thread);
+			Groups*			_GroupsToHelp() const;
+			void			_RunGroups(Groups* groups, uint32 thread);
+
+			std::vector<std::thread> fThreads;
+			std::mutex		fLock;
+			std::condition_variable fWake;
+			std::condition_variable fHelped;
+			std::list<Groups*> fGroups;
+			std::deque<Task> fTasks;
+			bool			fQuit;
+};
+
+
+#endif // CODECPOOL_H
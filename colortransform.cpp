@@ -0,0 +1,225 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "colortransform.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "jxllibrary.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Points along each side of the grid; 33 keeps the error under one step
+// of 8 bits for ordinary display profiles
+const int32 kGridSize = 33;
+const size_t kSlicePixels = kGridSize * kGridSize;
+const uint32 kMaxCachedTransforms = 8;
+
+const size_t kRedStride = kGridSize * kGridSize * 4;
+const size_t kGreenStride = kGridSize * 4;
+const size_t kBlueStride = 4;
+
+
+ColorTransform::ColorTransform()
+{
+}
+
+
+ColorTransform*
+ColorTransform::Create(const JxlLibrary* jxl, const uint8* source,
+	size_t sourceSize, const uint8* target, size_t targetSize)
+{
+	const JxlCmsInterface* cms = jxl->GetDefaultCms();
+	if (cms == NULL)
+		return NULL;
+
+	JxlColorProfile input;
+	memset(&input, 0, sizeof(input));
+	input.icc.data = source;
+	input.icc.size = sourceSize;
+	input.num_channels = 3;
+	JxlColorProfile output;
+	memset(&output, 0, sizeof(output));
+	output.icc.data = target;
+	output.icc.size = targetSize;
+	output.num_channels = 3;
+
+	void* state = cms->init(cms->init_data, 1, kSlicePixels, &input, &output,
+		255.0f);
+	if (state == NULL)
+		return NULL;
+
+	ColorTransform* transform = new ColorTransform;
+	transform->fTable.resize((size_t)kGridSize * kRedStride);
+	std::vector<float> colors(kSlicePixels * 3);
+	std::vector<float> converted(kSlicePixels * 3);
+	bool success = true;
+	// a slice of constant red at a time
+	for (int32 red = 0; red < kGridSize && success; red++) {
+		for (size_t i = 0; i < kSlicePixels; i++) {
+			colors[i * 3] = (float)red / (kGridSize - 1);
+			colors[i * 3 + 1] = (float)(i / kGridSize) / (kGridSize - 1);
+			colors[i * 3 + 2] = (float)(i % kGridSize) / (kGridSize - 1);
+		}
+		success = cms->run(state, 0, colors.data(), converted.data(),
+			kSlicePixels);
+
+		float* slice = transform->fTable.data() + red * kRedStride;
+		for (size_t i = 0; i < kSlicePixels; i++) {
+			for (int c = 0; c < 3; c++) {
+				slice[i * 4 + c] = std::min(std::max(converted[i * 3 + c],
+					0.0f), 1.0f) * 255;
+			}
+			slice[i * 4 + 3] = 0;
+		}
+	}
+	cms->destroy(state);
+
+	if (!success) {
+		delete transform;
+		return NULL;
+	}
+	return transform;
+}
+
+
+void
+ColorTransform::Apply(uint8* pixels, size_t count, bool bgra) const
+{
+	const int red = bgra ? 2 : 0;
+	const int blue = bgra ? 0 : 2;
+	const float scale = (float)(kGridSize - 1) / 255;
+	const float* table = fTable.data();
+
+	for (size_t i = 0; i < count; i++) {
+		uint8* pixel = pixels + i * 4;
+		float position[3] = { pixel[red] * scale, pixel[1] * scale,
+			pixel[blue] * scale };
+		int32 index[3];
+		float fraction[3];
+		for (int c = 0; c < 3; c++) {
+			index[c] = std::min((int32)position[c], kGridSize - 2);
+			fraction[c] = position[c] - index[c];
+		}
+		const float* base = table + index[0] * kRedStride
+			+ index[1] * kGreenStride + index[2] * kBlueStride;
+
+		// Pick the tetrahedron of the cell the color is in, walking from
+		// the near corner along the axes in order of their fractions
+		size_t first, second;
+		float weights[3];
+		if (fraction[0] >= fraction[1]) {
+			if (fraction[1] >= fraction[2]) {
+				first = kRedStride;
+				second = kRedStride + kGreenStride;
+				weights[0] = fraction[0];
+				weights[1] = fraction[1];
+				weights[2] = fraction[2];
+			} else if (fraction[0] >= fraction[2]) {
+				first = kRedStride;
+				second = kRedStride + kBlueStride;
+				weights[0] = fraction[0];
+				weights[1] = fraction[2];
+				weights[2] = fraction[1];
+			} else {
+				first = kBlueStride;
+				second = kRedStride + kBlueStride;
+				weights[0] = fraction[2];
+				weights[1] = fraction[0];
+				weights[2] = fraction[1];
+			}
+		} else {
+			if (fraction[2] >= fraction[1]) {
+				first = kBlueStride;
+				second = kGreenStride + kBlueStride;
+				weights[0] = fraction[2];
+				weights[1] = fraction[1];
+				weights[2] = fraction[0];
+			} else if (fraction[2] >= fraction[0]) {
+				first = kGreenStride;
+				second = kGreenStride + kBlueStride;
+				weights[0] = fraction[1];
+				weights[1] = fraction[2];
+				weights[2] = fraction[0];
+			} else {
+				first = kGreenStride;
+				second = kRedStride + kGreenStride;
+				weights[0] = fraction[1];
+				weights[1] = fraction[0];
+				weights[2] = fraction[2];
+			}
+		}
+		const size_t last = kRedStride + kGreenStride + kBlueStride;
+
+#if defined(__SSE2__)
+		__m128 corner0 = _mm_loadu_ps(base);
+		__m128 corner1 = _mm_loadu_ps(base + first);
+		__m128 corner2 = _mm_loadu_ps(base + second);
+		__m128 corner3 = _mm_loadu_ps(base + last);
+		__m128 color = _mm_add_ps(corner0, _mm_mul_ps(_mm_set1_ps(weights[0]),
+			_mm_sub_ps(corner1, corner0)));
+		color = _mm_add_ps(color, _mm_mul_ps(_mm_set1_ps(weights[1]),
+			_mm_sub_ps(corner2, corner1)));
+		color = _mm_add_ps(color, _mm_mul_ps(_mm_set1_ps(weights[2]),
+			_mm_sub_ps(corner3, corner2)));
+		__m128i rounded = _mm_cvtps_epi32(color);
+		int32 values[4];
+		_mm_storeu_si128((__m128i*)values, rounded);
+#else
+		int32 values[3];
+		for (int c = 0; c < 3; c++) {
+			float color = base[c] + weights[0] * (base[first + c] - base[c])
+				+ weights[1] * (base[second + c] - base[first + c])
+				+ weights[2] * (base[last + c] - base[second + c]);
+			values[c] = (int32)(color + 0.5f);
+		}
+#endif
+		pixel[red] = values[0];
+		pixel[1] = values[1];
+		pixel[blue] = values[2];
+	}
+}
+
+
+// #pragma mark -
+
+
+ColorTransformCache::ColorTransformCache()
+{
+}
+
+
+std::shared_ptr<const ColorTransform>
+ColorTransformCache::Get(const JxlLibrary* jxl,
+	const std::vector<uint8>& source, const uint8* target, size_t targetSize)
+{
+	if (source.size() == targetSize
+		&& memcmp(source.data(), target, targetSize) == 0)
+		return NULL;
+
+	std::lock_guard<std::mutex> lock(fLock);
+	for (std::list<Entry>::iterator it = fEntries.begin();
+			it != fEntries.end(); it++) {
+		if (it->source == source && it->target.size() == targetSize
+			&& memcmp(it->target.data(), target, targetSize) == 0) {
+			fEntries.splice(fEntries.begin(), fEntries, it);
+			return it->transform;
+		}
+	}
+
+	// failures are kept too, so they aren't tried again every time
+	Entry entry;
+	entry.source = source;
+	entry.target.assign(target, target + targetSize);
+	entry.transform.reset(ColorTransform::Create(jxl, source.data(),
+		source.size(), target, targetSize));
+	fEntries.push_front(entry);
+	if (fEntries.size() > kMaxCachedTransforms)
+		fEntries.pop_back();
+	return fEntries.front().transform;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef COLORTRANSFORM_H
+#define COLORTRANSFORM_H
+
+#include "codecdefs.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct JxlLibrary;
+
+
+// Converts 8 bit RGB pixels from one ICC profile to another. libjxl's
+// color management is run once over a grid of colors, pixels are then
+// interpolated between the nearest four of them.
+class ColorTransform {
+public:
+	static	ColorTransform* Create(const JxlLibrary* jxl,
+							const uint8* source, size_t sourceSize,
+							const uint8* target, size_t targetSize);
+				// NULL if the profiles couldn't be converted between
+
+			void		Apply(uint8* pixels, size_t count, bool bgra) const;
+				// converts count pixels in place, in R, G, B, A order or
+				// B, G, R, A with bgra set. Alpha is left alone.
+
+private:
+						ColorTransform();
+
+			std::vector<float> fTable;
+				// the grid's colors times 255, 4 floats each
+};
+
+
+// Keeps the transforms between the most recently used pairs of profiles,
+// since making one takes far longer than a small image does to convert
+class ColorTransformCache {
+public:
+						ColorTransformCache();
+
+			std::shared_ptr<const ColorTransform> Get(const JxlLibrary* jxl,
+							const std::vector<uint8>& source,
+							const uint8* target, size_t targetSize);
+				// makes the transform if it isn't kept yet. NULL if the
+				// profiles are the same or can't be converted between.
+
+private:
+	struct Entry {
+		std::vector<uint8>	source;
+		std::vector<uint8>	target;
+		std::shared_ptr<const ColorTransform> transform;
+	};
+
+			std::mutex	fLock;
+			std::list<Entry> fEntries;
+				// most recently used first
+};
+
+
+#endif // COLORTRANSFORM_H
@@ -11,7 +11,7 @@
 #include <stdio.h>
 #include <StringView.h>
 
-#include <jxl/encode.h>
+#include "jxllibrary.h"
 #include "jxltranslator.h"
 
 #undef B_TRANSLATION_CONTEXT
@@ -19,6 +19,9 @@
 
 #define BMSG_DISTANCE 'jdst'
 #define BMSG_EFFORT 'jeff'
+#define BMSG_DECODING_SPEED 'jdsp'
+#define BMSG_PROGRESSIVE 'jprg'
+#define BMSG_PREVIEW 'jprv'
 
 
 ConfigView::ConfigView(TranslatorSettings *settings)
@@ -43,11 +46,16 @@ ConfigView::ConfigView(TranslatorSettings *settings)
 	BStringView * copyright = new BStringView("copyright", "©2021, Craig Watson");
 	
 	char libjxlVersionString[255];
-	uint32 jxlver = JxlEncoderVersion();
-	sprintf(libjxlVersionString, "libjxl v%d.%d.%d",
-		jxlver / 1000000, 
-		(jxlver/1000) %1000,
-		jxlver %1000);
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl != NULL) {
+		uint32 jxlver = jxl->EncoderVersion();
+		sprintf(libjxlVersionString, "libjxl v%d.%d.%d",
+			jxlver / 1000000, 
+			(jxlver/1000) %1000,
+			jxlver %1000);
+	} else
+		strlcpy(libjxlVersionString, B_TRANSLATE("libjxl not found"),
+			sizeof(libjxlVersionString));
 
 	BStringView * basedon = new BStringView("based on", "Based on JXL Library © The JPEG XL Project Authors");
 	BStringView * jxlversion = new BStringView("jxlversion", libjxlVersionString);
@@ -60,11 +68,26 @@ ConfigView::ConfigView(TranslatorSettings *settings)
 	fDistanceSlider->SetValue(fSettings->SetGetInt32(JXL_SETTING_DISTANCE));
 	
 	fEffortSlider = new BSlider("effort", B_TRANSLATE("Encoding effort:"),
-		new BMessage(BMSG_EFFORT), 3, 9, B_HORIZONTAL, B_BLOCK_THUMB);
+		new BMessage(BMSG_EFFORT), 1, 9, B_HORIZONTAL, B_BLOCK_THUMB);
 	fEffortSlider->SetHashMarks(B_HASH_MARKS_BOTTOM);
-	fEffortSlider->SetHashMarkCount(7);
+	fEffortSlider->SetHashMarkCount(9);
 	fEffortSlider->SetLimitLabels(B_TRANSLATE("Faster"),B_TRANSLATE("Slower"));
 	fEffortSlider->SetValue(fSettings->SetGetInt32(JXL_SETTING_EFFORT));
+
+	fDecodingSpeedSlider = new BSlider("decoding speed", B_TRANSLATE("Decoding speed:"),
+		new BMessage(BMSG_DECODING_SPEED), 0, 4, B_HORIZONTAL, B_BLOCK_THUMB);
+	fDecodingSpeedSlider->SetHashMarks(B_HASH_MARKS_BOTTOM);
+	fDecodingSpeedSlider->SetHashMarkCount(5);
+	fDecodingSpeedSlider->SetLimitLabels(B_TRANSLATE("Smaller"),B_TRANSLATE("Faster"));
+	fDecodingSpeedSlider->SetValue(fSettings->SetGetInt32(JXL_SETTING_DECODING_SPEED));
+
+	fProgressiveCheckBox = new BCheckBox("progressive",
+		B_TRANSLATE("Progressive (fast first paint)"), new BMessage(BMSG_PROGRESSIVE));
+	fProgressiveCheckBox->SetValue(fSettings->SetGetBool(JXL_SETTING_PROGRESSIVE));
+
+	fPreviewCheckBox = new BCheckBox("preview",
+		B_TRANSLATE("Fast thumbnails"), new BMessage(BMSG_PREVIEW));
+	fPreviewCheckBox->SetValue(fSettings->SetGetBool(JXL_SETTING_PREVIEW));
 	
 	
 	BLayoutBuilder::Group<>(this, B_VERTICAL, 0)
@@ -75,13 +98,16 @@ ConfigView::ConfigView(TranslatorSettings *settings)
 		.AddGlue()
 		.Add(fDistanceSlider)
 		.Add(fEffortSlider)
+		.Add(fDecodingSpeedSlider)
+		.Add(fProgressiveCheckBox)
+		.Add(fPreviewCheckBox)
 		.AddGlue()
 		.Add(basedon)
 		.Add(jxlversion);
 	
 	BFont font;
 	GetFont(&font);
-	SetExplicitPreferredSize(BSize((font.Size() * 300) / 12, (font.Size()) * 350 / 12));
+	SetExplicitPreferredSize(BSize((font.Size() * 300) / 12, (font.Size()) * 450 / 12));
 }
 
 
@@ -96,6 +122,9 @@ ConfigView::AttachedToWindow()
 	BGroupView::AttachedToWindow();
 	fDistanceSlider->SetTarget(this);
 	fEffortSlider->SetTarget(this);
+	fDecodingSpeedSlider->SetTarget(this);
+	fProgressiveCheckBox->SetTarget(this);
+	fPreviewCheckBox->SetTarget(this);
 	
 	if (Parent() == NULL && Window()->GetLayout() == NULL)
 	{
@@ -130,6 +159,38 @@ ConfigView::MessageReceived(BMessage* message)
 			}
 			break;
 		}
+		case BMSG_DECODING_SPEED:
+		{
+			int32 value;
+			if (message->FindInt32("be:value", &value) == B_OK)
+			{
+				fSettings->SetGetInt32(JXL_SETTING_DECODING_SPEED, &value);
+				fSettings->SaveSettings();
+			}
+			break;
+		}
+		case BMSG_PROGRESSIVE:
+		{
+			int32 value;
+			if (message->FindInt32("be:value", &value) == B_OK)
+			{
+				bool progressive = value != 0;
+				fSettings->SetGetBool(JXL_SETTING_PROGRESSIVE, &progressive);
+				fSettings->SaveSettings();
+			}
+			break;
+		}
+		case BMSG_PREVIEW:
+		{
+			int32 value;
+			if (message->FindInt32("be:value", &value) == B_OK)
+			{
+				bool preview = value != 0;
+				fSettings->SetGetBool(JXL_SETTING_PREVIEW, &preview);
+				fSettings->SaveSettings();
+			}
+			break;
+		}
 		default:
 			BGroupView::MessageReceived(message);
 	}	
@@ -6,13 +6,14 @@
 #ifndef CONFIGVIEW_H
 #define CONFIGVIEW_H
 
+#include <CheckBox.h>
 #include <GroupView.h>
 #include <Slider.h>
 
 #include "TranslatorSettings.h"
 
 #define JXL_VIEW_WIDTH		300
-#define JXL_VIEW_HEIGHT		270
+#define JXL_VIEW_HEIGHT		340
 
 
 class ConfigView : public BGroupView {
@@ -26,6 +27,9 @@ private:
 	TranslatorSettings *fSettings;
 	BSlider * fDistanceSlider;
 	BSlider * fEffortSlider;
+	BSlider * fDecodingSpeedSlider;
+	BCheckBox * fProgressiveCheckBox;
+	BCheckBox * fPreviewCheckBox;
 };
 
 
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "contenthash.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const size_t kStripeSize = 64;
+const uint32 kNumLanes = kStripeSize / sizeof(uint64);
+const uint32 kStripesPerBlock = 16;
+const uint32 kScrambleKey = kStripesPerBlock;
+	// the block's last stripe key runs up to here, the scramble key after
+
+const uint64 kPrime32_1 = 0x9e3779b1ULL;
+const uint64 kPrime64_1 = 0x9e3779b185ebca87ULL;
+
+// Stripe n of a block is mixed with words n to n + 7, so moving data
+// around within a block changes the hash. Scrambling after every block
+// does the same for moving blocks around.
+static const uint64 sSecret[kScrambleKey + kNumLanes] = {
+	0xe5457933e1334d94ULL, 0x9dcdbb0ef49fbd44ULL, 0x643b4c1eaa1b4f1fULL,
+	0x60942a71826e33a0ULL, 0xc02e2bb66cd396d0ULL, 0x5cb6440482483c93ULL,
+	0xf774635f40ade907ULL, 0x17b7a29ef97f566aULL, 0x8bf2f7cd95a3209eULL,
+	0x8d2514ce89688dafULL, 0x2348bbb718ac0b68ULL, 0x9044b8ae2752cea8ULL,
+	0x5d47af90817d0062ULL, 0xc93335d76c40758aULL, 0xafec4633bdc0d4cdULL,
+	0xa7cc919911334766ULL, 0xf35bc1bd122f3123ULL, 0x3c0b3911ef8a1691ULL,
+	0x879f723f68f602caULL, 0x8f3066562f31ab7cULL, 0xa65e11f421c9fafaULL,
+	0x9abb6faa8c33057eULL, 0xf62c829227b43277ULL, 0xb5475227939e8539ULL
+};
+
+static const uint64 sInitialAccumulators[kNumLanes] = {
+	0x00000000c2b2ae3dULL, 0x9e3779b185ebca87ULL, 0xc2b2ae3d27d4eb4fULL,
+	0x165667b19e3779f9ULL, 0x85ebca77c2b2ae63ULL, 0x0000000085ebca77ULL,
+	0x27d4eb2f165667c5ULL, 0x000000009e3779b1ULL
+};
+
+
+#if defined(__SSE2__)
+
+static inline void
+accumulate_stripe(__m128i* acc, const uint8* data, const uint64* key)
+{
+	for (uint32 i = 0; i < kNumLanes / 2; i++) {
+		__m128i value = _mm_loadu_si128((const __m128i*)data + i);
+		__m128i mixed = _mm_xor_si128(value,
+			_mm_loadu_si128((const __m128i*)key + i));
+		// low half of each 64 bit lane times its high half
+		__m128i product = _mm_mul_epu32(mixed,
+			_mm_shuffle_epi32(mixed, _MM_SHUFFLE(0, 3, 0, 1)));
+		__m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+		acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+	}
+}
+
+
+static inline void
+scramble(__m128i* acc)
+{
+	const __m128i prime = _mm_set1_epi32((int)kPrime32_1);
+	for (uint32 i = 0; i < kNumLanes / 2; i++) {
+		__m128i value = _mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47));
+		value = _mm_xor_si128(value,
+			_mm_loadu_si128((const __m128i*)(sSecret + kScrambleKey) + i));
+		// 64 bit multiply by a 32 bit constant
+		__m128i low = _mm_mul_epu32(value, prime);
+		__m128i high = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+		acc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+	}
+}
+
+
+static void
+accumulate(uint64* accumulators, const uint8* data, size_t size)
+{
+	__m128i acc[kNumLanes / 2];
+	memcpy(acc, accumulators, sizeof(acc));
+
+	size_t numStripes = size / kStripeSize;
+	uint32 stripe = 0;
+	for (size_t i = 0; i < numStripes; i++) {
+		accumulate_stripe(acc, data + i * kStripeSize, sSecret + stripe);
+		if (++stripe == kStripesPerBlock) {
+			scramble(acc);
+			stripe = 0;
+		}
+	}
+	if (size % kStripeSize != 0) {
+		uint8 last[kStripeSize] = {};
+		memcpy(last, data + numStripes * kStripeSize, size % kStripeSize);
+		accumulate_stripe(acc, last, sSecret + stripe);
+	}
+
+	memcpy(accumulators, acc, sizeof(acc));
+}
+
+#else // !__SSE2__
+
+static inline void
+accumulate_stripe(uint64* acc, const uint8* data, const uint64* key)
+{
+	uint64 values[kNumLanes];
+	memcpy(values, data, sizeof(values));
+	for (uint32 i = 0; i < kNumLanes; i++) {
+		uint64 mixed = values[i] ^ key[i];
+		acc[i] += (mixed & 0xffffffff) * (mixed >> 32) + values[i ^ 1];
+	}
+}
+
+
+static inline void
+scramble(uint64* acc)
+{
+	for (uint32 i = 0; i < kNumLanes; i++) {
+		acc[i] = (acc[i] ^ (acc[i] >> 47) ^ sSecret[kScrambleKey + i])
+			* kPrime32_1;
+	}
+}
+
+
+static void
+accumulate(uint64* acc, const uint8* data, size_t size)
+{
+	size_t numStripes = size / kStripeSize;
+	uint32 stripe = 0;
+	for (size_t i = 0; i < numStripes; i++) {
+		accumulate_stripe(acc, data + i * kStripeSize, sSecret + stripe);
+		if (++stripe == kStripesPerBlock) {
+			scramble(acc);
+			stripe = 0;
+		}
+	}
+	if (size % kStripeSize != 0) {
+		uint8 last[kStripeSize] = {};
+		memcpy(last, data + numStripes * kStripeSize, size % kStripeSize);
+		accumulate_stripe(acc, last, sSecret + stripe);
+	}
+}
+
+#endif // !__SSE2__
+
+
+// Both halves of the 128 bit product, xor'ed. Written out in 32 bit parts
+// so it also works where there is no 128 bit type.
+static inline uint64
+multiply_fold(uint64 a, uint64 b)
+{
+	uint64 lowLow = (a & 0xffffffff) * (b & 0xffffffff);
+	uint64 highLow = (a >> 32) * (b & 0xffffffff);
+	uint64 lowHigh = (a & 0xffffffff) * (b >> 32);
+	uint64 highHigh = (a >> 32) * (b >> 32);
+	uint64 cross = (lowLow >> 32) + (highLow & 0xffffffff) + lowHigh;
+	uint64 upper = (highLow >> 32) + (cross >> 32) + highHigh;
+	uint64 lower = (cross << 32) | (lowLow & 0xffffffff);
+	return upper ^ lower;
+}
+
+
+uint64
+content_hash(const void* data, size_t size, uint64 seed)
+{
+	uint64 acc[kNumLanes];
+	memcpy(acc, sInitialAccumulators, sizeof(acc));
+	accumulate(acc, (const uint8*)data, size);
+
+	uint64 hash = size * kPrime64_1 + seed;
+	for (uint32 i = 0; i < kNumLanes; i += 2) {
+		hash += multiply_fold(acc[i] ^ sSecret[i + 3],
+			acc[i + 1] ^ sSecret[i + 4]);
+	}
+	hash ^= hash >> 37;
+	hash *= 0x165667919e3779f9ULL;
+	hash ^= hash >> 32;
+	return hash;
+}
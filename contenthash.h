@@ -0,0 +1,17 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include "codecdefs.h"
+
+
+uint64 content_hash(const void* data, size_t size, uint64 seed);
+	// A 64 bit hash for cache keys, fast enough to run over a whole bitmap.
+	// Works on 64 byte stripes in the style of XXH3; the SSE2 and plain
+	// versions give the same results. Not suitable against an adversary.
+
+
+#endif // CONTENTHASH_H
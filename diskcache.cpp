@@ -0,0 +1,209 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "diskcache.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <Autolock.h>
+#include <DataIO.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <OS.h>
+#include <Path.h>
+
+#include <algorithm>
+
+#include "contenthash.h"
+
+const size_t kKeySampleSize = 4096;
+
+
+struct CacheFile {
+	BPath	path;
+	time_t	modified;
+	off_t	size;
+};
+
+
+static bool
+compare_cache_files(const CacheFile& a, const CacheFile& b)
+{
+	return a.modified < b.modified;
+}
+
+
+DiskCache::DiskCache(const char* name)
+	:
+	fName(name),
+	fLock("disk cache"),
+	fMaxSize(0),
+	fTotalSize(-1),
+	fHits(0),
+	fMisses(0)
+{
+}
+
+
+void
+DiskCache::SetMaxSize(off_t maxSize)
+{
+	BAutolock lock(fLock);
+	fMaxSize = maxSize;
+}
+
+
+bool
+DiskCache::Lookup(uint64 key, std::vector<uint8>& data)
+{
+	char name[B_FILE_NAME_LENGTH];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+	BPath path;
+	if (_Directory(&path) != B_OK || path.Append(name) != B_OK) {
+		fMisses++;
+		return false;
+	}
+
+	BFile file(path.Path(), B_READ_WRITE);
+	off_t size;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK) {
+		fMisses++;
+		return false;
+	}
+	data.resize(size);
+	if (file.ReadAtExactly(0, data.data(), size) != B_OK) {
+		fMisses++;
+		return false;
+	}
+
+	// the modification time is the LRU order
+	file.SetModificationTime(time(NULL));
+	fHits++;
+	return true;
+}
+
+
+void
+DiskCache::Store(uint64 key, const void* data, size_t size)
+{
+	BPath directory;
+	if (_Directory(&directory) != B_OK)
+		return;
+	{
+		BAutolock lock(fLock);
+		if ((off_t)size > fMaxSize)
+			return;
+	}
+
+	char name[B_FILE_NAME_LENGTH];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+	char tempName[B_FILE_NAME_LENGTH];
+	snprintf(tempName, sizeof(tempName), "%s.%d.tmp", name,
+		(int)find_thread(NULL));
+	BPath tempPath(directory.Path(), tempName);
+
+	{
+		BFile file(tempPath.Path(), B_WRITE_ONLY | B_CREATE_FILE
+			| B_ERASE_FILE);
+		if (file.InitCheck() != B_OK)
+			return;
+		if (file.WriteAtExactly(0, data, size) != B_OK) {
+			BEntry(tempPath.Path()).Remove();
+			return;
+		}
+	}
+	BEntry entry(tempPath.Path());
+	if (entry.Rename(name, true) != B_OK) {
+		entry.Remove();
+		return;
+	}
+
+	BAutolock lock(fLock);
+	if (fTotalSize >= 0)
+		fTotalSize += size;
+	if (fTotalSize < 0 || fTotalSize > fMaxSize)
+		_Trim(directory);
+}
+
+
+status_t
+DiskCache::_Directory(BPath* path)
+{
+	status_t status = find_directory(B_USER_CACHE_DIRECTORY, path);
+	if (status == B_OK)
+		status = path->Append("JXLTranslator");
+	if (status == B_OK)
+		status = path->Append(fName);
+	if (status != B_OK)
+		return status;
+
+	status = create_directory(path->Path(), 0755);
+	return status == B_FILE_EXISTS ? B_OK : status;
+}
+
+
+// Removes the least recently used entries until the cache is well under
+// its limit, so this doesn't run again on the next store. fLock must be
+// held.
+void
+DiskCache::_Trim(const BPath& directory)
+{
+	BDirectory dir(directory.Path());
+	if (dir.InitCheck() != B_OK)
+		return;
+
+	std::vector<CacheFile> files;
+	off_t totalSize = 0;
+	BEntry entry;
+	while (dir.GetNextEntry(&entry) == B_OK) {
+		CacheFile file;
+		if (entry.GetModificationTime(&file.modified) != B_OK
+			|| entry.GetSize(&file.size) != B_OK
+			|| entry.GetPath(&file.path) != B_OK)
+			continue;
+		totalSize += file.size;
+		files.push_back(file);
+	}
+
+	if (totalSize > fMaxSize) {
+		std::sort(files.begin(), files.end(), compare_cache_files);
+		const off_t targetSize = fMaxSize / 4 * 3;
+		for (size_t i = 0; i < files.size() && totalSize > targetSize; i++) {
+			if (BEntry(files[i].path.Path()).Remove() == B_OK)
+				totalSize -= files[i].size;
+		}
+	}
+	fTotalSize = totalSize;
+}
+
+
+// #pragma mark -
+
+
+status_t
+content_key(BPositionIO* in, uint64* key)
+{
+	off_t size;
+	status_t status = in->GetSize(&size);
+	if (status != B_OK)
+		return status;
+
+	uint8 sample[kKeySampleSize];
+	ssize_t bytesRead = in->ReadAt(0, sample, sizeof(sample));
+	if (bytesRead < 0)
+		return bytesRead;
+	uint64 hash = content_hash(sample, bytesRead, size);
+	if (size > (off_t)kKeySampleSize) {
+		bytesRead = in->ReadAt(std::max((off_t)kKeySampleSize,
+			size - (off_t)kKeySampleSize), sample, sizeof(sample));
+		if (bytesRead < 0)
+			return bytesRead;
+		hash = content_hash(sample, bytesRead, hash);
+	}
+	*key = hash;
+	return B_OK;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <Locker.h>
+#include <SupportDefs.h>
+
+#include <atomic>
+#include <vector>
+
+class BPath;
+class BPositionIO;
+
+
+// A directory of files in the user's cache directory, named by a 64 bit
+// key. Entries are written to a temporary file and renamed into place, so
+// readers never see a partial one, even from another team. When the total
+// size goes over the limit, the least recently used entries are removed.
+class DiskCache {
+public:
+							DiskCache(const char* name);
+
+			void			SetMaxSize(off_t maxSize);
+
+			bool			Lookup(uint64 key, std::vector<uint8>& data);
+			void			Store(uint64 key, const void* data, size_t size);
+
+			int64			Hits() const { return fHits; }
+			int64			Misses() const { return fMisses; }
+
+private:
+			status_t		_Directory(BPath* path);
+			void			_Trim(const BPath& directory);
+
+			const char*		fName;
+			BLocker			fLock;
+			off_t			fMaxSize;
+			off_t			fTotalSize;
+				// -1 until the directory has been scanned
+			std::atomic<int64> fHits;
+			std::atomic<int64> fMisses;
+};
+
+
+status_t content_key(BPositionIO* in, uint64* key);
+	// identifies a file by its size and the data at its start and end,
+	// without reading the rest
+
+
+#endif // DISKCACHE_H
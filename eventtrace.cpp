@@ -0,0 +1,199 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "eventtrace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <string>
+
+const uint32 kRingSize = 16384;
+
+struct TraceEvent {
+	const char*		name;
+	bigtime_t		start;
+	bigtime_t		duration;
+	thread_id		thread;
+};
+
+// Written only by the thread that owns it, so recording needs no lock
+struct TraceRing {
+	TraceEvent		events[kRingSize];
+	std::atomic<uint64> count;
+		// events ever recorded, the last kRingSize are kept
+	uint64			dumped;
+		// events already written out, guarded by sDumpLock
+	bool			inUse;
+	TraceRing*		next;
+};
+
+std::atomic<bool> gTraceEnabled(false);
+
+static std::mutex sTraceLock;
+static TraceRing* sRings = NULL;
+	// never freed, guarded by sTraceLock. Rings are only ever added in
+	// front, so the list can be walked from a head read under it.
+static std::string sTracePath;
+
+// Dumps append to the file, so recording threads never wait on it
+static std::mutex sDumpLock;
+static FILE* sTraceFile = NULL;
+static std::string sTraceFilePath;
+static bool sTraceFileEmpty;
+
+// Gives the ring back when its thread exits, so threads that come and go
+// don't each leave one behind
+struct RingOwner {
+	RingOwner()
+		:
+		ring(NULL)
+	{
+	}
+
+	~RingOwner()
+	{
+		if (ring != NULL) {
+			std::lock_guard<std::mutex> lock(sTraceLock);
+			ring->inUse = false;
+		}
+	}
+
+	TraceRing*		ring;
+};
+
+static thread_local RingOwner sRingOwner;
+
+
+static TraceRing*
+claim_ring()
+{
+	std::lock_guard<std::mutex> lock(sTraceLock);
+	TraceRing* ring = sRings;
+	while (ring != NULL && ring->inUse)
+		ring = ring->next;
+	if (ring == NULL) {
+		ring = new(std::nothrow) TraceRing;
+		if (ring == NULL)
+			return NULL;
+		ring->count = 0;
+		ring->dumped = 0;
+		ring->next = sRings;
+		sRings = ring;
+	}
+	ring->inUse = true;
+	return ring;
+}
+
+
+// Ends the JSON array and closes the file, with sDumpLock held
+static status_t
+close_trace_file()
+{
+	if (sTraceFile == NULL)
+		return B_OK;
+	fputs("\n]\n", sTraceFile);
+	status_t status = fclose(sTraceFile) == 0 ? B_OK : errno;
+	sTraceFile = NULL;
+	sTraceFilePath.clear();
+	return status;
+}
+
+
+void
+trace_configure(const char* path)
+{
+	std::lock_guard<std::mutex> lock(sTraceLock);
+	const char* override = getenv("JXL_TRACE");
+	if (override != NULL && override[0] != '\0')
+		sTracePath = override;
+	else if (path != NULL)
+		sTracePath = path;
+	else
+		sTracePath.clear();
+
+	gTraceEnabled = !sTracePath.empty();
+	if (!gTraceEnabled) {
+		// turned back on, it starts over
+		std::lock_guard<std::mutex> dumpLock(sDumpLock);
+		close_trace_file();
+	}
+}
+
+
+void
+trace_record(const char* name, bigtime_t start, bigtime_t duration)
+{
+	TraceRing* ring = sRingOwner.ring;
+	if (ring == NULL) {
+		ring = claim_ring();
+		if (ring == NULL)
+			return;
+		sRingOwner.ring = ring;
+	}
+
+	const uint64 index = ring->count.load(std::memory_order_relaxed);
+	TraceEvent& event = ring->events[index % kRingSize];
+	event.name = name;
+	event.start = start;
+	event.duration = duration;
+	event.thread = find_thread(NULL);
+	ring->count.store(index + 1, std::memory_order_release);
+}
+
+
+status_t
+trace_dump()
+{
+	std::string path;
+	TraceRing* rings;
+	{
+		std::lock_guard<std::mutex> lock(sTraceLock);
+		path = sTracePath;
+		rings = sRings;
+	}
+
+	std::lock_guard<std::mutex> lock(sDumpLock);
+	if (path != sTraceFilePath) {
+		close_trace_file();
+		if (path.empty())
+			return B_OK;
+		sTraceFile = fopen(path.c_str(), "w");
+		if (sTraceFile == NULL)
+			return errno;
+		sTraceFilePath = path;
+		sTraceFileEmpty = true;
+		fputs("[", sTraceFile);
+	}
+
+	for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+		const uint64 count = ring->count.load(std::memory_order_acquire);
+		uint64 first = count > kRingSize ? count - kRingSize : 0;
+		first = std::max(first, ring->dumped);
+		for (uint64 i = first; i < count; i++) {
+			const TraceEvent& event = ring->events[i % kRingSize];
+			fprintf(sTraceFile, "%s{\"name\":\"%s\",\"ph\":\"X\","
+				"\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d}",
+				sTraceFileEmpty ? "\n" : ",\n", event.name,
+				(long long)event.start, (long long)event.duration,
+				(int)getpid(), (int)event.thread);
+			sTraceFileEmpty = false;
+		}
+		ring->dumped = count;
+	}
+	return fflush(sTraceFile) == 0 ? B_OK : errno;
+}
+
+
+status_t
+trace_finish()
+{
+	std::lock_guard<std::mutex> lock(sDumpLock);
+	return close_trace_file();
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef EVENTTRACE_H
+#define EVENTTRACE_H
+
+#include "codecdefs.h"
+
+#include <atomic>
+
+
+extern std::atomic<bool> gTraceEnabled;
+
+void trace_configure(const char* path);
+	// Turns tracing on, writing to path, or off if path is NULL. The
+	// JXL_TRACE environment variable overrides it with a path of its own.
+void trace_record(const char* name, bigtime_t start, bigtime_t duration);
+	// Adds a span to the calling thread's ring, the oldest spans are
+	// overwritten. name must stay valid, a string literal.
+status_t trace_dump();
+	// Appends the spans recorded since the last dump to the file, as a
+	// Chrome trace JSON array for chrome://tracing or Perfetto. The file
+	// is started over when tracing is turned on or moved, and spans
+	// recorded while this runs may come out torn.
+status_t trace_finish();
+	// Ends the array and closes the file. A file left unfinished, by a
+	// crash say, still loads.
+
+
+// Records the time until it goes out of scope. When tracing is off, this
+// is a single relaxed load.
+class TraceSpan {
+public:
+	TraceSpan(const char* name)
+		:
+		fName(name),
+		fStart(gTraceEnabled.load(std::memory_order_relaxed)
+			? system_time() : -1)
+	{
+	}
+
+	~TraceSpan()
+	{
+		if (fStart >= 0)
+			trace_record(fName, fStart, system_time() - fStart);
+	}
+
+private:
+			const char*		fName;
+			bigtime_t		fStart;
+};
+
+
+#endif // EVENTTRACE_H
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "imageanalysis.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const uint32 kColorTableSize = IMAGE_ANALYSIS_MAX_COLORS * 2;
+const uint32 kColorTableShift = 23;
+	// 32 - log2(kColorTableSize)
+
+
+ImageAnalyzer::ImageAnalyzer(const PixelLayout& layout, int32 width)
+	:
+	fLayout(layout),
+	fWidth(width),
+	fOpaque(true),
+	fGray(true),
+	fCountColors(true),
+	fNumColors(0),
+	fLastColor(0),
+	fHaveLastColor(false)
+{
+	memset(fUsed, 0, sizeof(fUsed));
+}
+
+
+void
+ImageAnalyzer::AddRows(const uint8* rows, size_t rowBytes, int32 count)
+{
+	for (int32 y = 0; y < count && !IsDone(); y++) {
+		const uint8* row = rows + y * rowBytes;
+		if (fOpaque || fGray)
+			_CheckRow(row);
+		if (fCountColors)
+			_CountColors(row);
+	}
+}
+
+
+bool
+ImageAnalyzer::IsDone() const
+{
+	return !fOpaque && !fGray && !fCountColors;
+}
+
+
+ImageAnalysis
+ImageAnalyzer::Result() const
+{
+	ImageAnalysis result;
+	result.opaque = fOpaque;
+	result.gray = fGray;
+	result.numColors = fCountColors ? fNumColors : 0;
+	return result;
+}
+
+
+uint32
+ImageAnalyzer::OutputChannels() const
+{
+	return (fGray ? 1 : 3) + (fOpaque ? 0 : 1);
+}
+
+
+void
+ImageAnalyzer::_CheckRow(const uint8* row)
+{
+	const PixelLayout& layout = fLayout;
+	const bool hasAlpha = layout.alpha >= 0;
+	if (!hasAlpha && layout.bytesPerPixel == 1) {
+		// B_GRAY8 can't be anything but opaque gray
+		return;
+	}
+
+	int32 x = 0;
+#if defined(__SSE2__)
+	if (layout.bytesPerPixel == 4) {
+		// Four pixels at a time. Comparing each byte with its neighbour
+		// checks the three contiguous color bytes for equality.
+		const int32 firstColor = std::min(layout.red,
+			std::min(layout.green, layout.blue));
+		const int grayMask = (0x3 << firstColor) * 0x1111;
+		const int alphaMask = hasAlpha ? (0x1 << layout.alpha) * 0x1111 : 0;
+		const __m128i allOnes = _mm_set1_epi8((char)0xff);
+		for (; x + 4 <= fWidth; x += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(row + x * 4));
+			if (fGray) {
+				__m128i next = _mm_srli_epi32(pixels, 8);
+				int equal = _mm_movemask_epi8(_mm_cmpeq_epi8(pixels, next));
+				if ((equal & grayMask) != grayMask)
+					fGray = false;
+			}
+			if (fOpaque && hasAlpha) {
+				int opaque = _mm_movemask_epi8(_mm_cmpeq_epi8(pixels, allOnes));
+				if ((opaque & alphaMask) != alphaMask)
+					fOpaque = false;
+			}
+			if (!fGray && (!fOpaque || !hasAlpha))
+				return;
+		}
+	}
+#endif
+
+	for (; x < fWidth; x++) {
+		const uint8* pixel = row + x * layout.bytesPerPixel;
+		if (pixel[layout.red] != pixel[layout.green]
+			|| pixel[layout.green] != pixel[layout.blue])
+			fGray = false;
+		if (hasAlpha && pixel[layout.alpha] != 0xff)
+			fOpaque = false;
+	}
+}
+
+
+void
+ImageAnalyzer::_CountColors(const uint8* row)
+{
+	const PixelLayout& layout = fLayout;
+	for (int32 x = 0; x < fWidth; x++) {
+		const uint8* pixel = row + x * layout.bytesPerPixel;
+		uint32 color = (pixel[layout.red] << 16) | (pixel[layout.green] << 8)
+			| pixel[layout.blue];
+		if (layout.alpha >= 0)
+			color |= (uint32)pixel[layout.alpha] << 24;
+
+		// flat areas repeat the same color, skip the table for those
+		if (fHaveLastColor && color == fLastColor)
+			continue;
+		fLastColor = color;
+		fHaveLastColor = true;
+
+		uint32 slot = (color * 0x9e3779b1u) >> kColorTableShift;
+		while (fUsed[slot] && fColors[slot] != color)
+			slot = (slot + 1) & (kColorTableSize - 1);
+		if (fUsed[slot])
+			continue;
+
+		if (fNumColors == IMAGE_ANALYSIS_MAX_COLORS) {
+			fCountColors = false;
+			return;
+		}
+		fUsed[slot] = true;
+		fColors[slot] = color;
+		fNumColors++;
+	}
+}
+
+
+// #pragma mark -
+
+
+static const struct {
+	color_space		space;
+	PixelLayout		layout;
+} sPixelLayouts[] = {
+	{ B_RGB32, { 4, 2, 1, 0, -1 } },
+	{ B_RGBA32, { 4, 2, 1, 0, 3 } },
+	{ B_RGB32_BIG, { 4, 1, 2, 3, -1 } },
+	{ B_RGBA32_BIG, { 4, 1, 2, 3, 0 } },
+	{ B_RGB24, { 3, 2, 1, 0, -1 } },
+	{ B_RGB24_BIG, { 3, 0, 1, 2, -1 } },
+	{ B_GRAY8, { 1, 0, 0, 0, -1 } }
+};
+
+const uint32 kNumPixelLayouts = sizeof(sPixelLayouts) / sizeof(sPixelLayouts[0]);
+
+
+bool
+get_pixel_layout(color_space space, PixelLayout* layout)
+{
+	for (uint32 i = 0; i < kNumPixelLayouts; i++) {
+		if (sPixelLayouts[i].space == space) {
+			*layout = sPixelLayouts[i].layout;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+status_t
+expand_rgb16_rows(const uint8* src, size_t srcRowBytes, color_space space,
+	int32 width, int32 height, uint8* dst)
+{
+	const bool bigEndian = space == B_RGB16_BIG || space == B_RGB15_BIG
+		|| space == B_RGBA15_BIG;
+	const bool rgb16 = space == B_RGB16 || space == B_RGB16_BIG;
+	const bool alpha = space == B_RGBA15 || space == B_RGBA15_BIG;
+	if (!rgb16 && !alpha && space != B_RGB15 && space != B_RGB15_BIG)
+		return B_BAD_VALUE;
+
+	for (int32 y = 0; y < height; y++) {
+		const uint8* row = src + y * srcRowBytes;
+		for (int32 x = 0; x < width; x++) {
+			uint16 value = bigEndian ? (row[x * 2] << 8) | row[x * 2 + 1]
+				: (row[x * 2 + 1] << 8) | row[x * 2];
+			uint8 red, green, blue;
+			if (rgb16) {
+				red = (value >> 11) & 0x1f;
+				green = (value >> 5) & 0x3f;
+				green = (green << 2) | (green >> 4);
+			} else {
+				red = (value >> 10) & 0x1f;
+				green = (value >> 5) & 0x1f;
+				green = (green << 3) | (green >> 2);
+			}
+			blue = value & 0x1f;
+			*dst++ = (red << 3) | (red >> 2);
+			*dst++ = green;
+			*dst++ = (blue << 3) | (blue >> 2);
+			if (alpha)
+				*dst++ = (value & 0x8000) != 0 ? 0xff : 0;
+		}
+	}
+	return B_OK;
+}
+
+
+void
+pack_pixels(const uint8* src, size_t srcRowBytes, const PixelLayout& layout,
+	int32 width, int32 height, uint32 channels, uint8* dst)
+{
+	const bool gray = channels <= 2;
+	const bool alpha = channels == 2 || channels == 4;
+	for (int32 y = 0; y < height; y++) {
+		const uint8* row = src + y * srcRowBytes;
+		for (int32 x = 0; x < width; x++) {
+			// read the whole pixel first, dst may overlap it
+			const uint8* pixel = row + x * layout.bytesPerPixel;
+			uint8 red = pixel[layout.red];
+			uint8 green = pixel[layout.green];
+			uint8 blue = pixel[layout.blue];
+			uint8 opacity = layout.alpha >= 0 ? pixel[layout.alpha] : 0xff;
+			*dst++ = red;
+			if (!gray) {
+				*dst++ = green;
+				*dst++ = blue;
+			}
+			if (alpha)
+				*dst++ = opacity;
+		}
+	}
+}
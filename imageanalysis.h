@@ -0,0 +1,80 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef IMAGEANALYSIS_H
+#define IMAGEANALYSIS_H
+
+#include "codecdefs.h"
+
+#define IMAGE_ANALYSIS_MAX_COLORS 256
+
+
+// Byte offsets of the channels within one pixel, -1 if not present
+struct PixelLayout {
+	uint32	bytesPerPixel;
+	int32	red;
+	int32	green;
+	int32	blue;
+	int32	alpha;
+};
+
+struct ImageAnalysis {
+	bool	opaque;
+		// alpha is absent or 255 everywhere
+	bool	gray;
+		// red, green and blue are equal everywhere
+	uint32	numColors;
+		// distinct colors, 0 if more than IMAGE_ANALYSIS_MAX_COLORS
+};
+
+
+// Finds the cheapest lossless representation of an image in a single pass
+// over its rows. Rows can be added in any number of batches.
+class ImageAnalyzer {
+public:
+						ImageAnalyzer(const PixelLayout& layout, int32 width);
+
+			void		AddRows(const uint8* rows, size_t rowBytes,
+							int32 count);
+			bool		IsDone() const;
+				// true when further rows can't change the result
+			ImageAnalysis Result() const;
+
+			uint32		OutputChannels() const;
+				// channels needed to represent the image losslessly:
+				// 1 = gray, 2 = gray + alpha, 3 = RGB, 4 = RGBA
+
+private:
+			void		_CheckRow(const uint8* row);
+			void		_CountColors(const uint8* row);
+
+			PixelLayout	fLayout;
+			int32		fWidth;
+			bool		fOpaque;
+			bool		fGray;
+			bool		fCountColors;
+			uint32		fNumColors;
+			uint32		fLastColor;
+			bool		fHaveLastColor;
+			uint32		fColors[IMAGE_ANALYSIS_MAX_COLORS * 2];
+			bool		fUsed[IMAGE_ANALYSIS_MAX_COLORS * 2];
+};
+
+
+bool get_pixel_layout(color_space space, PixelLayout* layout);
+	// layout of the 8 bit per channel color spaces, false for others
+
+status_t expand_rgb16_rows(const uint8* src, size_t srcRowBytes,
+	color_space space, int32 width, int32 height, uint8* dst);
+	// expands B_RGB15/16 to packed RGB and B_RGBA15 to packed RGBA, the
+	// _BIG variants included
+
+void pack_pixels(const uint8* src, size_t srcRowBytes,
+	const PixelLayout& layout, int32 width, int32 height, uint32 channels,
+	uint8* dst);
+	// converts to the packed layout given by ImageAnalyzer::OutputChannels(),
+	// in channel order R, G, B, A. dst may be equal to src.
+
+
+#endif // IMAGEANALYSIS_H
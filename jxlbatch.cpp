@@ -0,0 +1,943 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Converts whole directory trees to, from or between JPEG XL files, or
+// checks them, with the codec core, for migrations and scrubs too big to
+// drive through the translator a file at a time:
+//	jxlbatch [options] transcode|decode|encode|verify <input> <output>
+// Files are read, translated and finished by separate groups of threads,
+// with bounded queues in between, so that storage and processors are kept
+// busy at the same time. Translations write straight to a partial file, so
+// no output is held in memory, and inputs too big to buffer are read as
+// they are translated. Finished files are synced, renamed and listed in a
+// journal in the output directory, and skipped when the same batch is run
+// again.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "codecio.h"
+#include "codecmetrics.h"
+#include "codecmonitor.h"
+#include "codecpool.h"
+#include "imageanalysis.h"
+#include "jxlcodec.h"
+#include "jxllibrary.h"
+
+const char* kJournalName = ".jxlbatch-journal";
+const char* kPartialSuffix = ".part";
+const bigtime_t kReportInterval = 1000000;
+const uint32 kBitmapMagic = 'bits';
+const size_t kMaxBufferedInput = 64 * 1024 * 1024;
+	// bigger files are read from as they are translated
+
+enum batch_mode {
+	MODE_TRANSCODE,
+	MODE_DECODE,
+	MODE_ENCODE,
+	MODE_VERIFY
+};
+
+
+// A queue between two stages of the pipeline, bounded both in items and in
+// the bytes they hold. Adding waits while it is full, taking waits while it
+// is empty until every producer is done.
+template<typename Item>
+class BoundedQueue {
+public:
+	BoundedQueue(size_t capacity, size_t byteCapacity, uint32 producers)
+		:
+		fCapacity(capacity),
+		fByteCapacity(byteCapacity),
+		fBytes(0),
+		fProducers(producers)
+	{
+	}
+
+	void Add(Item item, size_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(fLock);
+		// an empty queue takes anything, or a big item would never fit
+		while (!fItems.empty() && (fItems.size() >= fCapacity
+				|| fBytes + bytes > fByteCapacity))
+			fNotFull.wait(lock);
+		fItems.push_back(Entry(std::move(item), bytes));
+		fBytes += bytes;
+		fNotEmpty.notify_one();
+	}
+
+	bool Take(Item* item)
+	{
+		std::unique_lock<std::mutex> lock(fLock);
+		while (fItems.empty() && fProducers > 0)
+			fNotEmpty.wait(lock);
+		if (fItems.empty())
+			return false;
+		*item = std::move(fItems.front().first);
+		fBytes -= fItems.front().second;
+		fItems.pop_front();
+		// items differ in size, so any of the waiting ones may fit now
+		fNotFull.notify_all();
+		return true;
+	}
+
+	void ProducerDone()
+	{
+		std::lock_guard<std::mutex> lock(fLock);
+		if (--fProducers == 0)
+			fNotEmpty.notify_all();
+	}
+
+private:
+	typedef std::pair<Item, size_t> Entry;
+
+	std::mutex				fLock;
+	std::condition_variable	fNotFull;
+	std::condition_variable	fNotEmpty;
+	std::deque<Entry>		fItems;
+	size_t					fCapacity;
+	size_t					fByteCapacity;
+	size_t					fBytes;
+	uint32					fProducers;
+};
+
+
+// A file on its way through the pipeline
+struct BatchItem {
+	BatchItem()
+		:
+		inputFile(-1),
+		outputFile(-1),
+		status(B_OK)
+	{
+	}
+
+	~BatchItem()
+	{
+		if (inputFile >= 0)
+			close(inputFile);
+		if (outputFile >= 0)
+			close(outputFile);
+	}
+
+	size_t					index;
+	std::vector<uint8>		input;
+		// the whole file, unless it is bigger than kMaxBufferedInput
+	int						inputFile;
+		// left open instead when it is, -1 otherwise
+	int						outputFile;
+		// the partial file the translation is written to, -1 if none
+	status_t				status;
+	VerifyResult			verify;
+	TranslationMetrics		metrics;
+};
+
+typedef std::unique_ptr<BatchItem> BatchItemPointer;
+
+
+struct BatchOptions {
+	batch_mode				mode;
+	std::string				input;
+	std::string				output;
+	EncodeParameters		encode;
+	uint32					readers;
+	uint32					workers;
+	uint32					threadsPerImage;
+	uint32					writers;
+	uint32					queueDepth;
+	size_t					queueBytes;
+	bool					digest;
+	const char*				reportPath;
+};
+
+
+// Shared by all threads of a batch
+struct Batch {
+	const BatchOptions*		options;
+	const JxlLibrary*		jxl;
+	std::vector<std::string> files;
+		// relative to the input and output directories
+	std::atomic<size_t>		nextRead;
+	BoundedQueue<BatchItemPointer>* read;
+	BoundedQueue<BatchItemPointer>* translated;
+
+	std::mutex				journalLock;
+	FILE*					journal;
+
+	std::mutex				writersLock;
+	std::condition_variable	writersDone;
+	uint32					writersLeft;
+	bigtime_t				finishTime;
+		// when the last writer was done
+
+	MetricsAggregate		metrics;
+	std::atomic<uint64>		filesDone;
+	std::atomic<uint64>		filesFailed;
+	std::atomic<uint64>		bytesRead;
+	std::atomic<uint64>		bytesWritten;
+	std::atomic<uint64>		pixels;
+};
+
+
+static void
+usage()
+{
+	fprintf(stderr,
+		"usage: jxlbatch [options] transcode|decode|encode|verify <input> "
+			"<output>\n"
+		"  transcode  re-encodes each .jxl file with the options below\n"
+		"  decode     writes each .jxl file as a Haiku bitmap (.bits)\n"
+		"  encode     writes each Haiku bitmap (.bits) as a .jxl file with\n"
+		"             the options below\n"
+		"  verify     only checks that each file decodes; <output> holds\n"
+		"             the journal with the results\n"
+		"options:\n"
+		"  -d distance   butteraugli distance, 0 for lossless (1)\n"
+		"  -e effort     1-9 (7)\n"
+		"  -p            progressive\n"
+		"  -j workers    images translated at once (processors / -t)\n"
+		"  -t threads    threads per image (1)\n"
+		"  -r readers    threads reading files (4)\n"
+		"  -w writers    threads writing files (4)\n"
+		"  -q depth      files waiting between stages (2 per worker)\n"
+		"  -m megabytes  memory for files waiting to be translated (1024)\n"
+		"  -s            digest the pixels when verifying\n"
+		"  -o report     also write the report as JSON\n");
+}
+
+
+static bool
+has_extension(const char* name, const char* extension)
+{
+	size_t length = strlen(name);
+	size_t extensionLength = strlen(extension);
+	return length > extensionLength
+		&& strcasecmp(name + length - extensionLength, extension) == 0;
+}
+
+
+// Lists the files with extension under directory, relative to the root of
+// the batch
+static void
+find_files(const std::string& root, const std::string& directory,
+	const char* extension, std::vector<std::string>* files)
+{
+	std::string path = directory.empty() ? root : root + "/" + directory;
+	DIR* dir = opendir(path.c_str());
+	if (dir == NULL) {
+		fprintf(stderr, "Can't read %s: %s\n", path.c_str(), strerror(errno));
+		return;
+	}
+	while (dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] == '.')
+			continue;
+		std::string name = directory.empty() ? entry->d_name
+			: directory + "/" + entry->d_name;
+		struct stat st;
+		if (stat((root + "/" + name).c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			find_files(root, name, extension, files);
+		else if (S_ISREG(st.st_mode) && has_extension(entry->d_name, extension)
+			&& strchr(entry->d_name, '\n') == NULL)
+			files->push_back(name);
+	}
+	closedir(dir);
+}
+
+
+static const char*
+status_message(status_t status)
+{
+#ifdef __HAIKU__
+	return strerror(status);
+#else
+	// errno values here, the codec's own are negative
+	return status > 0 ? strerror(status) : "can't be translated";
+#endif
+}
+
+
+static status_t
+make_directories(const std::string& path)
+{
+	for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+		std::string part = path.substr(0, slash);
+		if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST)
+			return errno;
+		if (slash == std::string::npos)
+			return B_OK;
+	}
+}
+
+
+static std::string
+output_path(const Batch* batch, const std::string& file)
+{
+	const std::string& output = batch->options->output;
+	switch (batch->options->mode) {
+		case MODE_DECODE:
+			return output + "/" + file.substr(0, file.size() - 4) + ".bits";
+		case MODE_ENCODE:
+			return output + "/" + file.substr(0, file.size() - 5) + ".jxl";
+		default:
+			return output + "/" + file;
+	}
+}
+
+
+// Reads a file into item->input, or leaves it open in item->inputFile if
+// it is too big to hold
+static status_t
+read_input(const std::string& path, BatchItem* item)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return errno;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return errno;
+	}
+	item->metrics.bytesIn = st.st_size;
+	if ((uint64)st.st_size > kMaxBufferedInput) {
+		item->inputFile = fd;
+		return B_OK;
+	}
+
+	status_t status = B_OK;
+	item->input.resize(st.st_size);
+	size_t done = 0;
+	while (done < item->input.size()) {
+		ssize_t bytesRead = read(fd, item->input.data() + done,
+			item->input.size() - done);
+		if (bytesRead <= 0) {
+			status = bytesRead < 0 ? errno : B_IO_ERROR;
+			break;
+		}
+		done += bytesRead;
+	}
+	close(fd);
+	return status;
+}
+
+
+// Output goes to a partial file first, so an interrupted batch never leaves
+// a truncated file under the final name
+static status_t
+open_output(const std::string& path, BatchItem* item)
+{
+	status_t status = make_directories(path.substr(0, path.rfind('/')));
+	if (status != B_OK)
+		return status;
+	std::string partial = path + kPartialSuffix;
+	item->outputFile = open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+		0644);
+	return item->outputFile >= 0 ? B_OK : errno;
+}
+
+
+// Makes a partial file permanent once it is safely on disk, or removes it
+static status_t
+finish_output(const std::string& path, BatchItem* item)
+{
+	std::string partial = path + kPartialSuffix;
+	status_t status = item->status;
+	struct stat st;
+	if (status == B_OK && fstat(item->outputFile, &st) == 0)
+		item->metrics.bytesOut = st.st_size;
+	if (status == B_OK && fsync(item->outputFile) != 0)
+		status = errno;
+	if (close(item->outputFile) != 0 && status == B_OK)
+		status = errno;
+	item->outputFile = -1;
+	if (status == B_OK && rename(partial.c_str(), path.c_str()) != 0)
+		status = errno;
+	if (status != B_OK)
+		unlink(partial.c_str());
+	return status;
+}
+
+
+static void
+write_big_endian(uint8* out, uint32 value)
+{
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+}
+
+
+static void
+write_big_endian(uint8* out, float value)
+{
+	uint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	write_big_endian(out, bits);
+}
+
+
+static uint32
+read_big_endian(const uint8* in)
+{
+	return (uint32)in[0] << 24 | (uint32)in[1] << 16 | (uint32)in[2] << 8
+		| in[3];
+}
+
+
+static float
+read_big_endian_float(const uint8* in)
+{
+	uint32 bits = read_big_endian(in);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+// The TranslatorBitmap header, big endian as in .bits files
+static status_t
+write_bitmap_header(CodecOutput* out, uint32 xsize, uint32 ysize)
+{
+	const uint64 rowBytes = (uint64)xsize * 4;
+	uint8 header[32];
+	write_big_endian(header, kBitmapMagic);
+	write_big_endian(header + 4, 0.0f);
+	write_big_endian(header + 8, 0.0f);
+	write_big_endian(header + 12, xsize - 1.0f);
+	write_big_endian(header + 16, ysize - 1.0f);
+	write_big_endian(header + 20, (uint32)rowBytes);
+	write_big_endian(header + 24, (uint32)B_RGBA32);
+	write_big_endian(header + 28,
+		(uint32)std::min(rowBytes * ysize, (uint64)UINT32_MAX));
+	return out->WriteExactly(header, sizeof(header));
+}
+
+
+// Loads the files finished by an earlier run of the same batch
+static void
+read_journal(const std::string& path, std::set<std::string>* done)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (file == NULL)
+		return;
+	char* line = NULL;
+	size_t size = 0;
+	ssize_t length;
+	// "ok <file>" and "failed <file>", extra fields following a tab
+	while ((length = getline(&line, &size, file)) > 0) {
+		if (line[length - 1] == '\n')
+			line[--length] = '\0';
+		if (strncmp(line, "ok ", 3) != 0)
+			continue;
+		char* end = strchr(line + 3, '\t');
+		done->insert(std::string(line + 3, end != NULL ? end : line + length));
+	}
+	free(line);
+	fclose(file);
+}
+
+
+static void
+write_journal(Batch* batch, const BatchItem* item)
+{
+	const std::string& file = batch->files[item->index];
+	std::lock_guard<std::mutex> lock(batch->journalLock);
+	if (item->status != B_OK) {
+		fprintf(batch->journal, "failed %s\terror %d", file.c_str(),
+			(int)item->status);
+		if (batch->options->mode == MODE_VERIFY && item->verify.errorOffset >= 0)
+			fprintf(batch->journal, " at %lld", (long long)item->verify.errorOffset);
+	} else {
+		fprintf(batch->journal, "ok %s", file.c_str());
+		if (batch->options->mode == MODE_VERIFY && batch->options->digest) {
+			fprintf(batch->journal, "\tdigest %016llx",
+				(unsigned long long)item->verify.digest);
+		}
+	}
+	fputc('\n', batch->journal);
+	fflush(batch->journal);
+}
+
+
+// #pragma mark - Stages
+
+
+static void
+read_files(Batch* batch)
+{
+	for (size_t index = batch->nextRead++; index < batch->files.size();
+			index = batch->nextRead++) {
+		BatchItemPointer item(new BatchItem);
+		item->index = index;
+		bigtime_t start = system_time();
+		item->status = read_input(batch->options->input + "/"
+			+ batch->files[index], item.get());
+		item->metrics.phaseTime[PHASE_READ] += system_time() - start;
+		batch->bytesRead += item->metrics.bytesIn;
+		const size_t bytes = item->input.size();
+		batch->read->Add(std::move(item), bytes);
+	}
+	batch->read->ProducerDone();
+}
+
+
+// Encodes a .bits file a chunk at a time, the way the translator encodes
+// bitmaps too big to hold
+static status_t
+encode_bitmap(Batch* batch, CodecMonitor* monitor, BatchItem* item,
+	CodecInput* input, CodecOutput* output)
+{
+	uint8 header[32];
+	status_t status = input->ReadAtExactly(0, header, sizeof(header));
+	if (status != B_OK)
+		return status;
+	if (read_big_endian(header) != kBitmapMagic)
+		return B_NO_TRANSLATOR;
+	const float width = ceilf(read_big_endian_float(header + 12)
+		- read_big_endian_float(header + 4)) + 1;
+	const float height = ceilf(read_big_endian_float(header + 16)
+		- read_big_endian_float(header + 8)) + 1;
+	if (!(width >= 1 && width <= INT32_MAX && height >= 1
+			&& height <= INT32_MAX))
+		return B_NO_TRANSLATOR;
+	const int32 xsize = (int32)width;
+	const int32 ysize = (int32)height;
+
+	ChunkedSource source;
+	source.in = input;
+	source.dataOffset = sizeof(header);
+	source.rowBytes = read_big_endian(header + 20);
+	source.space = (color_space)read_big_endian(header + 24);
+	source.status = B_OK;
+	source.monitor = monitor;
+	if (get_pixel_layout(source.space, &source.layout))
+		source.sourceBytesPerPixel = source.layout.bytesPerPixel;
+	else {
+		// 15 and 16 bit formats are widened to 8 bits per channel first
+		bool alpha;
+		switch (source.space) {
+			case B_RGBA15:
+			case B_RGBA15_BIG:
+				alpha = true;
+				break;
+			case B_RGB16:
+			case B_RGB16_BIG:
+			case B_RGB15:
+			case B_RGB15_BIG:
+				alpha = false;
+				break;
+			default:
+				return B_NO_TRANSLATOR;
+		}
+		PixelLayout expanded = { alpha ? 4u : 3u, 0, 1, 2, alpha ? 3 : -1 };
+		source.layout = expanded;
+		source.sourceBytesPerPixel = 2;
+	}
+	if (source.rowBytes < (uint64)xsize * source.sourceBytesPerPixel)
+		return B_NO_TRANSLATOR;
+
+	ImageAnalyzer analyzer(source.layout, xsize);
+	for (int32 y = 0; y < ysize && !analyzer.IsDone(); y += kRowBatchSize) {
+		const int32 count = std::min((int32)kRowBatchSize, ysize - y);
+		uint8* rows = ReadBitmapRect(&source, 0, y, xsize, count);
+		if (rows == NULL)
+			return source.status;
+		PhaseTimer timer(&item->metrics, PHASE_CONVERT);
+		analyzer.AddRows(rows, (size_t)xsize * source.layout.bytesPerPixel,
+			count);
+		free(rows);
+	}
+	const uint32 channels = analyzer.OutputChannels();
+	source.colorChannels = channels >= 3 ? 3 : 1;
+
+	EncodeParameters params = batch->options->encode;
+	params.monitor = monitor;
+	params.metrics = &item->metrics;
+	if (params.distance == 0 && analyzer.Result().numColors > 0)
+		params.paletteColors = analyzer.Result().numColors;
+	item->metrics.pixels = (uint64)xsize * ysize;
+	return EncodeChunked(batch->jxl, &source, xsize, ysize, channels, params,
+		output);
+}
+
+
+// Runs the codec over one file
+static status_t
+run_codec(Batch* batch, CodecMonitor* monitor, BatchItem* item,
+	CodecInput* input, CodecOutput* output)
+{
+	const BatchOptions* options = batch->options;
+	switch (options->mode) {
+		case MODE_TRANSCODE:
+		{
+			EncodeParameters params = options->encode;
+			params.monitor = monitor;
+			params.metrics = &item->metrics;
+			return TranscodeStreaming(batch->jxl, input, params, monitor,
+				output);
+		}
+		case MODE_DECODE:
+		{
+			DecodeParameters params;
+			params.toneCurve = TONE_CURVE_NONE;
+			params.targetProfile = NULL;
+			params.targetProfileSize = 0;
+			params.transforms = NULL;
+			params.orientation = 0;
+			return DecodeStreaming(batch->jxl, input, params, monitor,
+				write_bitmap_header, output);
+		}
+		case MODE_ENCODE:
+			return encode_bitmap(batch, monitor, item, input, output);
+		case MODE_VERIFY:
+			return VerifyStreaming(batch->jxl, input, options->digest,
+				monitor, &item->verify);
+	}
+	return B_BAD_VALUE;
+}
+
+
+static void
+translate_file(Batch* batch, CodecThreadPool* pool, BatchItem* item)
+{
+	const bigtime_t start = system_time();
+	CodecMonitor monitor;
+	monitor.SetThreadPool(pool);
+	monitor.SetMetrics(&item->metrics);
+	std::unique_ptr<CodecInput> input;
+	if (item->inputFile >= 0)
+		input.reset(new FileInput(item->inputFile));
+	else
+		input.reset(new MemoryInput(item->input.data(), item->input.size()));
+
+	if (batch->options->mode != MODE_VERIFY) {
+		item->status = open_output(output_path(batch,
+			batch->files[item->index]), item);
+	}
+	if (item->status == B_OK) {
+		FileOutput output(item->outputFile);
+		item->status = run_codec(batch, &monitor, item, input.get(), &output);
+	}
+
+	// the input isn't needed any more
+	input.reset();
+	std::vector<uint8>().swap(item->input);
+	if (item->inputFile >= 0) {
+		close(item->inputFile);
+		item->inputFile = -1;
+	}
+	item->metrics.Finish(system_time() - start
+		+ item->metrics.phaseTime[PHASE_READ]);
+	// set once the output is on disk for encodes
+	if (batch->options->mode != MODE_ENCODE)
+		item->metrics.compressedBytes = item->metrics.bytesIn;
+}
+
+
+static void
+translate_files(Batch* batch)
+{
+	// each worker keeps its own threads for the groups of its images
+	CodecThreadPool pool(batch->options->threadsPerImage - 1);
+	BatchItemPointer item;
+	while (batch->read->Take(&item)) {
+		if (item->status == B_OK)
+			translate_file(batch, &pool, item.get());
+		// the output is on disk already
+		batch->translated->Add(std::move(item), 0);
+	}
+	batch->translated->ProducerDone();
+}
+
+
+// Syncs, renames and journals the translated files, so a file is only
+// listed as done once it is on disk
+static void
+write_files(Batch* batch)
+{
+	BatchItemPointer item;
+	while (batch->translated->Take(&item)) {
+		if (item->outputFile >= 0) {
+			bigtime_t start = system_time();
+			item->status = finish_output(output_path(batch,
+				batch->files[item->index]), item.get());
+			bigtime_t time = system_time() - start;
+			item->metrics.phaseTime[PHASE_WRITE] += time;
+			item->metrics.totalTime += time;
+			batch->bytesWritten += item->metrics.bytesOut;
+			if (batch->options->mode == MODE_ENCODE)
+				item->metrics.compressedBytes = item->metrics.bytesOut;
+		}
+
+		if (item->status != B_OK) {
+			fprintf(stderr, "%s: %s\n", batch->files[item->index].c_str(),
+				status_message(item->status));
+			batch->filesFailed++;
+		} else {
+			batch->metrics.Add(item->metrics);
+			batch->pixels += item->metrics.pixels;
+		}
+		write_journal(batch, item.get());
+		batch->filesDone++;
+		item.reset();
+	}
+
+	std::lock_guard<std::mutex> lock(batch->writersLock);
+	if (--batch->writersLeft == 0) {
+		batch->finishTime = system_time();
+		batch->writersDone.notify_all();
+	}
+}
+
+
+// #pragma mark - Report
+
+
+static void
+print_progress(Batch* batch, bigtime_t start)
+{
+	const double seconds = (system_time() - start) / 1000000.0;
+	fprintf(stderr, "\r%llu/%zu files, %.1f MB/s in, %.1f MB/s out, "
+		"%.1f MP/s  ", (unsigned long long)batch->filesDone.load(),
+		batch->files.size(), batch->bytesRead / 1e6 / seconds,
+		batch->bytesWritten / 1e6 / seconds, batch->pixels / 1e6 / seconds);
+}
+
+
+static void
+print_report(Batch* batch, size_t skipped, bigtime_t elapsed)
+{
+	MetricsSummary summary;
+	batch->metrics.GetSummary(&summary);
+	const double seconds = elapsed / 1000000.0;
+	printf("\n%llu files translated, %llu failed, %zu already done\n",
+		(unsigned long long)(batch->filesDone - batch->filesFailed),
+		(unsigned long long)batch->filesFailed.load(), skipped);
+	printf("%.1f s, %.1f MB read (%.1f MB/s), %.1f MB written (%.1f MB/s)\n",
+		seconds, batch->bytesRead / 1e6, batch->bytesRead / 1e6 / seconds,
+		batch->bytesWritten / 1e6, batch->bytesWritten / 1e6 / seconds);
+	printf("%.1f megapixels/s overall, %.2f files/s\n",
+		batch->pixels / 1e6 / seconds, batch->filesDone / seconds);
+	if (summary.count > 0) {
+		// upper bounds, at most 12.5% off
+		printf("per file: p50 <= %.3g ms, p90 <= %.3g ms, p99 <= %.3g ms\n",
+			summary.latencyP50 / 1000.0, summary.latencyP90 / 1000.0,
+			summary.latencyP99 / 1000.0);
+		printf("thread time: read %.1f s, convert %.1f s, write %.1f s, "
+			"codec %.1f s\n", summary.phaseTime[PHASE_READ] / 1e6,
+			summary.phaseTime[PHASE_CONVERT] / 1e6,
+			summary.phaseTime[PHASE_WRITE] / 1e6,
+			summary.phaseTime[PHASE_CODEC] / 1e6);
+	}
+
+	if (batch->options->reportPath != NULL) {
+		// transcodes and encodes count as encodes, the rest as decodes
+		MetricsSummary empty;
+		MetricsAggregate().GetSummary(&empty);
+		const bool encodes = batch->options->mode == MODE_TRANSCODE
+			|| batch->options->mode == MODE_ENCODE;
+		if (write_metrics_json(batch->options->reportPath,
+				encodes ? empty : summary, encodes ? summary : empty) != B_OK) {
+			fprintf(stderr, "Can't write %s\n", batch->options->reportPath);
+		}
+	}
+}
+
+
+// #pragma mark -
+
+
+static bool
+parse_options(int argc, char** argv, BatchOptions* options)
+{
+	const uint32 processors = std::max(1u, std::thread::hardware_concurrency());
+	options->encode.distance = 1;
+	options->encode.effort = 7;
+	options->encode.decodingSpeed = 0;
+	options->encode.progressive = false;
+	options->encode.preview = false;
+	options->encode.paletteColors = 0;
+	options->encode.monitor = NULL;
+	options->encode.metrics = NULL;
+	options->readers = 4;
+	options->workers = 0;
+	options->threadsPerImage = 1;
+	options->writers = 4;
+	options->queueDepth = 0;
+	options->queueBytes = 1024 * 1024 * 1024;
+	options->digest = false;
+	options->reportPath = NULL;
+
+	int option;
+	while ((option = getopt(argc, argv, "d:e:pj:t:r:w:q:m:so:")) != -1) {
+		switch (option) {
+			case 'd':
+				options->encode.distance = atof(optarg);
+				break;
+			case 'e':
+				options->encode.effort = atoi(optarg);
+				break;
+			case 'p':
+				options->encode.progressive = true;
+				break;
+			case 'j':
+				options->workers = atoi(optarg);
+				break;
+			case 't':
+				options->threadsPerImage = atoi(optarg);
+				break;
+			case 'r':
+				options->readers = atoi(optarg);
+				break;
+			case 'w':
+				options->writers = atoi(optarg);
+				break;
+			case 'q':
+				options->queueDepth = atoi(optarg);
+				break;
+			case 'm':
+				options->queueBytes = (size_t)atoi(optarg) * 1024 * 1024;
+				break;
+			case 's':
+				options->digest = true;
+				break;
+			case 'o':
+				options->reportPath = optarg;
+				break;
+			default:
+				return false;
+		}
+	}
+	if (argc - optind != 3)
+		return false;
+	if (strcmp(argv[optind], "transcode") == 0)
+		options->mode = MODE_TRANSCODE;
+	else if (strcmp(argv[optind], "decode") == 0)
+		options->mode = MODE_DECODE;
+	else if (strcmp(argv[optind], "encode") == 0)
+		options->mode = MODE_ENCODE;
+	else if (strcmp(argv[optind], "verify") == 0)
+		options->mode = MODE_VERIFY;
+	else
+		return false;
+	options->input = argv[optind + 1];
+	options->output = argv[optind + 2];
+
+	if (options->encode.distance < 0 || options->encode.distance > 25
+		|| options->encode.effort < 1 || options->encode.effort > 9
+		|| options->readers < 1 || options->writers < 1
+		|| options->threadsPerImage < 1)
+		return false;
+	if (options->workers < 1)
+		options->workers = std::max(1u, processors / options->threadsPerImage);
+	if (options->queueDepth < 1)
+		options->queueDepth = options->workers * 2;
+	return true;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	BatchOptions options;
+	if (!parse_options(argc, argv, &options)) {
+		usage();
+		return 1;
+	}
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL) {
+		fprintf(stderr, "Can't load libjxl\n");
+		return 1;
+	}
+	if (make_directories(options.output) != B_OK) {
+		fprintf(stderr, "Can't create %s\n", options.output.c_str());
+		return 1;
+	}
+
+	Batch batch;
+	batch.options = &options;
+	batch.jxl = jxl;
+	batch.nextRead = 0;
+	batch.filesDone = 0;
+	batch.filesFailed = 0;
+	batch.bytesRead = 0;
+	batch.bytesWritten = 0;
+	batch.pixels = 0;
+	batch.writersLeft = options.writers;
+	batch.finishTime = 0;
+
+	std::vector<std::string> found;
+	find_files(options.input, "",
+		options.mode == MODE_ENCODE ? ".bits" : ".jxl", &found);
+	std::sort(found.begin(), found.end());
+	const std::string journalPath = options.output + "/" + kJournalName;
+	std::set<std::string> done;
+	read_journal(journalPath, &done);
+	for (size_t i = 0; i < found.size(); i++) {
+		if (done.count(found[i]) == 0)
+			batch.files.push_back(found[i]);
+	}
+	const size_t skipped = found.size() - batch.files.size();
+
+	batch.journal = fopen(journalPath.c_str(), "a");
+	if (batch.journal == NULL) {
+		fprintf(stderr, "Can't write %s\n", journalPath.c_str());
+		return 1;
+	}
+
+	BoundedQueue<BatchItemPointer> read(options.queueDepth, options.queueBytes,
+		options.readers);
+	BoundedQueue<BatchItemPointer> translated(options.queueDepth, SIZE_MAX,
+		options.workers);
+	batch.read = &read;
+	batch.translated = &translated;
+
+	const bigtime_t start = system_time();
+	std::vector<std::thread> threads;
+	for (uint32 i = 0; i < options.readers; i++)
+		threads.push_back(std::thread(read_files, &batch));
+	for (uint32 i = 0; i < options.workers; i++)
+		threads.push_back(std::thread(translate_files, &batch));
+	for (uint32 i = 0; i < options.writers; i++)
+		threads.push_back(std::thread(write_files, &batch));
+
+	const std::chrono::microseconds interval(isatty(STDERR_FILENO)
+		? kReportInterval : kReportInterval * 10);
+	{
+		std::unique_lock<std::mutex> lock(batch.writersLock);
+		while (batch.writersLeft > 0) {
+			if (batch.writersDone.wait_for(lock, interval)
+					== std::cv_status::timeout)
+				print_progress(&batch, start);
+		}
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	fclose(batch.journal);
+
+	print_report(&batch, skipped, batch.finishTime - start);
+	return batch.filesFailed > 0 ? 2 : 0;
+}
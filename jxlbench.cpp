@@ -0,0 +1,1762 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Times translations over a corpus of images, run by
+// "make -f Makefile.core bench". On Haiku the translator add-on is loaded
+// and driven through Translate(); elsewhere the codec core is, along the
+// same buffered and streamed paths the translator picks between.
+// Benchmarks that need libjxl are skipped when it can't be loaded.
+//
+// Usage: jxlbench [options] [benchmark ...]
+//	-c dir		a corpus of .bits files, sorted into classes by the
+//				subdirectory they are in. Without one, synthetic photos,
+//				screenshots, alpha, gray images, icons and scans are used.
+//	-k classes	the classes to run, separated by commas
+//	-s WxH		size of the synthetic images, icons excepted
+//	-S WxH		size of the synthetic scans, 32768x32768 is a gigapixel
+//	-d list		distances, -e efforts, -D decoding speeds and -j threads
+//	-e list		to run all combinations of, separated by commas
+//	-D list
+//	-j list
+//	-r runs		of each combination
+//	-m MiB		memory budget the paths are chosen by, elsewhere than on
+//				Haiku. Half of the physical memory by default, as in the
+//				translator.
+//	-a path		the translator add-on to load on Haiku, the installed one
+//				by default
+//	-o file		writes the results as JSON
+//	-b file		compares the results with those of an earlier run, and
+//	-t percent	fails if any got worse by more than this
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __HAIKU__
+#include <DataIO.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Message.h>
+#include <Path.h>
+#include <TranslatorFormats.h>
+#include <image.h>
+
+#include "jxltranslator.h"
+#include "testaddon.h"
+#endif
+
+#include "benchresults.h"
+#include "codecio.h"
+#include "codecmetrics.h"
+#include "codecmonitor.h"
+#include "codecpool.h"
+#include "colortransform.h"
+#include "imageanalysis.h"
+#include "jxlcodec.h"
+#include "jxllibrary.h"
+#include "pixelconversion.h"
+#include "testimages.h"
+#include "tonemap.h"
+
+// Corpus files larger than this are read as they are translated
+const off_t kMaxHeldFileSize = 256 * 1024 * 1024;
+// The tiers the translator takes
+const int32 kMinEffort = 1;
+const int32 kMaxEffort = 9;
+const int32 kMaxDecodingSpeed = 4;
+// Each image is saved this many times by the duplicates benchmark
+const uint32 kDuplicateSaves = 4;
+
+static const uint32 sIconSizes[] = { 16, 32, 64, 128 };
+
+struct BenchOptions {
+			const char*		corpus;
+			std::vector<std::string> classes;
+			uint32			width;
+			uint32			height;
+			uint32			scanWidth;
+			uint32			scanHeight;
+			std::vector<int32> distances;
+			std::vector<int32> efforts;
+			std::vector<int32> decodingSpeeds;
+			std::vector<int32> threads;
+			uint32			runs;
+			uint64			memoryBudget;
+			const char*		addOn;
+};
+
+// An image to translate, either held as a .bits file or read as it is
+// translated, from a file or as it is made
+struct CorpusImage {
+			std::string		name;
+			std::string		group;
+			TestImage		header;
+				// the size and layout, without the pixels
+			std::vector<uint8> bits;
+			std::string		path;
+			image_kind		kind;
+			uint32			seed;
+};
+
+struct GridPoint {
+			int32			distance;
+			int32			effort;
+			int32			decodingSpeed;
+			int32			threads;
+			bool			progressive;
+};
+
+struct BenchContext {
+			const BenchOptions* options;
+			const JxlLibrary* jxl;
+			BenchResults*	results;
+			std::vector<CorpusImage> corpus;
+#ifdef __HAIKU__
+			BTranslator*	translator;
+#endif
+};
+
+struct Benchmark {
+			const char*		name;
+			void			(*function)(BenchContext& context);
+			bool			needsLibrary;
+};
+
+// What one run measures, besides the time it takes
+typedef std::function<status_t(TranslationMetrics* metrics)> BenchRun;
+
+// The totals of one combination over a class of images
+struct GridResult {
+	GridResult()
+		:
+		encodeMemory(0),
+		decodeMemory(0)
+	{
+	}
+
+			MetricsAggregate encodes;
+			MetricsAggregate decodes;
+			uint64			encodeMemory;
+			uint64			decodeMemory;
+				// measured, the largest of any run
+};
+
+
+// An input for one translation of a corpus image
+class CorpusInput {
+public:
+	CorpusInput(const CorpusImage& image)
+		:
+		fFile(-1)
+	{
+		if (!image.bits.empty()) {
+			fInput.reset(new MemoryInput(image.bits.data(),
+				image.bits.size()));
+			fSize = image.bits.size();
+		} else if (!image.path.empty()) {
+			fFile = open(image.path.c_str(), O_RDONLY);
+			struct stat stat;
+			fSize = fFile >= 0 && fstat(fFile, &stat) == 0
+				? stat.st_size : 0;
+			fInput.reset(new FileInput(fFile));
+		} else {
+			TestImageInput* input = new TestImageInput(image.kind,
+				image.header.width, image.header.height, image.seed);
+			fSize = input->Size();
+			fInput.reset(input);
+		}
+	}
+
+	~CorpusInput()
+	{
+		if (fFile >= 0)
+			close(fFile);
+	}
+
+	CodecInput* Input() const
+	{
+		return fInput.get();
+	}
+
+	off_t Size() const
+	{
+		return fSize;
+	}
+
+private:
+	std::unique_ptr<CodecInput> fInput;
+	int					fFile;
+	off_t				fSize;
+};
+
+
+// Counts what is written to it and throws it away, so decodes are timed
+// without the bitmaps having to fit anywhere
+class NullOutput : public CodecOutput {
+public:
+	NullOutput()
+		:
+		fPosition(0)
+	{
+	}
+
+	virtual ssize_t Write(const void* buffer, size_t size)
+	{
+		fPosition += size;
+		return size;
+	}
+
+	virtual ssize_t WriteAt(off_t position, const void* buffer, size_t size)
+	{
+		return size;
+	}
+
+	virtual off_t Position() const
+	{
+		return fPosition;
+	}
+
+	virtual status_t SetPosition(off_t position)
+	{
+		fPosition = position;
+		return B_OK;
+	}
+
+private:
+	off_t				fPosition;
+};
+
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: jxlbench [-c corpus] [-k classes] [-s WxH] "
+		"[-S WxH] [-d distances]\n\t[-e efforts] [-D decoding speeds] "
+		"[-j threads] [-r runs] [-m MiB]\n\t[-a add-on] [-o results] "
+		"[-b baseline [-t percent]] [benchmark ...]\n");
+	exit(EXIT_FAILURE);
+}
+
+
+static std::vector<int32>
+parse_list(const char* list)
+{
+	std::vector<int32> values;
+	while (*list != '\0') {
+		char* end;
+		values.push_back(strtol(list, &end, 10));
+		if (end == list || (*end != ',' && *end != '\0'))
+			usage();
+		list = *end == ',' ? end + 1 : end;
+	}
+	return values;
+}
+
+
+static void
+parse_size(const char* size, uint32* width, uint32* height)
+{
+	unsigned parsedWidth;
+	unsigned parsedHeight;
+	if (sscanf(size, "%ux%u", &parsedWidth, &parsedHeight) != 2
+		|| parsedWidth == 0 || parsedHeight == 0)
+		usage();
+	*width = parsedWidth;
+	*height = parsedHeight;
+}
+
+
+static bool
+class_selected(const BenchOptions& options, const std::string& group)
+{
+	return options.classes.empty()
+		|| std::find(options.classes.begin(), options.classes.end(), group)
+			!= options.classes.end();
+}
+
+
+// #pragma mark - Corpus
+
+
+static void
+add_synthetic_image(BenchContext& context, image_kind kind, uint32 width,
+	uint32 height, bool streamed)
+{
+	CorpusImage image;
+	image.group = image_kind_name(kind);
+	image.kind = kind;
+	image.seed = context.corpus.size() + 1;
+	if (streamed) {
+		image.header.width = width;
+		image.header.height = height;
+		image.header.space = test_image_space(kind);
+		image.header.rowBytes = test_image_row_bytes(kind, width);
+	} else {
+		TestImage test;
+		make_test_image(kind, width, height, image.seed, &test);
+		make_bits_file(test, &image.bits);
+		test.pixels.clear();
+		image.header = test;
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "%s-%ux%u", image.group.c_str(),
+		(unsigned)width, (unsigned)height);
+	image.name = name;
+	context.corpus.push_back(image);
+}
+
+
+static void
+make_synthetic_corpus(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	for (uint32 kind = 0; kind < kNumImageKinds; kind++) {
+		if (!class_selected(options, image_kind_name((image_kind)kind)))
+			continue;
+		if (kind == IMAGE_ICON) {
+			for (uint32 size : sIconSizes)
+				add_synthetic_image(context, IMAGE_ICON, size, size, false);
+		} else if (kind == IMAGE_SCAN) {
+			// never held, so they can be as large as a gigapixel
+			add_synthetic_image(context, IMAGE_SCAN, options.scanWidth,
+				options.scanHeight, true);
+		} else {
+			add_synthetic_image(context, (image_kind)kind, options.width,
+				options.height, false);
+		}
+	}
+}
+
+
+// Adds the .bits files in directory and below it, those in a subdirectory
+// of the corpus belonging to the class it is named after
+static void
+read_corpus_directory(BenchContext& context, const std::string& directory,
+	const std::string& group)
+{
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL) {
+		fprintf(stderr, "Could not open %s\n", directory.c_str());
+		return;
+	}
+	std::vector<std::string> names;
+	while (dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] != '.')
+			names.push_back(entry->d_name);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+
+	for (const std::string& name : names) {
+		const std::string path = directory + "/" + name;
+		struct stat stat;
+		if (::stat(path.c_str(), &stat) != 0)
+			continue;
+		if (S_ISDIR(stat.st_mode)) {
+			read_corpus_directory(context, path,
+				group.empty() ? name : group);
+			continue;
+		}
+		const std::string fileGroup = group.empty() ? "corpus" : group;
+		if (name.size() < 5 || name.compare(name.size() - 5, 5, ".bits") != 0
+			|| !class_selected(*context.options, fileGroup))
+			continue;
+
+		CorpusImage image;
+		image.name = path.substr(strlen(context.options->corpus) + 1);
+		image.group = fileGroup;
+		image.kind = IMAGE_PHOTO;
+		image.seed = 0;
+		uint8 header[32];
+		FILE* file = fopen(path.c_str(), "rb");
+		status_t status = B_IO_ERROR;
+		if (file != NULL && fread(header, sizeof(header), 1, file) == 1)
+			status = parse_bits_header(header, &image.header);
+		if (status == B_OK && stat.st_size <= kMaxHeldFileSize) {
+			image.bits.resize(stat.st_size);
+			rewind(file);
+			if (fread(image.bits.data(), stat.st_size, 1, file) != 1)
+				status = B_IO_ERROR;
+		} else
+			image.path = path;
+		if (file != NULL)
+			fclose(file);
+		if (status != B_OK) {
+			fprintf(stderr, "Skipping %s: error %d\n", path.c_str(),
+				(int)status);
+			continue;
+		}
+		context.corpus.push_back(image);
+	}
+}
+
+
+// #pragma mark - Running
+
+
+// Times one run, adding what it measured to aggregate
+static status_t
+time_run(MetricsAggregate* aggregate, const BenchRun& run)
+{
+	TranslationMetrics metrics;
+	const bigtime_t start = system_time();
+	const status_t status = run(&metrics);
+	if (status != B_OK)
+		return status;
+	metrics.totalTime = system_time() - start;
+	aggregate->Add(metrics);
+	return B_OK;
+}
+
+
+// Times run() as many times as asked for, stopping at the first error. With
+// peakMemory, the most memory any run took is kept in it.
+static status_t
+time_runs(BenchContext& context, MetricsAggregate* aggregate,
+	const BenchRun& run, uint64* peakMemory = NULL)
+{
+	PeakMemoryMeter meter;
+	for (uint32 i = 0; i < context.options->runs; i++) {
+		if (peakMemory != NULL)
+			meter.Start();
+		const status_t status = time_run(aggregate, run);
+		if (peakMemory != NULL)
+			*peakMemory = std::max(*peakMemory, meter.Stop());
+		if (status != B_OK)
+			return status;
+	}
+	return B_OK;
+}
+
+
+// Reports the latency of the runs, and the throughput, output size and
+// memory of those that have them. Runs that count the bytes they read
+// rather than pixels are reported in megabytes per second.
+static void
+report_summary(BenchContext& context, const std::string& name,
+	const MetricsAggregate& aggregate, uint64 measuredMemory = 0)
+{
+	MetricsSummary summary;
+	aggregate.GetSummary(&summary);
+	if (summary.count == 0)
+		return;
+	BenchResults& results = *context.results;
+	if (summary.pixels > 0)
+		results.Add(name, "megapixelsPerSecond", summary.MegapixelsPerSecond());
+	if (summary.bytesIn > 0 && summary.totalTime > 0) {
+		// bytes per microsecond are megabytes per second
+		results.Add(name, "megabytesPerSecond",
+			(double)summary.bytesIn / summary.totalTime);
+	}
+	results.Add(name, "latencyP50", summary.latencyP50);
+	results.Add(name, "latencyP90", summary.latencyP90);
+	results.Add(name, "latencyP99", summary.latencyP99);
+	if (summary.compressedBytes > 0 && summary.pixels > 0)
+		results.Add(name, "bitsPerPixel", summary.BitsPerPixel());
+	if (measuredMemory > 0)
+		results.Add(name, "peakMemory", measuredMemory);
+	if (summary.peakMemory > 0)
+		results.Add(name, "estimatedPeakMemory", summary.peakMemory);
+}
+
+
+// #pragma mark - Translating
+
+
+#ifdef __HAIKU__
+
+// Lets the translator read a corpus input
+class CorpusIO : public BPositionIO {
+public:
+	CorpusIO(const CorpusInput& input)
+		:
+		fInput(input),
+		fPosition(0)
+	{
+	}
+
+	virtual ssize_t ReadAt(off_t position, void* buffer, size_t size)
+	{
+		return fInput.Input()->ReadAt(position, buffer, size);
+	}
+
+	virtual ssize_t WriteAt(off_t position, const void* buffer, size_t size)
+	{
+		return B_NOT_ALLOWED;
+	}
+
+	virtual off_t Seek(off_t position, uint32 seekMode)
+	{
+		if (seekMode == SEEK_CUR)
+			position += fPosition;
+		else if (seekMode == SEEK_END)
+			position += fInput.Size();
+		if (position < 0)
+			return B_BAD_VALUE;
+		fPosition = position;
+		return fPosition;
+	}
+
+	virtual off_t Position() const
+	{
+		return fPosition;
+	}
+
+	virtual status_t GetSize(off_t* size) const
+	{
+		*size = fInput.Size();
+		return B_OK;
+	}
+
+private:
+	const CorpusInput&	fInput;
+	off_t				fPosition;
+};
+
+
+// The decoded bitmaps go nowhere
+class NullIO : public BPositionIO {
+public:
+	NullIO()
+		:
+		fPosition(0),
+		fSize(0)
+	{
+	}
+
+	virtual ssize_t ReadAt(off_t position, void* buffer, size_t size)
+	{
+		return B_NOT_ALLOWED;
+	}
+
+	virtual ssize_t WriteAt(off_t position, const void* buffer, size_t size)
+	{
+		fSize = std::max(fSize, position + (off_t)size);
+		return size;
+	}
+
+	virtual off_t Seek(off_t position, uint32 seekMode)
+	{
+		if (seekMode == SEEK_CUR)
+			position += fPosition;
+		else if (seekMode == SEEK_END)
+			position += fSize;
+		fPosition = position;
+		return fPosition;
+	}
+
+	virtual off_t Position() const
+	{
+		return fPosition;
+	}
+
+	virtual status_t SetSize(off_t size)
+	{
+		fSize = size;
+		return B_OK;
+	}
+
+private:
+	off_t				fPosition;
+	off_t				fSize;
+};
+
+
+// The settings of a point of the grid, for this translation alone, with
+// the caches and budgets off so every run does all the work
+static void
+add_grid_settings(const GridPoint& point, BMessage* ioExtension)
+{
+	ioExtension->AddInt32(JXL_SETTING_DISTANCE, point.distance);
+	ioExtension->AddInt32(JXL_SETTING_EFFORT, point.effort);
+	ioExtension->AddInt32(JXL_SETTING_DECODING_SPEED, point.decodingSpeed);
+	ioExtension->AddBool(JXL_SETTING_PROGRESSIVE, point.progressive);
+	ioExtension->AddInt32(JXL_EXT_MAX_THREADS, point.threads);
+	ioExtension->AddInt32(JXL_SETTING_TIME_BUDGET, 0);
+	ioExtension->AddInt32(JXL_SETTING_SIZE_BUDGET, 0);
+	ioExtension->AddInt32(JXL_SETTING_ENCODE_CACHE_SIZE, 0);
+	ioExtension->AddBool(JXL_EXT_INVALIDATE_CACHE, true);
+	ioExtension->AddBool(JXL_EXT_METRICS, true);
+}
+
+
+// Identifies and translates in, with the translator's estimate of the
+// memory it took in metrics
+static status_t
+translate(BTranslator* translator, BPositionIO* in, BMessage* ioExtension,
+	uint32 outType, BPositionIO* out, TranslationMetrics* metrics)
+{
+	translator_info info;
+	status_t status = translator->Identify(in, NULL, ioExtension, &info,
+		outType);
+	if (status != B_OK)
+		return status;
+	in->Seek(0, SEEK_SET);
+	status = translator->Translate(in, &info, ioExtension, outType, out);
+	int64 peakMemory;
+	if (ioExtension->FindInt64(JXL_METRICS_PEAK_MEMORY, &peakMemory) == B_OK)
+		metrics->peakMemory = peakMemory;
+	return status;
+}
+
+#else
+
+static status_t
+write_no_header(CodecOutput* out, uint32 xsize, uint32 ysize)
+{
+	uint8 header[32] = {};
+	return out->WriteExactly(header, sizeof(header));
+}
+
+
+// What Compress() does with the caches and budgets off
+static status_t
+encode_core(BenchContext& context, const CorpusImage& image,
+	const CorpusInput& input, const GridPoint& point, CodecMonitor* monitor,
+	MemoryOutput* out, TranslationMetrics* metrics)
+{
+	const TestImage& header = image.header;
+	PixelLayout layout;
+	bool expand = false;
+	if (!get_pixel_layout(header.space, &layout)) {
+		switch (header.space) {
+			case B_RGBA15:
+			case B_RGBA15_BIG:
+				expand = true;
+				layout = { 4, 0, 1, 2, 3 };
+				break;
+			case B_RGB16:
+			case B_RGB16_BIG:
+			case B_RGB15:
+			case B_RGB15_BIG:
+				expand = true;
+				layout = { 3, 0, 1, 2, -1 };
+				break;
+			default:
+				return B_NO_TRANSLATOR;
+		}
+	}
+
+	EncodeParameters params = {};
+	params.distance = point.distance;
+	params.effort = point.effort;
+	params.decodingSpeed = point.decodingSpeed;
+	params.progressive = point.progressive;
+	params.monitor = monitor;
+
+	const uint64 pixels = (uint64)header.width * header.height;
+	const uint64 inSize = (uint64)header.rowBytes * header.height;
+	const uint64 bufferedMemory = BufferedEncodeMemory(pixels, inSize,
+		expand ? layout.bytesPerPixel : 0);
+	if (bufferedMemory > context.options->memoryBudget) {
+		metrics->peakMemory = StreamingEncodeMemory(header.width);
+		PixelLayout sourceLayout;
+		ChunkedSource source;
+		source.in = input.Input();
+		source.dataOffset = 32;
+		source.rowBytes = header.rowBytes;
+		source.space = header.space;
+		source.layout = layout;
+		source.sourceBytesPerPixel = get_pixel_layout(header.space,
+			&sourceLayout) ? layout.bytesPerPixel : 2;
+		source.status = B_OK;
+		source.monitor = monitor;
+
+		ImageAnalyzer analyzer(layout, header.width);
+		for (uint32 y = 0; y < header.height && !analyzer.IsDone();
+				y += kRowBatchSize) {
+			const uint32 count = std::min(kRowBatchSize, header.height - y);
+			uint8* rows = ReadBitmapRect(&source, 0, y, header.width, count);
+			if (rows == NULL)
+				return source.status;
+			analyzer.AddRows(rows, (size_t)header.width * layout.bytesPerPixel,
+				count);
+			free(rows);
+		}
+		const uint32 channels = analyzer.OutputChannels();
+		source.colorChannels = channels >= 3 ? 3 : 1;
+		if (params.distance == 0 && analyzer.Result().numColors > 0)
+			params.paletteColors = analyzer.Result().numColors;
+		return EncodeChunked(context.jxl, &source, header.width,
+			header.height, channels, params, out);
+	}
+
+	metrics->peakMemory = bufferedMemory;
+	std::vector<uint8> data(inSize);
+	status_t status = input.Input()->ReadAtExactly(32, data.data(), inSize);
+	if (status != B_OK)
+		return status;
+	size_t rowBytes = header.rowBytes;
+	if (expand) {
+		std::vector<uint8> expanded(pixels * layout.bytesPerPixel);
+		expand_rgb16_rows(data.data(), rowBytes, header.space, header.width,
+			header.height, expanded.data());
+		data.swap(expanded);
+		rowBytes = (size_t)header.width * layout.bytesPerPixel;
+	}
+	ImageAnalyzer analyzer(layout, header.width);
+	analyzer.AddRows(data.data(), rowBytes, header.height);
+	const uint32 channels = analyzer.OutputChannels();
+	if (params.distance == 0 && analyzer.Result().numColors > 0)
+		params.paletteColors = analyzer.Result().numColors;
+	pack_pixels(data.data(), rowBytes, layout, header.width, header.height,
+		channels, data.data());
+	return EncodePixels(context.jxl, data.data(), header.width,
+		header.height, channels, params, out);
+}
+
+
+// What Decompress() does with the caches off
+static status_t
+decode_core(BenchContext& context, const CorpusImage& image,
+	const std::vector<uint8>& file, CodecMonitor* monitor,
+	TranslationMetrics* metrics)
+{
+	DecodeParameters params = {};
+	NullOutput out;
+	const uint64 pixels = (uint64)image.header.width * image.header.height;
+	const uint64 bufferedMemory = BufferedDecodeMemory(pixels, file.size());
+	if (bufferedMemory > context.options->memoryBudget) {
+		metrics->peakMemory = StreamingDecodeMemory(pixels,
+			image.header.width, 0);
+		MemoryInput in(file.data(), file.size());
+		return DecodeStreaming(context.jxl, &in, params, monitor,
+			write_no_header, &out);
+	}
+
+	metrics->peakMemory = bufferedMemory;
+	size_t stride;
+	size_t xsize;
+	size_t ysize;
+	int hasAlpha;
+	int previewSource;
+	uint8* decoded = NULL;
+	status_t status = JxlMemoryToPixels(file.data(), file.size(), false,
+		params, monitor, &stride, &xsize, &ysize, &hasAlpha, &previewSource,
+		decoded);
+	if (status != B_OK)
+		return status;
+	status = write_no_header(&out, xsize, ysize);
+	if (status == B_OK)
+		status = WriteOrientedPixels(decoded, xsize, ysize, 1, NULL, &out);
+	free(decoded);
+	return status;
+}
+
+#endif // __HAIKU__
+
+
+static status_t
+encode_image(BenchContext& context, const CorpusImage& image,
+	const GridPoint& point, std::vector<uint8>* file,
+	TranslationMetrics* metrics, bool encodeCache = false)
+{
+	CorpusInput input(image);
+#ifdef __HAIKU__
+	CorpusIO in(input);
+	BMallocIO out;
+	BMessage ioExtension;
+	add_grid_settings(point, &ioExtension);
+	if (encodeCache)
+		ioExtension.RemoveName(JXL_SETTING_ENCODE_CACHE_SIZE);
+	status_t status = translate(context.translator, &in, &ioExtension,
+		JXL_FORMAT, &out, metrics);
+	if (status == B_OK) {
+		const uint8* buffer = (const uint8*)out.Buffer();
+		file->assign(buffer, buffer + out.BufferLength());
+	}
+#else
+	std::unique_ptr<CodecThreadPool> pool(point.threads > 1
+		? new CodecThreadPool(point.threads - 1) : NULL);
+	CodecMonitor monitor;
+	monitor.SetThreadPool(pool.get());
+	MemoryOutput out;
+	status_t status = encode_core(context, image, input, point, &monitor,
+		&out, metrics);
+	if (status == B_OK)
+		file->assign(out.Buffer(), out.Buffer() + out.BufferLength());
+#endif
+	metrics->pixels = (uint64)image.header.width * image.header.height;
+	metrics->compressedBytes = file->size();
+	return status;
+}
+
+
+static status_t
+decode_image(BenchContext& context, const CorpusImage& image,
+	const GridPoint& point, const std::vector<uint8>& file,
+	TranslationMetrics* metrics)
+{
+#ifdef __HAIKU__
+	BMemoryIO in(file.data(), file.size());
+	NullIO out;
+	BMessage ioExtension;
+	add_grid_settings(point, &ioExtension);
+	status_t status = translate(context.translator, &in, &ioExtension,
+		B_TRANSLATOR_BITMAP, &out, metrics);
+#else
+	std::unique_ptr<CodecThreadPool> pool(point.threads > 1
+		? new CodecThreadPool(point.threads - 1) : NULL);
+	CodecMonitor monitor;
+	monitor.SetThreadPool(pool.get());
+	status_t status = decode_core(context, image, file, &monitor, metrics);
+#endif
+	metrics->pixels = (uint64)image.header.width * image.header.height;
+	metrics->compressedBytes = file.size();
+	return status;
+}
+
+
+// #pragma mark - Benchmarks
+
+
+#ifdef __HAIKU__
+
+static bool
+libjxl_loaded()
+{
+	int32 cookie = 0;
+	image_info info;
+	while (get_next_image_info(B_CURRENT_TEAM, &cookie, &info) == B_OK) {
+		const char* name = strrchr(info.name, '/');
+		if (strncmp(name != NULL ? name + 1 : info.name, "libjxl.", 7) == 0)
+			return true;
+	}
+	return false;
+}
+
+#endif
+
+
+// What every application using the Translation Kit pays for the add-on:
+// loading it, making the translator and identifying a file. libjxl should
+// only be loaded by the first real translation, so this runs before any
+// other benchmark. Elsewhere it times what that first translation adds,
+// opening libjxl.
+static void
+bench_startup(BenchContext& context)
+{
+	MetricsAggregate aggregate;
+#ifdef __HAIKU__
+	static const uint8 kCodestream[] = { 0xff, 0x0a, 0, 0, 0, 0, 0, 0 };
+	bool loaded = false;
+	const status_t status = time_runs(context, &aggregate,
+		[&](TranslationMetrics* metrics) {
+			image_id addOn;
+			BTranslator* translator;
+			status_t status = load_translator(context.options->addOn,
+				&addOn, &translator);
+			if (status != B_OK)
+				return status;
+			BMemoryIO in(kCodestream, sizeof(kCodestream));
+			translator_info info;
+			status = translator->Identify(&in, NULL, NULL, &info,
+				B_TRANSLATOR_BITMAP);
+			loaded |= libjxl_loaded();
+			unload_translator(addOn, translator);
+			return status;
+		});
+	if (status != B_OK) {
+		fprintf(stderr, "startup: error %d\n", (int)status);
+		return;
+	}
+	const char* name = "startup/addOn";
+#else
+	// the library is only opened once, so this can only be timed once
+	bool loaded = false;
+	time_run(&aggregate, [&](TranslationMetrics* metrics) {
+		loaded = jxl_library() != NULL;
+		return B_OK;
+	});
+	const char* name = "startup/libjxl";
+#endif
+	report_summary(context, name, aggregate);
+	context.results->Add(name, "libjxlLoaded", loaded ? 1 : 0);
+}
+
+
+// Encodes and decodes every image of the corpus at each point, summing up
+// the runs of each class
+static void
+run_grid(BenchContext& context, const std::string& prefix,
+	const std::vector<GridPoint>& points, bool (*filter)(const CorpusImage&))
+{
+	std::map<std::string, GridResult> grid;
+	for (const CorpusImage& image : context.corpus) {
+		if (filter != NULL && !filter(image))
+			continue;
+		for (const GridPoint& point : points) {
+			char key[128];
+			snprintf(key, sizeof(key), "%s/d%d/e%d/s%d/t%d",
+				image.group.c_str(), (int)point.distance, (int)point.effort,
+				(int)point.decodingSpeed, (int)point.threads);
+			fprintf(stderr, "%s %s\n", image.name.c_str(),
+				strchr(key, '/') + 1);
+			GridResult& result = grid[key];
+
+			std::vector<uint8> file;
+			status_t status = time_runs(context, &result.encodes,
+				[&](TranslationMetrics* metrics) {
+					return encode_image(context, image, point, &file,
+						metrics);
+				}, &result.encodeMemory);
+			if (status == B_OK) {
+				status = time_runs(context, &result.decodes,
+					[&](TranslationMetrics* metrics) {
+						return decode_image(context, image, point, file,
+							metrics);
+					}, &result.decodeMemory);
+			}
+			if (status != B_OK) {
+				fprintf(stderr, "%s: error %d\n", image.name.c_str(),
+					(int)status);
+			}
+		}
+	}
+
+	for (const auto& entry : grid) {
+		report_summary(context, prefix + "encode/" + entry.first,
+			entry.second.encodes, entry.second.encodeMemory);
+		report_summary(context, prefix + "decode/" + entry.first,
+			entry.second.decodes, entry.second.decodeMemory);
+	}
+}
+
+
+// Every combination of the distances, efforts, decoding speeds and threads
+// given
+static void
+bench_translate(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	std::vector<GridPoint> points;
+	for (int32 threads : options.threads) {
+		for (int32 distance : options.distances) {
+			for (int32 effort : options.efforts) {
+				for (int32 decodingSpeed : options.decodingSpeeds) {
+					points.push_back({ distance, effort, decodingSpeed,
+						threads, false });
+				}
+			}
+		}
+	}
+	run_grid(context, "", points, NULL);
+}
+
+
+static bool
+not_a_scan(const CorpusImage& image)
+{
+	return image.group != image_kind_name(IMAGE_SCAN);
+}
+
+
+// Every effort against every decoding speed, at each distance given and
+// the most threads, for what each tier costs to encode and saves to
+// decode. The scans are left out, their slowest tiers would take hours.
+static void
+bench_speed(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	const int32 threads = *std::max_element(options.threads.begin(),
+		options.threads.end());
+	std::vector<GridPoint> points;
+	for (int32 distance : options.distances) {
+		for (int32 effort = kMinEffort; effort <= kMaxEffort; effort++) {
+			for (int32 decodingSpeed = 0; decodingSpeed <= kMaxDecodingSpeed;
+					decodingSpeed++) {
+				points.push_back({ distance, effort, decodingSpeed,
+					threads, false });
+			}
+		}
+	}
+	run_grid(context, "speed/", points, not_a_scan);
+}
+
+
+// How far into the files of each class their 1:8 image can be decoded,
+// with and without the progressive option, at each distance given
+static void
+bench_first_paint(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	const int32 threads = *std::max_element(options.threads.begin(),
+		options.threads.end());
+	for (int32 distance : options.distances) {
+		for (int progressive = 0; progressive < 2; progressive++) {
+			const GridPoint point = { distance, options.efforts.front(), 0,
+				threads, progressive != 0 };
+			// offsets and sizes of each class
+			std::map<std::string, std::pair<uint64, uint64> > totals;
+			for (const CorpusImage& image : context.corpus) {
+				// the prefixes are decoded whole
+				if (!not_a_scan(image))
+					continue;
+				std::vector<uint8> file;
+				TranslationMetrics metrics;
+				status_t status = encode_image(context, image, point, &file,
+					&metrics);
+				if (status != B_OK) {
+					fprintf(stderr, "%s: error %d\n", image.name.c_str(),
+						(int)status);
+					continue;
+				}
+				std::pair<uint64, uint64>& total = totals[image.group];
+				total.first += first_paint_offset(context.jxl, file.data(),
+					file.size());
+				total.second += file.size();
+			}
+			for (const auto& entry : totals) {
+				char name[128];
+				snprintf(name, sizeof(name), "firstPaint/%s/d%d/p%d",
+					entry.first.c_str(), (int)distance, progressive);
+				context.results->Add(name, "firstPaintBytes",
+					entry.second.first);
+				context.results->Add(name, "firstPaintFraction",
+					(double)entry.second.first / entry.second.second);
+			}
+		}
+	}
+}
+
+
+// Nits of the HDR test image's brightest pixels, and of reference white as
+// the tone curves take it
+const double kHdrPeak = 1000;
+const double kHdrWhite = 203;
+
+
+// The constants of the PQ transfer function
+const double kPqM1 = 0.1593017578125;
+const double kPqM2 = 78.84375;
+const double kPqC1 = 0.8359375;
+const double kPqC2 = 18.8515625;
+const double kPqC3 = 18.6875;
+
+
+static double
+pq_encode(double nits)
+{
+	const double y = pow(nits / 10000, kPqM1);
+	return pow((kPqC1 + kPqC2 * y) / (1 + kPqC3 * y), kPqM2);
+}
+
+
+static double
+pq_decode(double value)
+{
+	const double p = pow(value, 1 / kPqM2);
+	return pow(std::max(p - kPqC1, 0.0) / (kPqC2 - kPqC3 * p), 1 / kPqM1)
+		* 10000;
+}
+
+
+static double
+srgb_encode(double linear)
+{
+	if (linear <= 0.0031308)
+		return linear * 12.92;
+	return 1.055 * pow(linear, 1 / 2.4) - 0.055;
+}
+
+
+// The curves of ToneMapper, in double precision and without dithering.
+// libjxl's own conversion is held to clipping.
+static double
+reference_curve(tone_curve curve, double value)
+{
+	const double peak = kHdrPeak / kHdrWhite;
+	if (curve == TONE_CURVE_REINHARD) {
+		value = value * (1 + value / (peak * peak)) / (1 + value);
+	} else if (curve == TONE_CURVE_ACES) {
+		value *= 0.6;
+		value = value * (2.51 * value + 0.03)
+			/ (value * (2.43 * value + 0.59) + 0.14);
+	}
+	return std::min(value, 1.0);
+}
+
+
+// A photo brightening from left to right up to kHdrPeak, stored losslessly
+// as 16 bit PQ. linear gets its color channels in units of reference white.
+static status_t
+make_hdr_file(const JxlLibrary* jxl, uint32 width, uint32 height,
+	std::vector<double>* linear, std::vector<uint8>* file)
+{
+	TestImage image;
+	make_test_image(IMAGE_PHOTO, width, height, 1, &image);
+	linear->resize((size_t)width * height * 3);
+	std::vector<uint16> pixels(linear->size());
+	for (uint32 y = 0; y < height; y++) {
+		for (uint32 x = 0; x < width; x++) {
+			const uint8* in = &image.pixels[y * image.rowBytes + x * 4];
+			const double brightness = (x + 1.0) / width * kHdrPeak
+				/ kHdrWhite;
+			for (uint32 c = 0; c < 3; c++) {
+				// B_RGB32 is stored blue first
+				const double srgb = in[2 - c] / 255.0;
+				const double value = (srgb <= 0.04045 ? srgb / 12.92
+					: pow((srgb + 0.055) / 1.055, 2.4)) * brightness;
+				const size_t index = ((size_t)y * width + x) * 3 + c;
+				pixels[index] = (uint16)lround(pq_encode(value * kHdrWhite)
+					* 65535);
+				// what the file holds, after rounding to 16 bits
+				(*linear)[index] = pq_decode(pixels[index] / 65535.0)
+					/ kHdrWhite;
+			}
+		}
+	}
+
+	JxlColorEncoding encoding;
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.color_space = JXL_COLOR_SPACE_RGB;
+	encoding.white_point = JXL_WHITE_POINT_D65;
+	encoding.primaries = JXL_PRIMARIES_SRGB;
+	encoding.transfer_function = JXL_TRANSFER_FUNCTION_PQ;
+	encoding.rendering_intent = JXL_RENDERING_INTENT_RELATIVE;
+	return encode_rgb16(jxl, width, height, encoding, kHdrPeak, pixels,
+		file);
+}
+
+
+// Decodes an HDR image with each tone curve, and with libjxl's own
+// conversion to 8 bits, which leaves the values in the file's transfer
+// function. The quality is the PSNR against the curve applied to the
+// source exactly.
+static void
+bench_tone_curves(BenchContext& context)
+{
+	static const char* const kCurveNames[] = { "libjxl", "clip", "reinhard",
+		"aces" };
+	const BenchOptions& options = *context.options;
+	const uint32 width = options.width;
+	const uint32 height = options.height;
+	std::vector<double> linear;
+	std::vector<uint8> file;
+	status_t status = make_hdr_file(context.jxl, width, height, &linear,
+		&file);
+	if (status != B_OK) {
+		fprintf(stderr, "Could not make an HDR image: error %d\n",
+			(int)status);
+		return;
+	}
+
+	CodecMonitor monitor;
+	for (int32 curve = 0; curve < kNumToneCurves; curve++) {
+		DecodeParameters params = {};
+		params.toneCurve = (tone_curve)curve;
+		MetricsAggregate aggregate;
+		// the pixels of the first run, to be compared after the runs
+		uint8* kept = NULL;
+		status = time_runs(context, &aggregate,
+			[&](TranslationMetrics* metrics) {
+				size_t stride;
+				size_t xsize;
+				size_t ysize;
+				int hasAlpha;
+				int previewSource;
+				uint8* decoded = NULL;
+				status_t status = JxlMemoryToPixels(file.data(), file.size(),
+					false, params, &monitor, &stride, &xsize, &ysize,
+					&hasAlpha, &previewSource, decoded);
+				metrics->pixels = (uint64)width * height;
+				if (kept == NULL)
+					kept = decoded;
+				else
+					free(decoded);
+				return status;
+			});
+		if (status != B_OK) {
+			free(kept);
+			fprintf(stderr, "Decoding with tone curve %d failed: error %d\n",
+				(int)curve, (int)status);
+			return;
+		}
+
+		double squaredError = 0;
+		for (size_t i = 0; i < linear.size(); i++) {
+			const uint8 value = kept[i / 3 * 4 + i % 3];
+			const double expected = srgb_encode(reference_curve(
+				(tone_curve)curve, linear[i])) * 255;
+			squaredError += (value - expected) * (value - expected);
+		}
+		free(kept);
+
+		const std::string name = std::string("toneCurve/")
+			+ kCurveNames[curve];
+		report_summary(context, name, aggregate);
+		const double meanError = squaredError / linear.size();
+		context.results->Add(name, "psnr", meanError > 0
+			? 10 * log10(255 * 255 / meanError) : 99);
+	}
+}
+
+
+// The ICC profile of RGB with primaries and the sRGB transfer function
+static bool
+make_profile(const JxlLibrary* jxl, JxlPrimaries primaries,
+	std::vector<uint8>* profile)
+{
+	JxlColorEncoding encoding;
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.color_space = JXL_COLOR_SPACE_RGB;
+	encoding.white_point = JXL_WHITE_POINT_D65;
+	encoding.primaries = primaries;
+	encoding.transfer_function = JXL_TRANSFER_FUNCTION_SRGB;
+	encoding.rendering_intent = JXL_RENDERING_INTENT_RELATIVE;
+	const std::vector<uint16> pixel(3, 0x8000);
+	std::vector<uint8> file;
+	return encode_rgb16(jxl, 1, 1, encoding, 255, pixel, &file) == B_OK
+		&& get_icc_profile(jxl, file.data(), file.size(), profile);
+}
+
+
+// What converting decodes from wide gamut profiles to sRGB costs: making
+// the table, finding it again in the cache, and applying it to a photo of
+// the synthetic size
+static void
+bench_color_transforms(BenchContext& context)
+{
+	static const struct {
+		const char*		name;
+		JxlPrimaries	primaries;
+	} kSources[] = {
+		{ "p3", JXL_PRIMARIES_P3 },
+		{ "rec2020", JXL_PRIMARIES_2100 }
+	};
+	const BenchOptions& options = *context.options;
+	std::vector<uint8> target;
+	if (!make_profile(context.jxl, JXL_PRIMARIES_SRGB, &target)) {
+		fprintf(stderr, "Could not make an sRGB profile\n");
+		return;
+	}
+	TestImage image;
+	make_test_image(IMAGE_ALPHA, options.width, options.height, 1, &image);
+	const uint64 pixels = (uint64)image.width * image.height;
+
+	for (const auto& source : kSources) {
+		std::vector<uint8> profile;
+		if (!make_profile(context.jxl, source.primaries, &profile)) {
+			fprintf(stderr, "Could not make a %s profile\n", source.name);
+			continue;
+		}
+		const std::string name = std::string("colorTransform/")
+			+ source.name;
+
+		MetricsAggregate creates;
+		std::unique_ptr<ColorTransform> transform;
+		const status_t status = time_runs(context, &creates,
+			[&](TranslationMetrics* metrics) {
+				transform.reset(ColorTransform::Create(context.jxl,
+					profile.data(), profile.size(), target.data(),
+					target.size()));
+				return transform != NULL ? B_OK : B_NO_TRANSLATOR;
+			});
+		if (status != B_OK) {
+			fprintf(stderr, "Could not convert from %s\n", source.name);
+			continue;
+		}
+
+		// the first lookup makes the table, the others find it
+		ColorTransformCache cache;
+		cache.Get(context.jxl, profile, target.data(), target.size());
+		MetricsAggregate lookups;
+		time_runs(context, &lookups,
+			[&](TranslationMetrics* metrics) {
+				cache.Get(context.jxl, profile, target.data(), target.size());
+				return B_OK;
+			});
+
+		std::vector<uint8> converted(image.pixels);
+		MetricsAggregate applies;
+		time_runs(context, &applies,
+			[&](TranslationMetrics* metrics) {
+				transform->Apply(converted.data(), pixels, true);
+				metrics->pixels = pixels;
+				return B_OK;
+			});
+
+		report_summary(context, name + "/create", creates);
+		report_summary(context, name + "/cached", lookups);
+		report_summary(context, name + "/apply", applies);
+	}
+}
+
+
+#ifdef __HAIKU__
+
+struct ThumbnailResult {
+	ThumbnailResult()
+		:
+		hits(0),
+		misses(0)
+	{
+	}
+
+			MetricsAggregate cold;
+			MetricsAggregate warm;
+			int64			hits;
+			int64			misses;
+};
+
+
+static int64
+translator_statistic(BTranslator* translator, const char* name)
+{
+	BMessage settings;
+	int64 value = 0;
+	if (translator->GetConfigurationMessage(&settings) == B_OK)
+		settings.FindInt64(name, &value);
+	return value;
+}
+
+
+static status_t
+decode_thumbnail(BenchContext& context, const std::vector<uint8>& file,
+	bool cold, TranslationMetrics* metrics)
+{
+	BMemoryIO in(file.data(), file.size());
+	NullIO out;
+	BMessage ioExtension;
+	ioExtension.AddBool(JXL_EXT_PREVIEW, true);
+	ioExtension.AddBool(JXL_EXT_INVALIDATE_CACHE, cold);
+	ioExtension.AddInt32(JXL_SETTING_MEMORY_CACHE_SIZE, 0);
+	ioExtension.AddBool(JXL_EXT_METRICS, true);
+	return translate(context.translator, &in, &ioExtension,
+		B_TRANSLATOR_BITMAP, &out, metrics);
+}
+
+
+// Thumbnails of the images of each class, decoded without the caches and
+// then served by the disk cache alone, as they would be to another
+// application
+static void
+bench_thumbnails(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	const int32 threads = *std::max_element(options.threads.begin(),
+		options.threads.end());
+	const GridPoint point = { options.distances.front(),
+		options.efforts.front(), 0, threads, false };
+	std::map<std::string, ThumbnailResult> results;
+	for (const CorpusImage& image : context.corpus) {
+		if (!not_a_scan(image))
+			continue;
+		std::vector<uint8> file;
+		TranslationMetrics encodeMetrics;
+		status_t status = encode_image(context, image, point, &file,
+			&encodeMetrics);
+		ThumbnailResult& result = results[image.group];
+		// the cold runs skip the caches and fill them
+		if (status == B_OK) {
+			status = time_runs(context, &result.cold,
+				[&](TranslationMetrics* metrics) {
+					return decode_thumbnail(context, file, true, metrics);
+				});
+		}
+		const int64 hits = translator_statistic(context.translator,
+			JXL_STATS_CACHE_HITS);
+		const int64 misses = translator_statistic(context.translator,
+			JXL_STATS_CACHE_MISSES);
+		if (status == B_OK) {
+			status = time_runs(context, &result.warm,
+				[&](TranslationMetrics* metrics) {
+					return decode_thumbnail(context, file, false, metrics);
+				});
+		}
+		if (status != B_OK) {
+			fprintf(stderr, "%s: error %d\n", image.name.c_str(),
+				(int)status);
+		}
+		result.hits += translator_statistic(context.translator,
+			JXL_STATS_CACHE_HITS) - hits;
+		result.misses += translator_statistic(context.translator,
+			JXL_STATS_CACHE_MISSES) - misses;
+	}
+
+	for (const auto& entry : results) {
+		const ThumbnailResult& result = entry.second;
+		report_summary(context, "thumbnail/" + entry.first + "/cold",
+			result.cold);
+		const std::string name = "thumbnail/" + entry.first + "/warm";
+		report_summary(context, name, result.warm);
+		const int64 lookups = result.hits + result.misses;
+		context.results->Add(name, "hitRate",
+			lookups > 0 ? (double)result.hits / lookups : 0);
+	}
+}
+
+
+// Saves the same bitmaps over and over, as a pipeline re-saving unchanged
+// edits and duplicate uploads does, with the encode cache off and then on.
+// It is only run when the cache is on in the translator's settings. The
+// first pixel of every image is set to a value of this run, so the entries
+// earlier runs left in the cache aren't hit.
+static void
+bench_duplicates(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	const int32 threads = *std::max_element(options.threads.begin(),
+		options.threads.end());
+	const GridPoint point = { options.distances.front(),
+		options.efforts.front(), 0, threads, false };
+	const uint32 stamp = system_time();
+	std::vector<CorpusImage> images;
+	for (const CorpusImage& image : context.corpus) {
+		// too big to be worth caching
+		if (image.bits.empty())
+			continue;
+		images.push_back(image);
+		memcpy(images.back().bits.data() + 32, &stamp,
+			std::min(sizeof(stamp), image.header.rowBytes));
+	}
+
+	// the cache is shared, so only the saved settings can turn it on
+	BMessage settings;
+	int32 cacheSize = 0;
+	if (context.translator->GetConfigurationMessage(&settings) != B_OK
+		|| settings.FindInt32(JXL_SETTING_ENCODE_CACHE_SIZE, &cacheSize)
+			!= B_OK
+		|| cacheSize <= 0) {
+		printf("%-40s skipped, the encode cache is off in the settings\n",
+			"duplicates");
+		return;
+	}
+
+	for (int cached = 0; cached < 2; cached++) {
+		MetricsAggregate aggregate;
+		const int64 hits = translator_statistic(context.translator,
+			JXL_STATS_ENCODE_CACHE_HITS);
+		const int64 misses = translator_statistic(context.translator,
+			JXL_STATS_ENCODE_CACHE_MISSES);
+		for (uint32 save = 0; save < kDuplicateSaves; save++) {
+			for (const CorpusImage& image : images) {
+				const status_t status = time_run(&aggregate,
+					[&](TranslationMetrics* metrics) {
+						std::vector<uint8> file;
+						return encode_image(context, image, point, &file,
+							metrics, cached != 0);
+					});
+				if (status != B_OK) {
+					fprintf(stderr, "%s: error %d\n", image.name.c_str(),
+						(int)status);
+					return;
+				}
+			}
+		}
+
+		const std::string name = cached != 0
+			? "duplicates/cached" : "duplicates/uncached";
+		report_summary(context, name, aggregate);
+		if (cached != 0) {
+			// 1 - 1 / kDuplicateSaves at best
+			const int64 newHits = translator_statistic(context.translator,
+				JXL_STATS_ENCODE_CACHE_HITS) - hits;
+			const int64 lookups = newHits + translator_statistic(
+				context.translator, JXL_STATS_ENCODE_CACHE_MISSES) - misses;
+			context.results->Add(name, "hitRate",
+				lookups > 0 ? (double)newHits / lookups : 0);
+		}
+	}
+}
+
+
+// Passes the bitmaps of the corpus through the translator unchanged, as it
+// does when asked for a bitmap of the same color space. A BMallocIO source
+// is written out whole, files and other streams are copied a block at a
+// time.
+static void
+bench_copy(BenchContext& context)
+{
+	static const char* const kSourceNames[] = { "mallocIO", "file",
+		"memoryIO" };
+	BPath directory;
+	if (find_directory(B_SYSTEM_TEMP_DIRECTORY, &directory) != B_OK)
+		return;
+	const BPath inPath(directory.Path(), "jxlbench-copy-in.bits");
+	const BPath outPath(directory.Path(), "jxlbench-copy-out.bits");
+
+	for (uint32 source = 0; source < 3; source++) {
+		MetricsAggregate aggregate;
+		for (const CorpusImage& image : context.corpus) {
+			if (image.bits.empty())
+				continue;
+			std::unique_ptr<BPositionIO> in;
+			std::unique_ptr<BPositionIO> out;
+			if (source == 0) {
+				BMallocIO* buffer = new BMallocIO;
+				buffer->WriteExactly(image.bits.data(), image.bits.size());
+				in.reset(buffer);
+				out.reset(new BMallocIO);
+			} else if (source == 1) {
+				BFile* file = new BFile(inPath.Path(), B_READ_WRITE
+					| B_CREATE_FILE | B_ERASE_FILE);
+				file->WriteExactly(image.bits.data(), image.bits.size());
+				in.reset(file);
+				out.reset(new BFile(outPath.Path(), B_WRITE_ONLY
+					| B_CREATE_FILE | B_ERASE_FILE));
+			} else {
+				in.reset(new BMemoryIO(image.bits.data(), image.bits.size()));
+				out.reset(new NullIO);
+			}
+
+			const status_t status = time_runs(context, &aggregate,
+				[&](TranslationMetrics* metrics) {
+					in->Seek(0, SEEK_SET);
+					out->Seek(0, SEEK_SET);
+					BMessage ioExtension;
+					metrics->bytesIn = image.bits.size();
+					return translate(context.translator, in.get(),
+						&ioExtension, B_TRANSLATOR_BITMAP, out.get(),
+						metrics);
+				});
+			if (status != B_OK) {
+				fprintf(stderr, "%s: error %d\n", image.name.c_str(),
+					(int)status);
+			}
+		}
+		report_summary(context, std::string("copy/") + kSourceNames[source],
+			aggregate);
+	}
+	BEntry(inPath.Path()).Remove();
+	BEntry(outPath.Path()).Remove();
+}
+
+#else
+
+static void
+bench_thumbnails(BenchContext& context)
+{
+	printf("%-40s skipped, the thumbnail cache is only on Haiku\n",
+		"thumbnails");
+}
+
+
+static void
+bench_duplicates(BenchContext& context)
+{
+	printf("%-40s skipped, the encode cache is only on Haiku\n",
+		"duplicates");
+}
+
+
+static void
+bench_copy(BenchContext& context)
+{
+	printf("%-40s skipped, the copies are only done on Haiku\n", "copy");
+}
+
+#endif
+
+
+// How fast rows are converted between each pair of color spaces, a photo
+// of the synthetic size at a time
+static void
+bench_conversions(BenchContext& context)
+{
+	const BenchOptions& options = *context.options;
+	const uint32 width = options.width;
+	const uint32 height = options.height;
+	color_map map;
+	make_test_color_map(&map);
+	TestImage image;
+	make_test_image(IMAGE_ALPHA, width, height, 1, &image);
+	// rows of any of the color spaces fit
+	const size_t rowBytes = (size_t)width * 4;
+	std::vector<uint8> source(rowBytes * height);
+	std::vector<uint8> dest(rowBytes * height);
+
+	for (color_space from : kRowColorSpaces) {
+		RowConverter toSource(B_RGBA32, from, width, &map);
+		for (uint32 y = 0; y < height; y++) {
+			toSource.Convert(&image.pixels[y * image.rowBytes],
+				&source[y * rowBytes]);
+		}
+		for (color_space to : kRowColorSpaces) {
+			RowConverter converter(from, to, width, &map);
+			if (to == from || converter.InitCheck() != B_OK)
+				continue;
+			MetricsAggregate aggregate;
+			time_runs(context, &aggregate,
+				[&](TranslationMetrics* metrics) {
+					for (uint32 y = 0; y < height; y++) {
+						converter.Convert(&source[y * rowBytes],
+							&dest[y * rowBytes]);
+					}
+					metrics->pixels = (uint64)width * height;
+					return B_OK;
+				});
+			report_summary(context, std::string("convert/")
+				+ color_space_name(from) + "/" + color_space_name(to),
+				aggregate);
+		}
+	}
+}
+
+
+// #pragma mark -
+
+
+static const Benchmark sBenchmarks[] = {
+	{ "startup", bench_startup, false },
+	{ "conversions", bench_conversions, false },
+	{ "copy", bench_copy, false },
+	{ "translate", bench_translate, true },
+	{ "speed", bench_speed, true },
+	{ "first_paint", bench_first_paint, true },
+	{ "thumbnails", bench_thumbnails, true },
+	{ "duplicates", bench_duplicates, true },
+	{ "tone_curves", bench_tone_curves, true },
+	{ "color_transforms", bench_color_transforms, true }
+};
+
+
+int
+main(int argc, char** argv)
+{
+	const uint32 cores = std::max(1u, std::thread::hardware_concurrency());
+	BenchOptions options;
+	options.corpus = NULL;
+	options.width = 1920;
+	options.height = 1080;
+	options.scanWidth = 4096;
+	options.scanHeight = 4096;
+	options.distances = { 0, 1, 3 };
+	options.efforts = { 3, 7 };
+	options.decodingSpeeds = { 0 };
+	options.threads = { 1, (int32)cores };
+	if (cores == 1)
+		options.threads.pop_back();
+	options.runs = 3;
+	options.memoryBudget = (uint64)sysconf(_SC_PHYS_PAGES)
+		* sysconf(_SC_PAGESIZE) / 2;
+	options.addOn = NULL;
+	const char* output = NULL;
+	const char* baselinePath = NULL;
+	double threshold = 10;
+
+	int option;
+	while ((option = getopt(argc, argv, "c:k:s:S:d:e:D:j:r:m:a:o:b:t:"))
+			!= -1) {
+		switch (option) {
+			case 'c':
+				options.corpus = optarg;
+				break;
+			case 'k':
+			{
+				char* list = optarg;
+				while (char* name = strsep(&list, ","))
+					options.classes.push_back(name);
+				break;
+			}
+			case 's':
+				parse_size(optarg, &options.width, &options.height);
+				break;
+			case 'S':
+				parse_size(optarg, &options.scanWidth, &options.scanHeight);
+				break;
+			case 'd':
+				options.distances = parse_list(optarg);
+				break;
+			case 'e':
+				options.efforts = parse_list(optarg);
+				break;
+			case 'D':
+				options.decodingSpeeds = parse_list(optarg);
+				break;
+			case 'j':
+				options.threads = parse_list(optarg);
+				break;
+			case 'r':
+				options.runs = std::max(1, atoi(optarg));
+				break;
+			case 'm':
+				options.memoryBudget = (uint64)atoll(optarg) * 1024 * 1024;
+				break;
+			case 'a':
+				options.addOn = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'b':
+				baselinePath = optarg;
+				break;
+			case 't':
+				threshold = atof(optarg);
+				break;
+			default:
+				usage();
+		}
+	}
+	if (options.distances.empty() || options.efforts.empty()
+		|| options.decodingSpeeds.empty())
+		usage();
+
+	BenchResults baseline;
+	if (baselinePath != NULL && baseline.ReadJSON(baselinePath) != B_OK) {
+		fprintf(stderr, "Could not read the results in %s\n", baselinePath);
+		return EXIT_FAILURE;
+	}
+
+	BenchResults results;
+	BenchContext context;
+	context.options = &options;
+	context.jxl = NULL;
+		// opened by the first benchmark needing it, after startup
+	context.results = &results;
+	if (options.corpus != NULL)
+		read_corpus_directory(context, options.corpus, "");
+	else
+		make_synthetic_corpus(context);
+
+#ifdef __HAIKU__
+	image_id addOn;
+	if (load_translator(options.addOn, &addOn, &context.translator) != B_OK)
+		return EXIT_FAILURE;
+#endif
+
+	for (const Benchmark& benchmark : sBenchmarks) {
+		bool selected = optind >= argc;
+		for (int i = optind; i < argc; i++)
+			selected |= strcmp(argv[i], benchmark.name) == 0;
+		if (!selected)
+			continue;
+
+		if (benchmark.needsLibrary && (context.jxl = jxl_library()) == NULL) {
+			printf("%-40s skipped, libjxl could not be loaded\n",
+				benchmark.name);
+			continue;
+		}
+		benchmark.function(context);
+	}
+
+#ifdef __HAIKU__
+	unload_translator(addOn, context.translator);
+#endif
+
+	if (output != NULL && results.WriteJSON(output) != B_OK) {
+		fprintf(stderr, "Could not write %s\n", output);
+		return EXIT_FAILURE;
+	}
+	if (baselinePath != NULL && results.Compare(baseline, threshold) > 0)
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,1838 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "jxlcodec.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "codecio.h"
+#include "codecmetrics.h"
+#include "codecmonitor.h"
+#include "colortransform.h"
+#include "eventtrace.h"
+#include "jxllibrary.h"
+#include "orientation.h"
+#include "tonemap.h"
+
+// Box filters an RGBA image down by the given factor, in place
+static void
+DownscaleRGBA(uint8 *pixels, size_t *xsize, size_t *ysize, size_t *stride,
+              size_t factor) {
+  size_t outX = std::max((size_t)1, *xsize / factor);
+  size_t outY = std::max((size_t)1, *ysize / factor);
+  size_t fx = std::min(factor, *xsize);
+  size_t fy = std::min(factor, *ysize);
+  for (size_t y = 0; y < outY; y++) {
+    for (size_t x = 0; x < outX; x++) {
+      uint32 sum[4] = {0, 0, 0, 0};
+      for (size_t dy = 0; dy < fy; dy++) {
+        const uint8 *src = pixels + (y * fy + dy) * *stride + x * fx * 4;
+        for (size_t dx = 0; dx < fx * 4; dx++)
+          sum[dx & 3] += src[dx];
+      }
+      // the output is never ahead of the rows still being read
+      uint8 *dst = pixels + (y * outX + x) * 4;
+      for (int c = 0; c < 4; c++)
+        dst[c] = sum[c] / (fx * fy);
+    }
+  }
+  *xsize = outX;
+  *ysize = outY;
+  *stride = outX * 4;
+}
+
+struct PixelSink {
+  uint8 *pixels;
+  size_t stride;
+  CodecMonitor *monitor;
+  const ToneMapper *toneMapper;
+};
+
+// Copies decoded pixels into the buffer as the decoder finishes them, so
+// the progress can be followed
+static void CopyDecodedPixels(void *opaque, size_t x, size_t y,
+                              size_t num_pixels, const void *pixels) {
+  TraceSpan span("ImageOut");
+  PixelSink *sink = (PixelSink *)opaque;
+  memcpy(sink->pixels + y * sink->stride + x * 4, pixels, num_pixels * 4);
+  sink->monitor->AddDone(num_pixels);
+}
+
+// Same for float pixels, mapped down to 8 bits on the way
+static void ToneMapDecodedPixels(void *opaque, size_t x, size_t y,
+                                 size_t num_pixels, const void *pixels) {
+  TraceSpan span("ImageOut");
+  PixelSink *sink = (PixelSink *)opaque;
+  sink->toneMapper->MapRow((const float *)pixels, x, y, num_pixels, false,
+                           sink->pixels + y * sink->stride + x * 4);
+  sink->monitor->AddDone(num_pixels);
+}
+
+// Asks for linear output, which libjxl can only give for XYB encoded
+// images, and sets up the mapping from whatever the output turns out to be
+static ToneMapper *CreateToneMapper(const JxlLibrary *jxl, JxlDecoder *dec,
+                                    tone_curve curve,
+                                    const JxlBasicInfo &info) {
+  JxlColorEncoding linear;
+  jxl->ColorEncodingSetToLinearSRGB(&linear, info.num_color_channels == 1);
+  jxl->DecoderSetPreferredColorProfile(dec, &linear);
+  JxlColorEncoding encoding;
+  if (JXL_DEC_SUCCESS !=
+      jxl->DecoderGetColorAsEncodedProfile(dec, JXL_COLOR_PROFILE_TARGET_DATA,
+                                           &encoding)) {
+    // only an ICC profile, take it as sRGB
+    return new ToneMapper(curve, info, NULL);
+  }
+  return new ToneMapper(curve, info, &encoding);
+}
+
+// The conversion from the profile of the decoded pixels to the one asked
+// for, NULL if there is none to do
+static std::shared_ptr<const ColorTransform>
+GetColorTransform(const JxlLibrary *jxl, JxlDecoder *dec,
+                  const JxlBasicInfo &info, const DecodeParameters &params) {
+  // a gray profile doesn't describe the RGB output
+  if (params.targetProfile == NULL || params.transforms == NULL ||
+      info.num_color_channels != 3)
+    return NULL;
+  size_t size;
+  if (JXL_DEC_SUCCESS !=
+      jxl->DecoderGetICCProfileSize(dec, JXL_COLOR_PROFILE_TARGET_DATA,
+                                    &size))
+    return NULL;
+  std::vector<uint8> profile(size);
+  if (JXL_DEC_SUCCESS !=
+      jxl->DecoderGetColorAsICCProfile(dec, JXL_COLOR_PROFILE_TARGET_DATA,
+                                       profile.data(), size))
+    return NULL;
+  return params.transforms->Get(jxl, profile, params.targetProfile,
+                                params.targetProfileSize);
+}
+
+status_t
+JxlMemoryToPixels(const uint8_t *next_in, size_t size, bool preview,
+                  const DecodeParameters &params, CodecMonitor *monitor, size_t *stride, size_t *xsize,
+                  size_t *ysize, int *has_alpha, int *preview_source,
+                  uint8 *& pixels) {
+  const JxlLibrary *jxl = jxl_library();
+  if (!jxl)
+    return B_MISSING_LIBRARY;
+  JxlDecoder *dec = jxl->DecoderCreate(NULL);
+  if (!dec) {
+    syslog(LOG_ERR, "JxlDecoderCreate failed\n");
+    return B_ERROR;
+  }
+  if (JXL_DEC_SUCCESS != jxl->DecoderSetParallelRunner(dec,
+                                                       CodecMonitor::Run,
+                                                       monitor)) {
+    syslog(LOG_ERR, "JxlDecoderSetParallelRunner failed\n");
+    jxl->DecoderDestroy(dec);
+    return B_ERROR;
+  }
+  *has_alpha = 1; //we always create RGBA32 currently, see format below
+  *preview_source = PREVIEW_NONE;
+  int events = JXL_DEC_BASIC_INFO | JXL_DEC_FULL_IMAGE;
+  if (preview)
+    events |= JXL_DEC_PREVIEW_IMAGE | JXL_DEC_FRAME_PROGRESSION;
+  if ((!preview && params.toneCurve != TONE_CURVE_NONE) ||
+      params.targetProfile != NULL)
+    events |= JXL_DEC_COLOR_ENCODING;
+  if (JXL_DEC_SUCCESS != jxl->DecoderSubscribeEvents(dec, events)) {
+    syslog(LOG_ERR, "JxlDecoderSubscribeEvents failed\n");
+    jxl->DecoderDestroy(dec);
+    return B_ERROR;
+  }
+  if (preview && JXL_DEC_SUCCESS != jxl->DecoderSetProgressiveDetail(dec, kDC)) {
+    syslog(LOG_ERR, "JxlDecoderSetProgressiveDetail failed\n");
+    jxl->DecoderDestroy(dec);
+    return B_ERROR;
+  }
+  // the pixels are turned while being written out instead
+  if (params.orientation != 0 &&
+      JXL_DEC_SUCCESS != jxl->DecoderSetKeepOrientation(dec, JXL_TRUE)) {
+    syslog(LOG_ERR, "JxlDecoderSetKeepOrientation failed\n");
+    jxl->DecoderDestroy(dec);
+    return B_ERROR;
+  }
+
+  JxlBasicInfo info;
+  int success = 0;
+  JxlPixelFormat format = {4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0};
+  JxlPixelFormat floatFormat = {4, JXL_TYPE_FLOAT, JXL_NATIVE_ENDIAN, 0};
+  std::unique_ptr<ToneMapper> toneMapper;
+  std::shared_ptr<const ColorTransform> transform;
+  PixelSink sink = {NULL, 0, monitor, NULL};
+  jxl->DecoderSetInput(dec, next_in, size);
+
+  for (;;) {
+    if (monitor->IsCancelled())
+      break;
+    JxlDecoderStatus status;
+    {
+      TraceSpan span("DecoderProcessInput");
+      status = jxl->DecoderProcessInput(dec);
+    }
+
+    if (status == JXL_DEC_ERROR) {
+      syslog(LOG_ERR, "Decoder error\n");
+      break;
+    } else if (status == JXL_DEC_NEED_MORE_INPUT) {
+      syslog(LOG_ERR, "Error, already provided all input\n");
+      break;
+    } else if (status == JXL_DEC_BASIC_INFO) {
+      if (JXL_DEC_SUCCESS != jxl->DecoderGetBasicInfo(dec, &info)) {
+        syslog(LOG_ERR, "JxlDecoderGetBasicInfo failed\n");
+        break;
+      }
+      if (preview && info.have_preview) {
+        *xsize = info.preview.xsize;
+        *ysize = info.preview.ysize;
+      } else {
+        *xsize = info.xsize;
+        *ysize = info.ysize;
+      }
+      // the decoder applies the orientation, which may swap the sides
+      if (params.orientation == 0 && info.orientation >= JXL_ORIENT_TRANSPOSE)
+        std::swap(*xsize, *ysize);
+      *stride = *xsize * 4;
+      monitor->SetTotal((uint64)*xsize * *ysize);
+    } else if (status == JXL_DEC_COLOR_ENCODING) {
+      if (!preview && ToneMapper::IsWanted(params.toneCurve, info))
+        toneMapper.reset(CreateToneMapper(jxl, dec, params.toneCurve, info));
+      else
+        transform = GetColorTransform(jxl, dec, info, params);
+    } else if (status == JXL_DEC_NEED_PREVIEW_OUT_BUFFER) {
+      size_t buffer_size;
+      if (JXL_DEC_SUCCESS !=
+          jxl->DecoderPreviewOutBufferSize(dec, &format, &buffer_size)) {
+        syslog(LOG_ERR, "JxlDecoderPreviewOutBufferSize failed\n");
+        break;
+      }
+      if (buffer_size != *stride * *ysize) {
+        syslog(LOG_ERR, "Invalid preview buffer size %zu %zu\n", buffer_size, *stride * *ysize);
+        break;
+      }
+      pixels = (uint8*)malloc(buffer_size);
+      if (!pixels ||
+          JXL_DEC_SUCCESS != jxl->DecoderSetPreviewOutBuffer(dec, &format,
+                                                             pixels,
+                                                             buffer_size)) {
+        syslog(LOG_ERR, "JxlDecoderSetPreviewOutBuffer failed\n");
+        break;
+      }
+    } else if (status == JXL_DEC_PREVIEW_IMAGE) {
+      // nothing after the preview is needed
+      *preview_source = PREVIEW_EMBEDDED;
+      success = 1;
+      break;
+    } else if (status == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+      size_t buffer_size;
+      if (JXL_DEC_SUCCESS !=
+          jxl->DecoderImageOutBufferSize(dec, &format, &buffer_size)) {
+        syslog(LOG_ERR, "JxlDecoderImageOutBufferSize failed\n");
+        break;
+      }
+      if (buffer_size != *stride * *ysize) {
+        syslog(LOG_ERR, "Invalid out buffer size %zu %zu\n", buffer_size, *stride * *ysize);
+        break;
+      }
+      size_t pixels_buffer_size = buffer_size * sizeof(uint8_t);
+      pixels = (uint8*)malloc(pixels_buffer_size);
+      void *pixels_buffer = (void *)pixels;
+      if (!pixels) {
+        syslog(LOG_ERR, "Couldn't allocate the out buffer\n");
+        break;
+      }
+      // previews need the buffer to flush the DC pass into
+      if (toneMapper) {
+        sink.pixels = pixels;
+        sink.stride = *stride;
+        sink.toneMapper = toneMapper.get();
+        if (JXL_DEC_SUCCESS !=
+            jxl->DecoderSetImageOutCallback(dec, &floatFormat,
+                                            ToneMapDecodedPixels, &sink)) {
+          syslog(LOG_ERR, "JxlDecoderSetImageOutCallback failed\n");
+          break;
+        }
+      } else if (monitor->ReportsProgress() && !preview) {
+        sink.pixels = pixels;
+        sink.stride = *stride;
+        if (JXL_DEC_SUCCESS != jxl->DecoderSetImageOutCallback(dec, &format,
+                                                             CopyDecodedPixels,
+                                                             &sink)) {
+          syslog(LOG_ERR, "JxlDecoderSetImageOutCallback failed\n");
+          break;
+        }
+      } else if (JXL_DEC_SUCCESS !=
+                 jxl->DecoderSetImageOutBuffer(dec, &format, pixels_buffer,
+                                               pixels_buffer_size)) {
+        syslog(LOG_ERR, "JxlDecoderSetImageOutBuffer failed\n");
+        break;
+      }
+    } else if (status == JXL_DEC_FRAME_PROGRESSION) {
+      // The DC pass is in; render it into the buffer and stop there
+      if (JXL_DEC_SUCCESS != jxl->DecoderFlushImage(dec)) {
+        syslog(LOG_ERR, "JxlDecoderFlushImage failed\n");
+        break;
+      }
+      DownscaleRGBA(pixels, xsize, ysize, stride, 8);
+      *preview_source = PREVIEW_DOWNSCALED;
+      success = 1;
+      break;
+    } else if (status == JXL_DEC_FULL_IMAGE) {
+      // This means the decoder has decoded all pixels into the buffer.
+      if (preview) {
+        // no progressive pass to stop at, scale the full image instead
+        DownscaleRGBA(pixels, xsize, ysize, stride, 8);
+        *preview_source = PREVIEW_DOWNSCALED;
+      }
+      success = 1;
+      break;
+    } else if (status == JXL_DEC_SUCCESS) {
+      syslog(LOG_ERR, "Decoding finished before receiving pixel data\n");
+      break;
+    } else {
+      syslog(LOG_ERR, "Unexpected decoder status: %d\n", status);
+      break;
+    }
+  }
+  jxl->DecoderDestroy(dec);
+
+  if (success && transform) {
+    PhaseTimer timer(monitor->Metrics(), PHASE_CONVERT);
+    transform->Apply(pixels, *xsize * *ysize, false);
+  }
+  if (success){
+    return B_OK;
+  } else {
+    free(pixels);
+    return monitor->IsCancelled() ? B_CANCELED : B_ERROR;
+  }
+}
+
+// The sample depth and colors of a file being transcoded, which the new
+// one keeps
+struct StoredFormat {
+	uint32			bitsPerSample;
+	uint32			exponentBits;
+	uint32			alphaBits;
+	uint32			alphaExponentBits;
+	bool			hasEncoding;
+	JxlColorEncoding encoding;
+	std::vector<uint8> profile;
+		// the ICC profile, when the colors have no encoding
+};
+
+// Describes an image with 1 (gray), 2 (gray + alpha), 3 (RGB) or 4 (RGBA)
+// channels to the encoder and applies the parameters, returns NULL on
+// failure. The channels are 8 bit sRGB unless stored says otherwise.
+static JxlEncoderFrameSettings*
+SetUpEncoder(const JxlLibrary* jxl, JxlEncoder* enc, uint32 xsize,
+	uint32 ysize, uint32 channels, const EncodeParameters& params,
+	JxlOrientation orientation = JXL_ORIENT_IDENTITY,
+	const StoredFormat* stored = NULL)
+{
+	const bool hasAlpha = channels == 2 || channels == 4;
+
+	if (params.monitor != NULL && JXL_ENC_SUCCESS
+			!= jxl->EncoderSetParallelRunner(enc, CodecMonitor::Run,
+				params.monitor)) {
+		syslog(LOG_ERR, "JxlEncoderSetParallelRunner failed\n");
+		return NULL;
+	}
+
+	// sides over 2^18 or more than 2^28 pixels need the higher level
+	if (xsize > (1 << 18) || ysize > (1 << 18)
+		|| (uint64)xsize * ysize > (1 << 28))
+		jxl->EncoderSetCodestreamLevel(enc, 10);
+
+	JxlBasicInfo basic_info;
+	jxl->EncoderInitBasicInfo(&basic_info);
+	basic_info.xsize = xsize;
+	basic_info.ysize = ysize;
+	basic_info.bits_per_sample = 8;
+	basic_info.orientation = orientation;
+	basic_info.num_color_channels = hasAlpha ? channels - 1 : channels;
+	basic_info.num_extra_channels = hasAlpha ? 1 : 0;
+	basic_info.alpha_bits = hasAlpha ? 8 : 0;
+	if (stored != NULL) {
+		basic_info.bits_per_sample = stored->bitsPerSample;
+		basic_info.exponent_bits_per_sample = stored->exponentBits;
+		basic_info.alpha_bits = hasAlpha ? stored->alphaBits : 0;
+		basic_info.alpha_exponent_bits
+			= hasAlpha ? stored->alphaExponentBits : 0;
+	}
+	// lossless can't go through XYB
+	if (params.distance == 0)
+		basic_info.uses_original_profile = JXL_TRUE;
+	
+	if (JXL_ENC_SUCCESS != jxl->EncoderSetBasicInfo(enc, &basic_info))
+	{
+		syslog(LOG_ERR, "JxlEncoderSetBasicInfo failed\n");	
+		return NULL;
+	}
+
+	JxlEncoderFrameSettings *options = jxl->EncoderFrameSettingsCreate(enc, NULL);
+	jxl->EncoderFrameSettingsSetOption(options, JXL_ENC_FRAME_SETTING_EFFORT,
+		params.effort);
+	if (params.decodingSpeed > 0) {
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_DECODING_SPEED, params.decodingSpeed);
+	}
+	jxl->EncoderSetFrameDistance(options, params.distance);
+	if (params.distance == 0)
+		jxl->EncoderSetFrameLossless(options, JXL_TRUE);
+	if (params.progressive) {
+		// Put a low resolution version first and the center of the
+		// image before the edges, so a reader can paint something useful
+		// after receiving only the start of the file
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_PROGRESSIVE_DC, 1);
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_PROGRESSIVE_AC, 1);
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_RESPONSIVE, 1);
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_GROUP_ORDER, 1);
+	}
+	if (params.preview && !params.progressive) {
+		// libjxl can't write a JxlPreviewHeader image, so store the 1:8
+		// pass first instead; thumbnailers stop decoding right after it
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_PROGRESSIVE_DC, 1);
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_RESPONSIVE, 1);
+	}
+	if (params.paletteColors > 0) {
+		// few colors, typically a screenshot or an icon: make sure a
+		// palette is used and look for repeated patches like text
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_PALETTE_COLORS, params.paletteColors);
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_PATCHES, 1);
+	}
+	if (stored != NULL && !stored->hasEncoding) {
+		if (JXL_ENC_SUCCESS != jxl->EncoderSetICCProfile(enc,
+				stored->profile.data(), stored->profile.size())) {
+			syslog(LOG_ERR, "JxlEncoderSetICCProfile failed\n");
+			return NULL;
+		}
+		return options;
+	}
+
+	JxlColorEncoding color_encoding;
+	memset(&color_encoding, 0, sizeof(JxlColorEncoding));
+	if (stored != NULL)
+		color_encoding = stored->encoding;
+	else
+		jxl->ColorEncodingSetToSRGB(&color_encoding, channels <= 2);
+
+	if (JXL_ENC_SUCCESS != jxl->EncoderSetColorEncoding(enc, &color_encoding))
+	{
+		syslog(LOG_ERR, "JxlEncoderSetColorEncoding failed\n");	
+		return NULL;
+	}
+	return options;
+}
+
+
+status_t
+EncodePixels(const JxlLibrary* jxl, const uint8* pixels, int xsize, int ysize,
+	uint32 channels, const EncodeParameters& params, CodecOutput* out)
+{
+	const size_t size = (size_t)xsize * ysize * channels;
+
+	JxlEncoder *enc = jxl->EncoderCreate(NULL);
+	JxlPixelFormat pixel_format = {channels, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0};
+	JxlEncoderFrameSettings *options = SetUpEncoder(jxl, enc, xsize, ysize,
+		channels, params);
+	if (options == NULL)
+	{
+		jxl->EncoderDestroy(enc);
+		return B_ERROR;
+	}
+
+	JxlEncoderStatus addResult;
+	{
+		TraceSpan span("EncoderAddImageFrame");
+		addResult = jxl->EncoderAddImageFrame(options, &pixel_format,
+			(void*)pixels, size);
+	}
+	if (JXL_ENC_SUCCESS != addResult)
+	{
+		jxl->EncoderDestroy(enc);
+		if (params.monitor != NULL && params.monitor->IsCancelled())
+			return B_CANCELED;
+		syslog(LOG_ERR, "JxlEncoderAddImageFrame failed\n");
+		return B_ERROR;
+	}
+	jxl->EncoderCloseInput(enc);
+	ssize_t written;
+	uint8* output = new uint8[4096];
+
+	size_t availOut;
+	JxlEncoderStatus process_result = JXL_ENC_NEED_MORE_OUTPUT;
+	while (process_result == JXL_ENC_NEED_MORE_OUTPUT)
+	{
+		if (params.monitor != NULL && params.monitor->IsCancelled())
+		{
+			delete[] output;
+			jxl->EncoderDestroy(enc);
+			return B_CANCELED;
+		}
+		availOut = 4096;
+		uint8* nextOut = output;
+		{
+			TraceSpan span("EncoderProcessOutput");
+			process_result = jxl->EncoderProcessOutput(enc, &nextOut,
+				&availOut);
+		}
+		
+		{
+			TraceSpan span("Write");
+			PhaseTimer timer(params.metrics, PHASE_WRITE);
+			written = out->Write(output, 4096-availOut);
+		}
+		if (written < B_OK)
+		{
+			syslog(LOG_ERR, "Data write failed %d\n", (int)written);
+			delete[] output;
+			jxl->EncoderDestroy(enc);
+			return written;
+		}
+		if (written != (ssize_t)(4096 - availOut))
+		{
+			syslog(LOG_ERR, "Data write IO Error\n");
+			delete[] output;
+			jxl->EncoderDestroy(enc);
+			return B_IO_ERROR;
+		}
+	}
+	delete[] output;
+	if (JXL_ENC_SUCCESS != process_result)
+	{
+		jxl->EncoderDestroy(enc);
+		if (params.monitor != NULL && params.monitor->IsCancelled())
+			return B_CANCELED;
+	    syslog(LOG_ERR,"JxlEncoderProcessOutput failed\n");
+	    return B_ERROR;			
+	}
+	jxl->EncoderDestroy(enc);
+	return B_OK;
+}
+
+
+// #pragma mark - Memory use
+
+uint64
+BufferedDecodeMemory(uint64 pixels, off_t fileSize)
+{
+	return fileSize + pixels * (4 + kDecoderBytesPerPixel);
+}
+
+uint64
+StreamingDecodeMemory(uint64 pixels, uint32 xsize, int32 orientation)
+{
+	uint64 memory = kInputChunkSize + (uint64)xsize * 4
+		+ pixels * kDecoderBytesPerPixel;
+	if (orientation_transposes(orientation)) {
+		// the bands libjxl is still filling
+		memory += (uint64)xsize * 4 * kMaxGroupRows;
+	}
+	return memory;
+}
+
+uint64
+BufferedEncodeMemory(uint64 pixels, uint64 bitmapSize, uint32 expandedBytes)
+{
+	return bitmapSize + pixels * (expandedBytes + kEncoderBytesPerPixel);
+}
+
+uint64
+StreamingEncodeMemory(uint32 xsize)
+{
+	return kStreamingEncoderBytes + (uint64)xsize * kRowBatchSize * 4;
+}
+
+uint64
+TranscodeMemory(uint64 pixels, uint32 xsize, uint32 sampleBytes)
+{
+	return kInputChunkSize + pixels * kDecoderBytesPerPixel
+		+ kStreamingEncoderBytes + (uint64)xsize * 4 * sampleBytes
+			* kTranscodeStripRows * kTranscodeStrips;
+}
+
+// Integers of up to 16 bits are passed on as such, anything else as float
+static JxlDataType
+TranscodeSampleType(uint32 bitsPerSample, uint32 exponentBits)
+{
+	if (exponentBits > 0 || bitsPerSample > 16)
+		return JXL_TYPE_FLOAT;
+	return bitsPerSample > 8 ? JXL_TYPE_UINT16 : JXL_TYPE_UINT8;
+}
+
+uint32
+TranscodeSampleBytes(uint32 bitsPerSample, uint32 exponentBits)
+{
+	switch (TranscodeSampleType(bitsPerSample, exponentBits)) {
+		case JXL_TYPE_UINT8:
+			return 1;
+		case JXL_TYPE_UINT16:
+			return 2;
+		default:
+			return 4;
+	}
+}
+
+uint64
+VerifyMemory(uint64 pixels)
+{
+	return kInputChunkSize + pixels * kDecoderBytesPerPixel;
+}
+
+bool
+FitsBitmap(uint32 xsize, uint32 ysize)
+{
+	return (uint64)xsize * 4 * ysize <= UINT32_MAX;
+}
+
+// #pragma mark - Orientation
+
+status_t
+WriteOrientedPixels(const uint8* pixels, size_t xsize, size_t ysize,
+	int32 orientation, TranslationMetrics* metrics, CodecOutput* out)
+{
+	size_t outXSize = xsize;
+	size_t outYSize = ysize;
+	if (orientation_transposes(orientation))
+		std::swap(outXSize, outYSize);
+
+	const size_t rowBytes = outXSize * 4;
+	std::vector<uint8> band(rowBytes * std::min<size_t>(kRowBatchSize,
+		outYSize));
+	for (size_t top = 0; top < outYSize; top += kRowBatchSize) {
+		size_t rows = std::min<size_t>(kRowBatchSize, outYSize - top);
+		{
+			PhaseTimer timer(metrics, PHASE_CONVERT);
+			// RGBA to B_RGBA32 on the way
+			orient_pixels(pixels, xsize * 4, 0, 0, xsize, ysize, orientation,
+				0, top, outXSize, rows, true, band.data(), rowBytes);
+		}
+		PhaseTimer timer(metrics, PHASE_WRITE);
+		status_t status = out->WriteExactly(band.data(), rowBytes * rows);
+		if (status != B_OK)
+			return status;
+	}
+	return B_OK;
+}
+
+// #pragma mark - Streamed decoding
+
+// The part of a file a streamed decoder is working on
+struct StreamedInput {
+	CodecInput*		in;
+	std::vector<uint8> buffer;
+	size_t			size;
+	off_t			offset;
+		// of the end of the buffer in the file
+	bool			closed;
+		// the whole file was handed over
+};
+
+static void
+InitStreamedInput(StreamedInput* input, CodecInput* in)
+{
+	input->in = in;
+	input->buffer.resize(kInputChunkSize);
+	input->size = 0;
+	input->offset = 0;
+	input->closed = false;
+}
+
+// Hands the decoder the next chunk of the file, keeping what it hasn't
+// used yet of the last one. With closeAtEnd the end of the file closes the
+// input, so the decoder fails or finishes instead of asking for more.
+static status_t
+FeedDecoder(const JxlLibrary* jxl, JxlDecoder* dec, StreamedInput* input,
+	TranslationMetrics* metrics, bool closeAtEnd = false)
+{
+	std::vector<uint8>& buffer = input->buffer;
+	size_t remaining = jxl->DecoderReleaseInput(dec);
+	if (remaining == buffer.size()) {
+		// it needs more than a whole chunk at once
+		buffer.resize(buffer.size() * 2);
+	}
+	memmove(buffer.data(), buffer.data() + input->size - remaining,
+		remaining);
+	ssize_t bytesRead;
+	{
+		TraceSpan span("ReadAt");
+		PhaseTimer timer(metrics, PHASE_READ);
+		bytesRead = input->in->ReadAt(input->offset, buffer.data() + remaining,
+			buffer.size() - remaining);
+	}
+	if (bytesRead == 0 && closeAtEnd && !input->closed) {
+		input->size = remaining;
+		jxl->DecoderSetInput(dec, buffer.data(), remaining);
+		jxl->DecoderCloseInput(dec);
+		input->closed = true;
+		return B_OK;
+	}
+	if (bytesRead <= 0) {
+		syslog(LOG_ERR, "Unexpected end of file\n");
+		input->size = remaining;
+		jxl->DecoderSetInput(dec, buffer.data(), remaining);
+		return bytesRead < 0 ? (status_t)bytesRead : (status_t)B_BAD_DATA;
+	}
+	input->offset += bytesRead;
+	input->size = remaining + bytesRead;
+	jxl->DecoderSetInput(dec, buffer.data(), input->size);
+	return B_OK;
+}
+
+// Stored rows collected until they can be written out as whole columns
+struct OrientationBand {
+	std::vector<uint8> pixels;
+	uint64			filled;
+};
+
+// What each of libjxl's threads converts and turns its runs in
+struct RowScratch {
+	std::vector<uint8> row;
+	std::vector<uint8> turned;
+};
+
+struct RowWriter {
+	CodecOutput*	out;
+	off_t			dataOffset;
+	uint64			rowBytes;
+	std::vector<RowScratch> scratch;
+		// by thread
+	std::mutex		lock;
+		// for the bands and status, the pixels are copied and turned
+		// outside of it
+	std::mutex		outputLock;
+		// outputs can only be written from one thread at a time
+	status_t		status;
+	CodecMonitor*	monitor;
+	TranslationMetrics* metrics;
+	const ToneMapper* toneMapper;
+		// maps float pixels, NULL when they are 8 bit
+	const ColorTransform* transform;
+		// converts 8 bit pixels to the profile asked for, may be NULL
+	int32			orientation;
+		// to turn the pixels to, 1 when libjxl has done so already
+	uint32			xsize;
+	uint32			ysize;
+		// of the image as libjxl delivers it
+	std::map<uint32, OrientationBand> bands;
+		// by the first stored row, when the orientation transposes
+};
+
+static status_t
+WriteOutput(RowWriter* writer, off_t position, const uint8* pixels,
+	size_t size)
+{
+	PhaseTimer timer(writer->metrics, PHASE_WRITE);
+	std::lock_guard<std::mutex> lock(writer->outputLock);
+	return writer->out->WriteAtExactly(position, pixels, size);
+}
+
+// Writes a converted run of a stored row to where it belongs once turned
+static status_t
+WriteRun(RowWriter* writer, RowScratch* scratch, size_t x, size_t y,
+	size_t numPixels, const uint8* row)
+{
+	const int32 orientation = writer->orientation;
+	if (orientation == 1) {
+		return WriteOutput(writer, writer->dataOffset + y * writer->rowBytes
+			+ x * 4, row, numPixels * 4);
+	}
+
+	size_t left, top;
+	uint8* turned = scratch->turned.data();
+	if (!orientation_transposes(orientation)) {
+		// stays a run of a single row
+		orient_rect(orientation, writer->xsize, writer->ysize, x, y,
+			numPixels, 1, &left, &top);
+		{
+			PhaseTimer timer(writer->metrics, PHASE_CONVERT);
+			orient_pixels(row, numPixels * 4, x, y, writer->xsize,
+				writer->ysize, orientation, left, top, numPixels, 1, false,
+				turned, numPixels * 4);
+		}
+		return WriteOutput(writer, writer->dataOffset
+			+ top * writer->rowBytes + left * 4, turned, numPixels * 4);
+	}
+
+	// A stored row becomes a column, so rows are collected into bands
+	// until the pixels of each output row are all there. Runs never
+	// overlap, so only finding the band and counting what it holds needs
+	// the lock, and the thread that completes it has it to itself.
+	const uint32 bandTop = y - y % kOrientationBandRows;
+	const uint32 bandRows = std::min(kOrientationBandRows,
+		writer->ysize - bandTop);
+	const size_t storedRowBytes = (size_t)writer->xsize * 4;
+	OrientationBand* band;
+	{
+		std::lock_guard<std::mutex> lock(writer->lock);
+		band = &writer->bands[bandTop];
+		if (band->pixels.empty()) {
+			band->pixels.resize(storedRowBytes * bandRows);
+			band->filled = 0;
+		}
+	}
+	memcpy(band->pixels.data() + (y - bandTop) * storedRowBytes + x * 4,
+		row, numPixels * 4);
+	{
+		std::lock_guard<std::mutex> lock(writer->lock);
+		band->filled += numPixels;
+		if (band->filled < (uint64)bandRows * writer->xsize)
+			return B_OK;
+	}
+
+	// the band turns into a bandRows wide strip as high as the image
+	orient_rect(orientation, writer->xsize, writer->ysize, 0, bandTop,
+		writer->xsize, bandRows, &left, &top);
+	status_t status = B_OK;
+	for (size_t done = 0; done < writer->xsize && status == B_OK;
+			done += kRowBatchSize) {
+		size_t rows = std::min<size_t>(kRowBatchSize, writer->xsize - done);
+		{
+			PhaseTimer timer(writer->metrics, PHASE_CONVERT);
+			orient_pixels(band->pixels.data(), storedRowBytes, 0, bandTop,
+				writer->xsize, writer->ysize, orientation, left, top + done,
+				bandRows, rows, false, turned, bandRows * 4);
+		}
+		for (size_t i = 0; i < rows && status == B_OK; i++) {
+			status = WriteOutput(writer, writer->dataOffset
+				+ (top + done + i) * writer->rowBytes + left * 4,
+				turned + i * bandRows * 4, bandRows * 4);
+		}
+	}
+	std::lock_guard<std::mutex> lock(writer->lock);
+	writer->bands.erase(bandTop);
+	return status;
+}
+
+// Gives each of libjxl's threads its own buffers
+static void*
+InitRowWriter(void* opaque, size_t numThreads, size_t numPixelsPerThread)
+{
+	RowWriter* writer = (RowWriter*)opaque;
+	const size_t turnedBytes = orientation_transposes(writer->orientation)
+		? (size_t)kOrientationBandRows * 4 * kRowBatchSize
+		: numPixelsPerThread * 4;
+	writer->scratch.resize(numThreads);
+	for (RowScratch& scratch : writer->scratch) {
+		scratch.row.resize(numPixelsPerThread * 4);
+		scratch.turned.resize(turnedBytes);
+	}
+	return writer;
+}
+
+static void
+DestroyRowWriter(void* opaque)
+{
+}
+
+// Called by libjxl with each run of decoded pixels, from several threads
+// at once
+static void
+WriteDecodedPixels(void* opaque, size_t thread, size_t x, size_t y,
+	size_t numPixels, const void* pixels)
+{
+	TraceSpan span("ImageOut");
+	RowWriter* writer = (RowWriter*)opaque;
+	{
+		std::lock_guard<std::mutex> lock(writer->lock);
+		if (writer->status != B_OK)
+			return;
+	}
+
+	RowScratch* scratch = &writer->scratch[thread];
+	const uint8* source = (const uint8*)pixels;
+	uint8* row = scratch->row.data();
+	{
+		PhaseTimer timer(writer->metrics, PHASE_CONVERT);
+		if (writer->toneMapper != NULL) {
+			writer->toneMapper->MapRow((const float*)pixels, x, y, numPixels,
+				true, row);
+		} else {
+			for (size_t i = 0; i < numPixels; i++) {
+				// RGBA to B_RGBA32
+				row[i * 4] = source[i * 4 + 2];
+				row[i * 4 + 1] = source[i * 4 + 1];
+				row[i * 4 + 2] = source[i * 4];
+				row[i * 4 + 3] = source[i * 4 + 3];
+			}
+			if (writer->transform != NULL)
+				writer->transform->Apply(row, numPixels, true);
+		}
+	}
+	TraceSpan writeSpan("WriteAt");
+	status_t status = WriteRun(writer, scratch, x, y, numPixels, row);
+	if (status != B_OK) {
+		std::lock_guard<std::mutex> lock(writer->lock);
+		writer->status = status;
+	}
+	writer->monitor->AddDone(numPixels);
+}
+
+status_t
+DecodeStreaming(const JxlLibrary* jxl, CodecInput* in,
+	const DecodeParameters& params, CodecMonitor* monitor,
+	ImageHeaderWriter writeHeader, CodecOutput* out)
+{
+	JxlDecoder* dec = jxl->DecoderCreate(NULL);
+	if (dec == NULL)
+		return B_NO_MEMORY;
+	int events = JXL_DEC_BASIC_INFO | JXL_DEC_FULL_IMAGE;
+	if (params.toneCurve != TONE_CURVE_NONE || params.targetProfile != NULL)
+		events |= JXL_DEC_COLOR_ENCODING;
+	if (jxl->DecoderSubscribeEvents(dec, events) != JXL_DEC_SUCCESS
+		|| jxl->DecoderSetParallelRunner(dec, CodecMonitor::Run, monitor)
+			!= JXL_DEC_SUCCESS
+		|| (params.orientation != 0
+			&& jxl->DecoderSetKeepOrientation(dec, JXL_TRUE)
+				!= JXL_DEC_SUCCESS)) {
+		jxl->DecoderDestroy(dec);
+		return B_ERROR;
+	}
+
+	JxlPixelFormat format = { 4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+	JxlBasicInfo info;
+	std::unique_ptr<ToneMapper> toneMapper;
+	std::shared_ptr<const ColorTransform> transform;
+	StreamedInput input;
+	InitStreamedInput(&input, in);
+	RowWriter writer;
+	writer.out = out;
+	writer.status = B_OK;
+	writer.monitor = monitor;
+	writer.metrics = monitor->Metrics();
+	writer.toneMapper = NULL;
+	writer.transform = NULL;
+	writer.orientation = params.orientation != 0 ? params.orientation : 1;
+	uint32 ysize = 0;
+	status_t status = B_ERROR;
+	for (;;) {
+		if (monitor->IsCancelled()) {
+			status = B_CANCELED;
+			break;
+		}
+		JxlDecoderStatus result;
+		{
+			TraceSpan span("DecoderProcessInput");
+			result = jxl->DecoderProcessInput(dec);
+		}
+		if (result == JXL_DEC_NEED_MORE_INPUT) {
+			status = FeedDecoder(jxl, dec, &input, writer.metrics);
+			if (status != B_OK)
+				break;
+			status = B_ERROR;
+		} else if (result == JXL_DEC_BASIC_INFO) {
+			if (jxl->DecoderGetBasicInfo(dec, &info) != JXL_DEC_SUCCESS)
+				break;
+			uint32 xsize = info.xsize;
+			ysize = info.ysize;
+			bool transposed = params.orientation != 0
+				? orientation_transposes(params.orientation)
+				: info.orientation >= JXL_ORIENT_TRANSPOSE;
+			if (transposed)
+				std::swap(xsize, ysize);
+			writer.xsize = params.orientation != 0 ? info.xsize : xsize;
+			writer.ysize = params.orientation != 0 ? info.ysize : ysize;
+
+			status = writeHeader(out, xsize, ysize);
+			if (status != B_OK)
+				break;
+			status = B_ERROR;
+			writer.dataOffset = out->Position();
+			writer.rowBytes = (uint64)xsize * 4;
+			monitor->SetTotal((uint64)xsize * ysize);
+			if (writer.metrics != NULL)
+				writer.metrics->pixels = (uint64)xsize * ysize;
+		} else if (result == JXL_DEC_COLOR_ENCODING) {
+			if (ToneMapper::IsWanted(params.toneCurve, info)) {
+				toneMapper.reset(CreateToneMapper(jxl, dec, params.toneCurve,
+					info));
+				writer.toneMapper = toneMapper.get();
+				format.data_type = JXL_TYPE_FLOAT;
+			} else {
+				transform = GetColorTransform(jxl, dec, info, params);
+				writer.transform = transform.get();
+			}
+		} else if (result == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+			if (jxl->DecoderSetMultithreadedImageOutCallback(dec, &format,
+					InitRowWriter, WriteDecodedPixels, DestroyRowWriter,
+					&writer) != JXL_DEC_SUCCESS) {
+				syslog(LOG_ERR,
+					"JxlDecoderSetMultithreadedImageOutCallback failed\n");
+				break;
+			}
+		} else if (result == JXL_DEC_FULL_IMAGE) {
+			status = writer.status;
+			if (status == B_OK && !writer.bands.empty()) {
+				syslog(LOG_ERR, "Decoded image has missing pixels\n");
+				status = B_BAD_DATA;
+			}
+			if (status == B_OK) {
+				status = out->SetPosition(writer.dataOffset
+					+ writer.rowBytes * ysize);
+			}
+			break;
+		} else if (monitor->IsCancelled()) {
+			status = B_CANCELED;
+			break;
+		} else {
+			syslog(LOG_ERR, "Decoder error %d\n", (int)result);
+			status = B_BAD_DATA;
+			break;
+		}
+	}
+	jxl->DecoderDestroy(dec);
+	return status;
+}
+
+// #pragma mark - Streamed encoding
+
+uint8*
+ReadBitmapRect(ChunkedSource* source, size_t xpos, size_t ypos, size_t xsize,
+	size_t ysize)
+{
+	const bool expand = source->sourceBytesPerPixel
+		!= source->layout.bytesPerPixel;
+	const size_t rowSize = xsize * source->layout.bytesPerPixel;
+	const size_t readSize = xsize * source->sourceBytesPerPixel;
+	if (source->monitor->IsCancelled()) {
+		// the encoder gives up on a missing chunk
+		source->status = B_CANCELED;
+		return NULL;
+	}
+	uint8* pixels = (uint8*)malloc(rowSize * ysize + (expand ? readSize : 0));
+	if (pixels == NULL) {
+		source->status = B_NO_MEMORY;
+		return NULL;
+	}
+	uint8* raw = pixels + rowSize * ysize;
+
+	TranslationMetrics* metrics = source->monitor->Metrics();
+	std::lock_guard<std::mutex> lock(source->lock);
+	for (size_t y = 0; y < ysize; y++) {
+		uint8* row = pixels + y * rowSize;
+		status_t status;
+		{
+			TraceSpan span("ReadAt");
+			PhaseTimer timer(metrics, PHASE_READ);
+			status = source->in->ReadAtExactly(source->dataOffset
+				+ (ypos + y) * source->rowBytes
+				+ xpos * source->sourceBytesPerPixel, expand ? raw : row,
+				readSize);
+		}
+		if (status != B_OK) {
+			source->status = status;
+			free(pixels);
+			return NULL;
+		}
+		if (expand) {
+			PhaseTimer timer(metrics, PHASE_CONVERT);
+			expand_rgb16_rows(raw, readSize, source->space, xsize, 1, row);
+		}
+	}
+	return pixels;
+}
+
+static void
+GetColorChannelsPixelFormat(void* opaque, JxlPixelFormat* format)
+{
+	ChunkedSource* source = (ChunkedSource*)opaque;
+	JxlPixelFormat pixelFormat = { source->colorChannels, JXL_TYPE_UINT8,
+		JXL_NATIVE_ENDIAN, 0 };
+	*format = pixelFormat;
+}
+
+static const void*
+GetColorChannelDataAt(void* opaque, size_t xpos, size_t ypos, size_t xsize,
+	size_t ysize, size_t* rowOffset)
+{
+	TraceSpan span("ColorChunk");
+	ChunkedSource* source = (ChunkedSource*)opaque;
+	uint8* pixels = ReadBitmapRect(source, xpos, ypos, xsize, ysize);
+	if (pixels == NULL)
+		return NULL;
+	PhaseTimer timer(source->monitor->Metrics(), PHASE_CONVERT);
+	pack_pixels(pixels, xsize * source->layout.bytesPerPixel, source->layout,
+		xsize, ysize, source->colorChannels, pixels);
+	*rowOffset = xsize * source->colorChannels;
+	source->monitor->AddDone((uint64)xsize * ysize);
+	return pixels;
+}
+
+static void
+GetExtraChannelPixelFormat(void* opaque, size_t index, JxlPixelFormat* format)
+{
+	JxlPixelFormat pixelFormat = { 1, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+	*format = pixelFormat;
+}
+
+static const void*
+GetExtraChannelDataAt(void* opaque, size_t index, size_t xpos, size_t ypos,
+	size_t xsize, size_t ysize, size_t* rowOffset)
+{
+	TraceSpan span("AlphaChunk");
+	ChunkedSource* source = (ChunkedSource*)opaque;
+	uint8* pixels = ReadBitmapRect(source, xpos, ypos, xsize, ysize);
+	if (pixels == NULL)
+		return NULL;
+	PhaseTimer timer(source->monitor->Metrics(), PHASE_CONVERT);
+	const uint32 bytesPerPixel = source->layout.bytesPerPixel;
+	const int32 alpha = source->layout.alpha;
+	for (size_t i = 0; i < xsize * ysize; i++)
+		pixels[i] = pixels[i * bytesPerPixel + alpha];
+	*rowOffset = xsize;
+	return pixels;
+}
+
+static void
+ReleaseChunkBuffer(void* opaque, const void* buffer)
+{
+	free((void*)buffer);
+}
+
+// Takes the encoded file from libjxl, which may seek back to fill in
+// sizes once it knows them
+struct OutputWriter {
+	CodecOutput*	out;
+	off_t			start;
+	uint64			position;
+	uint64			end;
+	std::vector<uint8> buffer;
+	status_t		status;
+	TranslationMetrics* metrics;
+};
+
+static void*
+GetOutputBuffer(void* opaque, size_t* size)
+{
+	OutputWriter* writer = (OutputWriter*)opaque;
+	if (*size > writer->buffer.size())
+		writer->buffer.resize(*size);
+	*size = writer->buffer.size();
+	return writer->buffer.data();
+}
+
+static void
+ReleaseOutputBuffer(void* opaque, size_t written)
+{
+	OutputWriter* writer = (OutputWriter*)opaque;
+	if (writer->status == B_OK) {
+		TraceSpan span("WriteAt");
+		PhaseTimer timer(writer->metrics, PHASE_WRITE);
+		writer->status = writer->out->WriteAtExactly(writer->start
+			+ writer->position, writer->buffer.data(), written);
+	}
+	writer->position += written;
+	writer->end = std::max(writer->end, writer->position);
+}
+
+static void
+SeekOutput(void* opaque, uint64_t position)
+{
+	((OutputWriter*)opaque)->position = position;
+}
+
+static void
+SetFinalizedPosition(void* opaque, uint64_t finalizedPosition)
+{
+}
+
+status_t
+EncodeChunked(const JxlLibrary* jxl, ChunkedSource* source, uint32 xsize,
+	uint32 ysize, uint32 channels, const EncodeParameters& params,
+	CodecOutput* out)
+{
+	JxlEncoder* enc = jxl->EncoderCreate(NULL);
+	if (enc == NULL)
+		return B_NO_MEMORY;
+	JxlEncoderFrameSettings* options = SetUpEncoder(jxl, enc, xsize, ysize,
+		channels, params);
+	if (options == NULL) {
+		jxl->EncoderDestroy(enc);
+		return B_ERROR;
+	}
+	jxl->EncoderFrameSettingsSetOption(options,
+		JXL_ENC_FRAME_SETTING_BUFFERING, 2);
+
+	OutputWriter writer;
+	writer.out = out;
+	writer.start = out->Position();
+	writer.position = 0;
+	writer.end = 0;
+	writer.buffer.resize(64 * 1024);
+	writer.status = B_OK;
+	writer.metrics = source->monitor->Metrics();
+	JxlEncoderOutputProcessor processor = { &writer, GetOutputBuffer,
+		ReleaseOutputBuffer, SeekOutput, SetFinalizedPosition };
+	JxlChunkedFrameInputSource input = { source, GetColorChannelsPixelFormat,
+		GetColorChannelDataAt, GetExtraChannelPixelFormat,
+		GetExtraChannelDataAt, ReleaseChunkBuffer };
+
+	source->monitor->SetTotal((uint64)xsize * ysize);
+	status_t status = B_OK;
+	if (jxl->EncoderSetOutputProcessor(enc, processor) != JXL_ENC_SUCCESS) {
+		syslog(LOG_ERR, "JxlEncoderSetOutputProcessor failed\n");
+		status = B_ERROR;
+	} else {
+		TraceSpan span("EncoderAddChunkedFrame");
+		if (jxl->EncoderAddChunkedFrame(options, JXL_TRUE, input)
+				!= JXL_ENC_SUCCESS) {
+			syslog(LOG_ERR, "JxlEncoderAddChunkedFrame failed\n");
+			status = B_ERROR;
+		}
+	}
+	if (status == B_OK) {
+		TraceSpan span("EncoderFlushInput");
+		jxl->EncoderCloseInput(enc);
+		if (jxl->EncoderFlushInput(enc) != JXL_ENC_SUCCESS) {
+			syslog(LOG_ERR, "JxlEncoderFlushInput failed\n");
+			status = B_ERROR;
+		}
+	}
+	jxl->EncoderDestroy(enc);
+
+	// a failed read shows up as an encoder error
+	if (source->status != B_OK)
+		return source->status;
+	if (source->monitor->IsCancelled())
+		return B_CANCELED;
+	if (status == B_OK)
+		status = writer.status;
+	if (status == B_OK)
+		status = out->SetPosition(writer.start + writer.end);
+	return status;
+}
+
+// #pragma mark - Transcoding
+
+// Decoded rows waiting for the encoder
+struct TranscodeStrip {
+	std::vector<uint8> pixels;
+	uint64			filled;
+	uint64			colorTaken;
+	uint64			alphaTaken;
+};
+
+// Passes decoded rows from the decoder's thread to the encoder's. The
+// decoder waits for the encoder to take a whole strip before starting
+// another once kTranscodeStrips are held, unless the encoder is waiting
+// too; then it asked for rows libjxl hasn't decoded yet, and the strips
+// are let to grow rather than getting stuck.
+struct StripQueue {
+	uint32			xsize;
+	uint32			ysize;
+	uint32			channels;
+	uint32			colorChannels;
+	JxlDataType		type;
+	uint32			sampleBytes;
+	JxlOrientation	orientation;
+	StoredFormat	stored;
+	std::map<uint32, TranscodeStrip> strips;
+		// by index, top to bottom
+	std::vector<bool> taken;
+		// strips the encoder is done with
+	std::mutex		lock;
+	std::condition_variable changed;
+	bool			haveInfo;
+	bool			decoded;
+	bool			encoderWaiting;
+	status_t		status;
+		// the first error of either side
+	CodecMonitor*	monitor;
+	TranslationMetrics* metrics;
+};
+
+static uint32
+StripRows(const StripQueue* queue, uint32 index)
+{
+	return std::min(kTranscodeStripRows,
+		queue->ysize - index * kTranscodeStripRows);
+}
+
+// Called by libjxl with each run of decoded pixels
+static void
+QueueDecodedPixels(void* opaque, size_t x, size_t y, size_t numPixels,
+	const void* pixels)
+{
+	TraceSpan span("ImageOut");
+	StripQueue* queue = (StripQueue*)opaque;
+	const uint32 index = y / kTranscodeStripRows;
+	std::unique_lock<std::mutex> lock(queue->lock);
+	while (queue->status == B_OK && queue->strips.count(index) == 0
+		&& queue->strips.size() >= kTranscodeStrips
+		&& !queue->encoderWaiting) {
+		queue->changed.wait(lock);
+	}
+	if (queue->status != B_OK)
+		return;
+	if (queue->taken[index]) {
+		syslog(LOG_ERR, "Rows decoded after the encoder took them\n");
+		queue->status = B_ERROR;
+		queue->changed.notify_all();
+		return;
+	}
+
+	TranscodeStrip& strip = queue->strips[index];
+	const size_t pixelBytes = (size_t)queue->channels * queue->sampleBytes;
+	const size_t rowBytes = queue->xsize * pixelBytes;
+	if (strip.pixels.empty()) {
+		strip.pixels.resize(rowBytes * StripRows(queue, index));
+		strip.filled = 0;
+		strip.colorTaken = 0;
+		strip.alphaTaken = 0;
+	}
+	memcpy(strip.pixels.data() + (y - (size_t)index * kTranscodeStripRows)
+		* rowBytes + x * pixelBytes, pixels, numPixels * pixelBytes);
+	strip.filled += numPixels;
+	if (strip.filled == (uint64)StripRows(queue, index) * queue->xsize)
+		queue->changed.notify_all();
+}
+
+// Hands the encoder a rectangle of one channel, or of the color channels
+// with channel -1, once the strips it covers are decoded
+static const void*
+TakeQueuedRect(StripQueue* queue, int32 channel, size_t xpos, size_t ypos,
+	size_t xsize, size_t ysize, size_t* rowOffset)
+{
+	const uint32 first = ypos / kTranscodeStripRows;
+	const uint32 last = (ypos + ysize - 1) / kTranscodeStripRows;
+	const uint64 rowPixels = queue->xsize;
+
+	std::vector<const uint8*> stripPixels;
+	std::unique_lock<std::mutex> lock(queue->lock);
+	for (uint32 index = first; index <= last; index++) {
+		for (;;) {
+			if (queue->status != B_OK)
+				return NULL;
+			if (queue->taken[index]) {
+				syslog(LOG_ERR, "Rows asked for again after being taken\n");
+				queue->status = B_ERROR;
+				queue->changed.notify_all();
+				return NULL;
+			}
+			std::map<uint32, TranscodeStrip>::iterator found
+				= queue->strips.find(index);
+			if (found != queue->strips.end() && found->second.filled
+					== StripRows(queue, index) * rowPixels) {
+				stripPixels.push_back(found->second.pixels.data());
+				break;
+			}
+			if (queue->decoded) {
+				syslog(LOG_ERR, "Decoded image has missing pixels\n");
+				queue->status = B_BAD_DATA;
+				return NULL;
+			}
+			queue->encoderWaiting = true;
+			queue->changed.notify_all();
+			queue->changed.wait(lock);
+			queue->encoderWaiting = false;
+		}
+	}
+	lock.unlock();
+
+	// the decoder doesn't touch complete strips, and they stay until taken
+	const size_t sampleBytes = queue->sampleBytes;
+	const size_t pixelBytes = queue->channels * sampleBytes;
+	const size_t rowBytes = (size_t)rowPixels * pixelBytes;
+	const uint32 width = channel < 0 ? queue->colorChannels : 1;
+	const size_t offset = (channel < 0 ? 0 : channel) * sampleBytes;
+	const size_t rectPixelBytes = width * sampleBytes;
+	uint8* rect = (uint8*)malloc(xsize * ysize * rectPixelBytes);
+	if (rect == NULL) {
+		lock.lock();
+		queue->status = B_NO_MEMORY;
+		queue->changed.notify_all();
+		return NULL;
+	}
+	{
+		PhaseTimer timer(queue->metrics, PHASE_CONVERT);
+		for (size_t y = 0; y < ysize; y++) {
+			const uint32 index = (ypos + y) / kTranscodeStripRows;
+			const uint8* source = stripPixels[index - first]
+				+ ((ypos + y) % kTranscodeStripRows) * rowBytes
+				+ xpos * pixelBytes + offset;
+			uint8* dest = rect + y * xsize * rectPixelBytes;
+			if (width == queue->channels) {
+				memcpy(dest, source, xsize * rectPixelBytes);
+				continue;
+			}
+			for (size_t x = 0; x < xsize; x++) {
+				memcpy(dest + x * rectPixelBytes, source + x * pixelBytes,
+					rectPixelBytes);
+			}
+		}
+	}
+	*rowOffset = xsize * rectPixelBytes;
+
+	// let go of the strips the encoder is done with
+	lock.lock();
+	for (uint32 index = first; index <= last; index++) {
+		TranscodeStrip& strip = queue->strips[index];
+		const uint64 top = (uint64)index * kTranscodeStripRows;
+		const uint64 rows = std::min<uint64>(ypos + ysize, top
+			+ StripRows(queue, index)) - std::max<uint64>(ypos, top);
+		(channel < 0 ? strip.colorTaken : strip.alphaTaken) += rows * xsize;
+		const uint64 size = StripRows(queue, index) * rowPixels;
+		if (strip.colorTaken == size && (strip.alphaTaken == size
+				|| queue->channels == queue->colorChannels)) {
+			queue->strips.erase(index);
+			queue->taken[index] = true;
+			queue->changed.notify_all();
+		}
+	}
+	lock.unlock();
+	if (channel < 0)
+		queue->monitor->AddDone((uint64)xsize * ysize);
+	return rect;
+}
+
+static void
+GetQueuedColorFormat(void* opaque, JxlPixelFormat* format)
+{
+	StripQueue* queue = (StripQueue*)opaque;
+	JxlPixelFormat pixelFormat = { queue->colorChannels, queue->type,
+		JXL_NATIVE_ENDIAN, 0 };
+	*format = pixelFormat;
+}
+
+static void
+GetQueuedAlphaFormat(void* opaque, size_t index, JxlPixelFormat* format)
+{
+	StripQueue* queue = (StripQueue*)opaque;
+	JxlPixelFormat pixelFormat = { 1, queue->type, JXL_NATIVE_ENDIAN, 0 };
+	*format = pixelFormat;
+}
+
+static const void*
+GetQueuedColorData(void* opaque, size_t xpos, size_t ypos, size_t xsize,
+	size_t ysize, size_t* rowOffset)
+{
+	TraceSpan span("ColorChunk");
+	return TakeQueuedRect((StripQueue*)opaque, -1, xpos, ypos, xsize, ysize,
+		rowOffset);
+}
+
+static const void*
+GetQueuedAlphaData(void* opaque, size_t index, size_t xpos, size_t ypos,
+	size_t xsize, size_t ysize, size_t* rowOffset)
+{
+	TraceSpan span("AlphaChunk");
+	StripQueue* queue = (StripQueue*)opaque;
+	return TakeQueuedRect(queue, queue->colorChannels, xpos, ypos, xsize,
+		ysize, rowOffset);
+}
+
+// Runs on a thread of its own, feeding the queue until the image is done
+static status_t
+DecodeIntoQueue(const JxlLibrary* jxl, CodecInput* in, StripQueue* queue)
+{
+	JxlDecoder* dec = jxl->DecoderCreate(NULL);
+	if (dec == NULL)
+		return B_NO_MEMORY;
+	// the pixels are encoded as they are stored, with the same orientation
+	if (jxl->DecoderSubscribeEvents(dec, JXL_DEC_BASIC_INFO
+			| JXL_DEC_COLOR_ENCODING | JXL_DEC_FULL_IMAGE) != JXL_DEC_SUCCESS
+		|| jxl->DecoderSetParallelRunner(dec, CodecMonitor::Run,
+			queue->monitor) != JXL_DEC_SUCCESS
+		|| jxl->DecoderSetKeepOrientation(dec, JXL_TRUE)
+			!= JXL_DEC_SUCCESS) {
+		jxl->DecoderDestroy(dec);
+		return B_ERROR;
+	}
+
+	JxlPixelFormat format = { 4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+	JxlBasicInfo info;
+	StreamedInput input;
+	InitStreamedInput(&input, in);
+	status_t status = B_ERROR;
+	for (;;) {
+		if (queue->monitor->IsCancelled()) {
+			status = B_CANCELED;
+			break;
+		}
+		JxlDecoderStatus result;
+		{
+			TraceSpan span("DecoderProcessInput");
+			result = jxl->DecoderProcessInput(dec);
+		}
+		if (result == JXL_DEC_NEED_MORE_INPUT) {
+			{
+				// no use going on once the encoder has failed
+				std::lock_guard<std::mutex> lock(queue->lock);
+				if (queue->status != B_OK)
+					break;
+			}
+			status = FeedDecoder(jxl, dec, &input, queue->metrics);
+			if (status != B_OK)
+				break;
+			status = B_ERROR;
+		} else if (result == JXL_DEC_BASIC_INFO) {
+			if (jxl->DecoderGetBasicInfo(dec, &info) != JXL_DEC_SUCCESS)
+				break;
+			std::lock_guard<std::mutex> lock(queue->lock);
+			queue->xsize = info.xsize;
+			queue->ysize = info.ysize;
+			queue->colorChannels = info.num_color_channels == 1 ? 1 : 3;
+			queue->channels = queue->colorChannels
+				+ (info.alpha_bits > 0 ? 1 : 0);
+			queue->orientation = info.orientation;
+			queue->type = TranscodeSampleType(info.bits_per_sample,
+				info.exponent_bits_per_sample);
+			queue->sampleBytes = TranscodeSampleBytes(info.bits_per_sample,
+				info.exponent_bits_per_sample);
+			queue->stored.bitsPerSample = info.bits_per_sample;
+			queue->stored.exponentBits = info.exponent_bits_per_sample;
+			queue->stored.alphaBits = info.alpha_bits;
+			queue->stored.alphaExponentBits = info.alpha_exponent_bits;
+			queue->taken.resize((info.ysize + kTranscodeStripRows - 1)
+				/ kTranscodeStripRows);
+			format.num_channels = queue->channels;
+			format.data_type = queue->type;
+		} else if (result == JXL_DEC_COLOR_ENCODING) {
+			// The new file is tagged with the colors the pixels come out
+			// in. XYB images come out in linear sRGB unless asked for
+			// their original colors, which libjxl can only convert to
+			// when they have an encoding rather than a profile.
+			JxlColorEncoding original;
+			if (!info.uses_original_profile) {
+				if (jxl->DecoderGetColorAsEncodedProfile(dec,
+						JXL_COLOR_PROFILE_TARGET_ORIGINAL, &original)
+							!= JXL_DEC_SUCCESS
+					|| jxl->DecoderSetPreferredColorProfile(dec, &original)
+						!= JXL_DEC_SUCCESS) {
+					syslog(LOG_ERR, "Can't keep the colors of an XYB image "
+						"with an ICC profile\n");
+					status = B_NO_TRANSLATOR;
+					break;
+				}
+			}
+			StoredFormat& stored = queue->stored;
+			stored.hasEncoding = jxl->DecoderGetColorAsEncodedProfile(dec,
+				JXL_COLOR_PROFILE_TARGET_DATA, &stored.encoding)
+					== JXL_DEC_SUCCESS;
+			size_t size;
+			if (!stored.hasEncoding) {
+				if (jxl->DecoderGetICCProfileSize(dec,
+						JXL_COLOR_PROFILE_TARGET_DATA, &size)
+							!= JXL_DEC_SUCCESS) {
+					status = B_NO_TRANSLATOR;
+					break;
+				}
+				stored.profile.resize(size);
+				if (jxl->DecoderGetColorAsICCProfile(dec,
+						JXL_COLOR_PROFILE_TARGET_DATA, stored.profile.data(),
+						size) != JXL_DEC_SUCCESS) {
+					status = B_NO_TRANSLATOR;
+					break;
+				}
+			}
+			// the encoder can be set up now
+			std::lock_guard<std::mutex> lock(queue->lock);
+			queue->haveInfo = true;
+			queue->changed.notify_all();
+		} else if (result == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+			if (jxl->DecoderSetImageOutCallback(dec, &format,
+					QueueDecodedPixels, queue) != JXL_DEC_SUCCESS) {
+				syslog(LOG_ERR, "JxlDecoderSetImageOutCallback failed\n");
+				break;
+			}
+		} else if (result == JXL_DEC_FULL_IMAGE) {
+			status = B_OK;
+			break;
+		} else if (queue->monitor->IsCancelled()) {
+			status = B_CANCELED;
+			break;
+		} else {
+			syslog(LOG_ERR, "Decoder error %d\n", (int)result);
+			status = B_BAD_DATA;
+			break;
+		}
+	}
+	jxl->DecoderDestroy(dec);
+	return status;
+}
+
+static void
+RunQueueDecoder(const JxlLibrary* jxl, CodecInput* in, StripQueue* queue)
+{
+	status_t status = DecodeIntoQueue(jxl, in, queue);
+	std::lock_guard<std::mutex> lock(queue->lock);
+	queue->decoded = true;
+	if (queue->status == B_OK)
+		queue->status = status;
+	queue->changed.notify_all();
+}
+
+status_t
+TranscodeStreaming(const JxlLibrary* jxl, CodecInput* in,
+	const EncodeParameters& params, CodecMonitor* monitor, CodecOutput* out)
+{
+	StripQueue queue;
+	queue.haveInfo = false;
+	queue.decoded = false;
+	queue.encoderWaiting = false;
+	queue.status = B_OK;
+	queue.monitor = monitor;
+	queue.metrics = monitor->Metrics();
+	std::thread decoder(RunQueueDecoder, jxl, in, &queue);
+
+	// the encoder can only be set up once the size is known
+	{
+		std::unique_lock<std::mutex> lock(queue.lock);
+		while (!queue.haveInfo && !queue.decoded)
+			queue.changed.wait(lock);
+	}
+	if (!queue.haveInfo) {
+		decoder.join();
+		return queue.status != B_OK ? queue.status : (status_t)B_BAD_DATA;
+	}
+
+	status_t status = B_OK;
+	OutputWriter writer;
+	writer.out = out;
+	writer.start = out->Position();
+	writer.position = 0;
+	writer.end = 0;
+	writer.buffer.resize(64 * 1024);
+	writer.status = B_OK;
+	writer.metrics = queue.metrics;
+	monitor->SetTotal((uint64)queue.xsize * queue.ysize);
+	if (queue.metrics != NULL)
+		queue.metrics->pixels = (uint64)queue.xsize * queue.ysize;
+
+	JxlEncoder* enc = jxl->EncoderCreate(NULL);
+	JxlEncoderFrameSettings* options = NULL;
+	if (enc != NULL) {
+		options = SetUpEncoder(jxl, enc, queue.xsize, queue.ysize,
+			queue.channels, params, queue.orientation, &queue.stored);
+	}
+	if (options == NULL) {
+		status = enc == NULL ? B_NO_MEMORY : B_ERROR;
+	} else {
+		jxl->EncoderFrameSettingsSetOption(options,
+			JXL_ENC_FRAME_SETTING_BUFFERING, 2);
+		JxlEncoderOutputProcessor processor = { &writer, GetOutputBuffer,
+			ReleaseOutputBuffer, SeekOutput, SetFinalizedPosition };
+		JxlChunkedFrameInputSource input = { &queue, GetQueuedColorFormat,
+			GetQueuedColorData, GetQueuedAlphaFormat,
+			GetQueuedAlphaData, ReleaseChunkBuffer };
+		if (jxl->EncoderSetOutputProcessor(enc, processor)
+				!= JXL_ENC_SUCCESS) {
+			syslog(LOG_ERR, "JxlEncoderSetOutputProcessor failed\n");
+			status = B_ERROR;
+		} else {
+			TraceSpan span("EncoderAddChunkedFrame");
+			if (jxl->EncoderAddChunkedFrame(options, JXL_TRUE, input)
+					!= JXL_ENC_SUCCESS) {
+				syslog(LOG_ERR, "JxlEncoderAddChunkedFrame failed\n");
+				status = B_ERROR;
+			}
+		}
+		if (status == B_OK) {
+			TraceSpan span("EncoderFlushInput");
+			jxl->EncoderCloseInput(enc);
+			if (jxl->EncoderFlushInput(enc) != JXL_ENC_SUCCESS) {
+				syslog(LOG_ERR, "JxlEncoderFlushInput failed\n");
+				status = B_ERROR;
+			}
+		}
+	}
+	if (enc != NULL)
+		jxl->EncoderDestroy(enc);
+
+	// stops the decoder if the encoder gave up first
+	{
+		std::lock_guard<std::mutex> lock(queue.lock);
+		if (queue.status == B_OK && status != B_OK)
+			queue.status = status;
+		queue.changed.notify_all();
+	}
+	decoder.join();
+
+	// a failed decode shows up as an encoder error
+	if (queue.status != B_OK)
+		return queue.status;
+	if (monitor->IsCancelled())
+		return B_CANCELED;
+	if (status == B_OK)
+		status = writer.status;
+	if (status == B_OK)
+		status = out->SetPosition(writer.start + writer.end);
+	return status;
+}
+
+// #pragma mark - Verification
+
+// Sums a hash of each pixel and its position, so runs may come in any
+// order and be split any way. Each frame of an animation follows the one
+// before it.
+struct PixelDigest {
+	uint32			xsize;
+	uint32			bytesPerPixel;
+	uint64			frameStart;
+		// position of the frame being decoded
+	bool			digest;
+	std::atomic<uint64> sum;
+	std::atomic<uint64> pixels;
+	CodecMonitor*	monitor;
+	TranslationMetrics* metrics;
+};
+
+static inline uint64
+MixPixel(uint64 value, uint64 position)
+{
+	// the splitmix64 finalizer
+	uint64 hash = value ^ (position * 0x9e3779b97f4a7c15ULL);
+	hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+	return hash ^ (hash >> 31);
+}
+
+static void
+DigestDecodedPixels(void* opaque, size_t x, size_t y, size_t numPixels,
+	const void* pixels)
+{
+	PixelDigest* digest = (PixelDigest*)opaque;
+	if (digest->digest) {
+		PhaseTimer timer(digest->metrics, PHASE_CONVERT);
+		const uint8* source = (const uint8*)pixels;
+		const uint32 bytesPerPixel = digest->bytesPerPixel;
+		const uint64 position = digest->frameStart
+			+ (uint64)y * digest->xsize + x;
+		uint64 sum = 0;
+		for (size_t i = 0; i < numPixels; i++) {
+			uint64 value = 0;
+			memcpy(&value, source + i * bytesPerPixel, bytesPerPixel);
+			sum += MixPixel(value, position + i);
+		}
+		digest->sum += sum;
+	}
+	digest->pixels += numPixels;
+	digest->monitor->AddDone(numPixels);
+}
+
+status_t
+VerifyStreaming(const JxlLibrary* jxl, CodecInput* in, bool digest,
+	CodecMonitor* monitor, VerifyResult* result)
+{
+	result->status = B_ERROR;
+	result->errorOffset = -1;
+	result->pixels = 0;
+	result->digest = 0;
+
+	JxlDecoder* dec = jxl->DecoderCreate(NULL);
+	if (dec == NULL)
+		return result->status = B_NO_MEMORY;
+	// the stored pixels are enough, turning them would only cost time
+	if (jxl->DecoderSubscribeEvents(dec, JXL_DEC_BASIC_INFO
+			| JXL_DEC_FULL_IMAGE) != JXL_DEC_SUCCESS
+		|| jxl->DecoderSetParallelRunner(dec, CodecMonitor::Run, monitor)
+			!= JXL_DEC_SUCCESS
+		|| jxl->DecoderSetKeepOrientation(dec, JXL_TRUE)
+			!= JXL_DEC_SUCCESS) {
+		jxl->DecoderDestroy(dec);
+		return result->status;
+	}
+
+	JxlPixelFormat format = { 4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+	JxlBasicInfo info;
+	PixelDigest pixels;
+	pixels.xsize = 0;
+	pixels.bytesPerPixel = 4;
+	pixels.frameStart = 0;
+	pixels.digest = digest;
+	pixels.sum = 0;
+	pixels.pixels = 0;
+	pixels.monitor = monitor;
+	pixels.metrics = monitor->Metrics();
+	StreamedInput input;
+	InitStreamedInput(&input, in);
+	status_t status = B_ERROR;
+	for (;;) {
+		if (monitor->IsCancelled()) {
+			status = B_CANCELED;
+			break;
+		}
+		JxlDecoderStatus decoderStatus;
+		{
+			TraceSpan span("DecoderProcessInput");
+			decoderStatus = jxl->DecoderProcessInput(dec);
+		}
+		if (decoderStatus == JXL_DEC_NEED_MORE_INPUT) {
+			if (input.closed) {
+				syslog(LOG_ERR, "Unexpected end of file\n");
+				status = B_BAD_DATA;
+				result->errorOffset = input.offset;
+				break;
+			}
+			status = FeedDecoder(jxl, dec, &input, pixels.metrics, true);
+			if (status != B_OK) {
+				result->errorOffset = input.offset;
+				break;
+			}
+			status = B_ERROR;
+		} else if (decoderStatus == JXL_DEC_BASIC_INFO) {
+			if (jxl->DecoderGetBasicInfo(dec, &info) != JXL_DEC_SUCCESS)
+				break;
+			// deeper images are checked at 16 bits
+			if (info.bits_per_sample > 8) {
+				format.data_type = JXL_TYPE_UINT16;
+				pixels.bytesPerPixel = 8;
+			}
+			pixels.xsize = info.xsize;
+			monitor->SetTotal((uint64)info.xsize * info.ysize);
+			if (pixels.metrics != NULL)
+				pixels.metrics->pixels = (uint64)info.xsize * info.ysize;
+		} else if (decoderStatus == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+			if (jxl->DecoderSetImageOutCallback(dec, &format,
+					DigestDecodedPixels, &pixels) != JXL_DEC_SUCCESS) {
+				syslog(LOG_ERR, "JxlDecoderSetImageOutCallback failed\n");
+				break;
+			}
+		} else if (decoderStatus == JXL_DEC_FULL_IMAGE) {
+			// the frames of an animation all follow, and anything after
+			// the last one is only known to be intact at the end
+			pixels.frameStart += (uint64)info.xsize * info.ysize;
+		} else if (decoderStatus == JXL_DEC_SUCCESS) {
+			status = B_OK;
+			break;
+		} else if (monitor->IsCancelled()) {
+			status = B_CANCELED;
+			break;
+		} else {
+			syslog(LOG_ERR, "Decoder error %d\n", (int)decoderStatus);
+			status = B_BAD_DATA;
+			// everything it hasn't given back was read
+			result->errorOffset = input.offset
+				- jxl->DecoderReleaseInput(dec);
+			break;
+		}
+	}
+	jxl->DecoderDestroy(dec);
+
+	result->pixels = pixels.pixels;
+	if (digest && status == B_OK)
+		result->digest = pixels.sum;
+	return result->status = status;
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef JXLCODEC_H
+#define JXLCODEC_H
+
+#include "codecdefs.h"
+#include "imageanalysis.h"
+#include "tonemap.h"
+
+#include <mutex>
+
+// The libjxl glue, kept free of the Translation Kit so it can be built and
+// exercised anywhere libjxl is. All I/O goes through CodecInput and
+// CodecOutput; positionio.h adapts those to BPositionIO.
+
+class CodecInput;
+class CodecMonitor;
+class ColorTransformCache;
+class CodecOutput;
+struct JxlLibrary;
+struct TranslationMetrics;
+
+// How a preview was made, the values of JXL_EXT_PREVIEW_SOURCE
+enum {
+	PREVIEW_NONE = 0,
+	PREVIEW_EMBEDDED = 1,
+	PREVIEW_DOWNSCALED = 2
+};
+
+const uint32 kMaxImageSide = 1 << 30;
+
+// libjxl keeps up to about this much per pixel for itself while decoding,
+// the worst case being progressive files where all coefficients are kept.
+const uint64 kDecoderBytesPerPixel = 12;
+// and while encoding a whole frame at once
+const uint64 kEncoderBytesPerPixel = 40;
+// Streamed encoding works on 2048x2048 pixel chunks
+const uint64 kStreamingEncoderBytes = 2048 * 2048 * kEncoderBytesPerPixel;
+const size_t kInputChunkSize = 1024 * 1024;
+const uint32 kRowBatchSize = 64;
+// Streamed decodes turned by 90 degrees collect this many stored rows
+// before writing them out as columns. libjxl delivers up to a row of its
+// largest groups, 1024 pixels high, before a band is complete.
+const uint32 kOrientationBandRows = 256;
+const uint32 kMaxGroupRows = 1024;
+// Transcodes pass decoded rows to the encoder in strips as high as its
+// chunks, holding at most this many at a time
+const uint32 kTranscodeStripRows = 2048;
+const uint32 kTranscodeStrips = 2;
+
+
+// Encoder parameters for a single encode, derived from the settings
+struct EncodeParameters {
+	float	distance;
+	int32	effort;
+	int32	decodingSpeed;
+	bool	progressive;
+	bool	preview;
+	int32	paletteColors;
+		// palette size hint from the image analysis, 0 = libjxl default
+	CodecMonitor* monitor;
+		// checked for cancellation, may be NULL
+	TranslationMetrics* metrics;
+		// where writes to the output are timed, may be NULL
+};
+
+// Decoder parameters for a single decode, from ioExtension
+struct DecodeParameters {
+	tone_curve	toneCurve;
+		// for images with more than 8 bits, previews are left to libjxl
+	const uint8* targetProfile;
+	size_t		targetProfileSize;
+		// ICC profile to convert RGB images to, NULL to keep their own.
+		// Tone mapped images are left in sRGB.
+	ColorTransformCache* transforms;
+		// where the conversions are kept between decodes
+	int32		orientation;
+		// Exif orientation to turn the stored pixels to, 0 to have libjxl
+		// apply the image's own
+};
+
+// Hands the encoder rectangles of a bitmap read straight from the input
+struct ChunkedSource {
+	CodecInput*		in;
+	off_t			dataOffset;
+	uint64			rowBytes;
+	color_space		space;
+	PixelLayout		layout;
+		// of the pixels after expanding 15 and 16 bit formats
+	uint32			sourceBytesPerPixel;
+	uint32			colorChannels;
+		// 1 (gray) or 3 (RGB), alpha is passed as an extra channel
+	std::mutex		lock;
+	status_t		status;
+	CodecMonitor*	monitor;
+};
+
+// What verifying a file found
+struct VerifyResult {
+	status_t		status;
+	off_t			errorOffset;
+		// how far into the file the decoder had read when it failed, -1
+		// if it didn't
+	uint64			pixels;
+		// decoded before any error
+	uint64			digest;
+		// of the stored pixels when asked for, 0 otherwise. It doesn't
+		// depend on the order they were decoded in.
+};
+
+typedef status_t (*ImageHeaderWriter)(CodecOutput* out, uint32 xsize,
+	uint32 ysize);
+	// writes whatever goes in front of the B_RGBA32 rows of a decode
+
+
+status_t JxlMemoryToPixels(const uint8_t *next_in, size_t size, bool preview,
+	const DecodeParameters& params, CodecMonitor *monitor, size_t *stride, size_t *xsize, size_t *ysize,
+	int *has_alpha, int *preview_source, uint8 *& pixels);
+	// Decodes a complete JPEG XL image to RGBA. With preview set, only the
+	// embedded preview is decoded, or if there is none, the image is
+	// decoded up to its 1:8 (DC) pass and scaled down by 8; preview_source
+	// tells which.
+status_t EncodePixels(const JxlLibrary* jxl, const uint8* pixels, int xsize,
+	int ysize, uint32 channels, const EncodeParameters& params,
+	CodecOutput* out);
+	// Encodes packed 8 bit pixels with 1 (gray), 2 (gray + alpha), 3 (RGB)
+	// or 4 (RGBA) channels
+
+uint64 BufferedDecodeMemory(uint64 pixels, off_t fileSize);
+uint64 StreamingDecodeMemory(uint64 pixels, uint32 xsize,
+	int32 orientation);
+uint64 BufferedEncodeMemory(uint64 pixels, uint64 bitmapSize,
+	uint32 expandedBytes);
+uint64 StreamingEncodeMemory(uint32 xsize);
+uint64 TranscodeMemory(uint64 pixels, uint32 xsize, uint32 sampleBytes);
+uint64 VerifyMemory(uint64 pixels);
+	// Rough peak memory use of each way of translating an image, to pick
+	// one that fits. orientation is the one the decoder turns the image to
+	// itself, 0 if libjxl does. sampleBytes is TranscodeSampleBytes().
+uint32 TranscodeSampleBytes(uint32 bitsPerSample, uint32 exponentBits);
+	// The size of the samples a transcode passes between decoder and
+	// encoder: bytes for up to 8 bits, 16 bit integers up to 16, floats
+	// beyond and for float images
+bool FitsBitmap(uint32 xsize, uint32 ysize);
+	// Whether the B_RGBA32 rows of an image fit in the 32 bit dataSize of
+	// a bitmap header, so a decode can be written as one
+
+status_t WriteOrientedPixels(const uint8* pixels, size_t xsize, size_t ysize,
+	int32 orientation, TranslationMetrics* metrics, CodecOutput* out);
+	// Writes decoded RGBA pixels out as the B_RGBA32 rows of the image
+	// turned to orientation, a band of rows at a time
+status_t DecodeStreaming(const JxlLibrary* jxl, CodecInput* in,
+	const DecodeParameters& params, CodecMonitor* monitor,
+	ImageHeaderWriter writeHeader, CodecOutput* out);
+	// Decodes straight from in to out as B_RGBA32, a chunk of input and a
+	// row of output at a time
+uint8* ReadBitmapRect(ChunkedSource* source, size_t xpos, size_t ypos,
+	size_t xsize, size_t ysize);
+	// Reads a rectangle of the bitmap in source->layout, returns NULL on
+	// failure. The caller frees it.
+status_t EncodeChunked(const JxlLibrary* jxl, ChunkedSource* source,
+	uint32 xsize, uint32 ysize, uint32 channels,
+	const EncodeParameters& params, CodecOutput* out);
+	// Encodes a bitmap read from the input in 2048x2048 chunks, writing the
+	// output as it is produced
+status_t TranscodeStreaming(const JxlLibrary* jxl, CodecInput* in,
+	const EncodeParameters& params, CodecMonitor* monitor, CodecOutput* out);
+	// Re-encodes a JPEG XL file with new parameters. It is decoded on a
+	// thread of its own while the encoder takes the rows from it, so
+	// neither the bitmap nor the file is ever held whole. The pixels keep
+	// their stored orientation, bit depth and colors, which are carried
+	// over. XYB images whose colors are an ICC profile can't be kept so
+	// and give B_NO_TRANSLATOR.
+status_t VerifyStreaming(const JxlLibrary* jxl, CodecInput* in, bool digest,
+	CodecMonitor* monitor, VerifyResult* result);
+	// Decodes a file a chunk at a time without keeping or writing any of
+	// the pixels, to check that it is intact. Every frame is decoded, up
+	// to the end of the file. Returns result->status.
+	// libjxl still keeps its own frame buffers, so the memory it needs
+	// grows with the image, see VerifyMemory().
+
+
+#endif // JXLCODEC_H
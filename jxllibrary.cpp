@@ -0,0 +1,75 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "jxllibrary.h"
+
+#include <dlfcn.h>
+#include <syslog.h>
+
+#include <jxl/version.h>
+
+#include "codecdefs.h"
+
+#define JXL_STRINGIFY(x) JXL_STRINGIFY_VALUE(x)
+#define JXL_STRINGIFY_VALUE(x) #x
+
+// Prefer the library we were built against, then whatever is installed
+static const char* sJxlLibraryNames[] = {
+	"libjxl.so." JXL_STRINGIFY(JPEGXL_MAJOR_VERSION) "."
+		JXL_STRINGIFY(JPEGXL_MINOR_VERSION),
+	"libjxl.so"
+};
+
+const uint32 kNumJxlLibraryNames
+	= sizeof(sJxlLibraryNames) / sizeof(sJxlLibraryNames[0]);
+
+
+static void*
+open_library(const char* const* names, uint32 count)
+{
+	for (uint32 i = 0; i < count; i++) {
+		void* handle = dlopen(names[i], RTLD_NOW | RTLD_LOCAL);
+		if (handle != NULL)
+			return handle;
+	}
+	return NULL;
+}
+
+
+static JxlLibrary*
+load_jxl_library()
+{
+	void* handle = open_library(sJxlLibraryNames, kNumJxlLibraryNames);
+	if (handle == NULL) {
+		syslog(LOG_ERR, "Couldn't load libjxl: %s\n", dlerror());
+		return NULL;
+	}
+
+	JxlLibrary* library = new JxlLibrary;
+	bool complete = true;
+#define JXL_RESOLVE_FUNCTION(name) \
+	library->name = (decltype(library->name))dlsym(handle, "Jxl" #name); \
+	if (library->name == NULL) { \
+		syslog(LOG_ERR, "libjxl is missing Jxl" #name "\n"); \
+		complete = false; \
+	}
+	JXL_LIBRARY_FUNCTIONS(JXL_RESOLVE_FUNCTION)
+#undef JXL_RESOLVE_FUNCTION
+
+	if (!complete) {
+		delete library;
+		dlclose(handle);
+		return NULL;
+	}
+	// the handle stays open for as long as the add-on is loaded
+	return library;
+}
+
+
+const JxlLibrary*
+jxl_library()
+{
+	static const JxlLibrary* sLibrary = load_jxl_library();
+	return sLibrary;
+}
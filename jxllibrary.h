@@ -0,0 +1,78 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef JXLLIBRARY_H
+#define JXLLIBRARY_H
+
+#include <jxl/cms.h>
+#include <jxl/decode.h>
+#include <jxl/encode.h>
+
+// The add-on is loaded by every application that uses the Translation Kit,
+// so libjxl is not linked directly. It is opened the first time an image is
+// actually decoded or encoded, and all calls go through this table.
+#define JXL_LIBRARY_FUNCTIONS(F) \
+	F(DecoderCreate) \
+	F(DecoderDestroy) \
+	F(DecoderSubscribeEvents) \
+	F(DecoderSetInput) \
+	F(DecoderSetParallelRunner) \
+	F(DecoderProcessInput) \
+	F(DecoderGetBasicInfo) \
+	F(DecoderGetColorAsEncodedProfile) \
+	F(DecoderGetICCProfileSize) \
+	F(DecoderGetColorAsICCProfile) \
+	F(DecoderSetPreferredColorProfile) \
+	F(DecoderImageOutBufferSize) \
+	F(DecoderSetImageOutBuffer) \
+	F(DecoderSetImageOutCallback) \
+	F(DecoderSetMultithreadedImageOutCallback) \
+	F(DecoderPreviewOutBufferSize) \
+	F(DecoderSetPreviewOutBuffer) \
+	F(DecoderSetProgressiveDetail) \
+	F(DecoderSetKeepOrientation) \
+	F(DecoderFlushImage) \
+	F(DecoderReleaseInput) \
+	F(DecoderCloseInput) \
+	F(DecoderSetDecompressBoxes) \
+	F(DecoderGetBoxType) \
+	F(DecoderSetBoxBuffer) \
+	F(DecoderReleaseBoxBuffer) \
+	F(EncoderVersion) \
+	F(EncoderCreate) \
+	F(EncoderDestroy) \
+	F(EncoderInitBasicInfo) \
+	F(EncoderSetCodestreamLevel) \
+	F(EncoderSetBasicInfo) \
+	F(EncoderSetParallelRunner) \
+	F(EncoderSetColorEncoding) \
+	F(EncoderSetICCProfile) \
+	F(EncoderFrameSettingsCreate) \
+	F(EncoderInitFrameHeader) \
+	F(EncoderSetFrameHeader) \
+	F(EncoderFrameSettingsSetOption) \
+	F(EncoderSetFrameDistance) \
+	F(EncoderSetFrameLossless) \
+	F(EncoderAddImageFrame) \
+	F(EncoderAddChunkedFrame) \
+	F(EncoderSetOutputProcessor) \
+	F(EncoderFlushInput) \
+	F(EncoderCloseInput) \
+	F(EncoderProcessOutput) \
+	F(ColorEncodingSetToSRGB) \
+	F(ColorEncodingSetToLinearSRGB) \
+	F(GetDefaultCms)
+
+
+struct JxlLibrary {
+#define JXL_DECLARE_FUNCTION(name) decltype(&Jxl##name) name;
+	JXL_LIBRARY_FUNCTIONS(JXL_DECLARE_FUNCTION)
+#undef JXL_DECLARE_FUNCTION
+};
+
+const JxlLibrary* jxl_library();
+	// opens libjxl on first use, returns NULL if it could not be loaded
+
+
+#endif // JXLLIBRARY_H
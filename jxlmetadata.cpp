@@ -0,0 +1,452 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "jxlmetadata.h"
+
+#include <string.h>
+#include <syslog.h>
+
+#include <DataIO.h>
+#include <Message.h>
+#include <TypeConstants.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "jxllibrary.h"
+#include "jxltranslator.h"
+
+const off_t kMaxMetadataBoxSize = 16 * 1024 * 1024;
+	// anything larger is skipped, no real metadata comes close
+const size_t kMaxHeaderBytes = 64 * 1024;
+	// the image header is a few bytes, give up on broken files after this
+const size_t kHeaderChunkSize = 1024;
+
+static const uint8 sCodestreamSignature[] = { 0xff, 0x0a };
+static const uint8 sContainerSignature[] = { 0, 0, 0, 0x0c, 'J', 'X', 'L', ' ',
+	0x0d, 0x0a, 0x87, 0x0a };
+static const uint8 sFileTypeBox[] = { 0, 0, 0, 0x14, 'f', 't', 'y', 'p',
+	'j', 'x', 'l', ' ', 0, 0, 0, 0, 'j', 'x', 'l', ' ' };
+
+static const char* sMetadataFields[] = {
+	JXL_EXT_IMAGE_WIDTH,
+	JXL_EXT_IMAGE_HEIGHT,
+	JXL_EXT_ORIENTATION,
+	JXL_EXT_CAPTURE_TIME,
+	JXL_EXT_EXIF,
+	JXL_EXT_XMP,
+	JXL_EXT_JUMBF
+};
+
+const uint32 kNumMetadataFields
+	= sizeof(sMetadataFields) / sizeof(sMetadataFields[0]);
+
+
+struct BoxHeader {
+	char	type[4];
+	off_t	contentOffset;
+	off_t	contentSize;
+};
+
+
+static inline uint32
+read_be32(const uint8* data)
+{
+	return ((uint32)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+
+static status_t
+read_box_header(BPositionIO* in, off_t offset, off_t fileSize, BoxHeader* box)
+{
+	uint8 header[16];
+	status_t status = in->ReadAtExactly(offset, header, 8);
+	if (status != B_OK)
+		return status;
+
+	uint64 size = read_be32(header);
+	off_t headerSize = 8;
+	if (size == 1) {
+		status = in->ReadAtExactly(offset + 8, header + 8, 8);
+		if (status != B_OK)
+			return status;
+		size = ((uint64)read_be32(header + 8) << 32) | read_be32(header + 12);
+		headerSize = 16;
+	} else if (size == 0) {
+		// the last box extends to the end of the file
+		size = fileSize - offset;
+	}
+	if (size < (uint64)headerSize || size > (uint64)(fileSize - offset))
+		return B_BAD_DATA;
+
+	memcpy(box->type, header + 4, 4);
+	box->contentOffset = offset + headerSize;
+	box->contentSize = size - headerSize;
+	return B_OK;
+}
+
+
+// #pragma mark - Exif
+
+
+static uint32
+exif_read(const uint8* data, uint32 bytes, bool bigEndian)
+{
+	uint32 value = 0;
+	for (uint32 i = 0; i < bytes; i++) {
+		uint32 byte = data[bigEndian ? i : bytes - 1 - i];
+		value = (value << 8) | byte;
+	}
+	return value;
+}
+
+
+// Returns the offset of the value field of the entry with the given tag in
+// the IFD at ifdOffset, or 0 if there is none
+static uint32
+exif_find_entry(const uint8* tiff, size_t size, bool bigEndian,
+	uint32 ifdOffset, uint16 tag, uint32* count)
+{
+	if (ifdOffset < 8 || ifdOffset > size - 2)
+		return 0;
+	uint32 numEntries = exif_read(tiff + ifdOffset, 2, bigEndian);
+	if (numEntries > (size - ifdOffset - 2) / 12)
+		return 0;
+
+	for (uint32 i = 0; i < numEntries; i++) {
+		const uint8* entry = tiff + ifdOffset + 2 + i * 12;
+		if (exif_read(entry, 2, bigEndian) == tag) {
+			*count = exif_read(entry + 4, 4, bigEndian);
+			return ifdOffset + 2 + i * 12 + 8;
+		}
+	}
+	return 0;
+}
+
+
+// Picks the capture time out of TIFF structured Exif data. The orientation
+// in there is ignored: a JPEG XL decoder has to use the codestream's.
+static void
+parse_exif(const uint8* tiff, size_t size, BMessage* metadata)
+{
+	if (size < 8)
+		return;
+	bool bigEndian;
+	if (memcmp(tiff, "MM\0*", 4) == 0)
+		bigEndian = true;
+	else if (memcmp(tiff, "II*\0", 4) == 0)
+		bigEndian = false;
+	else
+		return;
+
+	uint32 count;
+	uint32 value = exif_find_entry(tiff, size, bigEndian,
+		exif_read(tiff + 4, 4, bigEndian), 0x8769, &count);
+		// Exif IFD pointer
+	if (value == 0)
+		return;
+	value = exif_find_entry(tiff, size, bigEndian,
+		exif_read(tiff + value, 4, bigEndian), 0x9003, &count);
+		// DateTimeOriginal, "YYYY:MM:DD HH:MM:SS"
+	if (value == 0 || count < 2 || count > 64)
+		return;
+	if (count > 4)
+		value = exif_read(tiff + value, 4, bigEndian);
+	if (value > size || count > size - value)
+		return;
+
+	char captureTime[64];
+	memcpy(captureTime, tiff + value, count);
+	captureTime[count - 1] = '\0';
+	metadata->AddString(JXL_EXT_CAPTURE_TIME, captureTime);
+}
+
+
+// #pragma mark - libjxl
+
+
+// Reads the basic info from a codestream at offset, feeding the decoder
+// only as much as it asks for
+static status_t
+read_basic_info(const JxlLibrary* jxl, BPositionIO* in, off_t offset,
+	off_t size, JxlBasicInfo* info)
+{
+	JxlDecoder* dec = jxl->DecoderCreate(NULL);
+	if (dec == NULL)
+		return B_NO_MEMORY;
+	if (jxl->DecoderSubscribeEvents(dec, JXL_DEC_BASIC_INFO)
+			!= JXL_DEC_SUCCESS) {
+		jxl->DecoderDestroy(dec);
+		return B_ERROR;
+	}
+
+	std::vector<uint8> buffer;
+	off_t position = 0;
+	status_t status = B_BAD_DATA;
+	while (position < size && position < (off_t)kMaxHeaderBytes) {
+		size_t chunk = std::min((off_t)kHeaderChunkSize, size - position);
+		size_t kept = buffer.size();
+		buffer.resize(kept + chunk);
+		status = in->ReadAtExactly(offset + position, buffer.data() + kept,
+			chunk);
+		if (status != B_OK)
+			break;
+		position += chunk;
+
+		jxl->DecoderSetInput(dec, buffer.data(), buffer.size());
+		JxlDecoderStatus result = jxl->DecoderProcessInput(dec);
+		if (result == JXL_DEC_BASIC_INFO) {
+			status = jxl->DecoderGetBasicInfo(dec, info) == JXL_DEC_SUCCESS
+				? B_OK : B_BAD_DATA;
+			break;
+		}
+		status = B_BAD_DATA;
+		if (result != JXL_DEC_NEED_MORE_INPUT)
+			break;
+		size_t remaining = jxl->DecoderReleaseInput(dec);
+		buffer.erase(buffer.begin(), buffer.end() - remaining);
+	}
+	jxl->DecoderDestroy(dec);
+	return status;
+}
+
+
+// Decompresses a complete "brob" box. libjxl only does this while parsing a
+// container, so the box is wrapped in the smallest one possible.
+static status_t
+decompress_box(const JxlLibrary* jxl, const std::vector<uint8>& box,
+	std::vector<uint8>& data)
+{
+	std::vector<uint8> container(sContainerSignature,
+		sContainerSignature + sizeof(sContainerSignature));
+	container.insert(container.end(), sFileTypeBox,
+		sFileTypeBox + sizeof(sFileTypeBox));
+	container.insert(container.end(), box.begin(), box.end());
+
+	JxlDecoder* dec = jxl->DecoderCreate(NULL);
+	if (dec == NULL)
+		return B_NO_MEMORY;
+	if (jxl->DecoderSubscribeEvents(dec, JXL_DEC_BOX) != JXL_DEC_SUCCESS
+		|| jxl->DecoderSetDecompressBoxes(dec, JXL_TRUE) != JXL_DEC_SUCCESS) {
+		jxl->DecoderDestroy(dec);
+		return B_ERROR;
+	}
+	jxl->DecoderSetInput(dec, container.data(), container.size());
+
+	status_t status = B_BAD_DATA;
+	bool haveBuffer = false;
+	for (;;) {
+		JxlDecoderStatus result = jxl->DecoderProcessInput(dec);
+		if (result == JXL_DEC_BOX) {
+			JxlBoxType type;
+			if (haveBuffer || jxl->DecoderGetBoxType(dec, type, JXL_FALSE)
+					!= JXL_DEC_SUCCESS || memcmp(type, "brob", 4) != 0)
+				continue;
+			data.resize(box.size() * 4);
+			if (jxl->DecoderSetBoxBuffer(dec, data.data(), data.size())
+					!= JXL_DEC_SUCCESS)
+				break;
+			haveBuffer = true;
+		} else if (result == JXL_DEC_BOX_NEED_MORE_OUTPUT) {
+			size_t used = data.size() - jxl->DecoderReleaseBoxBuffer(dec);
+			if (data.size() >= (size_t)kMaxMetadataBoxSize) {
+				haveBuffer = false;
+				break;
+			}
+			data.resize(data.size() * 2);
+			jxl->DecoderSetBoxBuffer(dec, data.data() + used,
+				data.size() - used);
+		} else if (result == JXL_DEC_NEED_MORE_INPUT && haveBuffer) {
+			// everything we passed in has been consumed
+			status = B_OK;
+			break;
+		} else
+			break;
+	}
+	if (haveBuffer)
+		data.resize(data.size() - jxl->DecoderReleaseBoxBuffer(dec));
+	jxl->DecoderDestroy(dec);
+	return status;
+}
+
+
+// #pragma mark -
+
+
+static void
+add_metadata_box(const char* type, const uint8* data, size_t size,
+	BMessage* metadata)
+{
+	if (memcmp(type, "Exif", 4) == 0) {
+		// starts with the offset of the TIFF header
+		if (size < 4)
+			return;
+		uint32 offset = read_be32(data);
+		if (offset > size - 4)
+			return;
+		metadata->AddData(JXL_EXT_EXIF, B_RAW_TYPE, data + 4 + offset,
+			size - 4 - offset, false);
+		parse_exif(data + 4 + offset, size - 4 - offset, metadata);
+	} else if (memcmp(type, "xml ", 4) == 0) {
+		metadata->AddData(JXL_EXT_XMP, B_RAW_TYPE, data, size, false);
+	} else if (memcmp(type, "jumb", 4) == 0) {
+		metadata->AddData(JXL_EXT_JUMBF, B_RAW_TYPE, data, size, false);
+	}
+}
+
+
+static inline bool
+is_metadata_box(const char* type)
+{
+	return memcmp(type, "Exif", 4) == 0 || memcmp(type, "xml ", 4) == 0
+		|| memcmp(type, "jumb", 4) == 0;
+}
+
+
+status_t
+read_jxl_metadata(BPositionIO* in, BMessage* metadata)
+{
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL)
+		return B_MISSING_LIBRARY;
+
+	off_t fileSize;
+	status_t status = in->GetSize(&fileSize);
+	if (status != B_OK)
+		return status;
+
+	uint8 signature[sizeof(sContainerSignature)];
+	ssize_t bytesRead = in->ReadAt(0, signature, sizeof(signature));
+	if (bytesRead < 0)
+		return bytesRead;
+
+	for (uint32 i = 0; i < kNumMetadataFields; i++)
+		metadata->RemoveName(sMetadataFields[i]);
+
+	JxlBasicInfo info;
+	bool haveInfo = false;
+	if (bytesRead >= (ssize_t)sizeof(sCodestreamSignature)
+		&& memcmp(signature, sCodestreamSignature,
+			sizeof(sCodestreamSignature)) == 0) {
+		// a bare codestream, there can't be any metadata boxes
+		haveInfo = read_basic_info(jxl, in, 0, fileSize, &info) == B_OK;
+	} else if (bytesRead == (ssize_t)sizeof(sContainerSignature)
+		&& memcmp(signature, sContainerSignature,
+			sizeof(sContainerSignature)) == 0) {
+		// Walk the boxes, skipping over the codestream. Only the start of
+		// the first codestream box is read, the image header is in there.
+		off_t offset = sizeof(sContainerSignature);
+		while (offset < fileSize) {
+			BoxHeader box;
+			status = read_box_header(in, offset, fileSize, &box);
+			if (status != B_OK) {
+				syslog(LOG_ERR, "Broken box at offset %lld\n",
+					(long long)offset);
+				break;
+			}
+			offset = box.contentOffset + box.contentSize;
+
+			if (!haveInfo && memcmp(box.type, "jxlc", 4) == 0) {
+				haveInfo = read_basic_info(jxl, in, box.contentOffset,
+					box.contentSize, &info) == B_OK;
+			} else if (!haveInfo && memcmp(box.type, "jxlp", 4) == 0
+				&& box.contentSize > 4) {
+				// a partial codestream, after its 4 byte index
+				haveInfo = read_basic_info(jxl, in, box.contentOffset + 4,
+					box.contentSize - 4, &info) == B_OK;
+			} else if (box.contentSize > kMaxMetadataBoxSize) {
+				continue;
+			} else if (is_metadata_box(box.type)) {
+				std::vector<uint8> data(box.contentSize);
+				status = in->ReadAtExactly(box.contentOffset, data.data(),
+					data.size());
+				if (status != B_OK)
+					break;
+				add_metadata_box(box.type, data.data(), data.size(), metadata);
+			} else if (memcmp(box.type, "brob", 4) == 0
+				&& box.contentSize > 4) {
+				// Brotli compressed, the original type comes first. Only
+				// read the rest for types we want.
+				char type[4];
+				status = in->ReadAtExactly(box.contentOffset, type, 4);
+				if (status != B_OK)
+					break;
+				if (!is_metadata_box(type))
+					continue;
+
+				// decompress_box() wants it with a plain 8 byte header
+				std::vector<uint8> boxData(8 + box.contentSize);
+				uint32 size = boxData.size();
+				boxData[0] = size >> 24;
+				boxData[1] = size >> 16;
+				boxData[2] = size >> 8;
+				boxData[3] = size;
+				memcpy(&boxData[4], "brob", 4);
+				status = in->ReadAtExactly(box.contentOffset, &boxData[8],
+					box.contentSize);
+				if (status != B_OK)
+					break;
+
+				std::vector<uint8> data;
+				if (decompress_box(jxl, boxData, data) == B_OK)
+					add_metadata_box(type, data.data(), data.size(), metadata);
+			}
+		}
+	} else
+		return B_NO_TRANSLATOR;
+
+	if (haveInfo) {
+		metadata->AddInt32(JXL_EXT_IMAGE_WIDTH, info.xsize);
+		metadata->AddInt32(JXL_EXT_IMAGE_HEIGHT, info.ysize);
+		metadata->AddInt32(JXL_EXT_ORIENTATION, info.orientation);
+	}
+	return haveInfo ? B_OK : B_BAD_DATA;
+}
+
+
+status_t
+read_jxl_basic_info(BPositionIO* in, JxlBasicInfo* info)
+{
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL)
+		return B_MISSING_LIBRARY;
+
+	off_t fileSize;
+	status_t status = in->GetSize(&fileSize);
+	if (status != B_OK)
+		return status;
+
+	uint8 signature[sizeof(sContainerSignature)];
+	ssize_t bytesRead = in->ReadAt(0, signature, sizeof(signature));
+	if (bytesRead < 0)
+		return bytesRead;
+
+	if (bytesRead >= (ssize_t)sizeof(sCodestreamSignature)
+		&& memcmp(signature, sCodestreamSignature,
+			sizeof(sCodestreamSignature)) == 0)
+		return read_basic_info(jxl, in, 0, fileSize, info);
+	if (bytesRead != (ssize_t)sizeof(sContainerSignature)
+		|| memcmp(signature, sContainerSignature,
+			sizeof(sContainerSignature)) != 0)
+		return B_NO_TRANSLATOR;
+
+	off_t offset = sizeof(sContainerSignature);
+	while (offset < fileSize) {
+		BoxHeader box;
+		status = read_box_header(in, offset, fileSize, &box);
+		if (status != B_OK)
+			return status;
+		offset = box.contentOffset + box.contentSize;
+
+		if (memcmp(box.type, "jxlc", 4) == 0) {
+			return read_basic_info(jxl, in, box.contentOffset,
+				box.contentSize, info);
+		}
+		if (memcmp(box.type, "jxlp", 4) == 0 && box.contentSize > 4) {
+			return read_basic_info(jxl, in, box.contentOffset + 4,
+				box.contentSize - 4, info);
+		}
+	}
+	return B_BAD_DATA;
+}
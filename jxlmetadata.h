@@ -0,0 +1,26 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef JXLMETADATA_H
+#define JXLMETADATA_H
+
+#include <SupportDefs.h>
+
+#include <jxl/codestream_header.h>
+
+class BMessage;
+class BPositionIO;
+
+
+status_t read_jxl_metadata(BPositionIO* in, BMessage* metadata);
+	// Adds the image size, orientation and the Exif, XMP and JUMBF boxes of
+	// a JPEG XL file to metadata as the JXL_EXT_* fields. Only the box
+	// headers, the metadata boxes and the start of the codestream are read,
+	// no pixels are decoded.
+
+status_t read_jxl_basic_info(BPositionIO* in, JxlBasicInfo* info);
+	// reads only the image header, to size up a decode before starting it
+
+
+#endif // JXLMETADATA_H
@@ -0,0 +1,1096 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+// Checks of the codec core, run by "make -f Makefile.core test". On Haiku
+// the translator add-on is checked too, the installed one or the one given
+// with -a. Tests that need libjxl are skipped when it can't be loaded.
+//
+// Usage: jxltest [-a add-on] [test ...]
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef __HAIKU__
+#include <DataIO.h>
+#include <TranslatorFormats.h>
+
+#include "testaddon.h"
+#endif
+
+#include "codecio.h"
+#include "codecmonitor.h"
+#include "colortransform.h"
+#include "contenthash.h"
+#include "imageanalysis.h"
+#include "jxlcodec.h"
+#include "jxllibrary.h"
+#include "orientation.h"
+#include "pixelconversion.h"
+#include "testimages.h"
+
+// content_hash built once more without SSE2, see Makefile.core
+uint64 content_hash_scalar(const void* data, size_t size, uint64 seed);
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static int32 sFailures = 0;
+#ifdef __HAIKU__
+static BTranslator* sTranslator = NULL;
+#endif
+
+struct Test {
+	const char*	name;
+	void		(*function)(const JxlLibrary* jxl);
+	bool		needsLibrary;
+};
+
+static bool
+check(bool condition, const char* what, const char* file, int line)
+{
+	if (!condition) {
+		fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+		sFailures++;
+	}
+	return condition;
+}
+
+
+static status_t
+write_no_header(CodecOutput* out, uint32 xsize, uint32 ysize)
+{
+	return B_OK;
+}
+
+
+static EncodeParameters
+encode_parameters(float distance, int32 effort)
+{
+	EncodeParameters params;
+	params.distance = distance;
+	params.effort = effort;
+	params.decodingSpeed = 0;
+	params.progressive = false;
+	params.preview = false;
+	params.paletteColors = 0;
+	params.monitor = NULL;
+	params.metrics = NULL;
+	return params;
+}
+
+
+static DecodeParameters
+decode_parameters(int32 orientation)
+{
+	DecodeParameters params;
+	params.toneCurve = TONE_CURVE_NONE;
+	params.targetProfile = NULL;
+	params.targetProfileSize = 0;
+	params.transforms = NULL;
+	params.orientation = orientation;
+	return params;
+}
+
+
+static status_t
+decode_buffered(const MemoryOutput& file, const DecodeParameters& params,
+	size_t* xsize, size_t* ysize, std::vector<uint8>* pixels)
+{
+	CodecMonitor monitor;
+	size_t stride;
+	int hasAlpha;
+	int previewSource;
+	uint8* decoded = NULL;
+	status_t status = JxlMemoryToPixels(file.Buffer(), file.BufferLength(),
+		false, params, &monitor, &stride, xsize, ysize, &hasAlpha,
+		&previewSource, decoded);
+	if (status != B_OK)
+		return status;
+	pixels->resize(*xsize * *ysize * 4);
+	for (size_t y = 0; y < *ysize; y++) {
+		memcpy(pixels->data() + y * *xsize * 4, decoded + y * stride,
+			*xsize * 4);
+	}
+	free(decoded);
+	return B_OK;
+}
+
+
+#ifdef __HAIKU__
+// #pragma mark - Translator
+
+
+static status_t
+identify(const void* data, size_t size)
+{
+	BMemoryIO in(data, size);
+	translator_info info;
+	return sTranslator->Identify(&in, NULL, NULL, &info,
+		B_TRANSLATOR_BITMAP);
+}
+
+
+// Only files starting with the codestream or container signature are
+// claimed, whatever else or however little there is to read
+static void
+test_identify(const JxlLibrary* jxl)
+{
+	static const uint8 kCodestream[] = { 0xff, 0x0a, 0xfa, 0x1f, 0, 0, 0, 0 };
+	static const uint8 kContainer[] = { 0, 0, 0, 0x0c, 'J', 'X', 'L', ' ',
+		0x0d, 0x0a, 0x87, 0x0a };
+	static const uint8 kPNG[] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a,
+		0x0a };
+	CHECK(identify(kCodestream, sizeof(kCodestream)) == B_OK);
+	CHECK(identify(kCodestream, 2) == B_OK);
+	CHECK(identify(kContainer, sizeof(kContainer)) == B_OK);
+	CHECK(identify(kPNG, sizeof(kPNG)) == B_NO_TRANSLATOR);
+	CHECK(identify(kCodestream, 1) == B_NO_TRANSLATOR);
+	CHECK(identify(kContainer, 4) == B_NO_TRANSLATOR);
+	CHECK(identify(kPNG, 0) == B_NO_TRANSLATOR);
+}
+
+
+static status_t
+translate_bits(const std::vector<uint8>& file, BMessage* ioExtension,
+	BMallocIO* out)
+{
+	BMemoryIO in(file.data(), file.size());
+	return sTranslator->Translate(&in, NULL, ioExtension,
+		B_TRANSLATOR_BITMAP, out);
+}
+
+
+// A bitmap asked for as it is comes back unchanged, and one whose data is
+// cut short is refused
+static void
+test_bits_copy(const JxlLibrary* jxl)
+{
+	TestImage image;
+	make_test_image(IMAGE_PHOTO, 37, 23, 1, &image);
+	std::vector<uint8> file;
+	make_bits_file(image, &file);
+	BMallocIO out;
+	if (CHECK(translate_bits(file, NULL, &out) == B_OK)) {
+		CHECK(out.BufferLength() == file.size()
+			&& memcmp(out.Buffer(), file.data(), file.size()) == 0);
+	}
+
+	std::vector<uint8> truncated(file.begin(), file.end() - 1);
+	BMallocIO truncatedOut;
+	CHECK(translate_bits(truncated, NULL, &truncatedOut) == B_BAD_DATA);
+}
+
+
+// Asked for only the header or only the data of a bitmap, as it is or in
+// another color space, that part of the whole one is written
+static void
+test_bits_parts(const JxlLibrary* jxl)
+{
+	TestImage image;
+	make_test_image(IMAGE_PHOTO, 37, 23, 1, &image);
+	std::vector<uint8> file;
+	make_bits_file(image, &file);
+
+	for (color_space space : { image.space, B_RGB24 }) {
+		BMessage whole;
+		whole.AddInt32(B_TRANSLATOR_EXT_BITMAP_COLOR_SPACE, space);
+		BMallocIO wholeOut;
+		if (!CHECK(translate_bits(file, &whole, &wholeOut) == B_OK)
+			|| !CHECK(wholeOut.BufferLength() > sizeof(TranslatorBitmap)))
+			continue;
+		const uint8* bitmap = (const uint8*)wholeOut.Buffer();
+
+		BMessage headerOnly(whole);
+		headerOnly.AddBool(B_TRANSLATOR_EXT_HEADER_ONLY, true);
+		BMallocIO header;
+		if (CHECK(translate_bits(file, &headerOnly, &header) == B_OK)) {
+			CHECK(header.BufferLength() == sizeof(TranslatorBitmap)
+				&& memcmp(header.Buffer(), bitmap, header.BufferLength())
+					== 0);
+		}
+
+		BMessage dataOnly(whole);
+		dataOnly.AddBool(B_TRANSLATOR_EXT_DATA_ONLY, true);
+		BMallocIO data;
+		if (CHECK(translate_bits(file, &dataOnly, &data) == B_OK)) {
+			CHECK(data.BufferLength() + sizeof(TranslatorBitmap)
+					== wholeOut.BufferLength()
+				&& memcmp(data.Buffer(), bitmap + sizeof(TranslatorBitmap),
+					data.BufferLength()) == 0);
+		}
+	}
+}
+#endif // __HAIKU__
+
+
+// #pragma mark - Orientation
+
+
+// Where pixel x, y of an image turned to orientation is stored, straight
+// from the Exif definitions
+static void
+stored_position(int32 orientation, size_t xsize, size_t ysize, size_t x,
+	size_t y, size_t* storedX, size_t* storedY)
+{
+	switch (orientation) {
+		case 2:
+			*storedX = xsize - 1 - x;
+			*storedY = y;
+			break;
+		case 3:
+			*storedX = xsize - 1 - x;
+			*storedY = ysize - 1 - y;
+			break;
+		case 4:
+			*storedX = x;
+			*storedY = ysize - 1 - y;
+			break;
+		case 5:
+			*storedX = y;
+			*storedY = x;
+			break;
+		case 6:
+			*storedX = y;
+			*storedY = ysize - 1 - x;
+			break;
+		case 7:
+			*storedX = xsize - 1 - y;
+			*storedY = ysize - 1 - x;
+			break;
+		case 8:
+			*storedX = xsize - 1 - y;
+			*storedY = x;
+			break;
+		default:
+			*storedX = x;
+			*storedY = y;
+			break;
+	}
+}
+
+
+// Each pixel tells where it is stored
+static void
+make_position_pixel(size_t x, size_t y, uint8* pixel)
+{
+	pixel[0] = x & 0xff;
+	pixel[1] = y & 0xff;
+	pixel[2] = (x >> 8 & 0xf) | (y >> 8 & 0xf) << 4;
+	pixel[3] = 0xa5;
+}
+
+
+// Compares a rectangle at left, top of the turned image with the stored one
+static bool
+check_oriented(int32 orientation, size_t xsize, size_t ysize, size_t left,
+	size_t top, size_t width, size_t height, bool swapRedBlue,
+	const uint8* pixels, size_t stride)
+{
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			size_t storedX;
+			size_t storedY;
+			stored_position(orientation, xsize, ysize, left + x, top + y,
+				&storedX, &storedY);
+			uint8 expected[4];
+			make_position_pixel(storedX, storedY, expected);
+			if (swapRedBlue)
+				std::swap(expected[0], expected[2]);
+			if (memcmp(pixels + y * stride + x * 4, expected, 4) != 0) {
+				fprintf(stderr, "orientation %d: pixel %zu, %zu of %zux%zu "
+					"at %zu, %zu is wrong\n", (int)orientation, x, y, width,
+					height, left, top);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+static void
+test_orientation(const JxlLibrary* jxl)
+{
+	// over more than one 64x64 block, and not a multiple of the 4x4 tiles
+	const size_t xsize = 133;
+	const size_t ysize = 70;
+	std::vector<uint8> stored(xsize * ysize * 4);
+	for (size_t y = 0; y < ysize; y++) {
+		for (size_t x = 0; x < xsize; x++)
+			make_position_pixel(x, y, &stored[(y * xsize + x) * 4]);
+	}
+
+	for (int32 orientation = 1; orientation <= 8; orientation++) {
+		const bool transposes = orientation >= 5;
+		CHECK(orientation_transposes(orientation) == transposes);
+		const size_t width = transposes ? ysize : xsize;
+		const size_t height = transposes ? xsize : ysize;
+
+		// the whole image, with and without swapping red and blue
+		std::vector<uint8> turned(width * height * 4);
+		for (int swap = 0; swap < 2; swap++) {
+			orient_pixels(stored.data(), xsize * 4, 0, 0, xsize, ysize,
+				orientation, 0, 0, width, height, swap != 0, turned.data(),
+				width * 4);
+			CHECK(check_oriented(orientation, xsize, ysize, 0, 0, width,
+				height, swap != 0, turned.data(), width * 4));
+		}
+
+		// a band of the turned image, from the whole stored one
+		const size_t bandTop = height / 3;
+		const size_t bandHeight = std::min<size_t>(37, height - bandTop);
+		orient_pixels(stored.data(), xsize * 4, 0, 0, xsize, ysize,
+			orientation, 0, bandTop, width, bandHeight, false, turned.data(),
+			width * 4);
+		CHECK(check_oriented(orientation, xsize, ysize, 0, bandTop, width,
+			bandHeight, false, turned.data(), width * 4));
+
+		// a stored rectangle, from only its own pixels
+		const size_t x = 21;
+		const size_t y = 9;
+		const size_t rectWidth = 70;
+		const size_t rectHeight = 41;
+		size_t left;
+		size_t top;
+		orient_rect(orientation, xsize, ysize, x, y, rectWidth, rectHeight,
+			&left, &top);
+		const size_t turnedWidth = transposes ? rectHeight : rectWidth;
+		const size_t turnedHeight = transposes ? rectWidth : rectHeight;
+		orient_pixels(stored.data() + (y * xsize + x) * 4, xsize * 4, x, y,
+			xsize, ysize, orientation, left, top, turnedWidth, turnedHeight,
+			false, turned.data(), turnedWidth * 4);
+		CHECK(check_oriented(orientation, xsize, ysize, left, top,
+			turnedWidth, turnedHeight, false, turned.data(),
+			turnedWidth * 4));
+	}
+}
+
+
+// #pragma mark - Content hash
+
+
+static void
+test_content_hash(const JxlLibrary* jxl)
+{
+	std::vector<uint8> data(8192);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (i * 0x9e3779b1) >> 13;
+
+	static const size_t kSizes[] = {
+		0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129,
+		191, 240, 241, 255, 256, 257, 1023, 1024, 1025, 4095, 4096, 4099, 8000
+	};
+	static const uint64 kSeeds[] = { 0, 1, 0x9e3779b97f4a7c15ULL };
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t size : kSizes) {
+			for (uint64 seed : kSeeds) {
+				const uint64 hash = content_hash(&data[offset], size, seed);
+				if (!CHECK(hash == content_hash_scalar(&data[offset], size,
+						seed))) {
+					fprintf(stderr, "content_hash: %zu bytes at %zu, seed "
+						"%llx\n", size, offset, (unsigned long long)seed);
+					return;
+				}
+			}
+		}
+	}
+
+	// every byte counts
+	for (size_t size : kSizes) {
+		if (size == 0)
+			continue;
+		const uint64 hash = content_hash(data.data(), size, 0);
+		for (size_t i = 0; i < size; i += std::max<size_t>(1, size / 7)) {
+			data[i] ^= 1;
+			CHECK(content_hash(data.data(), size, 0) != hash);
+			data[i] ^= 1;
+		}
+		CHECK(content_hash(data.data(), size, 1) != hash);
+	}
+}
+
+
+// #pragma mark - Pixel layouts
+
+
+// Pixels of every 8 bit color space are packed in R, G, B, A order
+static void
+test_channel_order(const JxlLibrary* jxl)
+{
+	static const struct {
+		color_space	space;
+		uint8		pixel[4];
+	} kPixels[] = {
+		{ B_RGB32, { 0x30, 0x20, 0x10, 0xff } },
+		{ B_RGBA32, { 0x30, 0x20, 0x10, 0x40 } },
+		{ B_RGB32_BIG, { 0xff, 0x10, 0x20, 0x30 } },
+		{ B_RGBA32_BIG, { 0x40, 0x10, 0x20, 0x30 } },
+		{ B_RGB24, { 0x30, 0x20, 0x10 } },
+		{ B_RGB24_BIG, { 0x10, 0x20, 0x30 } }
+	};
+	for (const auto& entry : kPixels) {
+		PixelLayout layout;
+		if (!CHECK(get_pixel_layout(entry.space, &layout)))
+			continue;
+		uint8 packed[4];
+		pack_pixels(entry.pixel, sizeof(entry.pixel), layout, 1, 1, 4,
+			packed);
+		const uint8 alpha = layout.alpha >= 0 ? 0x40 : 0xff;
+		if (!CHECK(packed[0] == 0x10 && packed[1] == 0x20
+				&& packed[2] == 0x30 && packed[3] == alpha))
+			fprintf(stderr, "color space 0x%x\n", (unsigned)entry.space);
+	}
+}
+
+
+// Decodes are only written as bitmaps whose data size fits in the 32 bits
+// of its header, up to just under 4 GiB
+static void
+test_bitmap_size(const JxlLibrary* jxl)
+{
+	CHECK(FitsBitmap(1, 1));
+	CHECK(FitsBitmap(1 << 14, (1 << 16) - 1));
+	CHECK(!FitsBitmap(1 << 14, 1 << 16));
+	CHECK(FitsBitmap((1 << 30) - 1, 1));
+	CHECK(!FitsBitmap(1 << 30, 1));
+	CHECK(FitsBitmap(1, (1 << 30) - 1));
+	CHECK(!FitsBitmap(1, 1 << 30));
+	CHECK(!FitsBitmap(kMaxImageSide, kMaxImageSide));
+}
+
+
+// #pragma mark - Row conversion
+
+
+static void
+convert_row(color_space from, color_space to, int32 width,
+	const color_map* map, const uint8* source, uint8* dest)
+{
+	RowConverter converter(from, to, width, map);
+	if (CHECK(converter.InitCheck() == B_OK))
+		converter.Convert(source, dest);
+}
+
+
+// Whether a space keeps 8 bits of each channel, and if it keeps alpha
+static bool
+keeps_colors(color_space space, bool* alpha)
+{
+	switch (space) {
+		case B_RGBA32:
+		case B_RGBA32_BIG:
+		case B_CMYA32:
+			*alpha = true;
+			return true;
+		case B_RGB32:
+		case B_RGB32_BIG:
+		case B_RGB24:
+		case B_RGB24_BIG:
+		case B_CMY32:
+		case B_CMY24:
+			*alpha = false;
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+static void
+test_row_conversion(const JxlLibrary* jxl)
+{
+	const int32 width = 37;
+	color_map map;
+	make_test_color_map(&map);
+
+	TestImage image;
+	make_test_image(IMAGE_ALPHA, width, 1, 7, &image);
+	std::vector<uint8> row(image.pixels.begin(), image.pixels.begin()
+		+ width * 4);
+	// a few pixels exactly on the edges of the ranges
+	static const uint8 kEdges[][4] = {
+		{ 0, 0, 0, 255 }, { 255, 255, 255, 255 }, { 255, 255, 255, 0 },
+		{ 0, 0, 255, 128 }, { 7, 8, 127, 127 }, { 128, 128, 128, 255 }
+	};
+	for (uint32 i = 0; i < sizeof(kEdges) / sizeof(kEdges[0]); i++)
+		memcpy(&row[i * 4], kEdges[i], 4);
+
+	const size_t rowBytes = width * 4 + 4;
+	std::vector<uint8> encoded(rowBytes);
+	std::vector<uint8> decoded(rowBytes);
+	std::vector<uint8> again(rowBytes);
+	std::vector<uint8> direct(rowBytes);
+	std::vector<uint8> through(rowBytes);
+	for (color_space from : kRowColorSpaces) {
+		const size_t usedBytes = (width * RowConverter::BitsPerPixel(from) + 7)
+			/ 8;
+		const bool padded = from == B_RGB32 || from == B_RGB32_BIG;
+		CHECK(usedBytes > 0);
+		convert_row(B_RGBA32, from, width, &map, row.data(), encoded.data());
+		convert_row(from, B_RGBA32, width, &map, encoded.data(),
+			decoded.data());
+
+		// what was read back is written and read the same way again. The
+		// padding of B_RGB32 keeps alpha, so only there the rows written
+		// differ.
+		convert_row(B_RGBA32, from, width, &map, decoded.data(),
+			again.data());
+		convert_row(from, B_RGBA32, width, &map, again.data(),
+			through.data());
+		if (!CHECK(memcmp(through.data(), decoded.data(), width * 4) == 0
+				&& (padded
+					|| memcmp(again.data(), encoded.data(), usedBytes) == 0)))
+			fprintf(stderr, "color space %#x doesn't round trip\n", from);
+
+		// spaces with 8 bits per channel keep them
+		bool alpha;
+		if (keeps_colors(from, &alpha)) {
+			for (int32 x = 0; x < width; x++) {
+				uint8 expected[4];
+				memcpy(expected, &row[x * 4], 4);
+				if (!alpha)
+					expected[3] = 255;
+				if (!CHECK(memcmp(&decoded[x * 4], expected, 4) == 0)) {
+					fprintf(stderr, "color space %#x changed pixel %d\n",
+						from, (int)x);
+					break;
+				}
+			}
+		}
+
+		// converting straight gives the same as through B_RGBA32
+		for (color_space to : kRowColorSpaces) {
+			const size_t targetBytes = (width * RowConverter::BitsPerPixel(to)
+				+ 7) / 8;
+			convert_row(from, to, width, &map, encoded.data(), direct.data());
+			convert_row(B_RGBA32, to, width, &map, decoded.data(),
+				through.data());
+			if (!CHECK(memcmp(direct.data(), through.data(), targetBytes)
+					== 0))
+				fprintf(stderr, "%#x to %#x differs\n", from, to);
+		}
+	}
+
+	CHECK(RowConverter::BitsPerPixel(B_NO_COLOR_SPACE) == 0);
+	CHECK(RowConverter(B_RGB32, B_NO_COLOR_SPACE, width, NULL).InitCheck()
+		== B_NO_TRANSLATOR);
+	CHECK(RowConverter(B_CMAP8, B_RGB32, width, NULL).InitCheck()
+		== B_NO_TRANSLATOR);
+
+	// a few known values, from B_RGBA32 blue, green, red, alpha
+	const uint8 pixel[8] = { 0x10, 0x20, 0x30, 0x40, 0, 0, 0xff, 0xff };
+	uint8 out[8];
+	convert_row(B_RGBA32, B_RGBA32_BIG, 1, NULL, pixel, out);
+	CHECK(out[0] == 0x40 && out[1] == 0x30 && out[2] == 0x20
+		&& out[3] == 0x10);
+	convert_row(B_RGBA32, B_RGB24, 1, NULL, pixel, out);
+	CHECK(out[0] == 0x10 && out[1] == 0x20 && out[2] == 0x30);
+	convert_row(B_RGBA32, B_RGB24_BIG, 1, NULL, pixel, out);
+	CHECK(out[0] == 0x30 && out[1] == 0x20 && out[2] == 0x10);
+	convert_row(B_RGBA32, B_RGB16, 1, NULL, pixel + 4, out);
+	CHECK(out[0] == 0x00 && out[1] == 0xf8);
+	convert_row(B_RGBA32, B_RGB16_BIG, 1, NULL, pixel + 4, out);
+	CHECK(out[0] == 0xf8 && out[1] == 0x00);
+	convert_row(B_RGBA32, B_RGBA15, 1, NULL, pixel + 4, out);
+	CHECK(out[0] == 0x00 && out[1] == 0xfc);
+	// set bits are black
+	const uint8 whiteBlack[8] = { 0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0xff };
+	convert_row(B_RGBA32, B_GRAY1, 2, NULL, whiteBlack, out);
+	CHECK(out[0] == 0x40);
+	convert_row(B_RGBA32, B_CMYK32, 1, NULL, pixel + 4, out);
+	CHECK(out[0] == 0 && out[1] == 0xff && out[2] == 0xff && out[3] == 0);
+	convert_row(B_RGB32, B_RGBA32, 1, NULL, pixel, out);
+	CHECK(out[3] == 0xff);
+}
+
+
+// #pragma mark - libjxl
+
+
+static void
+test_round_trip(const JxlLibrary* jxl)
+{
+	// odd sizes, so no row is a whole number of groups
+	TestImage image;
+	make_test_image(IMAGE_ALPHA, 67, 45, 3, &image);
+	const DecodeParameters decodeParams = decode_parameters(0);
+
+	for (uint32 channels = 1; channels <= 4; channels++) {
+		std::vector<uint8> packed;
+		pack_test_image(image, channels, &packed);
+		MemoryOutput file;
+		if (!CHECK(EncodePixels(jxl, packed.data(), image.width,
+				image.height, channels, encode_parameters(0, 2), &file)
+				== B_OK))
+			continue;
+
+		size_t xsize;
+		size_t ysize;
+		std::vector<uint8> pixels;
+		if (!CHECK(decode_buffered(file, decodeParams, &xsize, &ysize,
+				&pixels) == B_OK))
+			continue;
+		CHECK(xsize == image.width && ysize == image.height);
+		if (xsize != image.width || ysize != image.height)
+			continue;
+
+		// lossless, so every channel comes back as it was
+		const uint8* in = packed.data();
+		for (size_t i = 0; i < xsize * ysize; i++, in += channels) {
+			const uint8* out = &pixels[i * 4];
+			uint8 expected[4];
+			if (channels <= 2) {
+				expected[0] = expected[1] = expected[2] = in[0];
+				expected[3] = channels == 2 ? in[1] : 255;
+			} else {
+				memcpy(expected, in, 3);
+				expected[3] = channels == 4 ? in[3] : 255;
+			}
+			if (!CHECK(memcmp(out, expected, 4) == 0)) {
+				fprintf(stderr, "%u channels: pixel %zu differs\n",
+					(unsigned)channels, i);
+				break;
+			}
+		}
+	}
+
+	// and a lossy encode stays close
+	std::vector<uint8> packed;
+	pack_test_image(image, 3, &packed);
+	MemoryOutput file;
+	if (!CHECK(EncodePixels(jxl, packed.data(), image.width, image.height, 3,
+			encode_parameters(1, 3), &file) == B_OK))
+		return;
+	size_t xsize;
+	size_t ysize;
+	std::vector<uint8> pixels;
+	if (!CHECK(decode_buffered(file, decodeParams, &xsize, &ysize,
+			&pixels) == B_OK))
+		return;
+	double error = 0;
+	for (size_t i = 0; i < xsize * ysize; i++) {
+		for (uint32 c = 0; c < 3; c++) {
+			const double difference = (double)pixels[i * 4 + c]
+				- packed[i * 3 + c];
+			error += difference * difference;
+		}
+	}
+	CHECK(error / (xsize * ysize * 3) < 30);
+}
+
+
+// A streamed decode writes the same B_RGBA32 rows as a buffered one, which
+// are RGBA
+static void
+test_streaming_decode(const JxlLibrary* jxl)
+{
+	// high enough to need more than one band of rows when turned
+	TestImage image;
+	make_test_image(IMAGE_ALPHA, 301, 530, 5, &image);
+	std::vector<uint8> packed;
+	pack_test_image(image, 4, &packed);
+	MemoryOutput file;
+	if (!CHECK(EncodePixels(jxl, packed.data(), image.width, image.height, 4,
+			encode_parameters(1, 3), &file) == B_OK))
+		return;
+
+	static const int32 kOrientations[] = { 0, 1, 2, 3, 5, 6, 7, 8 };
+	for (int32 orientation : kOrientations) {
+		const DecodeParameters params = decode_parameters(orientation);
+		size_t xsize;
+		size_t ysize;
+		std::vector<uint8> pixels;
+		if (!CHECK(decode_buffered(file, params, &xsize, &ysize, &pixels)
+				== B_OK))
+			return;
+		// what the translator writes from a buffered decode
+		MemoryOutput buffered;
+		CHECK(WriteOrientedPixels(pixels.data(), xsize, ysize,
+			orientation != 0 ? orientation : 1, NULL, &buffered) == B_OK);
+
+		MemoryInput in(file.Buffer(), file.BufferLength());
+		CodecMonitor monitor;
+		MemoryOutput streamed;
+		if (!CHECK(DecodeStreaming(jxl, &in, params, &monitor,
+				write_no_header, &streamed) == B_OK))
+			continue;
+		if (!CHECK(streamed.BufferLength() == buffered.BufferLength()
+				&& memcmp(streamed.Buffer(), buffered.Buffer(),
+					buffered.BufferLength()) == 0))
+			fprintf(stderr, "orientation %d differs\n", (int)orientation);
+	}
+}
+
+
+// The bit depth and colors a file was stored with, and its pixels as 16 bit
+// RGB
+static status_t
+decode_rgb16(const JxlLibrary* jxl, const uint8* file, size_t size,
+	JxlBasicInfo* info, JxlColorEncoding* encoding,
+	std::vector<uint16>* pixels)
+{
+	JxlDecoder* decoder = jxl->DecoderCreate(NULL);
+	if (decoder == NULL)
+		return B_NO_MEMORY;
+	const JxlPixelFormat format = { 3, JXL_TYPE_UINT16, JXL_NATIVE_ENDIAN, 0 };
+	status_t status = B_ERROR;
+	if (jxl->DecoderSubscribeEvents(decoder, JXL_DEC_BASIC_INFO
+			| JXL_DEC_COLOR_ENCODING | JXL_DEC_FULL_IMAGE) == JXL_DEC_SUCCESS
+		&& jxl->DecoderSetInput(decoder, file, size) == JXL_DEC_SUCCESS) {
+		for (;;) {
+			JxlDecoderStatus result = jxl->DecoderProcessInput(decoder);
+			if (result == JXL_DEC_BASIC_INFO) {
+				if (jxl->DecoderGetBasicInfo(decoder, info)
+						!= JXL_DEC_SUCCESS)
+					break;
+				pixels->resize((size_t)info->xsize * info->ysize * 3);
+			} else if (result == JXL_DEC_COLOR_ENCODING) {
+				if (jxl->DecoderGetColorAsEncodedProfile(decoder,
+						JXL_COLOR_PROFILE_TARGET_ORIGINAL, encoding)
+							!= JXL_DEC_SUCCESS)
+					break;
+			} else if (result == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+				if (jxl->DecoderSetImageOutBuffer(decoder, &format,
+						pixels->data(), pixels->size() * sizeof(uint16))
+							!= JXL_DEC_SUCCESS)
+					break;
+			} else {
+				if (result == JXL_DEC_FULL_IMAGE)
+					status = B_OK;
+				break;
+			}
+		}
+	}
+	jxl->DecoderDestroy(decoder);
+	return status;
+}
+
+
+// A transcode keeps the bit depth and colors of the file, here 16 bit
+// Display P3, both when stored losslessly and through XYB. A lossless one
+// keeps the pixels too.
+static void
+test_transcode(const JxlLibrary* jxl)
+{
+	TestImage image;
+	make_test_image(IMAGE_PHOTO, 64, 48, 3, &image);
+	std::vector<uint16> pixels((size_t)image.width * image.height * 3);
+	for (uint32 y = 0; y < image.height; y++) {
+		for (uint32 x = 0; x < image.width; x++) {
+			const uint8* in = &image.pixels[y * image.rowBytes + x * 4];
+			for (uint32 c = 0; c < 3; c++) {
+				// low bits an 8 bit transcode would lose
+				pixels[((size_t)y * image.width + x) * 3 + c]
+					= in[2 - c] << 8 | ((x * 31 + y * 17 + c * 7) & 0xff);
+			}
+		}
+	}
+	JxlColorEncoding p3;
+	memset(&p3, 0, sizeof(p3));
+	p3.color_space = JXL_COLOR_SPACE_RGB;
+	p3.white_point = JXL_WHITE_POINT_D65;
+	p3.primaries = JXL_PRIMARIES_P3;
+	p3.transfer_function = JXL_TRANSFER_FUNCTION_SRGB;
+	p3.rendering_intent = JXL_RENDERING_INTENT_RELATIVE;
+	std::vector<uint8> source;
+	if (!CHECK(encode_rgb16(jxl, image.width, image.height, p3, 255, pixels,
+			&source) == B_OK))
+		return;
+
+	for (float distance : { 0.0f, 1.0f }) {
+		// the lossy file is transcoded once more, from XYB
+		std::vector<uint8> file(source);
+		for (int pass = 0; pass < (distance > 0 ? 2 : 1); pass++) {
+			MemoryInput in(file.data(), file.size());
+			CodecMonitor monitor;
+			EncodeParameters params = encode_parameters(distance, 1);
+			params.monitor = &monitor;
+			MemoryOutput out;
+			if (!CHECK(TranscodeStreaming(jxl, &in, params, &monitor, &out)
+					== B_OK))
+				return;
+			file.assign(out.Buffer(), out.Buffer() + out.BufferLength());
+
+			JxlBasicInfo info;
+			JxlColorEncoding encoding;
+			std::vector<uint16> transcoded;
+			if (!CHECK(decode_rgb16(jxl, file.data(), file.size(), &info,
+					&encoding, &transcoded) == B_OK))
+				return;
+			CHECK(info.bits_per_sample == 16);
+			CHECK(info.exponent_bits_per_sample == 0);
+			CHECK((distance == 0) == (info.uses_original_profile != 0));
+			CHECK(encoding.color_space == JXL_COLOR_SPACE_RGB);
+			CHECK(encoding.primaries == JXL_PRIMARIES_P3);
+			CHECK(encoding.white_point == JXL_WHITE_POINT_D65);
+			CHECK(encoding.transfer_function == JXL_TRANSFER_FUNCTION_SRGB);
+			if (distance == 0)
+				CHECK(transcoded == pixels);
+		}
+	}
+}
+
+
+// An animation of lossless RGB frames, each a different photo shown for one
+// tick
+static status_t
+encode_animation(const JxlLibrary* jxl, uint32 width, uint32 height,
+	uint32 frames, std::vector<uint8>* file)
+{
+	JxlEncoder* encoder = jxl->EncoderCreate(NULL);
+	if (encoder == NULL)
+		return B_NO_MEMORY;
+	JxlBasicInfo info;
+	jxl->EncoderInitBasicInfo(&info);
+	info.xsize = width;
+	info.ysize = height;
+	info.bits_per_sample = 8;
+	info.num_color_channels = 3;
+	info.uses_original_profile = JXL_TRUE;
+	info.have_animation = JXL_TRUE;
+	info.animation.tps_numerator = 10;
+	info.animation.tps_denominator = 1;
+	JxlColorEncoding srgb;
+	jxl->ColorEncodingSetToSRGB(&srgb, JXL_FALSE);
+	JxlFrameHeader header;
+	jxl->EncoderInitFrameHeader(&header);
+	header.duration = 1;
+	const JxlPixelFormat format = { 3, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+	JxlEncoderFrameSettings* settings = NULL;
+	status_t status = B_ERROR;
+	if (jxl->EncoderSetBasicInfo(encoder, &info) == JXL_ENC_SUCCESS
+		&& jxl->EncoderSetColorEncoding(encoder, &srgb) == JXL_ENC_SUCCESS
+		&& (settings = jxl->EncoderFrameSettingsCreate(encoder, NULL)) != NULL
+		&& jxl->EncoderSetFrameLossless(settings, JXL_TRUE) == JXL_ENC_SUCCESS
+		&& jxl->EncoderFrameSettingsSetOption(settings,
+			JXL_ENC_FRAME_SETTING_EFFORT, 1) == JXL_ENC_SUCCESS
+		&& jxl->EncoderSetFrameHeader(settings, &header) == JXL_ENC_SUCCESS) {
+		status = B_OK;
+		for (uint32 frame = 0; frame < frames && status == B_OK; frame++) {
+			TestImage image;
+			make_test_image(IMAGE_PHOTO, width, height, frame + 1, &image);
+			std::vector<uint8> packed;
+			pack_test_image(image, 3, &packed);
+			if (jxl->EncoderAddImageFrame(settings, &format, packed.data(),
+					packed.size()) != JXL_ENC_SUCCESS)
+				status = B_ERROR;
+		}
+	}
+	if (status == B_OK) {
+		jxl->EncoderCloseInput(encoder);
+		file->resize(1 << 20);
+		size_t used = 0;
+		JxlEncoderStatus result = JXL_ENC_NEED_MORE_OUTPUT;
+		while (result == JXL_ENC_NEED_MORE_OUTPUT) {
+			if (used == file->size())
+				file->resize(file->size() * 2);
+			uint8* next = file->data() + used;
+			size_t available = file->size() - used;
+			result = jxl->EncoderProcessOutput(encoder, &next, &available);
+			used = next - file->data();
+		}
+		file->resize(used);
+		if (result != JXL_ENC_SUCCESS)
+			status = B_ERROR;
+	}
+	jxl->EncoderDestroy(encoder);
+	return status;
+}
+
+
+// Verifying goes through every frame of an animation to the end of the
+// file, so one cut short after its first frame is found broken
+static void
+test_verify(const JxlLibrary* jxl)
+{
+	const uint32 kWidth = 96;
+	const uint32 kHeight = 64;
+	const uint32 kFrames = 3;
+	std::vector<uint8> file;
+	if (!CHECK(encode_animation(jxl, kWidth, kHeight, kFrames, &file)
+			== B_OK))
+		return;
+
+	MemoryInput in(file.data(), file.size());
+	CodecMonitor monitor;
+	VerifyResult result;
+	CHECK(VerifyStreaming(jxl, &in, true, &monitor, &result) == B_OK);
+	CHECK(result.pixels == (uint64)kWidth * kHeight * kFrames);
+	const uint64 digest = result.digest;
+
+	// the frames are about the same size, so this is well into the last
+	MemoryInput truncated(file.data(), file.size() * 3 / 4);
+	CodecMonitor truncatedMonitor;
+	CHECK(VerifyStreaming(jxl, &truncated, true, &truncatedMonitor, &result)
+		== B_BAD_DATA);
+	CHECK(result.errorOffset >= 0);
+
+	// and so is this
+	std::vector<uint8> damaged(file);
+	for (size_t i = damaged.size() * 3 / 4; i < damaged.size() - 16; i++)
+		damaged[i] ^= 0x5a;
+	MemoryInput damagedIn(damaged.data(), damaged.size());
+	CodecMonitor damagedMonitor;
+	if (VerifyStreaming(jxl, &damagedIn, true, &damagedMonitor, &result)
+			== B_OK) {
+		// libjxl doesn't always notice, but the pixels are then different
+		CHECK(result.digest != digest);
+	}
+}
+
+
+// How much of a file is needed to show its 1:8 image, which should be
+// little with the progressive option
+static void
+test_first_paint(const JxlLibrary* jxl)
+{
+	// several groups, so there is more to the image than its 1:8 pass
+	TestImage image;
+	make_test_image(IMAGE_PHOTO, 640, 480, 7, &image);
+	std::vector<uint8> packed;
+	pack_test_image(image, 3, &packed);
+
+	for (float distance : { 0.0f, 1.0f }) {
+		for (int progressive = 0; progressive < 2; progressive++) {
+			EncodeParameters params = encode_parameters(distance, 3);
+			params.progressive = progressive != 0;
+			MemoryOutput file;
+			if (!CHECK(EncodePixels(jxl, packed.data(), image.width,
+					image.height, 3, params, &file) == B_OK))
+				return;
+			const size_t offset = first_paint_offset(jxl, file.Buffer(),
+				file.BufferLength());
+			printf("%-20s distance %g%s: 1:8 after %zu of %zu bytes\n", "",
+				distance, progressive ? ", progressive" : "", offset,
+				file.BufferLength());
+			if (progressive)
+				CHECK(offset < file.BufferLength() / 2);
+		}
+	}
+}
+
+
+static void
+test_color_transform(const JxlLibrary* jxl)
+{
+	TestImage image;
+	make_test_image(IMAGE_PHOTO, 16, 16, 1, &image);
+	std::vector<uint8> packed;
+	pack_test_image(image, 3, &packed);
+	MemoryOutput file;
+	std::vector<uint8> profile;
+	if (!CHECK(EncodePixels(jxl, packed.data(), image.width, image.height, 3,
+			encode_parameters(1, 1), &file) == B_OK)
+		|| !CHECK(get_icc_profile(jxl, file.Buffer(), file.BufferLength(),
+			&profile)))
+		return;
+
+	std::unique_ptr<ColorTransform> transform(ColorTransform::Create(jxl,
+		profile.data(), profile.size(), profile.data(), profile.size()));
+	if (!CHECK(transform.get() != NULL))
+		return;
+
+	// every level of each channel, and mixes of them
+	const size_t count = 256 * 4;
+	std::vector<uint8> pixels(count * 4);
+	for (size_t i = 0; i < count; i++) {
+		const uint32 level = i & 255;
+		uint8* pixel = &pixels[i * 4];
+		pixel[0] = i / 256 == 0 ? level : (level * 37) & 255;
+		pixel[1] = i / 256 == 1 ? level : (level * 101) & 255;
+		pixel[2] = i / 256 == 2 ? level : (level * 13) & 255;
+		pixel[3] = level;
+	}
+	for (int bgra = 0; bgra < 2; bgra++) {
+		std::vector<uint8> converted(pixels);
+		transform->Apply(converted.data(), count, bgra != 0);
+		int32 worst = 0;
+		for (size_t i = 0; i < pixels.size(); i++)
+			worst = std::max(worst, abs(converted[i] - pixels[i]));
+		if (!CHECK(worst <= 1))
+			fprintf(stderr, "identity transform is off by %d\n", (int)worst);
+	}
+
+	ColorTransformCache cache;
+	CHECK(cache.Get(jxl, profile, profile.data(), profile.size()) == NULL);
+}
+
+
+// #pragma mark -
+
+
+static const Test sTests[] = {
+#ifdef __HAIKU__
+	{ "identify", test_identify, false },
+	{ "bits_copy", test_bits_copy, false },
+	{ "bits_parts", test_bits_parts, false },
+#endif
+	{ "orientation", test_orientation, false },
+	{ "content_hash", test_content_hash, false },
+	{ "channel_order", test_channel_order, false },
+	{ "bitmap_size", test_bitmap_size, false },
+	{ "row_conversion", test_row_conversion, false },
+	{ "round_trip", test_round_trip, true },
+	{ "streaming_decode", test_streaming_decode, true },
+	{ "transcode", test_transcode, true },
+	{ "verify", test_verify, true },
+	{ "first_paint", test_first_paint, true },
+	{ "color_transform", test_color_transform, true }
+};
+
+
+int
+main(int argc, char** argv)
+{
+	const char* addOnPath = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "a:")) != -1) {
+		if (option != 'a') {
+			fprintf(stderr, "Usage: jxltest [-a add-on] [test ...]\n");
+			return EXIT_FAILURE;
+		}
+		addOnPath = optarg;
+	}
+
+#ifdef __HAIKU__
+	image_id addOn;
+	if (load_translator(addOnPath, &addOn, &sTranslator) != B_OK)
+		return EXIT_FAILURE;
+#else
+	if (addOnPath != NULL)
+		fprintf(stderr, "The add-on is only checked on Haiku.\n");
+#endif
+
+	const JxlLibrary* jxl = jxl_library();
+	int32 failed = 0;
+	for (const Test& test : sTests) {
+		bool selected = optind >= argc;
+		for (int i = optind; i < argc; i++)
+			selected |= strcmp(argv[i], test.name) == 0;
+		if (!selected)
+			continue;
+
+		if (test.needsLibrary && jxl == NULL) {
+			printf("%-20s skipped, libjxl could not be loaded\n", test.name);
+			continue;
+		}
+		const int32 failures = sFailures;
+		test.function(jxl);
+		const bool passed = sFailures == failures;
+		printf("%-20s %s\n", test.name, passed ? "ok" : "FAILED");
+		if (!passed)
+			failed++;
+	}
+
+#ifdef __HAIKU__
+	unload_translator(addOn, sTranslator);
+#endif
+	return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -6,17 +6,39 @@
 #include "jxltranslator.h"
 
 #include <Alignment.h>
+#include <Autolock.h>
 #include <Catalog.h>
+#include <Directory.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <OS.h>
+#include <Path.h>
 #include <Translator.h>
 #include <TranslatorFormats.h>
 #include <TranslationDefs.h>
 #include <syslog.h>
-#include <vector>
 
-#include <jxl/decode.h>
-#include <jxl/encode.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
 
+#include "codecpool.h"
 #include "configview.h"
+#include "contenthash.h"
+#include "eventtrace.h"
+#include "imageanalysis.h"
+#include "jxlcodec.h"
+#include "jxllibrary.h"
+#include "jxlmetadata.h"
+#include "orientation.h"
+#include "positionio.h"
+#include "translationmetrics.h"
+#include "translationmonitor.h"
 #include "TranslatorSettings.h"
 
 #undef B_TRANSLATION_CONTEXT
@@ -38,7 +60,19 @@ static const translation_format sOutputFormats[] = {
 
 static const TranSetting sDefaultSettings[] = {
 	{JXL_SETTING_DISTANCE, TRAN_SETTING_INT32, JXL_DEFAULT_DISTANCE},
-	{JXL_SETTING_EFFORT, TRAN_SETTING_INT32, JXL_DEFAULT_EFFORT}	
+	{JXL_SETTING_EFFORT, TRAN_SETTING_INT32, JXL_DEFAULT_EFFORT},
+	{JXL_SETTING_DECODING_SPEED, TRAN_SETTING_INT32, JXL_DEFAULT_DECODING_SPEED},
+	{JXL_SETTING_PROGRESSIVE, TRAN_SETTING_BOOL, JXL_DEFAULT_PROGRESSIVE},
+	{JXL_SETTING_PREVIEW, TRAN_SETTING_BOOL, JXL_DEFAULT_PREVIEW},
+	{JXL_SETTING_TIME_BUDGET, TRAN_SETTING_INT32, 0},
+	{JXL_SETTING_SIZE_BUDGET, TRAN_SETTING_INT32, 0},
+	{JXL_SETTING_CACHE_SIZE, TRAN_SETTING_INT32, JXL_DEFAULT_CACHE_SIZE},
+	{JXL_SETTING_MEMORY_CACHE_SIZE, TRAN_SETTING_INT32,
+		JXL_DEFAULT_MEMORY_CACHE_SIZE},
+	{JXL_SETTING_ENCODE_CACHE_SIZE, TRAN_SETTING_INT32, 0},
+	{JXL_SETTING_MEMORY_BUDGET, TRAN_SETTING_INT32, 0},
+	{JXL_SETTING_METRICS, TRAN_SETTING_BOOL, false},
+	{JXL_SETTING_TRACE, TRAN_SETTING_BOOL, false}
 };
 
 static const char sJXLHeader[] = { (char)0xff, 0x0a };
@@ -57,12 +91,23 @@ JXLTranslator::JXLTranslator()
 		sOutputFormats, kNumOutputFormats,
 		JXL_TRANSLATOR_SETTINGS,
 		sDefaultSettings, kNumDefaultSettings,
-		B_TRANSLATOR_BITMAP, JXL_FORMAT)
+		B_TRANSLATOR_BITMAP, JXL_FORMAT),
+	fThumbnailCache("thumbnails"),
+	fEncodeCache("encodes"),
+	fCacheSize(-1),
+	fMemoryCacheSize(-1),
+	fEncodeCacheSize(-1),
+	fThreadPoolLock("JXLTranslator thread pool"),
+	fThreadPool(NULL),
+	fBatchJobs(0)
 {
+	UpdateCacheSizes();
 }
 
 JXLTranslator::~JXLTranslator()
 {
+	trace_finish();
+	delete fThreadPool;
 }
 
 status_t
@@ -71,13 +116,17 @@ JXLTranslator::IdentifyJXL(BPositionIO *inSource, translator_info *outInfo)
 	off_t position;
 	position = inSource->Position();
 	char header[8];
-	status_t err = inSource->Read(header, 8);
+	ssize_t err = inSource->Read(header, 8);
 	inSource->Seek(position, SEEK_SET);
 	if (err < B_OK)
 		return err;
-		
-	if (memcmp(header, sJXLHeader, sizeof(sJXLHeader)) ||
-		memcmp(header, sJPEGCompatHeader, sizeof(sJPEGCompatHeader)))
+	if (err < (ssize_t)sizeof(sJXLHeader))
+		return B_NO_TRANSLATOR;
+
+	// only the magic bytes are checked, so this never needs libjxl
+	if (memcmp(header, sJXLHeader, sizeof(sJXLHeader)) == 0 ||
+		(err == (ssize_t)sizeof(sJPEGCompatHeader) &&
+		memcmp(header, sJPEGCompatHeader, sizeof(sJPEGCompatHeader)) == 0))
 	{
 		outInfo->type = JXL_FORMAT;
 		outInfo->group = B_TRANSLATOR_BITMAP;
@@ -99,205 +148,806 @@ JXLTranslator::DerivedIdentify(BPositionIO* inSource, const translation_format*
 	return IdentifyJXL(inSource, outInfo);	
 }
 
-status_t
-JxlMemoryToPixels(const uint8_t *next_in, size_t size, size_t *stride,
-                           size_t *xsize, size_t *ysize, int *has_alpha, uint8 *& pixels) {
-  JxlDecoder *dec = JxlDecoderCreate(NULL);
-  if (!dec) {
-    syslog(LOG_ERR, "JxlDecoderCreate failed\n");
-    return B_ERROR;
-  }
-  *has_alpha = 1; //we always create RGBA32 currently, see format below
-  if (JXL_DEC_SUCCESS !=
-      JxlDecoderSubscribeEvents(dec, JXL_DEC_BASIC_INFO | JXL_DEC_FULL_IMAGE)) {
-    syslog(LOG_ERR, "JxlDecoderSubscribeEvents failed\n");
-    JxlDecoderDestroy(dec);
-    return B_ERROR;
-  }
-
-  JxlBasicInfo info;
-  int success = 0;
-  JxlPixelFormat format = {4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0};
-  JxlDecoderSetInput(dec, next_in, size);
-
-  for (;;) {
-    JxlDecoderStatus status = JxlDecoderProcessInput(dec);
-
-    if (status == JXL_DEC_ERROR) {
-      syslog(LOG_ERR, "Decoder error\n");
-      break;
-    } else if (status == JXL_DEC_NEED_MORE_INPUT) {
-      syslog(LOG_ERR, "Error, already provided all input\n");
-      break;
-    } else if (status == JXL_DEC_BASIC_INFO) {
-      if (JXL_DEC_SUCCESS != JxlDecoderGetBasicInfo(dec, &info)) {
-        syslog(LOG_ERR, "JxlDecoderGetBasicInfo failed\n");
-        break;
-      }
-      *xsize = info.xsize;
-      *ysize = info.ysize;
-      *stride = info.xsize * 4;
-    } else if (status == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
-      size_t buffer_size;
-      if (JXL_DEC_SUCCESS !=
-          JxlDecoderImageOutBufferSize(dec, &format, &buffer_size)) {
-        syslog(LOG_ERR, "JxlDecoderImageOutBufferSize failed\n");
-        break;
-      }
-      if (buffer_size != *stride * *ysize) {
-        syslog(LOG_ERR, "Invalid out buffer size %zu %zu\n", buffer_size, *stride * *ysize);
-        break;
-      }
-      size_t pixels_buffer_size = buffer_size * sizeof(uint8_t);
-      pixels = (uint8*)malloc(pixels_buffer_size);
-      void *pixels_buffer = (void *)pixels;
-      if (JXL_DEC_SUCCESS != JxlDecoderSetImageOutBuffer(dec, &format,
-                                                         pixels_buffer,
-                                                         pixels_buffer_size)) {
-        syslog(LOG_ERR, "JxlDecoderSetImageOutBuffer failed\n");
-        break;
-      }
-    } else if (status == JXL_DEC_FULL_IMAGE) {
-      // This means the decoder has decoded all pixels into the buffer.
-      success = 1;
-      break;
-    } else if (status == JXL_DEC_SUCCESS) {
-      syslog(LOG_ERR, "Decoding finished before receiving pixel data\n");
-      break;
-    } else {
-      syslog(LOG_ERR, "Unexpected decoder status: %d\n", status);
-      break;
-    }
-  }
-  JxlDecoderDestroy(dec);
-
-  if (success){
-    return B_OK;
-  } else {
-    free(pixels);
-    return B_ERROR;
-  }
+// #pragma mark - encode budgets
+
+
+static const int32 kMinEffort = 1;
+static const int32 kMaxEffort = 9;
+static const int32 kCalibrationSize = 256;
+static const int32 kProxyPixels = 256 * 1024;
+static const float kMaxDistance = 15;
+
+// Candidate distances tried on the proxy when searching for a size budget,
+// from best to worst quality
+static const float sBudgetDistances[] = {
+	0, 0.5, 1, 1.5, 2, 3, 4, 5.5, 7.5, 10, 15
+};
+
+const uint32 kNumBudgetDistances
+	= sizeof(sBudgetDistances) / sizeof(sBudgetDistances[0]);
+
+// Milliseconds per megapixel for each effort, measured once per machine
+// and kept in JXL_CALIBRATION_FILE. Index 0 is lossy, 1 is lossless.
+static float sMsPerMegapixel[2][kMaxEffort + 1];
+static bool sCalibrated[2];
+static bool sCalibrationLoaded;
+static BLocker sCalibrationLock("JXLTranslator calibration");
+
+
+static void
+fill_calibration_image(uint8* pixels, int32 size)
+{
+	// smooth gradients with some deterministic texture, roughly the
+	// workload of a photo
+	uint32 seed = 0x2545F491;
+	for (int32 y = 0; y < size; y++) {
+		for (int32 x = 0; x < size; x++) {
+			seed = seed * 1664525 + 1013904223;
+			uint8 noise = (seed >> 24) & 0x1f;
+			uint8* pixel = pixels + (y * size + x) * 3;
+			pixel[0] = (x * 255 / size) ^ noise;
+			pixel[1] = (y * 255 / size) + noise;
+			pixel[2] = ((x + y) * 127 / size) - noise;
+		}
+	}
 }
 
-status_t
-JXLTranslator::BitmapPixelsToJxl(uint8* pixels, size_t size, int xsize, int ysize, uint32 bpp, int alphabits, uint32 align, BPositionIO* out)
+
+static status_t
+calibration_path(BPath* path)
 {
-	if (bpp == 4 && alphabits == 0)
-	{
-		// JPEG-XL doesn't accept this combination, truncate
-		for (int i = 0; i < xsize * ysize; i++)
-		{
-			pixels[i*3] = pixels[i*4+2];
-			pixels[i*3+1] = pixels[i*4+1];
-			pixels[i*3+2] = pixels[i*4];
+	status_t err = find_directory(B_USER_SETTINGS_DIRECTORY, path);
+	if (err != B_OK)
+		return err;
+	return path->Append(JXL_CALIBRATION_FILE);
+}
+
+
+static void
+load_calibration(const JxlLibrary* jxl)
+{
+	BPath path;
+	BFile file;
+	BMessage msg;
+	if (calibration_path(&path) != B_OK
+		|| file.SetTo(path.Path(), B_READ_ONLY) != B_OK
+		|| msg.Unflatten(&file) != B_OK)
+		return;
+
+	int32 version;
+	if (msg.FindInt32("version", &version) != B_OK
+		|| (uint32)version != jxl->EncoderVersion())
+		return;
+
+	const char* names[2] = { "lossy", "lossless" };
+	for (int32 mode = 0; mode < 2; mode++) {
+		bool complete = true;
+		for (int32 effort = kMinEffort; effort <= kMaxEffort; effort++) {
+			if (msg.FindFloat(names[mode], effort,
+					&sMsPerMegapixel[mode][effort]) != B_OK)
+				complete = false;
 		}
-		size = xsize * ysize * 3;
-		bpp = 3;
-	}
-
-	JxlEncoder *enc = JxlEncoderCreate(NULL);
-	JxlPixelFormat pixel_format = {bpp, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, align};
-	
-	JxlBasicInfo basic_info;
-	JxlEncoderInitBasicInfo(&basic_info);
-	basic_info.xsize = xsize;
-	basic_info.ysize = ysize;
-	basic_info.bits_per_sample = 8;
-	basic_info.orientation = JXL_ORIENT_IDENTITY;
-	basic_info.num_color_channels = bpp;
-	basic_info.num_extra_channels = alphabits > 0 ? 1 : 0;
-	basic_info.alpha_bits = alphabits;
-	
-	if (JXL_ENC_SUCCESS != JxlEncoderSetBasicInfo(enc, &basic_info))
-	{
-		syslog(LOG_ERR, "JxlEncoderSetBasicInfo failed\n");	
-		JxlEncoderDestroy(enc);
-		return B_ERROR;
-	}
-
-	int32 distance = fSettings->SetGetInt32(JXL_SETTING_DISTANCE);
-	JxlEncoderOptions *options = JxlEncoderOptionsCreate(enc, NULL);
-	JxlEncoderOptionsSetEffort(options, fSettings->SetGetInt32(JXL_SETTING_EFFORT));
-	JxlEncoderOptionsSetDistance(options, (float)distance);
-	if (distance == 0)
-		JxlEncoderOptionsSetLossless(options, JXL_TRUE);
-	JxlColorEncoding color_encoding;
-	memset(&color_encoding, 0, sizeof(JxlColorEncoding));
-	JxlColorEncodingSetToSRGB(&color_encoding, bpp == 1);
-
-	if (JXL_ENC_SUCCESS != JxlEncoderSetColorEncoding(enc, &color_encoding))
-	{
-		syslog(LOG_ERR, "JxlEncoderSetColorEncoding failed\n");	
-		JxlEncoderDestroy(enc);
-		return B_ERROR;
+		sCalibrated[mode] = complete;
 	}
+}
 
-	if (JXL_ENC_SUCCESS != 
-		JxlEncoderAddImageFrame(options, &pixel_format, (void*)pixels, size))
-	{
-		syslog(LOG_ERR, "JxlEncoderAddImageFrame failed\n");
-		JxlEncoderDestroy(enc);
-		return B_ERROR;
+
+static void
+save_calibration(const JxlLibrary* jxl)
+{
+	BMessage msg;
+	msg.AddInt32("version", jxl->EncoderVersion());
+	const char* names[2] = { "lossy", "lossless" };
+	for (int32 mode = 0; mode < 2; mode++) {
+		if (!sCalibrated[mode])
+			continue;
+		// pad the unused low efforts so the index matches the effort
+		for (int32 effort = 0; effort <= kMaxEffort; effort++)
+			msg.AddFloat(names[mode], sMsPerMegapixel[mode][effort]);
 	}
-	ssize_t written;
-	uint8* output = new uint8[4096];
 
-	size_t availOut;
-	JxlEncoderStatus process_result = JXL_ENC_NEED_MORE_OUTPUT;
-	while (process_result == JXL_ENC_NEED_MORE_OUTPUT)
+	BPath path;
+	BFile file;
+	if (calibration_path(&path) != B_OK
+		|| file.SetTo(path.Path(),
+			B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE) != B_OK)
+		return;
+	msg.Flatten(&file);
+}
+
+
+// Returns the calibrated encode speed table for lossy or lossless encoding,
+// measuring it on a synthetic image the first time it is needed. That is
+// done on the threads of monitor, as the encodes it predicts are, and
+// without holding the lock, so other translations aren't kept waiting.
+static const float*
+encode_speed_table(const JxlLibrary* jxl, bool lossless,
+	const CodecMonitor* monitor)
+{
+	const int32 mode = lossless ? 1 : 0;
 	{
-		availOut = 4096;
-		uint8* nextOut = output;
-		process_result = JxlEncoderProcessOutput(enc, &nextOut, &availOut);
-		
-		written = out->Write(output, 4096-availOut);
-		if (written < B_OK)
-		{
-			syslog(LOG_ERR, "Data write failed %d\n", written);
-			delete[] output;
-			return written;
+		BAutolock locker(sCalibrationLock);
+		if (!sCalibrationLoaded) {
+			load_calibration(jxl);
+			sCalibrationLoaded = true;
 		}
-		if (written != (ssize_t)(4096 - availOut))
-		{
-			syslog(LOG_ERR, "Data write IO Error\n");
-			delete[] output;
-			return B_IO_ERROR;
+		if (sCalibrated[mode])
+			return sMsPerMegapixel[mode];
+	}
+
+	const size_t size = kCalibrationSize * kCalibrationSize * 3;
+	uint8* pixels = new(std::nothrow) uint8[size];
+	if (pixels == NULL)
+		return NULL;
+	fill_calibration_image(pixels, kCalibrationSize);
+
+	CodecMonitor runner;
+	if (monitor != NULL)
+		runner.Follow(monitor);
+	float speed[kMaxEffort + 1] = {};
+	const float megapixels = kCalibrationSize * kCalibrationSize / 1e6f;
+	for (int32 effort = kMinEffort; effort <= kMaxEffort; effort++) {
+		EncodeParameters params = { lossless ? 0.0f : 1.0f, effort, 0, false,
+			false, 0, &runner, NULL };
+		MemoryOutput sink;
+		bigtime_t start = system_time();
+		if (EncodePixels(jxl, pixels, kCalibrationSize, kCalibrationSize, 3,
+				params, &sink) != B_OK) {
+			delete[] pixels;
+			return NULL;
+		}
+		speed[effort] = (system_time() - start) / 1000.0f / megapixels;
+	}
+	delete[] pixels;
+
+	// the first translation to finish measuring sets the table
+	BAutolock locker(sCalibrationLock);
+	if (!sCalibrated[mode]) {
+		memcpy(sMsPerMegapixel[mode], speed, sizeof(speed));
+		sCalibrated[mode] = true;
+		save_calibration(jxl);
+	}
+	return sMsPerMegapixel[mode];
+}
+
+
+// Picks the highest effort that is expected to finish within the given time
+static int32
+effort_for_time_budget(const JxlLibrary* jxl, int xsize, int ysize,
+	bool lossless, int32 budgetMs, int32 maxEffort,
+	const CodecMonitor* monitor)
+{
+	const float* speed = encode_speed_table(jxl, lossless, monitor);
+	if (speed == NULL)
+		return maxEffort;
+
+	const float megapixels = (float)xsize * ysize / 1e6f;
+	int32 effort = kMinEffort;
+	for (int32 i = kMinEffort; i <= maxEffort; i++) {
+		if (speed[i] * megapixels <= budgetMs)
+			effort = i;
+	}
+	return effort;
+}
+
+
+// Box filters the image down by an integer factor so it has at most
+// kProxyPixels pixels. Returns NULL if the image is small enough as it is.
+static uint8*
+make_proxy(const uint8* pixels, int xsize, int ysize, uint32 channels,
+	int* proxyXSize, int* proxyYSize, uint32* factor)
+{
+	uint32 scale = 1;
+	while ((int64)(xsize / scale) * (ysize / scale) > kProxyPixels)
+		scale++;
+	*factor = scale;
+	if (scale == 1)
+		return NULL;
+
+	int outX = xsize / scale;
+	int outY = ysize / scale;
+	uint8* proxy = new(std::nothrow) uint8[(size_t)outX * outY * channels];
+	if (proxy == NULL)
+		return NULL;
+
+	const uint32 area = scale * scale;
+	for (int y = 0; y < outY; y++) {
+		for (int x = 0; x < outX; x++) {
+			for (uint32 c = 0; c < channels; c++) {
+				uint32 sum = 0;
+				for (uint32 dy = 0; dy < scale; dy++) {
+					const uint8* row = pixels
+						+ ((size_t)(y * scale + dy) * xsize + x * scale) * channels;
+					for (uint32 dx = 0; dx < scale; dx++)
+						sum += row[dx * channels + c];
+				}
+				proxy[((size_t)y * outX + x) * channels + c] = sum / area;
+			}
+		}
+	}
+	*proxyXSize = outX;
+	*proxyYSize = outY;
+	return proxy;
+}
+
+
+// The trial encodes of a size budget search. The translation's thread
+// and tasks queued on its pool take them in turn. Those tasks may only
+// start once the search is over, so they share the struct.
+struct DistanceTrial {
+	const JxlLibrary*	jxl;
+	const uint8*		pixels;
+	int					xsize;
+	int					ysize;
+	uint32				channels;
+	EncodeParameters	params;
+	CodecMonitor		monitor;
+		// follows the translation's, see CodecMonitor::Follow()
+	std::atomic<uint32>	next;
+	std::mutex			lock;
+	std::condition_variable finished;
+	uint32				done;
+	off_t				sizes[kNumBudgetDistances];
+};
+
+
+static void
+run_distance_trials(DistanceTrial* trial)
+{
+	for (;;) {
+		uint32 index = trial->next.fetch_add(1);
+		if (index >= kNumBudgetDistances)
+			break;
+
+		EncodeParameters params = trial->params;
+		params.distance = sBudgetDistances[index];
+		MemoryOutput sink;
+		const off_t size = EncodePixels(trial->jxl, trial->pixels,
+			trial->xsize, trial->ysize, trial->channels, params, &sink) == B_OK
+				? sink.BufferLength() : -1;
+
+		std::lock_guard<std::mutex> lock(trial->lock);
+		trial->sizes[index] = size;
+		if (++trial->done == kNumBudgetDistances)
+			trial->finished.notify_all();
+	}
+}
+
+
+static void
+run_distance_trials_task(void* data)
+{
+	std::shared_ptr<DistanceTrial>* trial
+		= (std::shared_ptr<DistanceTrial>*)data;
+	run_distance_trials(trial->get());
+	delete trial;
+}
+
+
+// Searches for the smallest distance whose output is expected to fit in
+// the given number of bytes, using trial encodes of a downscaled proxy
+static float
+distance_for_size_budget(const JxlLibrary* jxl, const uint8* pixels,
+	int xsize, int ysize, uint32 channels, const EncodeParameters& params,
+	off_t budget)
+{
+	int proxyX = xsize, proxyY = ysize;
+	uint32 factor;
+	uint8* proxy = make_proxy(pixels, xsize, ysize, channels, &proxyX, &proxyY,
+		&factor);
+
+	DistanceTrial* trialData = new(std::nothrow) DistanceTrial;
+	if (trialData == NULL) {
+		delete[] proxy;
+		return params.distance;
+	}
+	std::shared_ptr<DistanceTrial> trial(trialData);
+	trial->jxl = jxl;
+	trial->pixels = proxy != NULL ? proxy : pixels;
+	trial->xsize = proxyX;
+	trial->ysize = proxyY;
+	trial->channels = channels;
+	trial->params = params;
+	trial->params.metrics = NULL;
+	trial->params.monitor = NULL;
+	if (params.monitor != NULL) {
+		trial->monitor.Follow(params.monitor);
+		trial->params.monitor = &trial->monitor;
+	}
+	trial->next = 0;
+	trial->done = 0;
+
+	CodecThreadPool* pool = trial->monitor.ThreadPool();
+	const uint32 helpers = pool != NULL
+		? std::min(kNumBudgetDistances - 1, pool->CountThreads()) : 0;
+	for (uint32 i = 0; i < helpers; i++) {
+		std::shared_ptr<DistanceTrial>* data
+			= new(std::nothrow) std::shared_ptr<DistanceTrial>(trial);
+		if (data == NULL)
+			break;
+		pool->AddTask(run_distance_trials_task, data);
+	}
+	run_distance_trials(trial.get());
+	{
+		// the pixels may only go once no trial is using them
+		std::unique_lock<std::mutex> lock(trial->lock);
+		while (trial->done < kNumBudgetDistances)
+			trial->finished.wait(lock);
+	}
+	delete[] proxy;
+
+	// A downscaled proxy has more detail per pixel than the original, so
+	// scaling its size by the pixel count overestimates the final size.
+	const double scale = (double)xsize * ysize / ((double)proxyX * proxyY);
+	for (uint32 i = 0; i < kNumBudgetDistances; i++) {
+		if (trial->sizes[i] >= 0 && trial->sizes[i] * scale <= budget)
+			return sBudgetDistances[i];
+	}
+	return kMaxDistance;
+}
+
+
+// A setting as given in ioExtension, or else as saved
+int32
+JXLTranslator::SettingInt32(BMessage* ioExtension, const char* name)
+{
+	int32 value;
+	if (ioExtension != NULL && ioExtension->FindInt32(name, &value) == B_OK)
+		return value;
+	return fSettings->SetGetInt32(name);
+}
+
+
+bool
+JXLTranslator::SettingBool(BMessage* ioExtension, const char* name)
+{
+	bool value;
+	if (ioExtension != NULL && ioExtension->FindBool(name, &value) == B_OK)
+		return value;
+	return fSettings->SetGetBool(name);
+}
+
+
+// Whether a cache is used for this translation. The caches are shared, so
+// ioExtension can only leave one out by setting its size to 0; a saved
+// size of 0 turns it off for all.
+bool
+JXLTranslator::CacheEnabled(BMessage* ioExtension, const char* name)
+{
+	int32 value;
+	if (ioExtension != NULL && ioExtension->FindInt32(name, &value) == B_OK
+		&& value <= 0)
+		return false;
+	return fSettings->SetGetInt32(name) > 0;
+}
+
+
+// Sizes the caches from the saved settings when they were loaded or have
+// changed since
+void
+JXLTranslator::UpdateCacheSizes()
+{
+	const int32 cacheSize = fSettings->SetGetInt32(JXL_SETTING_CACHE_SIZE);
+	if (fCacheSize.exchange(cacheSize) != cacheSize)
+		fThumbnailCache.SetMaxSize((off_t)cacheSize * 1024 * 1024);
+	const int32 memoryCacheSize = fSettings->SetGetInt32(
+		JXL_SETTING_MEMORY_CACHE_SIZE);
+	if (fMemoryCacheSize.exchange(memoryCacheSize) != memoryCacheSize)
+		fDecodeCache.SetMaxSize((size_t)memoryCacheSize * 1024 * 1024);
+	const int32 encodeCacheSize = fSettings->SetGetInt32(
+		JXL_SETTING_ENCODE_CACHE_SIZE);
+	if (fEncodeCacheSize.exchange(encodeCacheSize) != encodeCacheSize)
+		fEncodeCache.SetMaxSize((off_t)encodeCacheSize * 1024 * 1024);
+}
+
+
+void
+JXLTranslator::ReadEncodeParameters(BMessage* ioExtension,
+	EncodeParameters* params)
+{
+	params->distance = SettingInt32(ioExtension, JXL_SETTING_DISTANCE);
+	params->effort = SettingInt32(ioExtension, JXL_SETTING_EFFORT);
+	params->decodingSpeed = SettingInt32(ioExtension,
+		JXL_SETTING_DECODING_SPEED);
+	params->progressive = SettingBool(ioExtension, JXL_SETTING_PROGRESSIVE);
+	params->preview = SettingBool(ioExtension, JXL_SETTING_PREVIEW);
+	params->paletteColors = 0;
+	params->monitor = NULL;
+	params->metrics = NULL;
+}
+
+status_t
+JXLTranslator::BitmapPixelsToJxl(const uint8* pixels, int xsize, int ysize,
+	uint32 channels, const ImageAnalysis& analysis, BMessage* ioExtension,
+	TranslationMonitor* monitor, BPositionIO* out)
+{
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL)
+		return B_MISSING_LIBRARY;
+
+	EncodeParameters params;
+	ReadEncodeParameters(ioExtension, &params);
+	params.monitor = monitor;
+
+	int32 timeBudget = SettingInt32(ioExtension, JXL_SETTING_TIME_BUDGET);
+	int32 sizeBudget = SettingInt32(ioExtension, JXL_SETTING_SIZE_BUDGET);
+
+	// The same bitmap is often saved again unchanged. The key covers
+	// everything the output depends on, so a hit also skips the budget
+	// searches.
+	UpdateCacheSizes();
+	const bool useCache = CacheEnabled(ioExtension,
+		JXL_SETTING_ENCODE_CACHE_SIZE);
+	uint64 cacheKey = 0;
+	if (useCache) {
+		const uint32 settings[] = { (uint32)xsize, (uint32)ysize, channels,
+			(uint32)params.distance, (uint32)params.effort,
+			(uint32)params.decodingSpeed, params.progressive, params.preview,
+			(uint32)timeBudget, (uint32)sizeBudget, jxl->EncoderVersion() };
+		cacheKey = content_hash(pixels, (size_t)xsize * ysize * channels,
+			content_hash(settings, sizeof(settings), 0));
+
+		std::vector<uint8> cached;
+		if (fEncodeCache.Lookup(cacheKey, cached)
+			&& cached.size() > sizeof(float) + sizeof(int32)) {
+			// the distance and effort used, followed by the file
+			memcpy(&params.distance, cached.data(), sizeof(float));
+			memcpy(&params.effort, cached.data() + sizeof(float),
+				sizeof(int32));
+			if (ioExtension != NULL) {
+				ioExtension->RemoveName(JXL_EXT_USED_DISTANCE);
+				ioExtension->RemoveName(JXL_EXT_USED_EFFORT);
+				ioExtension->AddFloat(JXL_EXT_USED_DISTANCE, params.distance);
+				ioExtension->AddInt32(JXL_EXT_USED_EFFORT, params.effort);
+			}
+			size_t headerSize = sizeof(float) + sizeof(int32);
+			PhaseTimer timer(monitor->Metrics(), PHASE_WRITE);
+			return out->WriteExactly(cached.data() + headerSize,
+				cached.size() - headerSize);
 		}
 	}
-	delete[] output;
-	if (JXL_ENC_SUCCESS != process_result)
+
+	if (timeBudget > 0) {
+		params.effort = effort_for_time_budget(jxl, xsize, ysize,
+			params.distance == 0, timeBudget, kMaxEffort, monitor);
+	}
+	if (sizeBudget > 0) {
+		params.distance = distance_for_size_budget(jxl, pixels, xsize, ysize,
+			channels, params, (off_t)sizeBudget * 1024);
+	}
+	if (params.distance == 0 && analysis.numColors > 0)
+		params.paletteColors = analysis.numColors;
+
+	if (ioExtension != NULL) {
+		ioExtension->RemoveName(JXL_EXT_USED_DISTANCE);
+		ioExtension->RemoveName(JXL_EXT_USED_EFFORT);
+		ioExtension->AddFloat(JXL_EXT_USED_DISTANCE, params.distance);
+		ioExtension->AddInt32(JXL_EXT_USED_EFFORT, params.effort);
+	}
+
+	if (!useCache) {
+		params.metrics = monitor->Metrics();
+		PositionIOOutput output(out);
+		return EncodePixels(jxl, pixels, xsize, ysize, channels, params,
+			&output);
+	}
+
+	MemoryOutput encoded;
+	encoded.Write(&params.distance, sizeof(float));
+	encoded.Write(&params.effort, sizeof(int32));
+	status_t status = EncodePixels(jxl, pixels, xsize, ysize, channels, params,
+		&encoded);
+	if (status != B_OK)
+		return status;
+	fEncodeCache.Store(cacheKey, encoded.Buffer(), encoded.BufferLength());
+	size_t headerSize = sizeof(float) + sizeof(int32);
+	PhaseTimer timer(monitor->Metrics(), PHASE_WRITE);
+	return out->WriteExactly(encoded.Buffer() + headerSize,
+		encoded.BufferLength() - headerSize);
+}
+
+// Fills in a B_RGBA32 bitmap header, if its size fits in one
+static status_t
+MakeBitmapHeader(TranslatorBitmap* header, uint32 xsize, uint32 ysize)
+{
+	if (!FitsBitmap(xsize, ysize)) {
+		syslog(LOG_ERR, "A %ux%u image is too big for a bitmap\n", xsize,
+			ysize);
+		return B_NO_TRANSLATOR;
+	}
+	const uint32 rowBytes = xsize * 4;
+	header->magic = B_HOST_TO_BENDIAN_INT32(B_TRANSLATOR_BITMAP);
+	header->bounds.left = B_HOST_TO_BENDIAN_FLOAT(0);
+	header->bounds.top = B_HOST_TO_BENDIAN_FLOAT(0);
+	header->bounds.right = B_HOST_TO_BENDIAN_FLOAT(xsize - 1.0f);
+	header->bounds.bottom = B_HOST_TO_BENDIAN_FLOAT(ysize - 1.0f);
+	header->colors = (color_space)B_HOST_TO_BENDIAN_INT32(B_RGBA32);
+	header->rowBytes = B_HOST_TO_BENDIAN_INT32(rowBytes);
+	header->dataSize = B_HOST_TO_BENDIAN_INT32(rowBytes * ysize);
+	return B_OK;
+}
+
+// Starts a streamed decode
+static status_t
+WriteBitmapHeader(CodecOutput* out, uint32 xsize, uint32 ysize)
+{
+	TranslatorBitmap header;
+	status_t status = MakeBitmapHeader(&header, xsize, ysize);
+	if (status != B_OK)
+		return status;
+	return out->WriteExactly(&header, sizeof(header));
+}
+
+// #pragma mark - Memory budget
+
+// A budget of 0 means half of the physical memory. Jobs of a batch share
+// it between them.
+uint64
+JXLTranslator::MemoryBudget() const
+{
+	const uint64 jobs = std::max(fBatchJobs.load(), 1);
+	int32 budget = fSettings->SetGetInt32(JXL_SETTING_MEMORY_BUDGET);
+	if (budget > 0)
+		return (uint64)budget * 1024 * 1024 / jobs;
+
+	system_info info;
+	if (get_system_info(&info) != B_OK)
+		return (uint64)1024 * 1024 * 1024 / jobs;
+	return (uint64)info.max_pages * B_PAGE_SIZE / 2 / jobs;
+}
+
+// One thread per core; codecs add their own thread to the groups they run
+CodecThreadPool*
+JXLTranslator::ThreadPool()
+{
+	BAutolock locker(fThreadPoolLock);
+	if (fThreadPool == NULL) {
+		fThreadPool = new CodecThreadPool(
+			std::max(1u, std::thread::hardware_concurrency()));
+	}
+	return fThreadPool;
+}
+
+status_t
+JXLTranslator::DerivedCanHandleImageSize(float width, float height) const
+{
+	if (width < 1 || height < 1 || width > kMaxImageSide
+		|| height > kMaxImageSide)
+		return B_NO_TRANSLATOR;
+	// anything at all can be encoded in chunks
+	if (StreamingEncodeMemory((uint32)width) > MemoryBudget())
+		return B_NO_MEMORY;
+	return B_OK;
+}
+
+// #pragma mark -
+
+// Mixed into the cache key of preview decodes, so they don't replace the
+// full decode of the same file
+const uint64 kPreviewCacheKey = 0x9e3779b97f4a7c15ULL;
+
+// Mixed into the cache key of full decodes times the tone curve
+const uint64 kToneCurveCacheKey = 0xc2b2ae3d27d4eb4fULL;
+// Seeds the hash of the output profile, which is mixed in as well
+const uint64 kProfileCacheSeed = 0x165667b19e3779f9ULL;
+// Mixed in times the output orientation, 0 being the image's own
+const uint64 kOrientationCacheKey = 0x27d4eb2f165667c5ULL;
+
+// The codec's tone curves and preview sources are passed on as they are
+static_assert(TONE_CURVE_NONE == JXL_TONE_CURVE_NONE
+	&& TONE_CURVE_CLIP == JXL_TONE_CURVE_CLIP
+	&& TONE_CURVE_REINHARD == JXL_TONE_CURVE_REINHARD
+	&& TONE_CURVE_ACES == JXL_TONE_CURVE_ACES
+	&& kNumToneCurves == JXL_TONE_CURVE_ACES + 1,
+	"tone curves don't match");
+static_assert(PREVIEW_NONE == JXL_PREVIEW_NONE
+	&& PREVIEW_EMBEDDED == JXL_PREVIEW_EMBEDDED
+	&& PREVIEW_DOWNSCALED == JXL_PREVIEW_DOWNSCALED,
+	"preview sources don't match");
+
+// The key of a decode in the memory cache. Previews aren't tone mapped.
+static uint64
+DecodeCacheKey(uint64 contentKey, bool preview, int32 curve,
+	int32 orientation, uint64 profileKey)
+{
+	uint64 key = preview ? contentKey ^ kPreviewCacheKey
+		: contentKey ^ (kToneCurveCacheKey * curve);
+	return key ^ (kOrientationCacheKey * orientation) ^ profileKey;
+}
+
+// Writes a bitmap from the decode caches. If ioExtension is given, the
+// preview source is returned in it.
+static status_t
+WriteCachedBitmap(const std::vector<uint8>& entry, BMessage* ioExtension,
+	BPositionIO* out)
+{
+	int32 source;
+	memcpy(&source, entry.data(), sizeof(source));
+	size_t size = entry.size() - sizeof(source);
+	ssize_t written = out->Write(entry.data() + sizeof(source), size);
+	if (written < B_OK)
+		return written;
+	if ((size_t)written != size)
+		return B_IO_ERROR;
+	if (ioExtension != NULL)
 	{
-		JxlEncoderDestroy(enc);
-	    syslog(LOG_ERR,"JxlEncoderProcessOutput failed\n");
-	    return B_ERROR;			
+		ioExtension->RemoveName(JXL_EXT_PREVIEW_SOURCE);
+		ioExtension->AddInt32(JXL_EXT_PREVIEW_SOURCE, source);
 	}
-	JxlEncoderDestroy(enc);
 	return B_OK;
 }
 
 status_t 
-JXLTranslator::Decompress(BPositionIO* in, BPositionIO* out)
+JXLTranslator::Decompress(BPositionIO* in, BMessage* ioExtension,
+	TranslationMonitor* monitor, BPositionIO* out)
 {
 	uint8_t * convertedData = NULL;
 	size_t xsize, ysize, stride;
  	int has_alpha;
+	int previewSource;
+	bool preview = false;
+	int32 curve = JXL_TONE_CURVE_NONE;
+	int32 orientation = 0;
+	const void* profile = NULL;
+	ssize_t profileSize = 0;
+	TranslationMetrics* metrics = monitor->Metrics();
+	if (ioExtension != NULL)
+	{
+		ioExtension->FindBool(JXL_EXT_PREVIEW, &preview);
+		ioExtension->FindInt32(JXL_EXT_TONE_CURVE, &curve);
+		if (ioExtension->FindInt32(JXL_EXT_OUTPUT_ORIENTATION, &orientation)
+				== B_OK && (orientation < 1 || orientation > 8))
+			return B_BAD_VALUE;
+		if (ioExtension->FindData(JXL_EXT_OUTPUT_PROFILE, B_RAW_TYPE,
+				&profile, &profileSize) != B_OK || profileSize <= 0)
+			profile = NULL;
+	}
+	if (curve < 0 || curve >= kNumToneCurves)
+		return B_BAD_VALUE;
+	DecodeParameters params;
+	params.toneCurve = (tone_curve)curve;
+	params.targetProfile = (const uint8*)profile;
+	params.targetProfileSize = profile != NULL ? profileSize : 0;
+	params.transforms = &fColorTransforms;
+	params.orientation = orientation;
+
+	// Viewers translate the same file again when going back and forth,
+	// and thumbnails of the same file are asked for over and over by
+	// different applications, so keep decodes around
+	UpdateCacheSizes();
+	const bool cacheEnabled = CacheEnabled(ioExtension,
+		JXL_SETTING_CACHE_SIZE);
+	const bool memoryCacheEnabled = CacheEnabled(ioExtension,
+		JXL_SETTING_MEMORY_CACHE_SIZE);
+	uint64 contentKey;
+	bool haveKey;
+	{
+		PhaseTimer timer(metrics, PHASE_READ);
+		haveKey = (memoryCacheEnabled || (preview && cacheEnabled))
+			&& content_key(in, &contentKey) == B_OK;
+	}
+	// the thumbnail cache is shared, so only unconverted previews go there
+	const bool useCache = haveKey && preview && cacheEnabled
+		&& profile == NULL && orientation == 0;
+	const bool useMemoryCache = haveKey && memoryCacheEnabled;
+	const uint64 profileKey = profile != NULL
+		? content_hash(profile, profileSize, kProfileCacheSeed) : 0;
+	const uint64 decodeKey = DecodeCacheKey(contentKey, preview, curve,
+		orientation, profileKey);
+
+	bool invalidate = false;
+	if (ioExtension != NULL)
+		ioExtension->FindBool(JXL_EXT_INVALIDATE_CACHE, &invalidate);
+	if (haveKey && invalidate)
+	{
+		// decodes to other profiles than this one are left to expire
+		const uint64 profileKeys[] = { 0, profileKey };
+		for (uint64 key : profileKeys)
+		{
+			for (int32 turn = 0; turn <= 8; turn++)
+			{
+				fDecodeCache.Invalidate(DecodeCacheKey(contentKey, true, 0,
+					turn, key));
+				for (int32 i = 0; i < kNumToneCurves; i++)
+				{
+					fDecodeCache.Invalidate(DecodeCacheKey(contentKey, false,
+						i, turn, key));
+				}
+			}
+		}
+	}
+	else if (useMemoryCache || useCache)
+	{
+		CacheData cached;
+		if (useMemoryCache)
+			cached = fDecodeCache.Lookup(decodeKey);
+		if (!cached && useCache)
+		{
+			std::vector<uint8> data;
+			if (fThumbnailCache.Lookup(contentKey, data))
+			{
+				cached.reset(new std::vector<uint8>(std::move(data)));
+				if (useMemoryCache)
+					fDecodeCache.Store(decodeKey, cached);
+			}
+		}
+		if (cached && cached->size() > sizeof(int32) + sizeof(TranslatorBitmap))
+		{
+			PhaseTimer timer(metrics, PHASE_WRITE);
+			return WriteCachedBitmap(*cached, preview ? ioExtension : NULL, out);
+		}
+	}
+
  	off_t inSize = in->Seek(0, SEEK_END);
  	in->Seek(0, SEEK_SET);
 
+	// Size up the image before committing to reading it all in. Too big
+	// to keep whole, it goes straight from in to out instead.
+	JxlBasicInfo info;
+	status_t err;
+	{
+		PhaseTimer timer(metrics, PHASE_READ);
+		err = read_jxl_basic_info(in, &info);
+	}
+	if (err != B_OK)
+		return err;
+	// previews are scaled down to fit
+	if (!preview && !FitsBitmap(info.xsize, info.ysize))
+	{
+		syslog(LOG_ERR, "A %ux%u image is too big for a bitmap\n",
+			info.xsize, info.ysize);
+		return B_NO_TRANSLATOR;
+	}
+	const uint64 pixels = (uint64)info.xsize * info.ysize;
+	const uint64 budget = MemoryBudget();
+	const uint64 bufferedMemory = BufferedDecodeMemory(pixels, inSize);
+	if (bufferedMemory > budget || bufferedMemory > SIZE_MAX)
+	{
+		const uint64 streamingMemory = StreamingDecodeMemory(pixels,
+			info.xsize, orientation);
+		if (preview || streamingMemory > budget)
+		{
+			syslog(LOG_ERR, "A %ux%u image needs %llu MiB, the budget is "
+				"%llu MiB\n", info.xsize, info.ysize,
+				(unsigned long long)std::min(bufferedMemory,
+					streamingMemory) >> 20,
+				(unsigned long long)budget >> 20);
+			return B_NO_MEMORY;
+		}
+		const JxlLibrary* jxl = jxl_library();
+		if (jxl == NULL)
+			return B_MISSING_LIBRARY;
+		if (metrics != NULL)
+			metrics->peakMemory = streamingMemory;
+		PositionIOInput input(in);
+		PositionIOOutput output(out);
+		return DecodeStreaming(jxl, &input, params, monitor,
+			WriteBitmapHeader, &output);
+	}
+
+	if (metrics != NULL)
+		metrics->peakMemory = bufferedMemory;
 	void * inData = malloc(inSize);
 	if (inData == NULL) {
 		syslog(LOG_ERR, "Couldn't malloc in space\n");
 		return B_NO_MEMORY;
 	}
 
-	if (in->Read(inData, inSize) != inSize)
+	ssize_t bytesRead;
+	{
+		PhaseTimer timer(metrics, PHASE_READ);
+		bytesRead = in->Read(inData, inSize);
+	}
+	if (bytesRead != inSize)
 	{
 		syslog(LOG_ERR, "Couldn't read in data\n");
 		free(inData);
 		return B_IO_ERROR;	
 	}
 
-	status_t err = JxlMemoryToPixels((uint8_t*)inData, inSize, &stride, &xsize, &ysize, &has_alpha, convertedData);
+	err = JxlMemoryToPixels((uint8_t*)inData, inSize, preview, params,
+		monitor, &stride, &xsize, &ysize, &has_alpha, &previewSource,
+		convertedData);
 	free(inData); // not needed now
 	if (err != B_OK) return err;
 	if (convertedData == NULL)
@@ -305,53 +955,154 @@ JXLTranslator::Decompress(BPositionIO* in, BPositionIO* out)
 		syslog(LOG_ERR, "Invalid pointer returned\n");
 		return B_ILLEGAL_DATA;	
 	}
-	for (size_t i = 0; i < stride * ysize; i += 4)
+	if (preview)
 	{
-		// flip r and b so the coloring is correct
-		uint8 tmp = convertedData[i];
-		convertedData[i] = convertedData[i+2];
-		convertedData[i+2] = tmp;
+		ioExtension->RemoveName(JXL_EXT_PREVIEW_SOURCE);
+		ioExtension->AddInt32(JXL_EXT_PREVIEW_SOURCE, previewSource);
 	}
-	BRect bounds(0, 0, xsize - 1, ysize - 1);
-	color_space outColorSpace = B_RGBA32;
-	size_t outSize = stride * ysize;
+	if (metrics != NULL)
+		metrics->pixels = (uint64)xsize * ysize;
 
+	// libjxl has turned the pixels already unless asked not to
+	const int32 turn = orientation != 0 ? orientation : 1;
+	size_t outXSize = xsize;
+	size_t outYSize = ysize;
+	if (orientation_transposes(turn))
+		std::swap(outXSize, outYSize);
+	size_t outSize = outXSize * 4 * outYSize;
 	TranslatorBitmap header;
-	header.magic = B_HOST_TO_BENDIAN_INT32(B_TRANSLATOR_BITMAP);
-	header.bounds.left = B_HOST_TO_BENDIAN_FLOAT(bounds.left);
-	header.bounds.top = B_HOST_TO_BENDIAN_FLOAT(bounds.top);
-	header.bounds.right = B_HOST_TO_BENDIAN_FLOAT(bounds.right);
-	header.bounds.bottom = B_HOST_TO_BENDIAN_FLOAT(bounds.bottom);
-	header.colors = (color_space)B_HOST_TO_BENDIAN_INT32(outColorSpace);
-	header.rowBytes = B_HOST_TO_BENDIAN_INT32(stride);
-	header.dataSize = B_HOST_TO_BENDIAN_INT32(outSize);
-	err = out->Write(&header, sizeof(TranslatorBitmap));
-	if (err < B_OK || err < (int)sizeof(TranslatorBitmap))
-		return B_IO_ERROR;
-
-	//write data from convertedData
-	size_t written;
-	written = out->Write(convertedData, outSize);
-	if (written < B_OK) 
+	err = MakeBitmapHeader(&header, outXSize, outYSize);
+	if (err != B_OK)
 	{
-		syslog(LOG_ERR, "Data write failed %d\n", err);
 		free(convertedData);
 		return err;
 	}
-	if (written != outSize)
+
+	// a full size copy is only worth making if the cache would keep it
+	if (useCache || (useMemoryCache && outSize <= (size_t)fMemoryCacheSize
+			* 1024 * 1024 / 4))
 	{
-		syslog(LOG_ERR, "Data write IO Error\n");					
+		// the preview source, followed by the bitmap as it is written
+		std::vector<uint8>* entry = new std::vector<uint8>(sizeof(int32)
+			+ sizeof(header) + outSize);
+		CacheData data(entry);
+		int32 source = previewSource;
+		memcpy(entry->data(), &source, sizeof(source));
+		memcpy(entry->data() + sizeof(source), &header, sizeof(header));
+		{
+			PhaseTimer timer(metrics, PHASE_CONVERT);
+			// RGBA to B_RGBA32 on the way
+			orient_pixels(convertedData, stride, 0, 0, xsize, ysize, turn, 0,
+				0, outXSize, outYSize, true,
+				entry->data() + sizeof(source) + sizeof(header),
+				outXSize * 4);
+		}
 		free(convertedData);
-		return B_IO_ERROR;
+		{
+			PhaseTimer timer(metrics, PHASE_WRITE);
+			ssize_t written = out->Write(entry->data() + sizeof(source),
+				entry->size() - sizeof(source));
+			if (written < B_OK)
+			{
+				syslog(LOG_ERR, "Data write failed %d\n", (int)written);
+				return written;
+			}
+			if ((size_t)written != entry->size() - sizeof(source))
+			{
+				syslog(LOG_ERR, "Data write IO Error\n");
+				return B_IO_ERROR;
+			}
+		}
+		if (useCache)
+			fThumbnailCache.Store(contentKey, entry->data(), entry->size());
+		if (useMemoryCache)
+			fDecodeCache.Store(decodeKey, data);
+		return B_OK;
 	}
-	
+
+	{
+		PhaseTimer timer(metrics, PHASE_WRITE);
+		err = out->Write(&header, sizeof(TranslatorBitmap));
+		if (err < B_OK || err < (int)sizeof(TranslatorBitmap))
+		{
+			free(convertedData);
+			return B_IO_ERROR;
+		}
+	}
+	PositionIOOutput output(out);
+	err = WriteOrientedPixels(convertedData, xsize, ysize, turn, metrics,
+		&output);
+	if (err != B_OK)
+		syslog(LOG_ERR, "Data write failed %d\n", (int)err);
 	free(convertedData);
-	return B_OK;
+	return err;
 }
 
 
-status_t 
-JXLTranslator::Compress(BPositionIO* in, BPositionIO* out)
+// Encodes a bitmap too big to hold in memory. The size budget and the
+// encode cache would both need the whole bitmap, so they are skipped.
+status_t
+JXLTranslator::CompressStreaming(BPositionIO* in, const PixelLayout& layout,
+	color_space space, int32 width, int32 height, uint64 rowBytes,
+	BMessage* ioExtension, TranslationMonitor* monitor, BPositionIO* out)
+{
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL)
+		return B_MISSING_LIBRARY;
+
+	PixelLayout sourceLayout;
+	PositionIOInput input(in);
+	ChunkedSource source;
+	source.in = &input;
+	source.dataOffset = in->Position();
+	source.rowBytes = rowBytes;
+	source.space = space;
+	source.layout = layout;
+	source.sourceBytesPerPixel = get_pixel_layout(space, &sourceLayout)
+		? layout.bytesPerPixel : 2;
+	source.status = B_OK;
+	source.monitor = monitor;
+
+	ImageAnalyzer analyzer(layout, width);
+	for (int32 y = 0; y < height && !analyzer.IsDone(); y += kRowBatchSize) {
+		const int32 count = std::min((int32)kRowBatchSize, height - y);
+		uint8* rows = ReadBitmapRect(&source, 0, y, width, count);
+		if (rows == NULL)
+			return source.status;
+		PhaseTimer timer(monitor->Metrics(), PHASE_CONVERT);
+		analyzer.AddRows(rows, (size_t)width * layout.bytesPerPixel, count);
+		free(rows);
+	}
+	const uint32 channels = analyzer.OutputChannels();
+	source.colorChannels = channels >= 3 ? 3 : 1;
+
+	EncodeParameters params;
+	ReadEncodeParameters(ioExtension, &params);
+	params.monitor = monitor;
+	int32 timeBudget = SettingInt32(ioExtension, JXL_SETTING_TIME_BUDGET);
+	if (timeBudget > 0) {
+		params.effort = effort_for_time_budget(jxl, width, height,
+			params.distance == 0, timeBudget, kMaxEffort, monitor);
+	}
+	if (params.distance == 0 && analyzer.Result().numColors > 0)
+		params.paletteColors = analyzer.Result().numColors;
+	if (SettingInt32(ioExtension, JXL_SETTING_SIZE_BUDGET) > 0)
+		syslog(LOG_INFO, "Size budget ignored for a streamed encode\n");
+
+	if (ioExtension != NULL) {
+		ioExtension->RemoveName(JXL_EXT_USED_DISTANCE);
+		ioExtension->RemoveName(JXL_EXT_USED_EFFORT);
+		ioExtension->AddFloat(JXL_EXT_USED_DISTANCE, params.distance);
+		ioExtension->AddInt32(JXL_EXT_USED_EFFORT, params.effort);
+	}
+	PositionIOOutput output(out);
+	return EncodeChunked(jxl, &source, width, height, channels, params,
+		&output);
+}
+
+status_t
+JXLTranslator::Compress(BPositionIO* in, BMessage* ioExtension,
+	TranslationMonitor* monitor, BPositionIO* out)
 {
 	TranslatorBitmap bmpHeader;
 	status_t err = identify_bits_header(in, NULL, &bmpHeader);
@@ -360,76 +1111,478 @@ JXLTranslator::Compress(BPositionIO* in, BPositionIO* out)
 		syslog(LOG_ERR, "Error identifying bitmap: %d\n", err);	
 		return err;
 	}
-	size_t inSize = bmpHeader.dataSize;
-	uint8* inData = new uint8[inSize];
-	if (in->Read(inData, inSize) != (ssize_t)inSize)
+
+	const int32 width = bmpHeader.bounds.IntegerWidth() + 1;
+	const int32 height = bmpHeader.bounds.IntegerHeight() + 1;
+	uint64 rowBytes = bmpHeader.rowBytes;
+	// dataSize is only 32 bits, so it can't be trusted for big bitmaps
+	const uint64 inSize = rowBytes * height;
+
+	PixelLayout layout;
+	bool expand = false;
+	if (!get_pixel_layout(bmpHeader.colors, &layout)) {
+		// 15 and 16 bit formats are widened to 8 bits per channel first
+		bool alpha = false;
+		switch (bmpHeader.colors) {
+			case B_RGBA15:
+			case B_RGBA15_BIG:
+				alpha = true;
+				break;
+			case B_RGB16:
+			case B_RGB16_BIG:
+			case B_RGB15:
+			case B_RGB15_BIG:
+				break;
+			default:
+				return B_NO_TRANSLATOR;
+		}
+		PixelLayout expandedLayout = { alpha ? 4u : 3u, 0, 1, 2,
+			alpha ? 3 : -1 };
+		layout = expandedLayout;
+		expand = true;
+	}
+
+	const uint64 pixels = (uint64)width * height;
+	TranslationMetrics* metrics = monitor->Metrics();
+	if (metrics != NULL)
+		metrics->pixels = pixels;
+	const uint64 budget = MemoryBudget();
+	const uint64 bufferedMemory = BufferedEncodeMemory(pixels, inSize,
+		expand ? layout.bytesPerPixel : 0);
+	if (bufferedMemory > budget || bufferedMemory > SIZE_MAX) {
+		const uint64 streamingMemory = StreamingEncodeMemory(width);
+		if (streamingMemory > budget) {
+			syslog(LOG_ERR, "Not enough memory to encode a %dx%d image\n",
+				(int)width, (int)height);
+			return B_NO_MEMORY;
+		}
+		if (metrics != NULL)
+			metrics->peakMemory = streamingMemory;
+		return CompressStreaming(in, layout, bmpHeader.colors, width, height,
+			rowBytes, ioExtension, monitor, out);
+	}
+
+	if (metrics != NULL)
+		metrics->peakMemory = bufferedMemory;
+	uint8* inData = new(std::nothrow) uint8[inSize];
+	if (inData == NULL)
+		return B_NO_MEMORY;
+	ssize_t bytesRead;
+	{
+		PhaseTimer timer(metrics, PHASE_READ);
+		bytesRead = in->Read(inData, inSize);
+	}
+	if (bytesRead != (ssize_t)inSize)
 	{
 		syslog(LOG_ERR, "Couldn't read in data\n");
 		delete[] inData;
 		return B_IO_ERROR;
 	}
 
-	//get bpp
-	uint32 bytesPerPixel = 0;
-	int32 alphaBits = 0;
-	switch (bmpHeader.colors) {
-		case B_RGB32:
-		case B_RGB32_BIG:
-			bytesPerPixel = 4;
-			alphaBits = 0;
-			break;
-		case B_RGBA32:
-		case B_RGBA32_BIG:
-			bytesPerPixel = 4;
-			alphaBits = 8;
-			break;
-		case B_RGB24:
-		case B_RGB24_BIG:
-			bytesPerPixel = 3;
-			break;
-		case B_RGB16:
-		case B_RGB16_BIG:
-		case B_RGB15:
-		case B_RGB15_BIG:
-			bytesPerPixel = 2;
-			break;
-		case B_RGBA15: // need alpha
-		case B_RGBA15_BIG:
-			bytesPerPixel = 2;
-			alphaBits = 1;
-			break;
-		case B_GRAY8:
-			bytesPerPixel = 1;
-			break;
-		default:
-			return B_NO_TRANSLATOR;	
+	if (expand) {
+		PhaseTimer timer(metrics, PHASE_CONVERT);
+		uint8* expanded = new(std::nothrow)
+			uint8[(size_t)width * height * layout.bytesPerPixel];
+		if (expanded == NULL) {
+			delete[] inData;
+			return B_NO_MEMORY;
+		}
+		expand_rgb16_rows(inData, rowBytes, bmpHeader.colors, width, height,
+			expanded);
+		delete[] inData;
+		inData = expanded;
+		rowBytes = (size_t)width * layout.bytesPerPixel;
 	}
-	
+
+	// Drop an opaque alpha channel and store gray images as one channel,
+	// the decoded result is the same either way
+	ImageAnalyzer analyzer(layout, width);
+	uint32 channels;
+	{
+		PhaseTimer timer(metrics, PHASE_CONVERT);
+		analyzer.AddRows(inData, rowBytes, height);
+		channels = analyzer.OutputChannels();
+		pack_pixels(inData, rowBytes, layout, width, height, channels, inData);
+	}
+
 	//encoding now
-	err = BitmapPixelsToJxl((uint8*)inData, inSize, bmpHeader.bounds.IntegerWidth()+1, bmpHeader.bounds.IntegerHeight()+1, bytesPerPixel, alphaBits, 0, out);
+	err = BitmapPixelsToJxl(inData, width, height, channels, analyzer.Result(),
+		ioExtension, monitor, out);
 	delete[] inData;
 	return err;
 }
 
 
+// Re-encodes a JPEG XL file with the current settings, without going
+// through a bitmap
+status_t
+JXLTranslator::Transcode(BPositionIO* in, BMessage* ioExtension,
+	TranslationMonitor* monitor, BPositionIO* out)
+{
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL)
+		return B_MISSING_LIBRARY;
+
+	JxlBasicInfo info;
+	status_t err;
+	{
+		PhaseTimer timer(monitor->Metrics(), PHASE_READ);
+		err = read_jxl_basic_info(in, &info);
+	}
+	if (err != B_OK)
+		return err;
+	const uint64 memory = TranscodeMemory((uint64)info.xsize * info.ysize,
+		info.xsize, TranscodeSampleBytes(info.bits_per_sample,
+			info.exponent_bits_per_sample));
+	if (memory > MemoryBudget())
+	{
+		syslog(LOG_ERR, "A %ux%u transcode needs %llu MiB, the budget is "
+			"%llu MiB\n", info.xsize, info.ysize,
+			(unsigned long long)memory >> 20,
+			(unsigned long long)MemoryBudget() >> 20);
+		return B_NO_MEMORY;
+	}
+	if (monitor->Metrics() != NULL)
+		monitor->Metrics()->peakMemory = memory;
+
+	EncodeParameters params;
+	ReadEncodeParameters(ioExtension, &params);
+	params.monitor = monitor;
+	int32 timeBudget = SettingInt32(ioExtension, JXL_SETTING_TIME_BUDGET);
+	if (timeBudget > 0) {
+		params.effort = effort_for_time_budget(jxl, info.xsize, info.ysize,
+			params.distance == 0, timeBudget, kMaxEffort, monitor);
+	}
+	if (SettingInt32(ioExtension, JXL_SETTING_SIZE_BUDGET) > 0)
+		syslog(LOG_INFO, "Size budget ignored for a transcode\n");
+
+	if (ioExtension != NULL) {
+		ioExtension->RemoveName(JXL_EXT_USED_DISTANCE);
+		ioExtension->RemoveName(JXL_EXT_USED_EFFORT);
+		ioExtension->AddFloat(JXL_EXT_USED_DISTANCE, params.distance);
+		ioExtension->AddInt32(JXL_EXT_USED_EFFORT, params.effort);
+	}
+	PositionIOInput input(in);
+	PositionIOOutput output(out);
+	return TranscodeStreaming(jxl, &input, params, monitor, &output);
+}
+
+// Decodes a file only to check it
+status_t
+JXLTranslator::Verify(BPositionIO* in, BMessage* ioExtension,
+	TranslationMonitor* monitor)
+{
+	const JxlLibrary* jxl = jxl_library();
+	if (jxl == NULL)
+		return B_MISSING_LIBRARY;
+
+	JxlBasicInfo info;
+	status_t err;
+	{
+		PhaseTimer timer(monitor->Metrics(), PHASE_READ);
+		err = read_jxl_basic_info(in, &info);
+	}
+	if (err != B_OK)
+		return err;
+	const uint64 memory = VerifyMemory((uint64)info.xsize * info.ysize);
+	if (memory > MemoryBudget())
+		return B_NO_MEMORY;
+	if (monitor->Metrics() != NULL)
+		monitor->Metrics()->peakMemory = memory;
+
+	bool digest = false;
+	ioExtension->FindBool(JXL_EXT_VERIFY_DIGEST, &digest);
+	PositionIOInput input(in);
+	VerifyResult result;
+	VerifyStreaming(jxl, &input, digest, monitor, &result);
+
+	ioExtension->RemoveName(JXL_EXT_ERROR_OFFSET);
+	ioExtension->RemoveName(JXL_EXT_PIXEL_DIGEST);
+	if (result.errorOffset >= 0)
+		ioExtension->AddInt64(JXL_EXT_ERROR_OFFSET, result.errorOffset);
+	if (digest && result.status == B_OK)
+		ioExtension->AddInt64(JXL_EXT_PIXEL_DIGEST, (int64)result.digest);
+	return result.status;
+}
+
+// Where the add-on writes files of its own
+static status_t
+CacheFilePath(const char* name, BPath* path)
+{
+	status_t status = find_directory(B_USER_CACHE_DIRECTORY, path);
+	if (status == B_OK)
+		status = path->Append("JXLTranslator");
+	if (status != B_OK)
+		return status;
+	create_directory(path->Path(), 0755);
+	return path->Append(name);
+}
+
+// With the setting on, traces go to trace.json in the cache directory
+static void
+ConfigureTrace(bool enabled)
+{
+	BPath path;
+	if (enabled && CacheFilePath("trace.json", &path) == B_OK)
+		trace_configure(path.Path());
+	else
+		trace_configure(NULL);
+}
+
+static void
+WriteMetricsFile(const MetricsAggregate& decodeMetrics,
+	const MetricsAggregate& encodeMetrics)
+{
+	BPath path;
+	if (CacheFilePath("metrics.json", &path) != B_OK)
+		return;
+	MetricsSummary decodes;
+	MetricsSummary encodes;
+	decodeMetrics.GetSummary(&decodes);
+	encodeMetrics.GetSummary(&encodes);
+	write_metrics_json(path.Path(), decodes, encodes);
+}
+
+// Set by RunBatchJob() for the translation of a job on this thread
+static thread_local TranslationMetrics* sJobMetrics = NULL;
+
 status_t
 JXLTranslator::DerivedTranslate(BPositionIO* inSource,
 	const translator_info* inInfo, BMessage* ioExtension, uint32 outType,
 	BPositionIO* outDestination, int32 baseType)
 {
+	// taken before this thread can run another job while it waits
+	TranslationMetrics* jobMetrics = sJobMetrics;
+	sJobMetrics = NULL;
+	return RunTranslation(inSource, inInfo, ioExtension, outType,
+		outDestination, baseType, jobMetrics);
+}
+
+// jobMetrics is always filled in when given, for batches
+status_t
+JXLTranslator::RunTranslation(BPositionIO* inSource,
+	const translator_info* inInfo, BMessage* ioExtension, uint32 outType,
+	BPositionIO* outDestination, int32 baseType,
+	TranslationMetrics* jobMetrics)
+{
+	ConfigureTrace(fSettings->SetGetBool(JXL_SETTING_TRACE));
+	TranslationMonitor monitor(ioExtension);
+	int32 maxThreads = 0;
+	if (ioExtension != NULL)
+		ioExtension->FindInt32(JXL_EXT_MAX_THREADS, &maxThreads);
+	// the calling thread runs groups too
+	std::unique_ptr<CodecThreadPool> ownPool;
+	if (maxThreads > 1)
+		ownPool.reset(new(std::nothrow) CodecThreadPool(maxThreads - 1));
+	if (maxThreads > 1 && ownPool == NULL)
+		return B_NO_MEMORY;
+	monitor.SetThreadPool(maxThreads > 0 ? ownPool.get() : ThreadPool());
+	TranslationMetrics ownMetrics;
+	TranslationMetrics& metrics = jobMetrics != NULL ? *jobMetrics
+		: ownMetrics;
+	bool returnMetrics = false;
+	if (ioExtension != NULL)
+		ioExtension->FindBool(JXL_EXT_METRICS, &returnMetrics);
+	const bool aggregate = fSettings->SetGetBool(JXL_SETTING_METRICS);
+	if (returnMetrics || aggregate || jobMetrics != NULL)
+		monitor.SetMetrics(&metrics);
+	const bigtime_t start = system_time();
+	const off_t inStart = inSource->Position();
+	const off_t outStart = outDestination->Position();
+
+	status_t status = B_NO_TRANSLATOR;
+	bool encode = true;
 	if (baseType == 1)
 	{
-		return Compress(inSource, outDestination);
+		status = Compress(inSource, ioExtension, &monitor, outDestination);
 	}
 	else if (outType == JXL_FORMAT && inInfo->type == B_TRANSLATOR_BITMAP)
 	{
-		return Compress(inSource, outDestination);
+		status = Compress(inSource, ioExtension, &monitor, outDestination);
+	}
+	else if (outType == JXL_FORMAT && inInfo->type == JXL_FORMAT)
+	{
+		status = Transcode(inSource, ioExtension, &monitor, outDestination);
 	}
 	else if (outType == B_TRANSLATOR_BITMAP && inInfo->type == JXL_FORMAT)
 	{
-		return Decompress(inSource, outDestination);
+		bool metadataOnly = false;
+		bool verify = false;
+		if (ioExtension != NULL)
+		{
+			ioExtension->FindBool(JXL_EXT_METADATA, &metadataOnly);
+			ioExtension->FindBool(JXL_EXT_VERIFY, &verify);
+		}
+		if (metadataOnly)
+			return read_jxl_metadata(inSource, ioExtension);
+		if (verify)
+			status = Verify(inSource, ioExtension, &monitor);
+		else
+			status = Decompress(inSource, ioExtension, &monitor, outDestination);
+		encode = false;
+	}
+	if (gTraceEnabled) {
+		trace_record("Translate", start, system_time() - start);
+		trace_dump();
 	}
-	return B_NO_TRANSLATOR;
+	if (status != B_OK)
+		return status;
+
+	monitor.Finish();
+	if (monitor.Metrics() != NULL) {
+		metrics.Finish(system_time() - start);
+		off_t inSize;
+		if (inSource->GetSize(&inSize) == B_OK)
+			metrics.bytesIn = inSize - inStart;
+		metrics.bytesOut = outDestination->Position() - outStart;
+		metrics.compressedBytes = encode ? metrics.bytesOut : metrics.bytesIn;
+		if (returnMetrics)
+			add_translation_metrics(metrics, ioExtension);
+		if (aggregate) {
+			(encode ? fEncodeMetrics : fDecodeMetrics).Add(metrics);
+			WriteMetricsFile(fDecodeMetrics, fEncodeMetrics);
+		}
+	}
+	return B_OK;
+}
+
+// #pragma mark - Batches
+
+struct TranslationBatch {
+	JXLTranslator*		translator;
+	TranslationJob*		jobs;
+	int32				count;
+	translation_job_hook hook;
+	void*				cookie;
+	std::atomic<int32>	next;
+	MetricsAggregate	decodes;
+	MetricsAggregate	encodes;
+
+	std::mutex			lock;
+	std::condition_variable finished;
+	int32				done;
+	int32				failed;
+	status_t			status;
+		// of the first job to fail
+};
+
+// Runs on the thread pool, once for each job. A job is identified and
+// translated as the Translation Kit would, adding it to the batch's
+// totals.
+void
+JXLTranslator::RunBatchJob(void* data)
+{
+	TranslationBatch* batch = (TranslationBatch*)data;
+	JXLTranslator* translator = batch->translator;
+	TranslationJob* job = &batch->jobs[batch->next++];
+
+	const bigtime_t start = system_time();
+	translator->fBatchJobs++;
+	const off_t position = job->source->Position();
+	translator_info info;
+	job->status = translator->Identify(job->source, NULL, job->ioExtension,
+		&info, job->outType);
+	job->source->Seek(position, SEEK_SET);
+	if (job->status == B_OK) {
+		TranslationMetrics metrics;
+		sJobMetrics = &metrics;
+		job->status = translator->Translate(job->source, &info,
+			job->ioExtension, job->outType, job->destination);
+		sJobMetrics = NULL;
+		// metadata requests and bitmap copies leave them unfinished
+		if (job->status == B_OK && metrics.totalTime > 0) {
+			(job->outType == JXL_FORMAT ? batch->encodes : batch->decodes)
+				.Add(metrics);
+		}
+	}
+	translator->fBatchJobs--;
+	job->time = system_time() - start;
+	if (batch->hook != NULL)
+		batch->hook(job, batch->cookie);
+
+	std::lock_guard<std::mutex> lock(batch->lock);
+	if (job->status != B_OK && batch->failed++ == 0)
+		batch->status = job->status;
+	if (++batch->done == batch->count)
+		batch->finished.notify_all();
+}
+
+status_t
+JXLTranslator::TranslateBatch(TranslationJob* jobs, int32 count,
+	translation_job_hook hook, void* cookie, BatchStatistics* statistics)
+{
+	if (count < 0 || (count > 0 && jobs == NULL))
+		return B_BAD_VALUE;
+
+	TranslationBatch batch;
+	batch.translator = this;
+	batch.jobs = jobs;
+	batch.count = count;
+	batch.hook = hook;
+	batch.cookie = cookie;
+	batch.next = 0;
+	batch.done = 0;
+	batch.failed = 0;
+	batch.status = B_OK;
+
+	// one task per job, each taking the next one, so that the pool can
+	// put its threads into the groups of images in flight in between
+	const bigtime_t start = system_time();
+	CodecThreadPool* pool = ThreadPool();
+	for (int32 i = 0; i < count; i++)
+		pool->AddTask(RunBatchJob, &batch);
+	{
+		std::unique_lock<std::mutex> lock(batch.lock);
+		while (batch.done < count)
+			batch.finished.wait(lock);
+	}
+
+	if (statistics != NULL) {
+		statistics->succeeded = count - batch.failed;
+		statistics->failed = batch.failed;
+		statistics->elapsed = system_time() - start;
+		batch.decodes.GetSummary(&statistics->decodes);
+		batch.encodes.GetSummary(&statistics->encodes);
+	}
+	return batch.status;
+}
+
+status_t
+JXLTranslator::GetConfigurationMessage(BMessage* ioExtension)
+{
+	status_t status = BaseTranslator::GetConfigurationMessage(ioExtension);
+	if (status != B_OK)
+		return status;
+
+	ioExtension->RemoveName(JXL_STATS_CACHE_HITS);
+	ioExtension->RemoveName(JXL_STATS_CACHE_MISSES);
+	ioExtension->RemoveName(JXL_STATS_MEMORY_CACHE_HITS);
+	ioExtension->RemoveName(JXL_STATS_MEMORY_CACHE_MISSES);
+	ioExtension->RemoveName(JXL_STATS_MEMORY_CACHE_SIZE);
+	ioExtension->RemoveName(JXL_STATS_ENCODE_CACHE_HITS);
+	ioExtension->RemoveName(JXL_STATS_ENCODE_CACHE_MISSES);
+	ioExtension->AddInt64(JXL_STATS_CACHE_HITS, fThumbnailCache.Hits());
+	ioExtension->AddInt64(JXL_STATS_CACHE_MISSES, fThumbnailCache.Misses());
+	ioExtension->AddInt64(JXL_STATS_MEMORY_CACHE_HITS, fDecodeCache.Hits());
+	ioExtension->AddInt64(JXL_STATS_MEMORY_CACHE_MISSES,
+		fDecodeCache.Misses());
+	ioExtension->AddInt64(JXL_STATS_MEMORY_CACHE_SIZE, fDecodeCache.Size());
+	ioExtension->AddInt64(JXL_STATS_ENCODE_CACHE_HITS, fEncodeCache.Hits());
+	ioExtension->AddInt64(JXL_STATS_ENCODE_CACHE_MISSES,
+		fEncodeCache.Misses());
+
+	MetricsSummary summary;
+	BMessage decodes;
+	BMessage encodes;
+	fDecodeMetrics.GetSummary(&summary);
+	add_metrics_summary(summary, &decodes);
+	fEncodeMetrics.GetSummary(&summary);
+	add_metrics_summary(summary, &encodes);
+	ioExtension->RemoveName(JXL_STATS_DECODES);
+	ioExtension->RemoveName(JXL_STATS_ENCODES);
+	ioExtension->AddMessage(JXL_STATS_DECODES, &decodes);
+	ioExtension->AddMessage(JXL_STATS_ENCODES, &encodes);
+	return B_OK;
 }
 
 BView *
@@ -7,12 +7,27 @@
 #define JXLTRANSLATOR_H
 
 #include "BaseTranslator.h"
+#include "colortransform.h"
+#include "diskcache.h"
+#include "memorycache.h"
+#include "translationmetrics.h"
+#include <Locker.h>
 #include <TranslationKit.h>
 #include <TranslatorAddOn.h>
 
+#include <atomic>
+
+class CodecThreadPool;
+struct EncodeParameters;
+struct ImageAnalysis;
+struct PixelLayout;
+struct TranslationBatch;
+class TranslationMonitor;
+
 #define JXL_TRANSLATOR_VERSION B_TRANSLATION_MAKE_VERSION(0,1,0)
 #define JXL_FORMAT 'JXL '
 #define JXL_TRANSLATOR_SETTINGS "JXLTranslatorSettings"
+#define JXL_CALIBRATION_FILE "JXLTranslatorCalibration"
 
 #define JXL_IN_QUALITY 0.7
 #define JXL_IN_CAPABILITY 0.8
@@ -26,8 +41,187 @@
 
 #define JXL_SETTING_DISTANCE "JXL_SETTING_DISTANCE"
 #define JXL_SETTING_EFFORT "JXL_SETTING_EFFORT"
+#define JXL_SETTING_DECODING_SPEED "JXL_SETTING_DECODING_SPEED"
+#define JXL_SETTING_PROGRESSIVE "JXL_SETTING_PROGRESSIVE"
+#define JXL_SETTING_PREVIEW "JXL_SETTING_PREVIEW"
 #define JXL_DEFAULT_DISTANCE 1 // visually lossless, 0-15 higher = worse
-#define JXL_DEFAULT_EFFORT 7 // 3-9 higher = slower
+#define JXL_DEFAULT_EFFORT 7 // 1-9 higher = slower, 1-2 are the fast lossless tiers
+#define JXL_DEFAULT_DECODING_SPEED 0 // 0-4 higher = faster decoding, larger files
+#define JXL_DEFAULT_PROGRESSIVE false // order the file for early low-resolution rendering
+#define JXL_DEFAULT_PREVIEW false // make files we write quick to thumbnail
+
+// Encode budgets, 0 = disabled. A time budget (milliseconds) picks the
+// effort, a size budget (KiB) picks the distance.
+#define JXL_SETTING_TIME_BUDGET "JXL_SETTING_TIME_BUDGET"
+#define JXL_SETTING_SIZE_BUDGET "JXL_SETTING_SIZE_BUDGET"
+
+// The settings above and the JXL_SETTING_*CACHE_SIZE ones below may also be
+// set in ioExtension, to override the saved ones for that translation alone.
+// They are int32, except JXL_SETTING_PROGRESSIVE and JXL_SETTING_PREVIEW
+// which are bool. The caches are shared, so the JXL_SETTING_*CACHE_SIZE
+// ones can only be set to 0 there, to leave the cache out; other values
+// are ignored.
+
+// Set in ioExtension to run a translation on this many threads of its own
+// instead of the shared ones, 1 to keep it on the calling thread
+#define JXL_EXT_MAX_THREADS "JXL_EXT_MAX_THREADS" // int32
+
+// Size limit of the on-disk cache of preview decodes in MiB, 0 = disabled
+#define JXL_SETTING_CACHE_SIZE "JXL_SETTING_CACHE_SIZE"
+#define JXL_DEFAULT_CACHE_SIZE 64
+
+// Size limit of the in-memory cache of recent decodes in MiB, 0 = disabled
+#define JXL_SETTING_MEMORY_CACHE_SIZE "JXL_SETTING_MEMORY_CACHE_SIZE"
+#define JXL_DEFAULT_MEMORY_CACHE_SIZE 32
+
+// Size limit of the on-disk cache of encoded files in MiB, 0 = disabled.
+// Saving an identical bitmap with the same settings again reuses the file.
+#define JXL_SETTING_ENCODE_CACHE_SIZE "JXL_SETTING_ENCODE_CACHE_SIZE"
+
+// Memory a translation may use in MiB, 0 = half of the physical memory.
+// Images that don't fit are decoded and encoded in pieces, straight from
+// the input to the output.
+#define JXL_SETTING_MEMORY_BUDGET "JXL_SETTING_MEMORY_BUDGET"
+
+// Set in ioExtension to drop the cached decodes of a file and decode it again
+#define JXL_EXT_INVALIDATE_CACHE "JXL_EXT_INVALIDATE_CACHE" // bool
+
+// Added to the configuration message
+#define JXL_STATS_CACHE_HITS "JXL_STATS_CACHE_HITS" // int64
+#define JXL_STATS_CACHE_MISSES "JXL_STATS_CACHE_MISSES" // int64
+#define JXL_STATS_MEMORY_CACHE_HITS "JXL_STATS_MEMORY_CACHE_HITS" // int64
+#define JXL_STATS_MEMORY_CACHE_MISSES "JXL_STATS_MEMORY_CACHE_MISSES" // int64
+#define JXL_STATS_MEMORY_CACHE_SIZE "JXL_STATS_MEMORY_CACHE_SIZE" // int64, bytes
+#define JXL_STATS_ENCODE_CACHE_HITS "JXL_STATS_ENCODE_CACHE_HITS" // int64
+#define JXL_STATS_ENCODE_CACHE_MISSES "JXL_STATS_ENCODE_CACHE_MISSES" // int64
+
+// Set in ioExtension to decode only a thumbnail: the embedded preview if
+// there is one, otherwise the image scaled down by 8
+#define JXL_EXT_PREVIEW "JXL_EXT_PREVIEW" // bool
+#define JXL_EXT_PREVIEW_SOURCE "JXL_EXT_PREVIEW_SOURCE" // int32, returned
+#define JXL_PREVIEW_NONE 0
+#define JXL_PREVIEW_EMBEDDED 1
+#define JXL_PREVIEW_DOWNSCALED 2
+
+// Set in ioExtension to choose how images with more than 8 bits per
+// channel, HDR ones in particular, are brought down to 8. By default
+// libjxl clips them, the others compress highlights to fit.
+#define JXL_EXT_TONE_CURVE "JXL_EXT_TONE_CURVE" // int32
+#define JXL_TONE_CURVE_NONE 0
+#define JXL_TONE_CURVE_CLIP 1
+#define JXL_TONE_CURVE_REINHARD 2
+#define JXL_TONE_CURVE_ACES 3
+
+// Set in ioExtension to have RGB images converted to another color
+// profile, such as the screen's, instead of being left in their own. Tone
+// mapped images stay in sRGB.
+#define JXL_EXT_OUTPUT_PROFILE "JXL_EXT_OUTPUT_PROFILE" // raw ICC profile
+
+// Set in ioExtension to turn the stored pixels to an Exif orientation
+// other than the one the image asks for. 1 leaves them as stored, which
+// together with JXL_EXT_ORIENTATION lets the caller turn them itself.
+#define JXL_EXT_OUTPUT_ORIENTATION "JXL_EXT_OUTPUT_ORIENTATION" // int32, 1-8
+
+// Set in ioExtension to skip decoding and return only the fields below.
+// Nothing is written to the output.
+#define JXL_EXT_METADATA "JXL_EXT_METADATA" // bool
+#define JXL_EXT_IMAGE_WIDTH "JXL_EXT_IMAGE_WIDTH" // int32
+#define JXL_EXT_IMAGE_HEIGHT "JXL_EXT_IMAGE_HEIGHT" // int32
+#define JXL_EXT_ORIENTATION "JXL_EXT_ORIENTATION" // int32, Exif values 1-8
+#define JXL_EXT_CAPTURE_TIME "JXL_EXT_CAPTURE_TIME" // string, Exif format
+#define JXL_EXT_EXIF "JXL_EXT_EXIF" // raw TIFF structured Exif
+#define JXL_EXT_XMP "JXL_EXT_XMP" // raw XML
+#define JXL_EXT_JUMBF "JXL_EXT_JUMBF" // raw, one item per box
+
+// Set in ioExtension to only check that a file decodes, writing nothing to
+// the output and keeping none of the decoded rows, though libjxl's own
+// buffers still grow with the image. The translation fails if it
+// doesn't, with the offset the decoder had read up to returned. With
+// JXL_EXT_VERIFY_DIGEST set too, a digest of the stored pixels is returned
+// on success, to compare against one taken earlier.
+#define JXL_EXT_VERIFY "JXL_EXT_VERIFY" // bool
+#define JXL_EXT_VERIFY_DIGEST "JXL_EXT_VERIFY_DIGEST" // bool
+#define JXL_EXT_ERROR_OFFSET "JXL_EXT_ERROR_OFFSET" // int64, returned
+#define JXL_EXT_PIXEL_DIGEST "JXL_EXT_PIXEL_DIGEST" // int64, returned
+
+// Set in ioExtension to follow a translation. Set the int32 to non-zero
+// from another thread to stop it; the translation then fails with
+// B_CANCELED. The messenger is sent JXL_MSG_PROGRESS messages.
+#define JXL_EXT_CANCEL "JXL_EXT_CANCEL" // pointer to an int32
+#define JXL_EXT_PROGRESS_TARGET "JXL_EXT_PROGRESS_TARGET" // BMessenger
+#define JXL_MSG_PROGRESS 'jxlp'
+#define JXL_PROGRESS_FRACTION "JXL_PROGRESS_FRACTION" // float, 0-1
+
+// Record a timeline of each translation and write it to trace.json in the
+// cache directory, for chrome://tracing. Setting JXL_TRACE in the
+// environment to a file name does the same, writing there.
+#define JXL_SETTING_TRACE "JXL_SETTING_TRACE"
+
+// Set in ioExtension to have the time spent in each phase of the
+// translation and its sizes returned in it, as the JXL_METRICS_* fields
+#define JXL_EXT_METRICS "JXL_EXT_METRICS" // bool
+
+// Keep aggregates of all translations, added to the configuration message
+// as JXL_STATS_DECODES and JXL_STATS_ENCODES. They are also written to
+// metrics.json in the cache directory after each translation, so scripts
+// can compare runs.
+#define JXL_SETTING_METRICS "JXL_SETTING_METRICS"
+#define JXL_STATS_DECODES "JXL_STATS_DECODES" // BMessage
+#define JXL_STATS_ENCODES "JXL_STATS_ENCODES" // BMessage
+
+// Per translation and summed up in the aggregates. Times are in
+// microseconds, the codec time is what the other phases leave.
+#define JXL_METRICS_READ_TIME "JXL_METRICS_READ_TIME" // int64
+#define JXL_METRICS_CONVERT_TIME "JXL_METRICS_CONVERT_TIME" // int64
+#define JXL_METRICS_WRITE_TIME "JXL_METRICS_WRITE_TIME" // int64
+#define JXL_METRICS_CODEC_TIME "JXL_METRICS_CODEC_TIME" // int64
+#define JXL_METRICS_TOTAL_TIME "JXL_METRICS_TOTAL_TIME" // int64
+#define JXL_METRICS_BYTES_IN "JXL_METRICS_BYTES_IN" // int64
+#define JXL_METRICS_BYTES_OUT "JXL_METRICS_BYTES_OUT" // int64
+#define JXL_METRICS_PIXELS "JXL_METRICS_PIXELS" // int64
+#define JXL_METRICS_BITS_PER_PIXEL "JXL_METRICS_BITS_PER_PIXEL" // float, of the JPEG XL side
+#define JXL_METRICS_PEAK_MEMORY "JXL_METRICS_PEAK_MEMORY" // int64, estimated, the largest in aggregates
+
+// Aggregates only. Percentiles are upper bounds, at most 1/8 above the
+// exact value. Item n of the histograms counts translations under 2^(n+1)
+// microseconds, or running under 2^(n+1) kilopixels per second.
+#define JXL_METRICS_COUNT "JXL_METRICS_COUNT" // int64
+#define JXL_METRICS_LATENCY_P50 "JXL_METRICS_LATENCY_P50" // int64
+#define JXL_METRICS_LATENCY_P90 "JXL_METRICS_LATENCY_P90" // int64
+#define JXL_METRICS_LATENCY_P99 "JXL_METRICS_LATENCY_P99" // int64
+#define JXL_METRICS_LATENCY_HISTOGRAM "JXL_METRICS_LATENCY_HISTOGRAM" // int64
+#define JXL_METRICS_SPEED_HISTOGRAM "JXL_METRICS_SPEED_HISTOGRAM" // int64
+
+// Returned in ioExtension after encoding
+#define JXL_EXT_USED_DISTANCE "JXL_EXT_USED_DISTANCE" // float
+#define JXL_EXT_USED_EFFORT "JXL_EXT_USED_EFFORT" // int32
+
+// A translation for JXLTranslator::TranslateBatch(), as the arguments of
+// Translate() would give it
+struct TranslationJob {
+	BPositionIO*	source;
+	BPositionIO*	destination;
+	BMessage*		ioExtension;
+		// may be NULL. Results are added to it, so jobs can't share one.
+	uint32			outType;
+	status_t		status;
+		// returned
+	bigtime_t		time;
+		// returned, from the job starting to it finishing in microseconds
+};
+
+typedef void (*translation_job_hook)(TranslationJob* job, void* cookie);
+	// called as each job of a batch finishes, from whichever thread ran it
+
+// The totals of a batch. The summaries only count jobs that succeeded,
+// transcodes as encodes.
+struct BatchStatistics {
+	int32			succeeded;
+	int32			failed;
+	bigtime_t		elapsed;
+	MetricsSummary	decodes;
+	MetricsSummary	encodes;
+};
 
 class JXLTranslator : public BaseTranslator {
 public:
@@ -35,16 +229,69 @@ public:
 	virtual status_t	DerivedIdentify(BPositionIO* inSource, const translation_format* inFormat, BMessage* ioExtension, translator_info * outInfo, uint32 outType);
 	virtual status_t	DerivedTranslate(BPositionIO* inSource, const translator_info *inInfo, BMessage* ioExtension, uint32 outType, BPositionIO* outDestination, int32 baseType);
 	virtual BView*		NewConfigView(TranslatorSettings* settings);
+	virtual status_t	GetConfigurationMessage(BMessage* ioExtension);
+	virtual status_t	DerivedCanHandleImageSize(float width, float height) const;
+
+	status_t TranslateBatch(TranslationJob* jobs, int32 count,
+				translation_job_hook hook, void* cookie,
+				BatchStatistics* statistics);
+		// Runs the jobs on the translator's threads, several at once, and
+		// returns once they are all done: B_OK if they all succeeded,
+		// otherwise the status of the first one that failed. Images in
+		// flight take idle threads for themselves before another job is
+		// started. hook and statistics may be NULL; hook must not start
+		// another batch. Jobs with JXL_EXT_VERIFY set check files instead,
+		// so a batch of them scrubs a collection on all cores.
 
 protected:
 	virtual ~JXLTranslator(void);
 
 private:
 	status_t IdentifyJXL(BPositionIO *inSource, translator_info *outInfo);
-	status_t Decompress(BPositionIO* in, BPositionIO* out);
-	status_t Compress(BPositionIO* in, BPositionIO* out);
-	status_t BitmapPixelsToJxl(uint8* pixels, size_t size, int xsize, int ysize, uint32 bpp,
-				int alphabits, uint32 align, BPositionIO* out);
+	status_t Decompress(BPositionIO* in, BMessage* ioExtension,
+				TranslationMonitor* monitor, BPositionIO* out);
+	status_t Compress(BPositionIO* in, BMessage* ioExtension,
+				TranslationMonitor* monitor, BPositionIO* out);
+	status_t BitmapPixelsToJxl(const uint8* pixels, int xsize, int ysize, uint32 channels,
+				const ImageAnalysis& analysis, BMessage* ioExtension,
+				TranslationMonitor* monitor, BPositionIO* out);
+	status_t CompressStreaming(BPositionIO* in, const PixelLayout& layout,
+				color_space space, int32 width, int32 height, uint64 rowBytes,
+				BMessage* ioExtension, TranslationMonitor* monitor,
+				BPositionIO* out);
+	status_t Transcode(BPositionIO* in, BMessage* ioExtension,
+				TranslationMonitor* monitor, BPositionIO* out);
+	status_t Verify(BPositionIO* in, BMessage* ioExtension,
+				TranslationMonitor* monitor);
+	status_t RunTranslation(BPositionIO* inSource,
+				const translator_info* inInfo, BMessage* ioExtension,
+				uint32 outType, BPositionIO* outDestination, int32 baseType,
+				TranslationMetrics* jobMetrics);
+	static void RunBatchJob(void* data);
+	int32 SettingInt32(BMessage* ioExtension, const char* name);
+	bool SettingBool(BMessage* ioExtension, const char* name);
+	bool CacheEnabled(BMessage* ioExtension, const char* name);
+	void UpdateCacheSizes();
+	void ReadEncodeParameters(BMessage* ioExtension,
+				EncodeParameters* params);
+	uint64 MemoryBudget() const;
+	CodecThreadPool* ThreadPool();
+
+	DiskCache fThumbnailCache;
+	MemoryCache fDecodeCache;
+	DiskCache fEncodeCache;
+	std::atomic<int32> fCacheSize;
+	std::atomic<int32> fMemoryCacheSize;
+	std::atomic<int32> fEncodeCacheSize;
+		// in MiB, as last set from the saved settings
+	MetricsAggregate fDecodeMetrics;
+	MetricsAggregate fEncodeMetrics;
+	ColorTransformCache fColorTransforms;
+	BLocker fThreadPoolLock;
+	CodecThreadPool* fThreadPool;
+		// made on first use, shared by all translations
+	std::atomic<int32> fBatchJobs;
+		// running, they share the memory budget
 };
 
 
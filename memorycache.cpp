@@ -0,0 +1,123 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "memorycache.h"
+
+#include <Autolock.h>
+
+
+MemoryCache::MemoryCache()
+	:
+	fLock("memory cache"),
+	fMaxSize(0),
+	fSize(0),
+	fHits(0),
+	fMisses(0)
+{
+}
+
+
+void
+MemoryCache::SetMaxSize(size_t maxSize)
+{
+	BAutolock lock(fLock);
+	fMaxSize = maxSize;
+	_Trim();
+}
+
+
+CacheData
+MemoryCache::Lookup(uint64 key)
+{
+	BAutolock lock(fLock);
+	auto found = fIndex.find(key);
+	if (found == fIndex.end()) {
+		fMisses++;
+		return CacheData();
+	}
+
+	fEntries.splice(fEntries.begin(), fEntries, found->second);
+	fHits++;
+	return found->second->second;
+}
+
+
+void
+MemoryCache::Store(uint64 key, const CacheData& data)
+{
+	BAutolock lock(fLock);
+	// one big image shouldn't push out everything else
+	if (data->size() > fMaxSize / 4)
+		return;
+
+	auto found = fIndex.find(key);
+	if (found != fIndex.end())
+		_Remove(found->second);
+
+	fEntries.push_front(Entry(key, data));
+	fIndex[key] = fEntries.begin();
+	fSize += data->size();
+	_Trim();
+}
+
+
+void
+MemoryCache::Invalidate(uint64 key)
+{
+	BAutolock lock(fLock);
+	auto found = fIndex.find(key);
+	if (found != fIndex.end())
+		_Remove(found->second);
+}
+
+
+void
+MemoryCache::Clear()
+{
+	BAutolock lock(fLock);
+	fEntries.clear();
+	fIndex.clear();
+	fSize = 0;
+}
+
+
+int64
+MemoryCache::Hits() const
+{
+	BAutolock lock(fLock);
+	return fHits;
+}
+
+
+int64
+MemoryCache::Misses() const
+{
+	BAutolock lock(fLock);
+	return fMisses;
+}
+
+
+size_t
+MemoryCache::Size() const
+{
+	BAutolock lock(fLock);
+	return fSize;
+}
+
+
+void
+MemoryCache::_Remove(EntryList::iterator entry)
+{
+	fSize -= entry->second->size();
+	fIndex.erase(entry->first);
+	fEntries.erase(entry);
+}
+
+
+void
+MemoryCache::_Trim()
+{
+	while (fSize > fMaxSize && !fEntries.empty())
+		_Remove(--fEntries.end());
+}
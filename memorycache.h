@@ -0,0 +1,56 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef MEMORYCACHE_H
+#define MEMORYCACHE_H
+
+#include <Locker.h>
+#include <SupportDefs.h>
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+typedef std::shared_ptr<const std::vector<uint8> > CacheData;
+
+
+// Keeps the most recently used blocks of data within a byte budget, keyed
+// like DiskCache. The data is shared, so a caller can keep using a block
+// after it has been evicted.
+class MemoryCache {
+public:
+							MemoryCache();
+
+			void			SetMaxSize(size_t maxSize);
+
+			CacheData		Lookup(uint64 key);
+			void			Store(uint64 key, const CacheData& data);
+			void			Invalidate(uint64 key);
+			void			Clear();
+
+			int64			Hits() const;
+			int64			Misses() const;
+			size_t			Size() const;
+
+private:
+	typedef std::pair<uint64, CacheData> Entry;
+	typedef std::list<Entry> EntryList;
+
+			void			_Remove(EntryList::iterator entry);
+			void			_Trim();
+
+	mutable	BLocker			fLock;
+			EntryList		fEntries;
+				// most recently used first
+			std::unordered_map<uint64, EntryList::iterator> fIndex;
+			size_t			fMaxSize;
+			size_t			fSize;
+			int64			fHits;
+			int64			fMisses;
+};
+
+
+#endif // MEMORYCACHE_H
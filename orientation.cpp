@@ -0,0 +1,193 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "orientation.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const size_t kBlockSize = 64;
+const size_t kTileSize = 4;
+
+
+// Where the pixels of the turned image come from: with transpose, its
+// columns are the stored rows, then either axis may run backwards
+struct OrientationMapping {
+	bool	transpose;
+	bool	flipX;
+	bool	flipY;
+};
+
+static const OrientationMapping sMappings[8] = {
+	{ false, false, false },
+	{ false, true, false },
+	{ false, true, true },
+	{ false, false, true },
+	{ true, false, false },
+	{ true, false, true },
+	{ true, true, true },
+	{ true, true, false }
+};
+
+// The part of the stored image a turned rectangle is made from
+struct OrientedSource {
+	const uint8*	pixels;
+	size_t			stride;
+	size_t			left;
+	size_t			top;
+	size_t			xsize;
+	size_t			ysize;
+	OrientationMapping mapping;
+
+	// the stored pixel at a, b before flipping
+	const uint8* At(size_t a, size_t b) const
+	{
+		size_t x = mapping.flipX ? xsize - 1 - a : a;
+		size_t y = mapping.flipY ? ysize - 1 - b : b;
+		return pixels + (y - top) * stride + (x - left) * 4;
+	}
+};
+
+
+static const OrientationMapping&
+mapping_for(int32 orientation)
+{
+	if (orientation < 1 || orientation > 8)
+		orientation = 1;
+	return sMappings[orientation - 1];
+}
+
+
+static inline void
+copy_pixel(const uint8* source, uint8* dest, bool swapRedBlue)
+{
+	dest[0] = source[swapRedBlue ? 2 : 0];
+	dest[1] = source[1];
+	dest[2] = source[swapRedBlue ? 0 : 2];
+	dest[3] = source[3];
+}
+
+
+#if defined(__SSE2__)
+
+static inline __m128i
+swap_red_blue(__m128i pixels)
+{
+	const __m128i greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+	const __m128i low = _mm_set1_epi32(0xff);
+	return _mm_or_si128(_mm_and_si128(pixels, greenAlpha),
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16), low),
+			_mm_slli_epi32(_mm_and_si128(pixels, low), 16)));
+}
+
+
+// Loads the 4 stored pixels at a to a + 3 before flipping, in that order
+static inline __m128i
+load_pixels(const OrientedSource& source, size_t a, size_t b)
+{
+	if (!source.mapping.flipX)
+		return _mm_loadu_si128((const __m128i*)source.At(a, b));
+	__m128i pixels = _mm_loadu_si128((const __m128i*)source.At(a + 3, b));
+	return _mm_shuffle_epi32(pixels, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+
+// Fills the 4x4 tile at ox, oy of the turned image
+static inline void
+orient_tile(const OrientedSource& source, size_t ox, size_t oy,
+	bool swapRedBlue, uint8* dest, size_t destStride)
+{
+	__m128i rows[4];
+	if (source.mapping.transpose) {
+		// column c of the tile comes from stored row ox + c
+		for (size_t c = 0; c < 4; c++)
+			rows[c] = load_pixels(source, oy, ox + c);
+		__m128i t0 = _mm_unpacklo_epi32(rows[0], rows[1]);
+		__m128i t1 = _mm_unpacklo_epi32(rows[2], rows[3]);
+		__m128i t2 = _mm_unpackhi_epi32(rows[0], rows[1]);
+		__m128i t3 = _mm_unpackhi_epi32(rows[2], rows[3]);
+		rows[0] = _mm_unpacklo_epi64(t0, t1);
+		rows[1] = _mm_unpackhi_epi64(t0, t1);
+		rows[2] = _mm_unpacklo_epi64(t2, t3);
+		rows[3] = _mm_unpackhi_epi64(t2, t3);
+	} else {
+		for (size_t r = 0; r < 4; r++)
+			rows[r] = load_pixels(source, ox, oy + r);
+	}
+	for (size_t r = 0; r < 4; r++) {
+		if (swapRedBlue)
+			rows[r] = swap_red_blue(rows[r]);
+		_mm_storeu_si128((__m128i*)(dest + r * destStride), rows[r]);
+	}
+}
+
+#endif
+
+
+bool
+orientation_transposes(int32 orientation)
+{
+	return orientation >= 5 && orientation <= 8;
+}
+
+
+void
+orient_rect(int32 orientation, size_t xsize, size_t ysize, size_t x,
+	size_t y, size_t width, size_t height, size_t* left, size_t* top)
+{
+	const OrientationMapping& mapping = mapping_for(orientation);
+	size_t a = mapping.flipX ? xsize - x - width : x;
+	size_t b = mapping.flipY ? ysize - y - height : y;
+	*left = mapping.transpose ? b : a;
+	*top = mapping.transpose ? a : b;
+}
+
+
+void
+orient_pixels(const uint8* pixels, size_t sourceStride, size_t sourceLeft,
+	size_t sourceTop, size_t xsize, size_t ysize, int32 orientation,
+	size_t left, size_t top, size_t width, size_t height, bool swapRedBlue,
+	uint8* dest, size_t destStride)
+{
+	const OrientedSource source = { pixels, sourceStride, sourceLeft,
+		sourceTop, xsize, ysize, mapping_for(orientation) };
+
+	for (size_t blockY = 0; blockY < height; blockY += kBlockSize) {
+		const size_t blockBottom = std::min(blockY + kBlockSize, height);
+		for (size_t blockX = 0; blockX < width; blockX += kBlockSize) {
+			const size_t blockRight = std::min(blockX + kBlockSize, width);
+
+			for (size_t y = blockY; y < blockBottom; y += kTileSize) {
+				const size_t tileHeight = std::min(kTileSize, blockBottom - y);
+				for (size_t x = blockX; x < blockRight; x += kTileSize) {
+					const size_t tileWidth = std::min(kTileSize,
+						blockRight - x);
+					uint8* out = dest + y * destStride + x * 4;
+#if defined(__SSE2__)
+					if (tileWidth == kTileSize && tileHeight == kTileSize) {
+						orient_tile(source, left + x, top + y, swapRedBlue,
+							out, destStride);
+						continue;
+					}
+#endif
+					for (size_t r = 0; r < tileHeight; r++) {
+						for (size_t c = 0; c < tileWidth; c++) {
+							size_t ox = left + x + c;
+							size_t oy = top + y + r;
+							const uint8* pixel = source.mapping.transpose
+								? source.At(oy, ox) : source.At(ox, oy);
+							copy_pixel(pixel, out + r * destStride + c * 4,
+								swapRedBlue);
+						}
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef ORIENTATION_H
+#define ORIENTATION_H
+
+#include "codecdefs.h"
+
+// Orientations are the Exif values 1-8, as in JxlOrientation: how the
+// stored pixels are turned for display. 1 leaves them as they are, 5-8
+// swap the sides.
+
+
+bool orientation_transposes(int32 orientation);
+	// whether the sides of an image turned to orientation are swapped
+
+void orient_rect(int32 orientation, size_t xsize, size_t ysize, size_t x,
+	size_t y, size_t width, size_t height, size_t* left, size_t* top);
+	// where a rectangle of a stored xsize x ysize image ends up once turned
+	// to orientation. Its sides are swapped if the orientation transposes.
+
+void orient_pixels(const uint8* source, size_t sourceStride,
+	size_t sourceLeft, size_t sourceTop, size_t xsize, size_t ysize,
+	int32 orientation, size_t left, size_t top, size_t width, size_t height,
+	bool swapRedBlue, uint8* dest, size_t destStride);
+	// Fills a width x height rectangle at left, top of a xsize x ysize
+	// image of 4 byte pixels turned to orientation. source holds the part
+	// of the stored image the rectangle comes from, its first pixel being
+	// at sourceLeft, sourceTop. With swapRedBlue the first and third byte
+	// of each pixel are swapped on the way. Works on 4x4 tiles within
+	// 64x64 blocks, so turning by 90 degrees reads memory in order too.
+
+
+#endif // ORIENTATION_H
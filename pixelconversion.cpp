@@ -0,0 +1,494 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "pixelconversion.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline uint8
+luma(const uint8* bgra)
+{
+	return (bgra[2] * 77 + bgra[1] * 150 + bgra[0] * 29) >> 8;
+}
+
+
+static inline uint8
+expand5(uint32 value)
+{
+	return (value << 3) | (value >> 2);
+}
+
+
+static inline uint8
+expand6(uint32 value)
+{
+	return (value << 2) | (value >> 4);
+}
+
+
+static inline uint16
+read16(const uint8* source, bool big)
+{
+	return big ? (source[0] << 8) | source[1] : source[0] | (source[1] << 8);
+}
+
+
+static inline void
+write16(uint8* dest, uint16 value, bool big)
+{
+	dest[big ? 1 : 0] = value & 0xff;
+	dest[big ? 0 : 1] = value >> 8;
+}
+
+
+#if defined(__SSE2__)
+
+// Reverses the bytes of each 32 bit pixel, BGRA to ARGB and back
+static inline __m128i
+reverse_pixels(__m128i pixels)
+{
+	pixels = _mm_or_si128(_mm_slli_epi16(pixels, 8),
+		_mm_srli_epi16(pixels, 8));
+	pixels = _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(pixels, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+#endif
+
+
+// #pragma mark - 32 bit
+
+
+static void
+copy_rgba32(const uint8* source, uint8* dest, int32 width,
+	const color_map* map)
+{
+	memcpy(dest, source, (size_t)width * 4);
+}
+
+
+static void
+read_rgb32(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	int32 x = 0;
+#if defined(__SSE2__)
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	for (; x + 4 <= width; x += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(source + x * 4));
+		_mm_storeu_si128((__m128i*)(bgra + x * 4),
+			_mm_or_si128(pixels, alpha));
+	}
+#endif
+	for (; x < width; x++) {
+		memcpy(bgra + x * 4, source + x * 4, 3);
+		bgra[x * 4 + 3] = 255;
+	}
+}
+
+
+template<bool kAlpha>
+static void
+read_rgb32_big(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	int32 x = 0;
+#if defined(__SSE2__)
+	const __m128i alpha = _mm_set1_epi32(kAlpha ? 0 : (int)0xff000000);
+	for (; x + 4 <= width; x += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(source + x * 4));
+		_mm_storeu_si128((__m128i*)(bgra + x * 4),
+			_mm_or_si128(reverse_pixels(pixels), alpha));
+	}
+#endif
+	for (; x < width; x++) {
+		const uint8* pixel = source + x * 4;
+		bgra[x * 4] = pixel[3];
+		bgra[x * 4 + 1] = pixel[2];
+		bgra[x * 4 + 2] = pixel[1];
+		bgra[x * 4 + 3] = kAlpha ? pixel[0] : 255;
+	}
+}
+
+
+static void
+write_rgb32_big(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	int32 x = 0;
+#if defined(__SSE2__)
+	for (; x + 4 <= width; x += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(bgra + x * 4));
+		_mm_storeu_si128((__m128i*)(dest + x * 4), reverse_pixels(pixels));
+	}
+#endif
+	for (; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		dest[x * 4] = pixel[3];
+		dest[x * 4 + 1] = pixel[2];
+		dest[x * 4 + 2] = pixel[1];
+		dest[x * 4 + 3] = pixel[0];
+	}
+}
+
+
+// #pragma mark - 24 bit
+
+
+template<bool kBig>
+static void
+read_rgb24(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = source + x * 3;
+		bgra[x * 4] = pixel[kBig ? 2 : 0];
+		bgra[x * 4 + 1] = pixel[1];
+		bgra[x * 4 + 2] = pixel[kBig ? 0 : 2];
+		bgra[x * 4 + 3] = 255;
+	}
+}
+
+
+template<bool kBig>
+static void
+write_rgb24(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		dest[x * 3] = pixel[kBig ? 2 : 0];
+		dest[x * 3 + 1] = pixel[1];
+		dest[x * 3 + 2] = pixel[kBig ? 0 : 2];
+	}
+}
+
+
+// #pragma mark - 15 and 16 bit
+
+
+template<bool kBig>
+static void
+read_rgb16(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint16 value = read16(source + x * 2, kBig);
+		bgra[x * 4] = expand5(value & 0x1f);
+		bgra[x * 4 + 1] = expand6((value >> 5) & 0x3f);
+		bgra[x * 4 + 2] = expand5(value >> 11);
+		bgra[x * 4 + 3] = 255;
+	}
+}
+
+
+template<bool kBig>
+static void
+write_rgb16(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		write16(dest + x * 2, ((pixel[2] & 0xf8) << 8)
+			| ((pixel[1] & 0xfc) << 3) | (pixel[0] >> 3), kBig);
+	}
+}
+
+
+template<bool kBig, bool kAlpha>
+static void
+read_rgb15(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint16 value = read16(source + x * 2, kBig);
+		bgra[x * 4] = expand5(value & 0x1f);
+		bgra[x * 4 + 1] = expand5((value >> 5) & 0x1f);
+		bgra[x * 4 + 2] = expand5((value >> 10) & 0x1f);
+		bgra[x * 4 + 3] = !kAlpha || (value & 0x8000) != 0 ? 255 : 0;
+	}
+}
+
+
+template<bool kBig, bool kAlpha>
+static void
+write_rgb15(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		uint16 value = ((pixel[2] & 0xf8) << 7) | ((pixel[1] & 0xf8) << 2)
+			| (pixel[0] >> 3);
+		if (!kAlpha || pixel[3] >= 128)
+			value |= 0x8000;
+		write16(dest + x * 2, value, kBig);
+	}
+}
+
+
+// #pragma mark - Gray and indexed
+
+
+static void
+read_gray8(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		memset(bgra + x * 4, source[x], 3);
+		bgra[x * 4 + 3] = 255;
+	}
+}
+
+
+static void
+write_gray8(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++)
+		dest[x] = luma(bgra + x * 4);
+}
+
+
+// Set bits are black, the leftmost pixel is the highest bit
+static void
+read_gray1(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const bool black = (source[x >> 3] & (0x80 >> (x & 7))) != 0;
+		memset(bgra + x * 4, black ? 0 : 255, 3);
+		bgra[x * 4 + 3] = 255;
+	}
+}
+
+
+static void
+write_gray1(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	memset(dest, 0, (width + 7) / 8);
+	for (int32 x = 0; x < width; x++) {
+		if (luma(bgra + x * 4) < 128)
+			dest[x >> 3] |= 0x80 >> (x & 7);
+	}
+}
+
+
+static void
+read_cmap8(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const rgb_color& color = map->color_list[source[x]];
+		bgra[x * 4] = color.blue;
+		bgra[x * 4 + 1] = color.green;
+		bgra[x * 4 + 2] = color.red;
+		bgra[x * 4 + 3] = source[x] == B_TRANSPARENT_MAGIC_CMAP8 ? 0 : 255;
+	}
+}
+
+
+static void
+write_cmap8(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		if (pixel[3] < 128) {
+			dest[x] = B_TRANSPARENT_MAGIC_CMAP8;
+			continue;
+		}
+		// the index map goes by 5 bits per channel
+		dest[x] = map->index_map[((pixel[2] & 0xf8) << 7)
+			| ((pixel[1] & 0xf8) << 2) | (pixel[0] >> 3)];
+	}
+}
+
+
+// #pragma mark - CMY(K)
+
+
+static void
+read_cmyk32(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = source + x * 4;
+		const uint32 white = 255 - pixel[3];
+		bgra[x * 4] = (255 - pixel[2]) * white / 255;
+		bgra[x * 4 + 1] = (255 - pixel[1]) * white / 255;
+		bgra[x * 4 + 2] = (255 - pixel[0]) * white / 255;
+		bgra[x * 4 + 3] = 255;
+	}
+}
+
+
+// Takes as much black out as possible, without knowing the inks
+static void
+write_cmyk32(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		const uint32 white = std::max(pixel[0], std::max(pixel[1], pixel[2]));
+		uint8* out = dest + x * 4;
+		if (white == 0) {
+			memset(out, 0, 3);
+		} else {
+			out[0] = (white - pixel[2]) * 255 / white;
+			out[1] = (white - pixel[1]) * 255 / white;
+			out[2] = (white - pixel[0]) * 255 / white;
+		}
+		out[3] = 255 - white;
+	}
+}
+
+
+// CMY with 3 or 4 bytes per pixel, the fourth is alpha or unused
+template<uint32 kBytes, bool kAlpha>
+static void
+read_cmy(const uint8* source, uint8* bgra, int32 width, const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = source + x * kBytes;
+		bgra[x * 4] = 255 - pixel[2];
+		bgra[x * 4 + 1] = 255 - pixel[1];
+		bgra[x * 4 + 2] = 255 - pixel[0];
+		bgra[x * 4 + 3] = kAlpha ? pixel[3] : 255;
+	}
+}
+
+
+template<uint32 kBytes, bool kAlpha>
+static void
+write_cmy(const uint8* bgra, uint8* dest, int32 width, const color_map* map)
+{
+	for (int32 x = 0; x < width; x++) {
+		const uint8* pixel = bgra + x * 4;
+		uint8* out = dest + x * kBytes;
+		out[0] = 255 - pixel[2];
+		out[1] = 255 - pixel[1];
+		out[2] = 255 - pixel[0];
+		if (kBytes == 4)
+			out[3] = kAlpha ? pixel[3] : 0;
+	}
+}
+
+
+// #pragma mark -
+
+
+struct ColorSpaceConversion {
+	color_space		space;
+	uint32			bitsPerPixel;
+	row_reader		read;
+	row_writer		write;
+};
+
+// B_RGB32 and B_RGBA32 share a layout, the unused byte of B_RGB32 is
+// written with the alpha
+static const ColorSpaceConversion sConversions[] = {
+	{ B_RGBA32, 32, copy_rgba32, copy_rgba32 },
+	{ B_RGB32, 32, read_rgb32, copy_rgba32 },
+	{ B_RGBA32_BIG, 32, read_rgb32_big<true>, write_rgb32_big },
+	{ B_RGB32_BIG, 32, read_rgb32_big<false>, write_rgb32_big },
+	{ B_RGB24, 24, read_rgb24<false>, write_rgb24<false> },
+	{ B_RGB24_BIG, 24, read_rgb24<true>, write_rgb24<true> },
+	{ B_RGB16, 16, read_rgb16<false>, write_rgb16<false> },
+	{ B_RGB16_BIG, 16, read_rgb16<true>, write_rgb16<true> },
+	{ B_RGB15, 16, read_rgb15<false, false>, write_rgb15<false, false> },
+	{ B_RGB15_BIG, 16, read_rgb15<true, false>, write_rgb15<true, false> },
+	{ B_RGBA15, 16, read_rgb15<false, true>, write_rgb15<false, true> },
+	{ B_RGBA15_BIG, 16, read_rgb15<true, true>, write_rgb15<true, true> },
+	{ B_GRAY8, 8, read_gray8, write_gray8 },
+	{ B_GRAY1, 1, read_gray1, write_gray1 },
+	{ B_CMAP8, 8, read_cmap8, write_cmap8 },
+	{ B_CMYK32, 32, read_cmyk32, write_cmyk32 },
+	{ B_CMY32, 32, read_cmy<4, false>, write_cmy<4, false> },
+	{ B_CMYA32, 32, read_cmy<4, true>, write_cmy<4, true> },
+	{ B_CMY24, 24, read_cmy<3, false>, write_cmy<3, false> }
+};
+
+const uint32 kNumConversions = sizeof(sConversions) / sizeof(sConversions[0]);
+
+
+static const ColorSpaceConversion*
+find_conversion(color_space space)
+{
+	for (uint32 i = 0; i < kNumConversions; i++) {
+		if (sConversions[i].space == space)
+			return &sConversions[i];
+	}
+	return NULL;
+}
+
+
+// #pragma mark -
+
+
+RowConverter::RowConverter(color_space from, color_space to, int32 width,
+	const color_map* map)
+	:
+	fFrom(from),
+	fTo(to),
+	fWidth(width),
+	fMap(map),
+	fRead(NULL),
+	fWrite(NULL),
+	fBuffer(NULL)
+{
+	const ColorSpaceConversion* source = find_conversion(from);
+	const ColorSpaceConversion* target = find_conversion(to);
+	if (source == NULL || target == NULL || width < 1
+		|| ((from == B_CMAP8 || to == B_CMAP8) && map == NULL))
+		return;
+	fRead = source->read;
+	fWrite = target->write;
+	fBuffer = new(std::nothrow) uint8[(size_t)width * 4];
+}
+
+
+RowConverter::~RowConverter()
+{
+	delete[] fBuffer;
+}
+
+
+status_t
+RowConverter::InitCheck() const
+{
+	if (fRead == NULL)
+		return B_NO_TRANSLATOR;
+	return fBuffer != NULL ? B_OK : B_NO_MEMORY;
+}
+
+
+void
+RowConverter::Convert(const uint8* source, uint8* dest) const
+{
+	// skip the step through B_RGBA32 where a side already is
+	const uint8* row = source;
+	if (fFrom != B_RGBA32) {
+		uint8* converted = fTo == B_RGBA32 ? dest : fBuffer;
+		fRead(source, converted, fWidth, fMap);
+		row = converted;
+	}
+	if (row != dest)
+		fWrite(row, dest, fWidth, fMap);
+}
+
+
+uint32
+RowConverter::BitsPerPixel(color_space space)
+{
+	const ColorSpaceConversion* conversion = find_conversion(space);
+	return conversion != NULL ? conversion->bitsPerPixel : 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef PIXELCONVERSION_H
+#define PIXELCONVERSION_H
+
+#include "codecdefs.h"
+
+// Rows are converted to and from B_RGBA32, that is blue, green, red and
+// alpha bytes. The color map is only used by B_CMAP8.
+typedef void (*row_reader)(const uint8* source, uint8* bgra, int32 width,
+	const color_map* map);
+typedef void (*row_writer)(const uint8* bgra, uint8* dest, int32 width,
+	const color_map* map);
+
+
+// Converts rows of pixels between the color spaces identify_bits_header()
+// accepts. Rows go through B_RGBA32 unless one of the sides already is.
+class RowConverter {
+public:
+						RowConverter(color_space from, color_space to,
+							int32 width, const color_map* map);
+							// map is needed if either side is B_CMAP8
+						~RowConverter();
+
+			status_t	InitCheck() const;
+				// B_NO_TRANSLATOR if either color space can't be
+				// converted
+
+			void		Convert(const uint8* source, uint8* dest) const;
+				// converts a row of width pixels. Goes through a buffer of
+				// its own, so a converter is only for one thread at a time.
+
+	static	uint32		BitsPerPixel(color_space space);
+				// of the color spaces rows can be converted between, 0 for
+				// others
+
+private:
+			color_space	fFrom;
+			color_space	fTo;
+			int32		fWidth;
+			const color_map* fMap;
+			row_reader	fRead;
+			row_writer	fWrite;
+			uint8*		fBuffer;
+};
+
+
+#endif // PIXELCONVERSION_H
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "positionio.h"
+
+
+PositionIOInput::PositionIOInput(BPositionIO* io)
+	:
+	fIO(io)
+{
+}
+
+
+ssize_t
+PositionIOInput::ReadAt(off_t position, void* buffer, size_t size)
+{
+	return fIO->ReadAt(position, buffer, size);
+}
+
+
+// #pragma mark -
+
+
+PositionIOOutput::PositionIOOutput(BPositionIO* io)
+	:
+	fIO(io)
+{
+}
+
+
+ssize_t
+PositionIOOutput::Write(const void* buffer, size_t size)
+{
+	return fIO->Write(buffer, size);
+}
+
+
+ssize_t
+PositionIOOutput::WriteAt(off_t position, const void* buffer, size_t size)
+{
+	return fIO->WriteAt(position, buffer, size);
+}
+
+
+off_t
+PositionIOOutput::Position() const
+{
+	return fIO->Position();
+}
+
+
+status_t
+PositionIOOutput::SetPosition(off_t position)
+{
+	off_t result = fIO->Seek(position, SEEK_SET);
+	return result < 0 ? (status_t)result : B_OK;
+}
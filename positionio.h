@@ -0,0 +1,42 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef POSITIONIO_H
+#define POSITIONIO_H
+
+#include <DataIO.h>
+
+#include "codecio.h"
+
+
+// Hands the codec a BPositionIO to read from
+class PositionIOInput : public CodecInput {
+public:
+								PositionIOInput(BPositionIO* io);
+
+	virtual	ssize_t				ReadAt(off_t position, void* buffer,
+									size_t size);
+
+private:
+			BPositionIO*		fIO;
+};
+
+
+// Hands the codec a BPositionIO to write to
+class PositionIOOutput : public CodecOutput {
+public:
+								PositionIOOutput(BPositionIO* io);
+
+	virtual	ssize_t				Write(const void* buffer, size_t size);
+	virtual	ssize_t				WriteAt(off_t position, const void* buffer,
+									size_t size);
+	virtual	off_t				Position() const;
+	virtual	status_t			SetPosition(off_t position);
+
+private:
+			BPositionIO*		fIO;
+};
+
+
+#endif // POSITIONIO_H
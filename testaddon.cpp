@@ -0,0 +1,54 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "testaddon.h"
+
+#include <stdio.h>
+
+#include <FindDirectory.h>
+#include <Path.h>
+#include <TranslatorAddOn.h>
+
+
+status_t
+load_translator(const char* path, image_id* _addOn, BTranslator** _translator)
+{
+	BPath installed;
+	if (path == NULL) {
+		status_t status = find_directory(B_USER_NONPACKAGED_ADDONS_DIRECTORY,
+			&installed);
+		if (status != B_OK)
+			return status;
+		installed.Append("Translators/JXLTranslator");
+		path = installed.Path();
+	}
+
+	const image_id addOn = load_add_on(path);
+	if (addOn < 0) {
+		fprintf(stderr, "Could not load the translator %s\n", path);
+		return addOn;
+	}
+	BTranslator* (*makeTranslator)(int32, image_id, uint32, ...);
+	status_t status = get_image_symbol(addOn, "make_nth_translator",
+		B_SYMBOL_TYPE_TEXT, (void**)&makeTranslator);
+	BTranslator* translator = status == B_OK
+		? makeTranslator(0, addOn, 0) : NULL;
+	if (translator == NULL) {
+		fprintf(stderr, "%s is not a translator\n", path);
+		unload_add_on(addOn);
+		return status != B_OK ? status : B_ERROR;
+	}
+
+	*_addOn = addOn;
+	*_translator = translator;
+	return B_OK;
+}
+
+
+void
+unload_translator(image_id addOn, BTranslator* translator)
+{
+	translator->Release();
+	unload_add_on(addOn);
+}
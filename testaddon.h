@@ -0,0 +1,21 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef TESTADDON_H
+#define TESTADDON_H
+
+#include <Translator.h>
+#include <image.h>
+
+// Loads the translator add-on as the Translation Kit does, for jxltest and
+// jxlbench to drive it through its public entry points
+
+status_t load_translator(const char* path, image_id* _addOn,
+	BTranslator** _translator);
+	// loads the add-on at path, or the installed one if it's NULL, and
+	// makes its translator
+void unload_translator(image_id addOn, BTranslator* translator);
+
+
+#endif // TESTADDON_H
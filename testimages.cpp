@@ -0,0 +1,777 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "testimages.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "jxllibrary.h"
+#include "pixelconversion.h"
+
+const uint32 kBitmapMagic = 'bits';
+
+static const char* sKindNames[kNumImageKinds] = {
+	"photo",
+	"screenshot",
+	"alpha",
+	"gray",
+	"icon",
+	"scan"
+};
+
+// The colors screenshots and icons are drawn with, as blue, green, red
+static const uint8 sInterfaceColors[][3] = {
+	{ 0xd8, 0xd8, 0xd8 }, { 0xff, 0xff, 0xff }, { 0x00, 0x00, 0x00 },
+	{ 0x99, 0x99, 0x99 }, { 0x00, 0xcb, 0xff }, { 0xd1, 0x80, 0x33 },
+	{ 0x33, 0x33, 0xcc }, { 0x4d, 0xb3, 0x4d }, { 0x60, 0x60, 0x60 },
+	{ 0xf0, 0xe8, 0xe0 }, { 0xa0, 0x50, 0x20 }, { 0x80, 0x00, 0x80 }
+};
+const uint32 kNumInterfaceColors = sizeof(sInterfaceColors)
+	/ sizeof(sInterfaceColors[0]);
+
+const uint32 kScreenshotWindows = 24;
+
+
+// A well mixed hash of a position, so any pixel can be made on its own
+static inline uint32
+mix(uint32 a, uint32 b, uint32 c)
+{
+	uint32 hash = a * 0x9e3779b1 ^ b * 0x85ebca77 ^ c * 0xc2b2ae3d;
+	hash ^= hash >> 15;
+	hash *= 0x2c1b3c6d;
+	hash ^= hash >> 12;
+	hash *= 0x297a2d39;
+	hash ^= hash >> 15;
+	return hash;
+}
+
+
+static inline uint8
+clamp_byte(int32 value)
+{
+	return std::max(0, std::min(255, value));
+}
+
+
+// A 5 bit channel as the 8 bit value in the middle of its range
+static inline int32
+expand_bits(uint32 value)
+{
+	return (value << 3) | (value >> 2);
+}
+
+
+static void
+write_big_endian(uint8* out, uint32 value)
+{
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+}
+
+
+static void
+write_big_endian(uint8* out, float value)
+{
+	uint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	write_big_endian(out, bits);
+}
+
+
+static void
+make_bits_header(uint32 width, uint32 height, color_space space,
+	size_t rowBytes, uint8* header)
+{
+	write_big_endian(header, kBitmapMagic);
+	write_big_endian(header + 4, 0.0f);
+	write_big_endian(header + 8, 0.0f);
+	write_big_endian(header + 12, width - 1.0f);
+	write_big_endian(header + 16, height - 1.0f);
+	write_big_endian(header + 20, (uint32)rowBytes);
+	write_big_endian(header + 24, (uint32)space);
+	write_big_endian(header + 28,
+		(uint32)std::min((uint64)rowBytes * height, (uint64)UINT32_MAX));
+}
+
+
+static uint32
+read_big_endian(const uint8* in)
+{
+	return (uint32)in[0] << 24 | (uint32)in[1] << 16 | (uint32)in[2] << 8
+		| in[3];
+}
+
+
+static float
+read_big_endian_float(const uint8* in)
+{
+	uint32 bits = read_big_endian(in);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+// #pragma mark - Generators
+
+
+// Value noise of one channel, bilinear between random values on a grid
+static inline int32
+value_noise(uint32 x, uint32 y, uint32 cell, uint32 seed)
+{
+	const uint32 cx = x / cell;
+	const uint32 cy = y / cell;
+	const int32 fx = x % cell * 256 / cell;
+	const int32 fy = y % cell * 256 / cell;
+	const int32 v00 = mix(cx, cy, seed) & 0xff;
+	const int32 v10 = mix(cx + 1, cy, seed) & 0xff;
+	const int32 v01 = mix(cx, cy + 1, seed) & 0xff;
+	const int32 v11 = mix(cx + 1, cy + 1, seed) & 0xff;
+	const int32 top = v00 * 256 + (v10 - v00) * fx;
+	const int32 bottom = v01 * 256 + (v11 - v01) * fx;
+	return (top * 256 + (bottom - top) * fy) >> 16;
+}
+
+
+// Smooth color at two scales with some sensor noise
+static void
+photo_pixel(uint32 x, uint32 y, uint32 seed, uint8* bgra)
+{
+	for (uint32 c = 0; c < 3; c++) {
+		const uint32 channelSeed = seed * 3 + c;
+		int32 value = value_noise(x, y, 96, channelSeed) * 3 / 4
+			+ value_noise(x, y, 12, channelSeed + 0x5000) / 4;
+		value += (int32)(mix(x, y, channelSeed + 0xa000) & 15) - 8;
+		bgra[c] = clamp_byte(value);
+	}
+	bgra[3] = 255;
+}
+
+
+struct ScreenRect {
+	uint32	left;
+	uint32	top;
+	uint32	right;
+	uint32	bottom;
+	uint32	color;
+	bool	text;
+};
+
+
+static void
+make_screen_rects(uint32 width, uint32 height, uint32 seed,
+	ScreenRect* rects)
+{
+	for (uint32 i = 0; i < kScreenshotWindows; i++) {
+		ScreenRect& rect = rects[i];
+		const uint32 w = mix(i, 1, seed) % std::max(1u, width / 2) + 8;
+		const uint32 h = mix(i, 2, seed) % std::max(1u, height / 2) + 8;
+		rect.left = mix(i, 3, seed) % width;
+		rect.top = mix(i, 4, seed) % height;
+		rect.right = rect.left + w;
+		rect.bottom = rect.top + h;
+		rect.color = mix(i, 5, seed) % kNumInterfaceColors;
+		rect.text = (mix(i, 6, seed) & 1) != 0;
+	}
+}
+
+
+// Windows with borders, some of them with lines of text in them
+static void
+screenshot_pixel(uint32 x, uint32 y, uint32 seed, const ScreenRect* rects,
+	uint8* bgra)
+{
+	const uint8* color = sInterfaceColors[3];
+	for (int32 i = kScreenshotWindows - 1; i >= 0; i--) {
+		const ScreenRect& rect = rects[i];
+		if (x < rect.left || x >= rect.right || y < rect.top
+			|| y >= rect.bottom)
+			continue;
+		if (x == rect.left || y == rect.top || x == rect.right - 1
+			|| y == rect.bottom - 1) {
+			color = sInterfaceColors[2];
+		} else if (y < rect.top + 20) {
+			// the tab
+			color = sInterfaceColors[4];
+		} else {
+			color = sInterfaceColors[rect.color];
+			const uint32 line = (y - rect.top - 20) / 14;
+			const uint32 row = (y - rect.top - 20) % 14;
+			const uint32 word = (x - rect.left) / 48;
+			const uint32 column = (x - rect.left) % 48;
+			if (rect.text && row >= 3 && row < 12 && x > rect.left + 4
+				&& column < 8 + mix(line, word, seed) % 36
+				&& (mix(x, y, seed) & 3) == 0)
+				color = sInterfaceColors[2];
+		}
+		break;
+	}
+	bgra[0] = color[0];
+	bgra[1] = color[1];
+	bgra[2] = color[2];
+	bgra[3] = 255;
+}
+
+
+// A photo faded out towards a round edge
+static void
+alpha_pixel(uint32 x, uint32 y, uint32 width, uint32 height, uint32 seed,
+	uint8* bgra)
+{
+	photo_pixel(x, y, seed, bgra);
+	const float dx = x - width / 2.0f;
+	const float dy = y - height / 2.0f;
+	const float radius = std::min(width, height) / 2.0f;
+	const float distance = sqrtf(dx * dx + dy * dy);
+	bgra[3] = clamp_byte((int32)((radius - distance) * 1020 / radius));
+}
+
+
+// A rounded square with a circle on it, on transparency
+static void
+icon_pixel(uint32 x, uint32 y, uint32 width, uint32 height, uint32 seed,
+	uint8* bgra)
+{
+	const int32 inset = std::max(1u, std::min(width, height) / 10);
+	const int32 corner = inset * 2;
+	const int32 left = inset;
+	const int32 top = inset;
+	const int32 right = width - inset - 1;
+	const int32 bottom = height - inset - 1;
+	const int32 px = x;
+	const int32 py = y;
+	const int32 nearX = std::max(left + corner, std::min(right - corner, px));
+	const int32 nearY = std::max(top + corner, std::min(bottom - corner, py));
+	const int32 dx = px - nearX;
+	const int32 dy = py - nearY;
+	const int32 distance = dx * dx + dy * dy;
+	if (px < left || px > right || py < top || py > bottom
+		|| distance > corner * corner) {
+		memset(bgra, 0, 4);
+		return;
+	}
+
+	const uint8* color = sInterfaceColors[4 + seed % 4];
+	if (distance > (corner - 1) * (corner - 1) || px == left || px == right
+		|| py == top || py == bottom) {
+		color = sInterfaceColors[2];
+	} else {
+		const int32 cx = px - (int32)width / 2;
+		const int32 cy = py - (int32)height / 2;
+		const int32 radius = std::min(width, height) / 4;
+		if (cx * cx + cy * cy <= radius * radius)
+			color = sInterfaceColors[1];
+	}
+	bgra[0] = color[0];
+	bgra[1] = color[1];
+	bgra[2] = color[2];
+	bgra[3] = 255;
+}
+
+
+// Lines of handwriting on slightly uneven paper
+static void
+scan_pixel(uint32 x, uint32 y, uint32 width, uint32 height, uint32 seed,
+	uint8* bgra)
+{
+	const uint32 noise = mix(x, y, seed);
+	int32 paper = 236 + (int32)(noise & 7) - 4
+		+ (value_noise(x, y, 256, seed) >> 5);
+	int32 blue = paper - 10;
+
+	const uint32 margin = std::max(width, height) / 20;
+	const uint32 line = y / 28;
+	const uint32 row = y % 28;
+	if (x >= margin && x < width - margin && y >= margin
+		&& y < height - margin && row >= 8 && row < 21) {
+		const uint32 word = x / 64;
+		const uint32 column = x % 64;
+		const uint32 wordLength = mix(line, word, seed) % 56;
+		const uint32 stroke = (x * 7 + row * 3 + (mix(line, word, seed) >> 8))
+			% 11;
+		if (column < wordLength && (stroke < 2 || row == 14)) {
+			paper = 40 + (int32)(noise >> 8 & 31);
+			blue = paper + 30;
+		}
+	}
+	bgra[0] = clamp_byte(blue);
+	bgra[1] = clamp_byte(paper);
+	bgra[2] = clamp_byte(paper);
+	bgra[3] = 255;
+}
+
+
+// #pragma mark -
+
+
+const char*
+image_kind_name(image_kind kind)
+{
+	return kind < kNumImageKinds ? sKindNames[kind] : "unknown";
+}
+
+
+const char*
+color_space_name(color_space space)
+{
+	switch (space) {
+		case B_RGBA32:
+			return "RGBA32";
+		case B_RGB32:
+			return "RGB32";
+		case B_RGBA32_BIG:
+			return "RGBA32_BIG";
+		case B_RGB32_BIG:
+			return "RGB32_BIG";
+		case B_RGB24:
+			return "RGB24";
+		case B_RGB24_BIG:
+			return "RGB24_BIG";
+		case B_RGB16:
+			return "RGB16";
+		case B_RGB16_BIG:
+			return "RGB16_BIG";
+		case B_RGB15:
+			return "RGB15";
+		case B_RGB15_BIG:
+			return "RGB15_BIG";
+		case B_RGBA15:
+			return "RGBA15";
+		case B_RGBA15_BIG:
+			return "RGBA15_BIG";
+		case B_GRAY8:
+			return "GRAY8";
+		case B_GRAY1:
+			return "GRAY1";
+		case B_CMAP8:
+			return "CMAP8";
+		case B_CMYK32:
+			return "CMYK32";
+		case B_CMY32:
+			return "CMY32";
+		case B_CMYA32:
+			return "CMYA32";
+		case B_CMY24:
+			return "CMY24";
+		default:
+			return "unknown";
+	}
+}
+
+
+color_space
+test_image_space(image_kind kind)
+{
+	switch (kind) {
+		case IMAGE_ALPHA:
+		case IMAGE_ICON:
+			return B_RGBA32;
+		case IMAGE_GRAY:
+			return B_GRAY8;
+		default:
+			return B_RGB32;
+	}
+}
+
+
+size_t
+test_image_row_bytes(image_kind kind, uint32 width)
+{
+	const size_t bytes = test_image_space(kind) == B_GRAY8 ? 1 : 4;
+	return (width * bytes + 3) / 4 * 4;
+}
+
+
+void
+make_test_rows(image_kind kind, uint32 width, uint32 height, uint32 seed,
+	uint32 y, uint32 count, uint8* dest, size_t rowBytes)
+{
+	ScreenRect rects[kScreenshotWindows];
+	if (kind == IMAGE_SCREENSHOT)
+		make_screen_rects(width, height, seed, rects);
+
+	for (uint32 row = y; row < y + count; row++) {
+		uint8* out = dest + (size_t)(row - y) * rowBytes;
+		memset(out, 0, rowBytes);
+		for (uint32 x = 0; x < width; x++) {
+			uint8 bgra[4];
+			switch (kind) {
+				case IMAGE_SCREENSHOT:
+					screenshot_pixel(x, row, seed, rects, bgra);
+					break;
+				case IMAGE_ALPHA:
+					alpha_pixel(x, row, width, height, seed, bgra);
+					break;
+				case IMAGE_ICON:
+					icon_pixel(x, row, width, height, seed, bgra);
+					break;
+				case IMAGE_SCAN:
+					scan_pixel(x, row, width, height, seed, bgra);
+					break;
+				default:
+					photo_pixel(x, row, seed, bgra);
+					break;
+			}
+			if (kind == IMAGE_GRAY)
+				out[x] = (bgra[2] * 77 + bgra[1] * 150 + bgra[0] * 29) >> 8;
+			else
+				memcpy(out + x * 4, bgra, 4);
+		}
+	}
+}
+
+
+void
+make_test_image(image_kind kind, uint32 width, uint32 height, uint32 seed,
+	TestImage* image)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%s-%ux%u", image_kind_name(kind),
+		(unsigned)width, (unsigned)height);
+	image->name = name;
+	image->width = width;
+	image->height = height;
+	image->space = test_image_space(kind);
+	image->rowBytes = test_image_row_bytes(kind, width);
+	image->pixels.resize(image->rowBytes * height);
+	make_test_rows(kind, width, height, seed, 0, height, image->pixels.data(),
+		image->rowBytes);
+}
+
+
+void
+pack_test_image(const TestImage& image, uint32 channels,
+	std::vector<uint8>* packed)
+{
+	packed->resize((size_t)image.width * image.height * channels);
+	uint8* out = packed->data();
+	for (uint32 y = 0; y < image.height; y++) {
+		const uint8* row = image.pixels.data() + y * image.rowBytes;
+		for (uint32 x = 0; x < image.width; x++) {
+			if (image.space == B_GRAY8) {
+				for (uint32 c = 0; c < (channels <= 2 ? 1 : 3); c++)
+					*out++ = row[x];
+				if (channels == 2 || channels == 4)
+					*out++ = 255;
+				continue;
+			}
+			const uint8* pixel = row + x * 4;
+			if (channels <= 2) {
+				*out++ = (pixel[2] * 77 + pixel[1] * 150 + pixel[0] * 29) >> 8;
+			} else {
+				*out++ = pixel[2];
+				*out++ = pixel[1];
+				*out++ = pixel[0];
+			}
+			if (channels == 2 || channels == 4)
+				*out++ = pixel[3];
+		}
+	}
+}
+
+
+void
+make_bits_file(const TestImage& image, std::vector<uint8>* file)
+{
+	file->resize(32 + image.pixels.size());
+	make_bits_header(image.width, image.height, image.space, image.rowBytes,
+		file->data());
+	memcpy(file->data() + 32, image.pixels.data(), image.pixels.size());
+}
+
+
+void
+make_test_color_map(color_map* map)
+{
+	memset(map, 0, sizeof(color_map));
+	uint32 index = 0;
+	for (uint32 red = 0; red < 6; red++) {
+		for (uint32 green = 0; green < 6; green++) {
+			for (uint32 blue = 0; blue < 6; blue++) {
+				rgb_color& color = map->color_list[index++];
+				color.red = red * 51;
+				color.green = green * 51;
+				color.blue = blue * 51;
+				color.alpha = 255;
+			}
+		}
+	}
+	// grays in the 5 bit steps the cube leaves free
+	for (uint32 step = 1; step < 31; step++) {
+		if (step == 6 || step == 12 || step == 19 || step == 25)
+			continue;
+		rgb_color& color = map->color_list[index++];
+		color.red = color.green = color.blue = step * 8 + 4;
+		color.alpha = 255;
+	}
+	// the rest stay black, and the last is transparent
+	rgb_color& transparent = map->color_list[B_TRANSPARENT_MAGIC_CMAP8];
+	transparent.red = 0x77;
+	transparent.green = 0x74;
+	transparent.blue = 0x77;
+
+	for (uint32 i = 0; i < 32768; i++) {
+		const int32 red = expand_bits(i >> 10 & 31);
+		const int32 green = expand_bits(i >> 5 & 31);
+		const int32 blue = expand_bits(i & 31);
+		int32 best = INT32_MAX;
+		for (uint32 j = 0; j < B_TRANSPARENT_MAGIC_CMAP8; j++) {
+			const rgb_color& color = map->color_list[j];
+			const int32 distance = (color.red - red) * (color.red - red)
+				+ (color.green - green) * (color.green - green)
+				+ (color.blue - blue) * (color.blue - blue);
+			if (distance < best) {
+				best = distance;
+				map->index_map[i] = j;
+			}
+		}
+	}
+	for (uint32 i = 0; i < 256; i++) {
+		const rgb_color& color = map->color_list[i];
+		map->inversion_map[i] = map->index_map[(31 - (color.red >> 3)) << 10
+			| (31 - (color.green >> 3)) << 5 | (31 - (color.blue >> 3))];
+	}
+}
+
+
+// #pragma mark -
+
+
+TestImageInput::TestImageInput(image_kind kind, uint32 width, uint32 height,
+	uint32 seed)
+	:
+	fKind(kind),
+	fWidth(width),
+	fHeight(height),
+	fSeed(seed),
+	fRowBytes(test_image_row_bytes(kind, width)),
+	fRow(new uint8[fRowBytes]),
+	fRowIndex(-1)
+{
+	make_bits_header(width, height, test_image_space(kind), fRowBytes,
+		fHeader);
+}
+
+
+TestImageInput::~TestImageInput()
+{
+	delete[] fRow;
+}
+
+
+ssize_t
+TestImageInput::ReadAt(off_t position, void* buffer, size_t size)
+{
+	if (position < 0)
+		return B_BAD_VALUE;
+	uint8* out = (uint8*)buffer;
+	size_t done = 0;
+	while (done < size && position < Size()) {
+		if (position < (off_t)sizeof(fHeader)) {
+			const size_t count = std::min(size - done,
+				(size_t)(sizeof(fHeader) - position));
+			memcpy(out + done, fHeader + position, count);
+			done += count;
+			position += count;
+			continue;
+		}
+
+		const uint64 offset = position - sizeof(fHeader);
+		const int64 row = offset / fRowBytes;
+		const size_t column = offset % fRowBytes;
+		if (row != fRowIndex) {
+			make_test_rows(fKind, fWidth, fHeight, fSeed, row, 1, fRow,
+				fRowBytes);
+			fRowIndex = row;
+		}
+		const size_t count = std::min(size - done, fRowBytes - column);
+		memcpy(out + done, fRow + column, count);
+		done += count;
+		position += count;
+	}
+	return done;
+}
+
+
+off_t
+TestImageInput::Size() const
+{
+	return sizeof(fHeader) + (off_t)fRowBytes * fHeight;
+}
+
+
+// #pragma mark -
+
+
+status_t
+parse_bits_header(const uint8* header, TestImage* image)
+{
+	if (read_big_endian(header) != kBitmapMagic)
+		return B_NO_TRANSLATOR;
+
+	const float width = ceilf(read_big_endian_float(header + 12)
+		- read_big_endian_float(header + 4)) + 1;
+	const float height = ceilf(read_big_endian_float(header + 16)
+		- read_big_endian_float(header + 8)) + 1;
+	const size_t rowBytes = read_big_endian(header + 20);
+	const color_space space = (color_space)read_big_endian(header + 24);
+	const uint32 bits = RowConverter::BitsPerPixel(space);
+	if (bits == 0 || !(width >= 1 && height >= 1) || width > (1 << 30)
+		|| height > (1 << 30) || (uint64)width * bits > (uint64)rowBytes * 8)
+		return B_BAD_DATA;
+
+	image->width = width;
+	image->height = height;
+	image->space = space;
+	image->rowBytes = rowBytes;
+	return B_OK;
+}
+
+
+// #pragma mark -
+
+
+status_t
+encode_rgb16(const JxlLibrary* jxl, uint32 width, uint32 height,
+	const JxlColorEncoding& encoding, float intensityTarget,
+	const std::vector<uint16>& pixels, std::vector<uint8>* file)
+{
+	JxlEncoder* encoder = jxl->EncoderCreate(NULL);
+	if (encoder == NULL)
+		return B_NO_MEMORY;
+	JxlBasicInfo info;
+	jxl->EncoderInitBasicInfo(&info);
+	info.xsize = width;
+	info.ysize = height;
+	info.bits_per_sample = 16;
+	info.num_color_channels = 3;
+	info.uses_original_profile = JXL_TRUE;
+	info.intensity_target = intensityTarget;
+	const JxlPixelFormat format = { 3, JXL_TYPE_UINT16, JXL_NATIVE_ENDIAN, 0 };
+	JxlEncoderFrameSettings* settings = NULL;
+	status_t status = B_ERROR;
+	if (jxl->EncoderSetBasicInfo(encoder, &info) == JXL_ENC_SUCCESS
+		&& jxl->EncoderSetColorEncoding(encoder, &encoding) == JXL_ENC_SUCCESS
+		&& (settings = jxl->EncoderFrameSettingsCreate(encoder, NULL)) != NULL
+		&& jxl->EncoderSetFrameLossless(settings, JXL_TRUE) == JXL_ENC_SUCCESS
+		&& jxl->EncoderFrameSettingsSetOption(settings,
+			JXL_ENC_FRAME_SETTING_EFFORT, 1) == JXL_ENC_SUCCESS
+		&& jxl->EncoderAddImageFrame(settings, &format, pixels.data(),
+			pixels.size() * sizeof(uint16)) == JXL_ENC_SUCCESS) {
+		jxl->EncoderCloseInput(encoder);
+		file->resize(1 << 20);
+		size_t used = 0;
+		JxlEncoderStatus result = JXL_ENC_NEED_MORE_OUTPUT;
+		while (result == JXL_ENC_NEED_MORE_OUTPUT) {
+			if (used == file->size())
+				file->resize(file->size() * 2);
+			uint8* next = file->data() + used;
+			size_t available = file->size() - used;
+			result = jxl->EncoderProcessOutput(encoder, &next, &available);
+			used = next - file->data();
+		}
+		file->resize(used);
+		if (result == JXL_ENC_SUCCESS)
+			status = B_OK;
+	}
+	jxl->EncoderDestroy(encoder);
+	return status;
+}
+
+
+bool
+get_icc_profile(const JxlLibrary* jxl, const uint8* file, size_t size,
+	std::vector<uint8>* profile)
+{
+	JxlDecoder* decoder = jxl->DecoderCreate(NULL);
+	if (decoder == NULL)
+		return false;
+	bool found = false;
+	if (jxl->DecoderSubscribeEvents(decoder, JXL_DEC_COLOR_ENCODING)
+			== JXL_DEC_SUCCESS
+		&& jxl->DecoderSetInput(decoder, file, size) == JXL_DEC_SUCCESS) {
+		JxlDecoderStatus status;
+		while ((status = jxl->DecoderProcessInput(decoder))
+				!= JXL_DEC_COLOR_ENCODING) {
+			if (status == JXL_DEC_ERROR || status == JXL_DEC_SUCCESS
+				|| status == JXL_DEC_NEED_MORE_INPUT)
+				break;
+		}
+		size_t profileSize;
+		if (status == JXL_DEC_COLOR_ENCODING
+			&& jxl->DecoderGetICCProfileSize(decoder,
+				JXL_COLOR_PROFILE_TARGET_DATA, &profileSize)
+					== JXL_DEC_SUCCESS) {
+			profile->resize(profileSize);
+			found = jxl->DecoderGetColorAsICCProfile(decoder,
+				JXL_COLOR_PROFILE_TARGET_DATA, profile->data(), profileSize)
+					== JXL_DEC_SUCCESS;
+		}
+	}
+	jxl->DecoderDestroy(decoder);
+	return found;
+}
+
+
+// Whether the 1:8 image, or the whole one, comes out of the start of a file.
+// libjxl reports each progression down to the 1:8 pass by default.
+static bool
+decodes_first_paint(const JxlLibrary* jxl, const uint8* file, size_t size)
+{
+	JxlDecoder* decoder = jxl->DecoderCreate(NULL);
+	if (decoder == NULL)
+		return false;
+
+	const JxlPixelFormat format = { 4, JXL_TYPE_UINT8, JXL_NATIVE_ENDIAN, 0 };
+	std::vector<uint8> pixels;
+	bool decoded = false;
+	if (jxl->DecoderSubscribeEvents(decoder, JXL_DEC_BASIC_INFO
+			| JXL_DEC_FRAME_PROGRESSION | JXL_DEC_FULL_IMAGE) == JXL_DEC_SUCCESS
+		&& jxl->DecoderSetInput(decoder, file, size) == JXL_DEC_SUCCESS) {
+		for (;;) {
+			const JxlDecoderStatus status = jxl->DecoderProcessInput(decoder);
+			if (status == JXL_DEC_FRAME_PROGRESSION
+				|| status == JXL_DEC_FULL_IMAGE) {
+				decoded = true;
+				break;
+			}
+			if (status == JXL_DEC_NEED_IMAGE_OUT_BUFFER) {
+				size_t bufferSize;
+				if (jxl->DecoderImageOutBufferSize(decoder, &format,
+						&bufferSize) != JXL_DEC_SUCCESS)
+					break;
+				pixels.resize(bufferSize);
+				if (jxl->DecoderSetImageOutBuffer(decoder, &format,
+						pixels.data(), pixels.size()) != JXL_DEC_SUCCESS)
+					break;
+			} else if (status != JXL_DEC_BASIC_INFO)
+				break;
+		}
+	}
+	jxl->DecoderDestroy(decoder);
+	return decoded;
+}
+
+
+size_t
+first_paint_offset(const JxlLibrary* jxl, const uint8* file, size_t size)
+{
+	// a longer start never decodes less, so it can be searched for
+	size_t low = 0;
+	size_t high = size;
+	while (high - low > 1) {
+		const size_t middle = low + (high - low) / 2;
+		if (decodes_first_paint(jxl, file, middle))
+			high = middle;
+		else
+			low = middle;
+	}
+	return high;
+}
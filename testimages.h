@@ -0,0 +1,125 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef TESTIMAGES_H
+#define TESTIMAGES_H
+
+#include "codecdefs.h"
+#include "codecio.h"
+
+#include <string>
+#include <vector>
+
+#include <jxl/color_encoding.h>
+
+struct JxlLibrary;
+
+// Synthetic images for the tests and benchmarks. They come out the same on
+// every run and machine, so results can be compared between them.
+
+enum image_kind {
+	IMAGE_PHOTO = 0,
+		// smooth color with fine noise, RGB
+	IMAGE_SCREENSHOT,
+		// flat areas, sharp edges and a few dozen colors, RGB
+	IMAGE_ALPHA,
+		// a photo cut out with a soft edge, RGBA
+	IMAGE_GRAY,
+		// a gray photo
+	IMAGE_ICON,
+		// a small shape with hard edges on transparency, RGBA
+	IMAGE_SCAN,
+		// lines of dark strokes on paper, RGB, meant to be made huge
+	kNumImageKinds
+};
+
+
+// All the color spaces rows can be converted between
+const color_space kRowColorSpaces[] = {
+	B_RGBA32, B_RGB32, B_RGBA32_BIG, B_RGB32_BIG, B_RGB24, B_RGB24_BIG,
+	B_RGB16, B_RGB16_BIG, B_RGB15, B_RGB15_BIG, B_RGBA15, B_RGBA15_BIG,
+	B_GRAY8, B_GRAY1, B_CMAP8, B_CMYK32, B_CMY32, B_CMYA32, B_CMY24
+};
+
+
+// A bitmap as it would follow a TranslatorBitmap header
+struct TestImage {
+			std::string		name;
+			uint32			width;
+			uint32			height;
+			color_space		space;
+				// B_RGB32, B_RGBA32 or B_GRAY8 when synthetic
+			size_t			rowBytes;
+			std::vector<uint8> pixels;
+};
+
+
+// The .bits file of a synthetic image, made as it is read so that images
+// of any size can be streamed to the encoder. Like the inputs the chunked
+// encoder reads from, it is read by one thread at a time.
+class TestImageInput : public CodecInput {
+public:
+								TestImageInput(image_kind kind, uint32 width,
+									uint32 height, uint32 seed);
+	virtual						~TestImageInput();
+
+	virtual	ssize_t				ReadAt(off_t position, void* buffer,
+									size_t size);
+
+			off_t				Size() const;
+
+private:
+			image_kind			fKind;
+			uint32				fWidth;
+			uint32				fHeight;
+			uint32				fSeed;
+			size_t				fRowBytes;
+			uint8				fHeader[32];
+			uint8*				fRow;
+			int64				fRowIndex;
+				// of the row in fRow, -1 before the first
+};
+
+
+const char* image_kind_name(image_kind kind);
+const char* color_space_name(color_space space);
+color_space test_image_space(image_kind kind);
+size_t test_image_row_bytes(image_kind kind, uint32 width);
+	// padded to 4 bytes, like a BBitmap
+
+void make_test_rows(image_kind kind, uint32 width, uint32 height,
+	uint32 seed, uint32 y, uint32 count, uint8* dest, size_t rowBytes);
+	// Any rows of an image can be made on their own, they come out the
+	// same as in the whole image
+void make_test_image(image_kind kind, uint32 width, uint32 height,
+	uint32 seed, TestImage* image);
+
+void pack_test_image(const TestImage& image, uint32 channels,
+	std::vector<uint8>* packed);
+	// packs a B_RGB32, B_RGBA32 or B_GRAY8 image to 1 (gray), 2 (gray and
+	// alpha), 3 (RGB) or 4 (RGBA) 8 bit channels for EncodePixels()
+
+void make_bits_file(const TestImage& image, std::vector<uint8>* file);
+	// the image with its big endian TranslatorBitmap header in front
+status_t parse_bits_header(const uint8* header, TestImage* image);
+	// fills in the size and layout from the 32 bytes of a .bits header
+
+void make_test_color_map(color_map* map);
+	// a 6x6x6 color cube and grays, with an index map that gives each of
+	// them back its own index
+
+status_t encode_rgb16(const JxlLibrary* jxl, uint32 width, uint32 height,
+	const JxlColorEncoding& encoding, float intensityTarget,
+	const std::vector<uint16>& pixels, std::vector<uint8>* file);
+	// stores 16 bit RGB pixels losslessly
+bool get_icc_profile(const JxlLibrary* jxl, const uint8* file, size_t size,
+	std::vector<uint8>* profile);
+	// a JPEG XL file's ICC profile as libjxl describes it
+size_t first_paint_offset(const JxlLibrary* jxl, const uint8* file,
+	size_t size);
+	// How much of the start of a JPEG XL file its 1:8 image can be decoded
+	// from, size if it takes the whole file
+
+
+#endif // TESTIMAGES_H
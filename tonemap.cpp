@@ -0,0 +1,307 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "tonemap.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const size_t kLinearTableSize = 4096;
+const size_t kEncodeTableSize = 16384;
+const size_t kStripPixels = 256;
+
+// Reference white of HDR content in nits, from ITU-R BT.2408. SDR content
+// keeps its own intensity target as white.
+const float kHdrReferenceWhite = 203.0f;
+const float kSdrIntensityTarget = 255.0f;
+
+// 4x4 ordered dither thresholds, added before truncating to 8 bits
+static const float sDither[4][4] = {
+	{ 0.5f / 16, 8.5f / 16, 2.5f / 16, 10.5f / 16 },
+	{ 12.5f / 16, 4.5f / 16, 14.5f / 16, 6.5f / 16 },
+	{ 3.5f / 16, 11.5f / 16, 1.5f / 16, 9.5f / 16 },
+	{ 15.5f / 16, 7.5f / 16, 13.5f / 16, 5.5f / 16 }
+};
+
+
+static float
+srgb_to_linear(float value)
+{
+	if (value <= 0.04045f)
+		return value / 12.92f;
+	return powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+
+// Linear to sRGB, times 255
+struct EncodeTable {
+	float	values[kEncodeTableSize];
+
+	EncodeTable()
+	{
+		for (size_t i = 0; i < kEncodeTableSize; i++) {
+			float value = (float)i / (kEncodeTableSize - 1);
+			if (value <= 0.0031308f)
+				value *= 12.92f;
+			else
+				value = 1.055f * powf(value, 1 / 2.4f) - 0.055f;
+			values[i] = value * 255;
+		}
+	}
+};
+
+
+static const float*
+encode_table()
+{
+	static const EncodeTable sTable;
+	return sTable.values;
+}
+
+
+// Encoded value to linear light, 1.0 being the nominal peak of the
+// transfer function
+static float
+to_linear(const JxlColorEncoding& encoding, float value)
+{
+	switch (encoding.transfer_function) {
+		case JXL_TRANSFER_FUNCTION_709:
+			if (value < 0.081f)
+				return value / 4.5f;
+			return powf((value + 0.099f) / 1.099f, 1 / 0.45f);
+		case JXL_TRANSFER_FUNCTION_GAMMA:
+			return powf(value, 1 / (float)encoding.gamma);
+		case JXL_TRANSFER_FUNCTION_DCI:
+			return powf(value, 2.6f);
+		case JXL_TRANSFER_FUNCTION_PQ:
+		{
+			const float m1 = 0.1593017578125f;
+			const float m2 = 78.84375f;
+			const float c1 = 0.8359375f;
+			const float c2 = 18.8515625f;
+			const float c3 = 18.6875f;
+			float p = powf(value, 1 / m2);
+			return powf(std::max(p - c1, 0.0f) / (c2 - c3 * p), 1 / m1);
+		}
+		case JXL_TRANSFER_FUNCTION_HLG:
+		{
+			const float a = 0.17883277f;
+			const float b = 0.28466892f;
+			const float c = 0.55991073f;
+			float scene = value <= 0.5f ? value * value / 3
+				: (expf((value - c) / a) + b) / 12;
+			// the system gamma of a 1000 nit display, per channel rather
+			// than on the luminance
+			return powf(scene, 1.2f);
+		}
+		default:
+			return srgb_to_linear(value);
+	}
+}
+
+
+template<tone_curve kCurve>
+static inline float
+apply_curve(float value, float whiteSquared)
+{
+	value = std::max(value, 0.0f);
+	if (kCurve == TONE_CURVE_REINHARD) {
+		// extended to reach 1.0 at the peak
+		value = value * (1 + value / whiteSquared) / (1 + value);
+	} else if (kCurve == TONE_CURVE_ACES) {
+		// Narkowicz' fit, with its usual exposure
+		value *= 0.6f;
+		value = value * (2.51f * value + 0.03f)
+			/ (value * (2.43f * value + 0.59f) + 0.14f);
+	}
+	return std::min(value, 1.0f);
+}
+
+
+#if defined(__SSE2__)
+
+template<tone_curve kCurve>
+static inline __m128
+apply_curve(__m128 value, __m128 whiteSquared)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	value = _mm_max_ps(value, _mm_setzero_ps());
+	if (kCurve == TONE_CURVE_REINHARD) {
+		__m128 numerator = _mm_mul_ps(value,
+			_mm_add_ps(one, _mm_div_ps(value, whiteSquared)));
+		value = _mm_div_ps(numerator, _mm_add_ps(one, value));
+	} else if (kCurve == TONE_CURVE_ACES) {
+		value = _mm_mul_ps(value, _mm_set1_ps(0.6f));
+		__m128 numerator = _mm_mul_ps(value, _mm_add_ps(
+			_mm_mul_ps(value, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+		__m128 denominator = _mm_add_ps(_mm_mul_ps(value, _mm_add_ps(
+				_mm_mul_ps(value, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))),
+			_mm_set1_ps(0.14f));
+		value = _mm_div_ps(numerator, denominator);
+	}
+	return _mm_min_ps(value, one);
+}
+
+#endif
+
+
+// Scales and maps the color channels of count pixels in place, leaving
+// alpha alone
+template<tone_curve kCurve>
+static void
+apply_curve_rgba(float* pixels, size_t count, float scale, float peak)
+{
+	const float whiteSquared = peak * peak;
+	size_t i = 0;
+#if defined(__SSE2__)
+	// a pixel at a time, with alpha passed through
+	const __m128 scaleVector = _mm_setr_ps(scale, scale, scale, 1.0f);
+	const __m128 whiteVector = _mm_set1_ps(whiteSquared);
+	const __m128 colorMask
+		= _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	for (; i < count; i++) {
+		__m128 pixel = _mm_loadu_ps(pixels + i * 4);
+		__m128 mapped = apply_curve<kCurve>(_mm_mul_ps(pixel, scaleVector),
+			whiteVector);
+		_mm_storeu_ps(pixels + i * 4, _mm_or_ps(
+			_mm_and_ps(colorMask, mapped), _mm_andnot_ps(colorMask, pixel)));
+	}
+#endif
+	for (; i < count; i++) {
+		for (int c = 0; c < 3; c++) {
+			pixels[i * 4 + c] = apply_curve<kCurve>(
+				pixels[i * 4 + c] * scale, whiteSquared);
+		}
+	}
+}
+
+
+// #pragma mark -
+
+
+ToneMapper::ToneMapper(tone_curve curve, const JxlBasicInfo& info,
+	const JxlColorEncoding* encoding)
+	:
+	fCurve(curve)
+{
+	float intensityTarget = info.intensity_target > 0
+		? info.intensity_target : kSdrIntensityTarget;
+	float white = intensityTarget > kSdrIntensityTarget
+		? kHdrReferenceWhite : intensityTarget;
+	float nominalPeak = intensityTarget;
+
+	JxlTransferFunction transfer = encoding != NULL
+		? encoding->transfer_function : JXL_TRANSFER_FUNCTION_SRGB;
+	if (transfer == JXL_TRANSFER_FUNCTION_PQ)
+		nominalPeak = 10000;
+	else if (transfer == JXL_TRANSFER_FUNCTION_HLG)
+		nominalPeak = 1000;
+
+	fScale = nominalPeak / white;
+	fPeak = std::max(1.0f, intensityTarget / white);
+
+	if (transfer != JXL_TRANSFER_FUNCTION_LINEAR) {
+		JxlColorEncoding srgb;
+		memset(&srgb, 0, sizeof(srgb));
+		srgb.transfer_function = JXL_TRANSFER_FUNCTION_SRGB;
+		const JxlColorEncoding& source = encoding != NULL ? *encoding : srgb;
+		fToLinear.resize(kLinearTableSize);
+		for (size_t i = 0; i < kLinearTableSize; i++) {
+			fToLinear[i] = to_linear(source,
+				(float)i / (kLinearTableSize - 1));
+		}
+	}
+}
+
+
+bool
+ToneMapper::IsWanted(tone_curve curve, const JxlBasicInfo& info)
+{
+	return curve != TONE_CURVE_NONE && (info.bits_per_sample > 8
+		|| info.exponent_bits_per_sample > 0
+		|| info.intensity_target > kSdrIntensityTarget);
+}
+
+
+void
+ToneMapper::MapRow(const float* rgba, size_t x, size_t y, size_t count,
+	bool bgra, uint8* out) const
+{
+	const float* encode = encode_table();
+	const float* dither = sDither[y & 3];
+	const int red = bgra ? 2 : 0;
+	const int blue = bgra ? 0 : 2;
+	float linear[kStripPixels * 4];
+	for (size_t start = 0; start < count; start += kStripPixels) {
+		size_t strip = std::min(kStripPixels, count - start);
+		_ToLinear(rgba + start * 4, strip, linear);
+		_ApplyCurve(linear, strip);
+
+		uint8* dest = out + start * 4;
+		for (size_t i = 0; i < strip; i++) {
+			const float* pixel = linear + i * 4;
+			const float threshold = dither[(x + start + i) & 3];
+			uint8 encoded[3];
+			for (int c = 0; c < 3; c++) {
+				size_t index = (size_t)(pixel[c] * (kEncodeTableSize - 1)
+					+ 0.5f);
+				encoded[c] = (uint8)std::min(encode[index] + threshold,
+					255.0f);
+			}
+			dest[i * 4 + red] = encoded[0];
+			dest[i * 4 + 1] = encoded[1];
+			dest[i * 4 + blue] = encoded[2];
+			float alpha = std::min(std::max(pixel[3], 0.0f), 1.0f);
+			dest[i * 4 + 3] = (uint8)std::min(alpha * 255 + threshold,
+				255.0f);
+		}
+	}
+}
+
+
+void
+ToneMapper::_ToLinear(const float* rgba, size_t count, float* linear) const
+{
+	if (fToLinear.empty()) {
+		memcpy(linear, rgba, count * 4 * sizeof(float));
+		return;
+	}
+
+	const float last = kLinearTableSize - 1;
+	for (size_t i = 0; i < count * 4; i++) {
+		if ((i & 3) == 3) {
+			linear[i] = rgba[i];
+			continue;
+		}
+		float position = std::min(std::max(rgba[i], 0.0f), 1.0f) * last;
+		size_t index = std::min((size_t)position, kLinearTableSize - 2);
+		float fraction = position - index;
+		linear[i] = fToLinear[index]
+			+ (fToLinear[index + 1] - fToLinear[index]) * fraction;
+	}
+}
+
+
+void
+ToneMapper::_ApplyCurve(float* linear, size_t count) const
+{
+	switch (fCurve) {
+		case TONE_CURVE_REINHARD:
+			apply_curve_rgba<TONE_CURVE_REINHARD>(linear, count, fScale,
+				fPeak);
+			break;
+		case TONE_CURVE_ACES:
+			apply_curve_rgba<TONE_CURVE_ACES>(linear, count, fScale, fPeak);
+			break;
+		default:
+			apply_curve_rgba<TONE_CURVE_CLIP>(linear, count, fScale, fPeak);
+			break;
+	}
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include "codecdefs.h"
+
+#include <jxl/codestream_header.h>
+#include <jxl/color_encoding.h>
+
+#include <vector>
+
+// How images with more than 8 bits per channel are brought down to 8, the
+// values of JXL_EXT_TONE_CURVE
+enum tone_curve {
+	TONE_CURVE_NONE = 0,
+		// libjxl converts to 8 bits, clipping anything brighter than white
+	TONE_CURVE_CLIP = 1,
+	TONE_CURVE_REINHARD = 2,
+	TONE_CURVE_ACES = 3
+};
+
+const int32 kNumToneCurves = 4;
+
+
+// Maps decoded float pixels to dithered 8 bit sRGB. Holds no state between
+// rows, so rows may be mapped from several threads at once.
+class ToneMapper {
+public:
+						ToneMapper(tone_curve curve,
+							const JxlBasicInfo& info,
+							const JxlColorEncoding* encoding);
+				// encoding is that of the decoded pixels, NULL to take
+				// them as sRGB
+
+	static	bool		IsWanted(tone_curve curve, const JxlBasicInfo& info);
+				// whether the image has more than 8 bits to map with the
+				// curve
+
+			void		MapRow(const float* rgba, size_t x, size_t y,
+							size_t count, bool bgra, uint8* out) const;
+				// maps count pixels of row y starting at column x, writing
+				// them in R, G, B, A order, or B, G, R, A with bgra set
+
+private:
+			void		_ToLinear(const float* rgba, size_t count,
+							float* linear) const;
+			void		_ApplyCurve(float* linear, size_t count) const;
+
+			tone_curve	fCurve;
+			float		fScale;
+				// brings the linear values to 1.0 = reference white
+			float		fPeak;
+				// the brightest value after scaling
+			std::vector<float> fToLinear;
+				// samples of the transfer function, empty if linear
+};
+
+
+#endif // TONEMAP_H
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "translationmetrics.h"
+
+#include <Message.h>
+
+#include "jxltranslator.h"
+
+static const char* sPhaseNames[kNumTranslationPhases] = {
+	JXL_METRICS_READ_TIME,
+	JXL_METRICS_CONVERT_TIME,
+	JXL_METRICS_WRITE_TIME,
+	JXL_METRICS_CODEC_TIME
+};
+
+
+void
+add_translation_metrics(const TranslationMetrics& metrics, BMessage* message)
+{
+	for (uint32 i = 0; i < kNumTranslationPhases; i++) {
+		message->RemoveName(sPhaseNames[i]);
+		message->AddInt64(sPhaseNames[i], metrics.phaseTime[i]);
+	}
+	message->RemoveName(JXL_METRICS_TOTAL_TIME);
+	message->RemoveName(JXL_METRICS_BYTES_IN);
+	message->RemoveName(JXL_METRICS_BYTES_OUT);
+	message->RemoveName(JXL_METRICS_PIXELS);
+	message->RemoveName(JXL_METRICS_BITS_PER_PIXEL);
+	message->RemoveName(JXL_METRICS_PEAK_MEMORY);
+	message->AddInt64(JXL_METRICS_TOTAL_TIME, metrics.totalTime);
+	message->AddInt64(JXL_METRICS_BYTES_IN, metrics.bytesIn);
+	message->AddInt64(JXL_METRICS_BYTES_OUT, metrics.bytesOut);
+	message->AddInt64(JXL_METRICS_PIXELS, metrics.pixels);
+	message->AddFloat(JXL_METRICS_BITS_PER_PIXEL, metrics.BitsPerPixel());
+	message->AddInt64(JXL_METRICS_PEAK_MEMORY, metrics.peakMemory);
+}
+
+
+void
+add_metrics_summary(const MetricsSummary& summary, BMessage* message)
+{
+	message->AddInt64(JXL_METRICS_COUNT, summary.count);
+	for (uint32 i = 0; i < kNumTranslationPhases; i++)
+		message->AddInt64(sPhaseNames[i], summary.phaseTime[i]);
+	message->AddInt64(JXL_METRICS_TOTAL_TIME, summary.totalTime);
+	message->AddInt64(JXL_METRICS_BYTES_IN, summary.bytesIn);
+	message->AddInt64(JXL_METRICS_BYTES_OUT, summary.bytesOut);
+	message->AddInt64(JXL_METRICS_PIXELS, summary.pixels);
+	message->AddFloat(JXL_METRICS_BITS_PER_PIXEL, summary.BitsPerPixel());
+	message->AddInt64(JXL_METRICS_PEAK_MEMORY, summary.peakMemory);
+	message->AddInt64(JXL_METRICS_LATENCY_P50, summary.latencyP50);
+	message->AddInt64(JXL_METRICS_LATENCY_P90, summary.latencyP90);
+	message->AddInt64(JXL_METRICS_LATENCY_P99, summary.latencyP99);
+	for (uint32 i = 0; i < kNumHistogramBuckets; i++) {
+		message->AddInt64(JXL_METRICS_LATENCY_HISTOGRAM, summary.latency[i]);
+		message->AddInt64(JXL_METRICS_SPEED_HISTOGRAM, summary.speed[i]);
+	}
+}
@@ -0,0 +1,21 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef TRANSLATIONMETRICS_H
+#define TRANSLATIONMETRICS_H
+
+#include "codecmetrics.h"
+
+class BMessage;
+
+
+void add_translation_metrics(const TranslationMetrics& metrics,
+	BMessage* message);
+	// replaces the JXL_METRICS_* fields in message with those of a single
+	// translation
+void add_metrics_summary(const MetricsSummary& summary, BMessage* message);
+	// adds the JXL_METRICS_* fields of an aggregate to message
+
+
+#endif // TRANSLATIONMETRICS_H
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#include "translationmonitor.h"
+
+#include <Message.h>
+
+#include "jxltranslator.h"
+
+
+TranslationMonitor::TranslationMonitor(BMessage* ioExtension)
+{
+	if (ioExtension == NULL)
+		return;
+
+	void* cancel;
+	if (ioExtension->FindPointer(JXL_EXT_CANCEL, &cancel) == B_OK)
+		SetCancelFlag((int32*)cancel);
+	ioExtension->FindMessenger(JXL_EXT_PROGRESS_TARGET, &fTarget);
+}
+
+
+bool
+TranslationMonitor::ReportsProgress() const
+{
+	return fTarget.IsValid();
+}
+
+
+void
+TranslationMonitor::ReportProgress(float fraction)
+{
+	BMessage message(JXL_MSG_PROGRESS);
+	message.AddFloat(JXL_PROGRESS_FRACTION, fraction);
+	// never hold up the translation for a busy receiver
+	fTarget.SendMessage(&message, (BHandler*)NULL, 0);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2026, Gustaf "Hanicef" Alhäll <gustaf@hanicef.me>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef TRANSLATIONMONITOR_H
+#define TRANSLATIONMONITOR_H
+
+#include <Messenger.h>
+
+#include "codecmonitor.h"
+
+class BMessage;
+
+
+// Follows one translation for the caller: tells it how far along it is
+// and whether it asked to stop, through the JXL_EXT_CANCEL and
+// JXL_EXT_PROGRESS_TARGET fields of ioExtension
+class TranslationMonitor : public CodecMonitor {
+public:
+							TranslationMonitor(BMessage* ioExtension);
+
+	virtual	bool			ReportsProgress() const;
+
+protected:
+	virtual	void			ReportProgress(float fraction);
+
+private:
+			BMessenger		fTarget;
+};
+
+
+#endif // TRANSLATIONMONITOR_H